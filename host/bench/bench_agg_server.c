@@ -0,0 +1,201 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Aggregation server over localhost TCP: aggregate throughput of simulated devices by worker
+// count, with capture files and without, and block validation alone
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "bench_util.h"
+#include "agg_server.h"
+
+#define BLOCK_SAMPLES 8192
+#define BLOCKS_PER_DEVICE 64 // pre-encoded and sent round robin
+#define RUN_S 1.0
+
+typedef struct
+{
+    pthread_t thread;
+    uint16_t device;
+    uint16_t port;
+    uint8_t *blocks;
+    size_t bytes;
+    uint64_t sent;
+} sim_device_t;
+
+static volatile int s_running;
+
+static void *device_main(void *arg)
+{
+    sim_device_t *d = arg;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(d->port)};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    // Whole passes over the pre-encoded blocks, so the server always sees complete blocks
+    while (s_running)
+    {
+        size_t off = 0;
+        while (off < d->bytes)
+        {
+            ssize_t r = send(fd, d->blocks + off, d->bytes - off, MSG_NOSIGNAL);
+            if (r <= 0)
+            {
+                close(fd);
+                return NULL;
+            }
+            off += (size_t)r;
+        }
+        d->sent += d->bytes;
+    }
+    close(fd);
+    return NULL;
+}
+
+static uint8_t *encode_device(uint16_t device, size_t *bytes)
+{
+    const size_t block_bytes = STREAM_HEADER_BYTES + stream_payload_bytes(STREAM_FMT_PACK13, BLOCK_SAMPLES);
+    uint8_t *out = malloc(block_bytes * BLOCKS_PER_DEVICE);
+    static sample_t samples[BLOCK_SAMPLES];
+    for (uint32_t b = 0; b < BLOCKS_PER_DEVICE; b++)
+    {
+        for (int i = 0; i < BLOCK_SAMPLES; i++)
+        {
+            samples[i] = (sample_t)(bench_rand() & 0x1fff);
+        }
+        stream_block_t blk = {
+            .device = device,
+            .channel = (uint8_t)(b & 1),
+            .format = STREAM_FMT_PACK13,
+            .seq = b / 2,
+            .samples = BLOCK_SAMPLES,
+            .pos = (uint64_t)(b / 2) * BLOCK_SAMPLES,
+        };
+        stream_block_encode(&blk, samples, out + b * block_bytes);
+    }
+    *bytes = block_bytes * BLOCKS_PER_DEVICE;
+    return out;
+}
+
+static void bench_server(int workers, int devices, const char *dir)
+{
+    agg_server_t *srv = calloc(1, sizeof(*srv));
+    agg_config_t cfg = {.dir = dir, .workers = workers};
+    if (!agg_server_start(srv, &cfg))
+    {
+        printf("server start failed\n");
+        free(srv);
+        return;
+    }
+    sim_device_t *devs = calloc((size_t)devices, sizeof(*devs));
+    s_running = 1;
+    for (int i = 0; i < devices; i++)
+    {
+        devs[i].device = (uint16_t)i;
+        devs[i].port = agg_server_port(srv);
+        devs[i].blocks = encode_device((uint16_t)i, &devs[i].bytes);
+    }
+    agg_stats_t before, after;
+    agg_server_stats(srv, &before);
+    double t0 = bench_now_s();
+    for (int i = 0; i < devices; i++)
+    {
+        pthread_create(&devs[i].thread, NULL, device_main, &devs[i]);
+    }
+    usleep((useconds_t)(RUN_S * 1e6));
+    agg_server_stats(srv, &after);
+    double dt = bench_now_s() - t0;
+    s_running = 0;
+    for (int i = 0; i < devices; i++)
+    {
+        pthread_join(devs[i].thread, NULL);
+        free(devs[i].blocks);
+    }
+    agg_server_stop(srv);
+
+    double mb_s = (after.bytes - before.bytes) / dt / 1e6;
+    printf("  workers %2d  devices %3d  %-7s  %8.1f MB/s  %8.0f blocks/s  %4.2f Msamples/s per device  bad %" PRIu64 "\n",
+           workers, devices, dir ? "files" : "no file", mb_s, (after.blocks - before.blocks) / dt,
+           (after.blocks - before.blocks) * (double)BLOCK_SAMPLES / dt / devices / 1e6, after.bad_blocks);
+    if (dir != NULL)
+    {
+        char path[256];
+        for (int i = 0; i < devices; i++)
+        {
+            for (int ch = 0; ch < 2; ch++)
+            {
+                snprintf(path, sizeof(path), "%s/dev%d_ch%d.asb", dir, i, ch);
+                unlink(path);
+            }
+        }
+    }
+    free(devs);
+    free(srv);
+}
+
+static void bench_validate(void)
+{
+    size_t bytes;
+    uint8_t *blocks = encode_device(0, &bytes);
+    const int reps = 200;
+    double t0 = bench_now_s();
+    for (int r = 0; r < reps; r++)
+    {
+        size_t off = 0;
+        stream_block_t blk;
+        while (off < bytes && stream_block_parse(blocks + off, bytes - off, &blk) == STREAM_OK)
+        {
+            off += STREAM_HEADER_BYTES + blk.payload;
+        }
+        bench_sink += off;
+    }
+    double dt = bench_now_s() - t0;
+    printf("  parse + CRC-32C: %.2f GB/s\n", bytes * (double)reps / dt / 1e9);
+
+    static sample_t samples[BLOCK_SAMPLES];
+    stream_block_t blk;
+    stream_block_parse(blocks, bytes, &blk);
+    t0 = bench_now_s();
+    for (int r = 0; r < reps * 10; r++)
+    {
+        stream_block_decode(&blk, blocks + STREAM_HEADER_BYTES, samples);
+        bench_sink += (uint64_t)samples[r & (BLOCK_SAMPLES - 1)];
+    }
+    dt = bench_now_s() - t0;
+    printf("  13-bit unpack:   %.1f Msamples/s\n", BLOCK_SAMPLES * (double)reps * 10 / dt / 1e6);
+    free(blocks);
+}
+
+int main(void)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("Aggregation server, %d-sample 13-bit blocks over localhost, %ld core(s)\n", BLOCK_SAMPLES, cores);
+    bench_validate();
+
+    char dir[] = "/tmp/bench_agg_XXXXXX";
+    if (mkdtemp(dir) == NULL)
+    {
+        return 1;
+    }
+    static const int workers[] = {1, 2, 4};
+    static const int devices[] = {4, 16, 64};
+    for (size_t w = 0; w < sizeof(workers) / sizeof(workers[0]); w++)
+    {
+        for (size_t d = 0; d < sizeof(devices) / sizeof(devices[0]); d++)
+        {
+            bench_server(workers[w], devices[d], NULL);
+            bench_server(workers[w], devices[d], dir);
+        }
+    }
+    rmdir(dir);
+    return 0;
+}
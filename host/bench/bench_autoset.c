@@ -0,0 +1,54 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Autoset analysis time per burst, by burst length, and the worst-case total over all ranges
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "autoset.h"
+
+#define MAX_BURST 16384
+
+int main(void)
+{
+    static sample_t s[MAX_BURST];
+    static meas_scratch_t scratch;
+    // 3 kHz sine at 1 MSPS, 40 % of the 13-bit scale, noise
+    for (size_t i = 0; i < MAX_BURST; i++)
+    {
+        s[i] = (sample_t)(3000 + 1600 * sin(2 * M_PI * 3000 * i / 1e6) + (int)(bench_rand() % 41) - 20);
+    }
+    autoset_config_t cfg = {
+        .code_min = 0,
+        .code_max = 8191,
+        .sample_rate_hz = 1000000,
+        .num_ranges = 4,
+        .range_full_scale_mv = {750, 1050, 1300, 2500},
+        .capture_len = 1024,
+        .max_decimation = 16,
+        .periods_per_capture = 4,
+        .min_amplitude = 64,
+        .hist_shift = 4,
+    };
+
+    uint32_t lens[] = {1024, 4096, 16384};
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++)
+    {
+        uint32_t reps = (uint32_t)(2e7 / lens[l]);
+        autoset_result_t res;
+        double t0 = bench_now_s();
+        for (uint32_t r = 0; r < reps; r++)
+        {
+            autoset_analyze(&cfg, 0, s, lens[l], &res, &scratch);
+            bench_sink += res.decimation;
+        }
+        double dt = (bench_now_s() - t0) / reps;
+        printf("burst %5u: %8.2f us/burst  %.2f ns/sample  worst case %d bursts %8.2f us  (decimation %u, %.0f Hz)\n",
+               lens[l], dt * 1e6, dt * 1e9 / lens[l], cfg.num_ranges, dt * 1e6 * cfg.num_ranges, res.decimation,
+               res.frequency_hz);
+    }
+    return 0;
+}
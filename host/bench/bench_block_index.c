@@ -0,0 +1,88 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Query time of the block summary index against raw ring scans
+#include "bench_util.h"
+#include "block_index.h"
+
+#define RING_SAMPLES 32768 // same as CIRC_BUF_SAMPLES on the device
+#define QUERIES 20000
+
+static sample_t s_storage[RING_SAMPLES];
+static block_summary_t s_blocks[RING_SAMPLES / BLOCK_INDEX_SAMPLES];
+
+int main(void)
+{
+    sample_ring_t ring;
+    block_index_t idx;
+    sample_ring_init(&ring, s_storage, RING_SAMPLES);
+    block_index_init(&idx, &ring, s_blocks);
+
+    // Two ring lengths of noisy data, committed in 128-sample frames like the device
+    sample_t frame[128];
+    double t0 = bench_now_s();
+    for (int f = 0; f < 2 * RING_SAMPLES / 128; f++)
+    {
+        for (int i = 0; i < 128; i++)
+        {
+            frame[i] = (sample_t)(2000 + bench_rand() % 200);
+        }
+        sample_ring_write(&ring, frame, 128);
+        block_index_commit(&idx, ring.head);
+    }
+    double commit_s = bench_now_s() - t0;
+    printf("ingest+commit: %.2f ns/sample\n", commit_s * 1e9 / (2 * RING_SAMPLES));
+
+    uint64_t lo = block_index_oldest_valid(&idx, ring.head);
+    uint64_t span = ring.head - lo;
+    range_stats_t st;
+    uint64_t pos;
+
+    size_t lengths[] = {1024, 8192, 30000};
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+    {
+        size_t len = lengths[l];
+        double t_raw = 0, t_idx = 0;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            double start = bench_now_s();
+            for (int q = 0; q < QUERIES; q++)
+            {
+                uint64_t a = lo + bench_rand() % (span - len);
+                if (pass == 0)
+                {
+                    block_index_range_stats_raw(&ring, a, a + len, &st);
+                }
+                else
+                {
+                    block_index_range_stats(&idx, ring.head, a, a + len, &st);
+                }
+                bench_sink += st.sum;
+            }
+            double el = bench_now_s() - start;
+            *(pass == 0 ? &t_raw : &t_idx) = el;
+        }
+        printf("range stats %6zu samples: raw %8.2f us  index %6.2f us  (%.0fx)\n",
+               len, t_raw * 1e6 / QUERIES, t_idx * 1e6 / QUERIES, t_raw / t_idx);
+    }
+
+    // Threshold search for a value that is absent (worst case for the raw scan)
+    double start = bench_now_s();
+    for (int q = 0; q < QUERIES / 10; q++)
+    {
+        bench_sink += block_index_find_raw(&ring, lo, ring.head, 3000, BLOCK_SEARCH_ABOVE, &pos);
+    }
+    double t_raw = bench_now_s() - start;
+    start = bench_now_s();
+    for (int q = 0; q < QUERIES / 10; q++)
+    {
+        bench_sink += block_index_find(&idx, ring.head, lo, ring.head, 3000, BLOCK_SEARCH_ABOVE, &pos);
+    }
+    double t_idx = bench_now_s() - start;
+    printf("threshold search (no match, %" PRIu64 " samples): raw %.2f us  index %.2f us  (%.0fx)\n",
+           span, t_raw * 1e6 / (QUERIES / 10), t_idx * 1e6 / (QUERIES / 10), t_raw / t_idx);
+    return 0;
+}
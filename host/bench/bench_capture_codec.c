@@ -0,0 +1,105 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Chunked capture compression: single thread vs the work-stealing pool, then the bounded-error
+// mode across error bounds
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "capture_codec.h"
+
+#define SAMPLES (8u << 20)
+#define REPS 3
+
+int main(void)
+{
+    sample_t *in = malloc(SAMPLES * sizeof(sample_t));
+    sample_t *out = malloc(SAMPLES * sizeof(sample_t));
+    size_t cap = capture_codec_bound(SAMPLES);
+    uint8_t *packed = malloc(cap);
+
+    // 1 kHz sine at 1 MSPS plus 3 LSB of noise on a 13-bit scale
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        in[i] = (sample_t)(4096 + 3000 * sin(2 * M_PI * 1000 * i / 1e6) + (int)(bench_rand() % 8) - 4);
+    }
+
+    printf("host cores: %d, %u samples (%.1f MB)\n", dsp_port_num_cores(), SAMPLES, SAMPLES * 2 / 1e6);
+    double base_c = 0, base_d = 0;
+    for (int w = 0; w <= DSP_SCHED_MAX_WORKERS; w++)
+    {
+        dsp_sched_t sched;
+        dsp_sched_t *sp = NULL;
+        if (w > 0)
+        {
+            dsp_sched_start(&sched, w);
+            sp = &sched;
+        }
+
+        size_t len = 0;
+        double t0 = bench_now_s();
+        for (int r = 0; r < REPS; r++)
+        {
+            len = capture_codec_compress(sp, in, SAMPLES, packed, cap);
+        }
+        double tc = (bench_now_s() - t0) / REPS;
+        t0 = bench_now_s();
+        for (int r = 0; r < REPS; r++)
+        {
+            bench_sink += capture_codec_decompress(sp, packed, len, out, SAMPLES);
+        }
+        double td = (bench_now_s() - t0) / REPS;
+        if (w == 0)
+        {
+            base_c = tc;
+            base_d = td;
+        }
+
+        printf("%-12s ratio %.2fx  compress %7.1f MB/s (%.2fx)  decompress %7.1f MB/s (%.2fx)\n",
+               w == 0 ? "single" : (w == 1 ? "1 worker" : w == 2 ? "2 workers" : w == 3 ? "3 workers" : "4 workers"),
+               SAMPLES * 2.0 / len, SAMPLES * 2 / tc / 1e6, base_c / tc, SAMPLES * 2 / td / 1e6, base_d / td);
+        if (sp)
+        {
+            dsp_sched_stop(sp);
+        }
+    }
+
+    // Bounded error, single thread: ratio, speed and the measured error per bound
+    static const uint32_t errs[] = {0, 1, 2, 4, 8, 16, 64};
+    printf("\nbounded error (single thread)\n");
+    for (size_t e = 0; e < sizeof(errs) / sizeof(errs[0]); e++)
+    {
+        size_t len = 0;
+        double t0 = bench_now_s();
+        for (int r = 0; r < REPS; r++)
+        {
+            len = capture_codec_compress_bounded(NULL, in, SAMPLES, errs[e], packed, cap);
+        }
+        double tc = (bench_now_s() - t0) / REPS;
+        t0 = bench_now_s();
+        for (int r = 0; r < REPS; r++)
+        {
+            bench_sink += capture_codec_decompress(NULL, packed, len, out, SAMPLES);
+        }
+        double td = (bench_now_s() - t0) / REPS;
+        int max_abs = 0;
+        double sq = 0;
+        for (size_t i = 0; i < SAMPLES; i++)
+        {
+            int d = out[i] - in[i];
+            max_abs = abs(d) > max_abs ? abs(d) : max_abs;
+            sq += (double)d * d;
+        }
+        printf("max_err %2u  ratio %5.2fx  compress %7.1f MB/s  decompress %7.1f MB/s  err max %2d rms %.2f LSB\n",
+               (unsigned)errs[e], SAMPLES * 2.0 / len, SAMPLES * 2 / tc / 1e6, SAMPLES * 2 / td / 1e6, max_abs,
+               sqrt(sq / SAMPLES));
+    }
+
+    free(in);
+    free(out);
+    free(packed);
+    return 0;
+}
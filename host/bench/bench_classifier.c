@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Classifier inference time per feature vector for a few MLP sizes, int8 against float
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "classifier.h"
+
+#define VECTORS 4096
+#define REPEAT 64
+
+static float frand(float lo, float hi)
+{
+    return lo + (hi - lo) * (bench_rand() % 10000) / 10000.0f;
+}
+
+int main(void)
+{
+    static const struct
+    {
+        int layers;
+        uint8_t widths[CLS_MAX_LAYERS + 1];
+    } shapes[] = {
+        {1, {9, 4}},
+        {2, {9, 16, 4}},
+        {3, {13, 32, 32, 8}},
+        {4, {16, 32, 32, 32, 8}},
+    };
+    static float w[CLS_MAX_LAYERS][CLS_MAX_WIDTH * CLS_MAX_WIDTH], b[CLS_MAX_LAYERS][CLS_MAX_WIDTH];
+    static float x[VECTORS * CLS_MAX_INPUTS];
+    static cls_model_t m;
+    float mean[CLS_MAX_INPUTS], std[CLS_MAX_INPUTS];
+    for (int i = 0; i < CLS_MAX_INPUTS; i++)
+    {
+        mean[i] = 0;
+        std[i] = 1;
+    }
+    for (size_t k = 0; k < VECTORS * CLS_MAX_INPUTS; k++)
+    {
+        x[k] = frand(-3, 3);
+    }
+
+    printf("shape              MACs  int8 ns/window  float ns/window\n");
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++)
+    {
+        cls_float_layer_t layers[CLS_MAX_LAYERS];
+        int macs = 0;
+        char name[32];
+        int len = 0;
+        for (int l = 0; l < shapes[s].layers; l++)
+        {
+            uint8_t in = shapes[s].widths[l], out = shapes[s].widths[l + 1];
+            for (int k = 0; k < in * out; k++)
+            {
+                w[l][k] = frand(-0.5f, 0.5f);
+            }
+            for (int k = 0; k < out; k++)
+            {
+                b[l][k] = frand(-0.2f, 0.2f);
+            }
+            layers[l] = (cls_float_layer_t){in, out, l < shapes[s].layers - 1, w[l], b[l]};
+            macs += in * out;
+            len += snprintf(name + len, sizeof(name) - len, l ? "-%u" : "%u", in);
+        }
+        snprintf(name + len, sizeof(name) - len, "-%u", shapes[s].widths[shapes[s].layers]);
+        const int n_in = shapes[s].widths[0];
+        cls_quantize(&m, layers, shapes[s].layers, mean, std, x, VECTORS * CLS_MAX_INPUTS / n_in);
+
+        double t0 = bench_now_s();
+        for (int r = 0; r < REPEAT; r++)
+        {
+            for (int k = 0; k < VECTORS; k++)
+            {
+                bench_sink += cls_predict(&m, &x[k * CLS_MAX_INPUTS], NULL);
+            }
+        }
+        double ns_q = (bench_now_s() - t0) * 1e9 / (REPEAT * VECTORS);
+        t0 = bench_now_s();
+        for (int r = 0; r < REPEAT; r++)
+        {
+            for (int k = 0; k < VECTORS; k++)
+            {
+                bench_sink += cls_predict_float(layers, shapes[s].layers, mean, std, &x[k * CLS_MAX_INPUTS]);
+            }
+        }
+        double ns_f = (bench_now_s() - t0) * 1e9 / (REPEAT * VECTORS);
+        printf("%-16s  %5d  %14.1f  %15.1f\n", name, macs, ns_q, ns_f);
+    }
+    return 0;
+}
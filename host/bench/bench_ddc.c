@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// DDC cost per input sample by decimation ratio and CIC order
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "ddc.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#define RATE 1000000
+#define LEN (1u << 20)
+#define IQ_SAMPLES (1u << 16)
+
+static uint64_t cycles_now(void)
+{
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+int main(void)
+{
+    static sample_t s[LEN], iq_buf[IQ_SAMPLES];
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s[i] = (sample_t)lrint(4096 + 2000 * sin(2 * M_PI * 123456.0 * i / RATE) + (int)(bench_rand() % 201) - 100);
+    }
+
+    printf("decim  order  out rate   bandwidth   ns/sample  cycles/sample (host TSC)\n");
+    for (uint8_t shift = 0; shift <= DDC_MAX_SHIFT; shift += 2)
+    {
+        for (uint8_t order = 1; order <= DDC_MAX_ORDER; order += DDC_MAX_ORDER - 1)
+        {
+            ddc_config_t cfg = {.sample_rate_hz = RATE, .center_hz = 123000, .cic_shift = shift, .cic_order = order,
+                                .offset = 4096};
+            ddc_t d;
+            sample_ring_t iq;
+            ddc_init(&d, &cfg);
+            sample_ring_init(&iq, iq_buf, IQ_SAMPLES);
+            double t0 = bench_now_s();
+            uint64_t c0 = cycles_now();
+            for (int r = 0; r < 4; r++)
+            {
+                for (size_t off = 0; off < LEN; off += 4096)
+                {
+                    ddc_process(&d, &s[off], 4096, &iq);
+                }
+            }
+            double ns = (bench_now_s() - t0) * 1e9 / (4.0 * LEN);
+            double cyc = (double)(cycles_now() - c0) / (4.0 * LEN);
+            bench_sink += d.outputs;
+            printf("%5u  %5u  %8.0f Hz %8.0f Hz  %9.2f  %13.1f\n", 2u << shift, order, ddc_output_rate_hz(&cfg),
+                   ddc_bandwidth_hz(&cfg), ns, cyc);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Throughput of one stage graph as the number of work-stealing workers grows.
+// Four independent FIR stages plus one bursty stage that forks each block into
+// segments, all reading the same pre-filled ring.
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "dsp_graph.h"
+
+#define RING_SAMPLES (1u << 20)
+#define FIR_TAPS 32
+#define FIR_STAGES 4
+#define BURST_SEGMENTS 8
+
+static sample_t *s_ring_buf;
+static sample_ring_t s_ring;
+static dsp_port_lock_t s_lock = DSP_PORT_LOCK_INIT;
+static dsp_graph_t s_graph;
+
+typedef struct
+{
+    int32_t taps[FIR_TAPS];
+    sample_t hist[FIR_TAPS];
+    int64_t acc;
+} fir_ctx_t;
+
+static fir_ctx_t s_fir[FIR_STAGES];
+
+static void fir_process(void *ctx, const dsp_block_t *blk)
+{
+    fir_ctx_t *f = ctx;
+    for (size_t i = 0; i < blk->len; i++)
+    {
+        memmove(&f->hist[1], &f->hist[0], (FIR_TAPS - 1) * sizeof(sample_t));
+        f->hist[0] = blk->in[0][i];
+        int32_t y = 0;
+        for (int t = 0; t < FIR_TAPS; t++)
+        {
+            y += f->taps[t] * f->hist[t];
+        }
+        f->acc += y >> 8;
+    }
+}
+
+typedef struct
+{
+    const sample_t *in;
+    size_t len;
+    int64_t out;
+} segment_t;
+
+static void segment_unit(void *arg, int worker)
+{
+    (void)worker;
+    segment_t *seg = arg;
+    int64_t acc = 0;
+    for (int rep = 0; rep < 16; rep++)
+    {
+        for (size_t i = 0; i < seg->len; i++)
+        {
+            acc += (int64_t)seg->in[i] * seg->in[(i + rep) % seg->len];
+        }
+    }
+    seg->out = acc;
+}
+
+static int64_t s_burst_acc;
+
+static void burst_process(void *ctx, const dsp_block_t *blk)
+{
+    (void)ctx;
+    segment_t segs[BURST_SEGMENTS];
+    dsp_task_group_t group;
+    dsp_sched_group_init(&group);
+    size_t seg_len = blk->len / BURST_SEGMENTS;
+    for (int s = 0; s < BURST_SEGMENTS; s++)
+    {
+        segs[s].in = blk->in[0] + s * seg_len;
+        segs[s].len = seg_len;
+        dsp_sched_group_submit(&s_graph.sched, &group, blk->worker + s, segment_unit, &segs[s]);
+    }
+    dsp_sched_group_wait(&s_graph.sched, &group);
+    dsp_sched_group_deinit(&group);
+    for (int s = 0; s < BURST_SEGMENTS; s++)
+    {
+        s_burst_acc += segs[s].out;
+    }
+}
+
+static double run(int workers)
+{
+    dsp_graph_init(&s_graph, &s_lock);
+    s_ring.head = 0;
+    for (int s = 0; s < FIR_STAGES; s++)
+    {
+        dsp_stage_desc_t d = {.name = "fir", .ctx = &s_fir[s], .process = fir_process,
+                              .inputs = {&s_ring}, .num_inputs = 1, .worker = DSP_PORT_CORE_ANY};
+        dsp_graph_add_stage(&s_graph, &d);
+    }
+    dsp_stage_desc_t b = {.name = "burst", .process = burst_process, .inputs = {&s_ring}, .num_inputs = 1,
+                          .worker = DSP_PORT_CORE_ANY};
+    dsp_graph_add_stage(&s_graph, &b);
+
+    dsp_graph_start(&s_graph, workers);
+    double t0 = bench_now_s();
+    dsp_graph_publish(&s_graph, &s_ring, RING_SAMPLES);
+    for (int s = 0; s < s_graph.num_stages; s++)
+    {
+        // Stages finish when they reach the head; poll under the graph lock
+        while (1)
+        {
+            dsp_port_lock(&s_lock);
+            bool done = s_graph.stages[s].done >= RING_SAMPLES && !s_graph.stages[s].queued;
+            dsp_port_unlock(&s_lock);
+            if (done)
+            {
+                break;
+            }
+        }
+    }
+    double el = bench_now_s() - t0;
+    dsp_graph_stop(&s_graph);
+    return el;
+}
+
+int main(void)
+{
+    s_ring_buf = malloc(RING_SAMPLES * sizeof(sample_t));
+    sample_ring_init(&s_ring, s_ring_buf, RING_SAMPLES);
+    for (size_t i = 0; i < RING_SAMPLES; i++)
+    {
+        s_ring_buf[i] = (sample_t)(bench_rand() % 8192);
+    }
+    for (int s = 0; s < FIR_STAGES; s++)
+    {
+        for (int t = 0; t < FIR_TAPS; t++)
+        {
+            s_fir[s].taps[t] = (int32_t)(bench_rand() % 256) - 128;
+        }
+    }
+
+    printf("host cores: %d\n", dsp_port_num_cores());
+    double base = 0;
+    for (int w = 1; w <= DSP_SCHED_MAX_WORKERS; w++)
+    {
+        double el = run(w);
+        if (w == 1)
+        {
+            base = el;
+        }
+        uint32_t stolen = 0;
+        for (int i = 0; i < w; i++)
+        {
+            stolen += s_graph.sched.workers[i].stolen;
+        }
+        printf("%d worker(s): %7.1f ms  %6.2f Msamples/s  speedup %.2fx  steals %" PRIu32 "\n",
+               w, el * 1e3, RING_SAMPLES / el / 1e6, base / el, stolen);
+    }
+    bench_sink += s_burst_acc + s_fir[0].acc;
+    free(s_ring_buf);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Frequency response sweep: acquisition time for N points and correlation cost per sample
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "fresp.h"
+
+#define MAX_POINTS 200
+
+int main(void)
+{
+    static fresp_point_t pts[MAX_POINTS];
+    static sample_t s[16384];
+    for (size_t i = 0; i < sizeof(s) / sizeof(s[0]); i++)
+    {
+        s[i] = (sample_t)(3000 + 1000 * sin(i * 0.05) + (int)(bench_rand() % 41) - 20);
+    }
+    fresp_config_t cfg = {
+        .adc_rate_hz = 1000000,
+        .dac_rate_hz = 250000,
+        .f_start_hz = 200,
+        .f_stop_hz = 50000,
+        .min_table = 16,
+        .max_table = 2048,
+        .table_align = 4,
+        .settle_cycles = 4,
+        .min_window = 4096,
+        .max_window = 16384,
+    };
+
+    uint32_t counts[] = {10, 50, 200};
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+    {
+        cfg.points = counts[c];
+        double t0 = bench_now_s();
+        uint32_t n = fresp_plan(&cfg, pts);
+        double plan = bench_now_s() - t0;
+
+        // Correlate every point's window once, as the sweep would
+        uint64_t correlated = 0;
+        t0 = bench_now_s();
+        for (uint32_t i = 0; i < n; i++)
+        {
+            fresp_acc_t acc;
+            fresp_result_t r;
+            fresp_acc_init(&acc, &pts[i], 0);
+            fresp_acc_add(&acc, s, pts[i].window, pts[i].settle);
+            fresp_acc_result(&acc, 1000, &r);
+            bench_sink += (uint64_t)(r.gain * 1000);
+            correlated += pts[i].window;
+        }
+        double corr = bench_now_s() - t0;
+        printf("%3u points (%3u distinct): sweep %7.1f ms of sample time at 1 MSPS, plan %6.2f ms, "
+               "correlation %.2f ns/sample (%.2f ms)\n",
+               counts[c], n, fresp_sweep_samples(pts, n) / 1e3, plan * 1e3, corr * 1e9 / correlated, corr * 1e3);
+    }
+    return 0;
+}
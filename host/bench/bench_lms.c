@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// LMS / NLMS cancellation cost per tap per sample, and attenuation after one second
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_util.h"
+#include "lms.h"
+
+#define RATE 1000000
+#define LEN (1u << 20)
+
+int main(void)
+{
+    static sample_t primary[LEN], ref[LEN], out[LEN];
+    // Reference: 50/150 Hz plus broadband noise; primary: the reference through a 3-tap path, delayed
+    double r1 = 0, r2 = 0, r3 = 0;
+    for (size_t i = 0; i < LEN; i++)
+    {
+        double t = (double)i / RATE;
+        double x = 600 * sin(2 * M_PI * 50 * t) + 250 * sin(2 * M_PI * 150 * t) + (int)(bench_rand() % 601) - 300;
+        ref[i] = (sample_t)lrint(3000 + x);
+        primary[i] = (sample_t)lrint(4000 + 0.4 * r1 + 0.5 * r2 - 0.2 * r3);
+        r3 = r2;
+        r2 = r1;
+        r1 = x;
+    }
+
+    printf("mode  taps  ns/sample  ns/tap/sample  attenuation\n");
+    for (int normalized = 1; normalized >= 0; normalized--)
+    {
+        for (uint8_t taps = 4; taps <= LMS_MAX_TAPS; taps *= 2)
+        {
+            lms_config_t cfg = {.taps = taps, .mu_shift = normalized ? 10 : 30, .normalized = normalized};
+            lms_t lms;
+            lms_init(&lms, &cfg);
+            double t0 = bench_now_s();
+            for (size_t off = 0; off < LEN; off += 256)
+            {
+                lms_process(&lms, &primary[off], &ref[off], &out[off], 256);
+            }
+            double ns = (bench_now_s() - t0) * 1e9 / LEN;
+            double before = 0, after = 0;
+            for (size_t i = LEN * 3 / 4; i < LEN; i++)
+            {
+                before += (primary[i] - 4000.0) * (primary[i] - 4000.0);
+                after += (out[i] - 4000.0) * (out[i] - 4000.0);
+            }
+            printf("%-4s  %4u  %9.2f  %13.3f  %8.1f dB\n", normalized ? "NLMS" : "LMS", taps, ns, ns / taps,
+                   10 * log10(after / before));
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Lock-in throughput, and measured vs theoretical SNR gain by time constant
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "lockin.h"
+
+#define RATE 1000000
+#define LEN (1u << 20)
+
+int main(void)
+{
+    static sample_t s[LEN], ref[LEN];
+    // 1 kHz, 2 codes of signal in +-400 codes of uniform noise (sigma 231): input SNR -44 dB
+    const double a = 2, sigma = 400 / sqrt(3);
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s[i] = (sample_t)lrint(4000 + a * sin(2 * M_PI * 1000.0 * i / RATE) + (int)(bench_rand() % 801) - 400);
+        ref[i] = (sample_t)lrint(3000 + 1000 * sin(2 * M_PI * 1000.0 * i / RATE));
+    }
+
+    lockin_config_t cfg = {.sample_rate_hz = RATE, .ref_hz = 1000, .decim_shift = 8, .order = 2, .tau_s = 0.01f};
+    lockin_t lk;
+    for (int with_ref = 0; with_ref < 2; with_ref++)
+    {
+        lockin_init(&lk, &cfg);
+        double t0 = bench_now_s();
+        for (int r = 0; r < 8; r++)
+        {
+            lockin_process(&lk, s, with_ref ? ref : NULL, LEN);
+        }
+        double dt = (bench_now_s() - t0) / (8.0 * LEN);
+        printf("%-15s %.2f ns/sample (%.0f Msamples/s)\n", with_ref ? "with reference" : "internal NCO", dt * 1e9,
+               1e-6 / dt);
+    }
+
+    // Output noise: variance of X and Y over many outputs after settling, signal removed
+    printf("input SNR %.1f dB\n", 10 * log10(a * a / 2 / (sigma * sigma)));
+    float taus[] = {0.001f, 0.01f, 0.1f};
+    for (size_t k = 0; k < sizeof(taus) / sizeof(taus[0]); k++)
+    {
+        cfg.tau_s = taus[k];
+        lockin_init(&lk, &cfg);
+        double settle = 10 * taus[k];
+        double sum_x = 0, sum_y = 0, sum_xx = 0, sum_yy = 0;
+        uint32_t count = 0;
+        uint64_t t = 0;
+        // Long runs for long time constants: reuse the noise buffer at random offsets
+        while (t < (uint64_t)((settle + 400 * taus[k]) * RATE))
+        {
+            size_t n = 256 * 16;
+            size_t off = (bench_rand() % ((LEN - n) / 1000)) * 1000; // whole 1 kHz periods keep the phase
+            lockin_process(&lk, &s[off], NULL, n);
+            t += n;
+            if (t < settle * RATE)
+            {
+                continue;
+            }
+            lockin_result_t res;
+            lockin_result(&lk, &res);
+            sum_x += res.x;
+            sum_y += res.y;
+            sum_xx += (double)res.x * res.x;
+            sum_yy += (double)res.y * res.y;
+            count++;
+        }
+        double var = (sum_xx - sum_x * sum_x / count + sum_yy - sum_y * sum_y / count) / count;
+        float enbw = lockin_enbw_hz(&cfg);
+        printf("tau %6.3f s order %d: ENBW %7.3f Hz  output SNR %5.1f dB  gain %5.1f dB (theory %5.1f dB)\n",
+               taus[k], cfg.order, enbw, 10 * log10(a * a / var), 10 * log10(a * a / var) -
+               10 * log10(a * a / 2 / (sigma * sigma)), 10 * log10(RATE / (4 * enbw)));
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Mask test throughput: captures/s checked in place in the ring, by capture length
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "mask_test.h"
+#include "trigger.h"
+
+#define RING (1u << 16)
+#define MAX_LEN 16384
+
+int main(void)
+{
+    static sample_t buf[RING], upper[MAX_LEN], lower[MAX_LEN], ref[MAX_LEN];
+    sample_ring_t ring;
+    sample_ring_init(&ring, buf, RING);
+
+    // 10 kHz sine with noise, one trigger every 100 samples
+    sample_t chunk[256];
+    for (int b = 0; b < (int)(RING / 256); b++)
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            size_t at = (size_t)b * 256 + i;
+            chunk[i] = (sample_t)(4096 + 3000 * sin(2 * M_PI * at / 100.0) + (int)(bench_rand() % 16) - 8);
+        }
+        sample_ring_write(&ring, chunk, 256);
+    }
+
+    // Trigger scan alone, for reference
+    trigger_config_t tcfg = {.edge = TRIGGER_RISING, .level = 4096, .hysteresis = 100, .pre = 64, .post = 64};
+    trigger_t trig;
+    trigger_init(&trig, &tcfg);
+    double t0 = bench_now_s();
+    for (int r = 0; r < 200; r++)
+    {
+        trigger_scan(&trig, buf, RING, (uint64_t)r * RING);
+        trig.pend_rd = trig.pend_wr;
+    }
+    double dt = bench_now_s() - t0;
+    printf("trigger scan: %.2f ns/sample\n", dt * 1e9 / (200.0 * RING));
+
+    uint32_t lens[] = {256, 1024, 4096, 16384};
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++)
+    {
+        uint32_t len = lens[l];
+        for (uint32_t i = 0; i < len; i++)
+        {
+            ref[i] = buf[i];
+        }
+        mask_from_reference(ref, len, 64, 1, upper, lower);
+        mask_t mask;
+        mask_init(&mask, upper, lower, len, 0);
+
+        // Start at every trigger-aligned position across the ring, wrapping included
+        uint32_t caps = (uint32_t)(4e8 / len);
+        t0 = bench_now_s();
+        for (uint32_t c = 0; c < caps; c++)
+        {
+            mask_result_t res;
+            uint64_t at = RING + (uint64_t)(c % (RING / 100)) * 100;
+            mask_check_ring(&mask, &ring, 2 * (uint64_t)RING, at, &res);
+            bench_sink += res.violations;
+        }
+        dt = bench_now_s() - t0;
+        printf("len %5u: %10.0f captures/s  %.3f ns/sample  (%.1f%% pass)\n", len, caps / dt, dt * 1e9 / ((double)caps * len),
+               100.0 * mask.passed / mask.tested);
+    }
+    return 0;
+}
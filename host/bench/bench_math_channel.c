@@ -0,0 +1,42 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Cost per sample and per bytecode instruction of the math channel interpreter
+#include "bench_util.h"
+#include "math_channel.h"
+
+#define BLOCKS 20000
+
+static sample_t s_a[MATH_BLOCK_SAMPLES], s_b[MATH_BLOCK_SAMPLES], s_out[MATH_BLOCK_SAMPLES];
+static math_scratch_t s_scratch;
+
+int main(void)
+{
+    const char *exprs[] = {"A-B", "A*0.5+100", "abs(A)", "A*B", "abs(A-B)*2+1", "(A-B)*(A+B)/64"};
+    const sample_t *src[2] = {s_a, s_b};
+    for (int i = 0; i < MATH_BLOCK_SAMPLES; i++)
+    {
+        s_a[i] = (sample_t)(bench_rand() % 8192);
+        s_b[i] = (sample_t)(bench_rand() % 8192);
+    }
+
+    printf("%-18s %6s %12s %14s\n", "expression", "insns", "ns/sample", "ns/sample/op");
+    for (size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); e++)
+    {
+        math_program_t prog;
+        math_compile(exprs[e], &prog, NULL);
+
+        double start = bench_now_s();
+        for (int b = 0; b < BLOCKS; b++)
+        {
+            math_eval(&prog, src, MATH_BLOCK_SAMPLES, s_out, &s_scratch);
+            bench_sink += s_out[b & (MATH_BLOCK_SAMPLES - 1)];
+        }
+        double ns = (bench_now_s() - start) * 1e9 / ((double)BLOCKS * MATH_BLOCK_SAMPLES);
+        printf("%-18s %6u %12.3f %14.3f\n", exprs[e], prog.len, ns, ns / prog.len);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Per-capture cost of the automatic measurements, by capture length
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "measure.h"
+
+#define MAX_LEN 16384
+
+int main(void)
+{
+    static sample_t s[MAX_LEN];
+    static meas_scratch_t scratch;
+    // 10 kHz square-ish wave at 1 MSPS: 5 sample edges, noise
+    for (size_t i = 0; i < MAX_LEN; i++)
+    {
+        double ph = fmod(i, 100.0);
+        double v = ph < 5 ? ph / 5 : ph < 50 ? 1 : ph < 55 ? 1 - (ph - 50) / 5 : 0;
+        s[i] = (sample_t)(1000 + 5000 * v + (int)(bench_rand() % 41) - 20);
+    }
+    meas_config_t cfg = {.level = 3500, .hysteresis = 300, .hist_min = 0, .hist_shift = 4, .sample_rate_hz = 1000000};
+
+    uint32_t lens[] = {256, 1024, 4096, 16384};
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++)
+    {
+        uint32_t reps = (uint32_t)(2e7 / lens[l]);
+        meas_result_t m;
+        double t0 = bench_now_s();
+        for (uint32_t r = 0; r < reps; r++)
+        {
+            meas_capture(&cfg, s, lens[l], &m, &scratch);
+            bench_sink += (uint32_t)m.period;
+        }
+        double dt = (bench_now_s() - t0) / reps;
+        printf("len %5u: %8.2f us/capture  %.2f ns/sample  %8.0f captures/s  (%u edges, freq %.1f Hz)\n", lens[l],
+               dt * 1e6, dt * 1e9 / lens[l], 1 / dt, m.rising_edges + m.falling_edges, m.frequency_hz);
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Running median and Hampel cost per sample against the 1 us budget of a 1 MSPS stream
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "median.h"
+
+#define LEN (1u << 20)
+#define BLOCK 256
+
+int main(void)
+{
+    static sample_t in[LEN], out[LEN];
+    for (size_t i = 0; i < LEN; i++)
+    {
+        in[i] = (sample_t)lrint(4000 + 800 * sin(2 * M_PI * i / 1000.0) + (int)(bench_rand() % 41) - 20);
+        if (bench_rand() % 1000 == 0)
+        {
+            in[i] += 1500;
+        }
+    }
+
+    printf("mode    window  ns/sample  of 1 MSPS budget\n");
+    for (int hampel = 0; hampel <= 1; hampel++)
+    {
+        for (uint8_t w = 3; w <= MEDIAN_MAX_WINDOW; w += 2)
+        {
+            median_config_t cfg = {.window = w, .hampel = hampel, .n_sigma = 3.0f, .min_dev = 8};
+            median_t m;
+            median_init(&m, &cfg);
+            double t0 = bench_now_s();
+            for (size_t off = 0; off < LEN; off += BLOCK)
+            {
+                median_process(&m, &in[off], &out[off], BLOCK);
+            }
+            double ns = (bench_now_s() - t0) * 1e9 / LEN;
+            bench_sink += (uint16_t)out[LEN - 1];
+            printf("%-6s  %6u  %9.2f  %15.1f%%\n", hampel ? "hampel" : "median", w, ns, ns / 10);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Persistence map accumulation cost per sample, triggered and clock-recovered
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "persist_map.h"
+
+#define SAMPLES (4u << 20)
+#define BLOCK 256
+#define REPS 5
+
+static uint16_t s_bins[256 * 128];
+
+static void run(const char *name, const persist_config_t *cfg, const sample_t *in)
+{
+    persist_map_t map;
+    persist_map_init(&map, cfg, s_bins);
+    double t0 = bench_now_s();
+    for (int r = 0; r < REPS; r++)
+    {
+        for (size_t i = 0; i < SAMPLES; i += BLOCK)
+        {
+            persist_map_accumulate(&map, in + i, BLOCK);
+        }
+    }
+    double dt = bench_now_s() - t0;
+    bench_sink += persist_map_peak(&map);
+    printf("%-22s %4ux%-4u %6.2f ns/sample  %7.1f Msamples/s  %u traces/edges per pass\n", name, cfg->width,
+           cfg->height, dt * 1e9 / ((double)SAMPLES * REPS), (double)SAMPLES * REPS / dt / 1e6, map.traces / REPS);
+}
+
+int main(void)
+{
+    sample_t *sine = malloc(SAMPLES * sizeof(sample_t));
+    sample_t *nrz = malloc(SAMPLES * sizeof(sample_t));
+
+    // 10 kHz sine at 1 MSPS, and 115200 baud NRZ with 1-sample edges, both with noise
+    int bit = 0, prev = 0;
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        sine[i] = (sample_t)(4096 + 3000 * sin(2 * M_PI * 10000 * i / 1e6) + (int)(bench_rand() % 64) - 32);
+        size_t k = (size_t)(i * 115200ull / 1000000);
+        if (k != (size_t)((i - (i > 0)) * 115200ull / 1000000))
+        {
+            prev = bit;
+            bit = bench_rand() & 1;
+        }
+        int lvl = (prev != bit && i * 115200ull % 1000000 < 115200) ? 4000 : (bit ? 7000 : 1000);
+        nrz[i] = (sample_t)(lvl + (int)(bench_rand() % 201) - 100);
+    }
+
+    uint16_t sizes[][2] = {{128, 64}, {256, 128}};
+    for (int s = 0; s < 2; s++)
+    {
+        persist_config_t trig = {
+            .mode = PERSIST_TRIGGERED,
+            .width = sizes[s][0],
+            .height = sizes[s][1],
+            .amp_min = 0,
+            .amp_max = 8192,
+            .low = 3900,
+            .high = 4300,
+            .pre = 16,
+        };
+        run("triggered (10 kHz sine)", &trig, sine);
+        persist_config_t eye = trig;
+        eye.mode = PERSIST_CLOCK;
+        eye.low = 3000;
+        eye.high = 5000;
+        eye.ui_q16 = (uint32_t)(1e6 / 115200 * 65536);
+        eye.span_ui = 2;
+        run("eye (115200 NRZ)", &eye, nrz);
+    }
+    free(sine);
+    free(nrz);
+    return 0;
+}
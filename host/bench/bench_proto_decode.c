@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Protocol decode throughput on noisy synthetic logic traffic at 1 MSPS
+#include <stdlib.h>
+#include "bench_util.h"
+#include "proto_decode.h"
+
+#define SAMPLES (4u << 20)
+#define BLOCK 256
+#define REPS 5
+
+static uint32_t s_frames;
+
+static void count(void *ctx, const proto_frame_t *frame)
+{
+    (void)ctx;
+    s_frames++;
+    bench_sink += frame->data;
+}
+
+static sample_t level(int bit)
+{
+    return (sample_t)((bit ? 7000 : 500) + (int)(bench_rand() % 801) - 400);
+}
+
+static void run(const char *name, const proto_config_t *cfg, sample_t *const *lines)
+{
+    proto_decoder_t dec;
+    proto_decoder_init(&dec, cfg, count, NULL);
+    int nl = proto_num_lines(cfg);
+    s_frames = 0;
+    double t0 = bench_now_s();
+    for (int r = 0; r < REPS; r++)
+    {
+        proto_decoder_reset(&dec);
+        for (size_t i = 0; i < SAMPLES; i += BLOCK)
+        {
+            const sample_t *at[PROTO_MAX_LINES];
+            for (int l = 0; l < nl; l++)
+            {
+                at[l] = lines[l] + i;
+            }
+            proto_decoder_process(&dec, at, BLOCK, (uint64_t)r * SAMPLES + i);
+        }
+    }
+    double dt = bench_now_s() - t0;
+    printf("%-8s %8.1f Msamples/s  %5.2f ns/sample  %u frames/pass\n", name, (double)SAMPLES * REPS / dt / 1e6,
+           dt * 1e9 / ((double)SAMPLES * REPS), s_frames / REPS);
+}
+
+int main(void)
+{
+    sample_t *lines[4];
+    for (int l = 0; l < 4; l++)
+    {
+        lines[l] = malloc(SAMPLES * sizeof(sample_t));
+    }
+
+    // UART 115200 8N1, back to back characters
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        size_t bit = (size_t)(i * 115200ull / 1000000);
+        size_t pos = bit % 10;
+        int v = pos == 0 ? 0 : pos == 9 ? 1 : (int)(((bit / 10) * 37 >> (pos - 1)) & 1);
+        lines[0][i] = level(v);
+    }
+    proto_config_t uart = {
+        .kind = PROTO_UART,
+        .low = 2500,
+        .high = 4500,
+        .sample_rate_hz = 1000000,
+        .uart = {.baud = 115200, .data_bits = 8},
+    };
+    run("uart", &uart, lines);
+
+    // SPI mode 0 at 125 kHz: 8 samples per bit, continuous words, no CS
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        size_t bit = i / 8;
+        lines[0][i] = level((i % 8) >= 4);
+        lines[1][i] = level((int)((bit / 8 * 73) >> (7 - bit % 8)) & 1);
+        lines[2][i] = level((int)((bit / 8 * 29) >> (7 - bit % 8)) & 1);
+    }
+    proto_config_t spi = {
+        .kind = PROTO_SPI,
+        .low = 2500,
+        .high = 4500,
+        .sample_rate_hz = 1000000,
+        .spi = {.mode = 0, .word_bits = 8, .has_miso = true},
+    };
+    run("spi", &spi, lines);
+
+    // I2C at 100 kHz: 100-bit transactions framed by start and stop, SDA moves while SCL is low
+    for (size_t i = 0; i < SAMPLES; i++)
+    {
+        size_t bit = i / 10, ph = i % 10, slot = bit % 100;
+        if (slot == 0 || slot == 99)
+        {
+            lines[0][i] = level(1);
+            lines[1][i] = level((ph < 5) == (slot == 0));
+        }
+        else
+        {
+            lines[0][i] = level(ph >= 3 && ph < 8);
+            lines[1][i] = level((int)((bit * 2654435761u) >> 31));
+        }
+    }
+    proto_config_t i2c = {.kind = PROTO_I2C, .low = 2500, .high = 4500, .sample_rate_hz = 1000000};
+    run("i2c", &i2c, lines);
+
+    for (int l = 0; l < 4; l++)
+    {
+        free(lines[l]);
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Fan-out relay over localhost: source and aggregate client throughput by number of clients,
+// sendfile() from the shared ring against send() copies, and with a stalled client
+#include <stdlib.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "bench_util.h"
+#include "relay.h"
+
+#define BLOCK_SAMPLES 8192
+#define SOURCE_BLOCKS 64 // pre-encoded and sent round robin
+#define READERS 4        // client threads, each polling its share of the connections
+#define RUN_S 1.0
+
+typedef struct
+{
+    pthread_t thread;
+    int *fds;
+    int num_fds;
+    uint64_t bytes;
+} reader_t;
+
+static volatile int s_running;
+static uint8_t *s_blocks;
+static size_t s_blocks_bytes;
+
+static void *source_main(void *arg)
+{
+    int fd = *(int *)arg;
+    while (s_running)
+    {
+        size_t off = 0;
+        while (off < s_blocks_bytes)
+        {
+            ssize_t r = send(fd, s_blocks + off, s_blocks_bytes - off, MSG_NOSIGNAL);
+            if (r <= 0)
+            {
+                return NULL;
+            }
+            off += (size_t)r;
+        }
+    }
+    return NULL;
+}
+
+static void *reader_main(void *arg)
+{
+    reader_t *rd = arg;
+    int ep = epoll_create1(0);
+    for (int i = 0; i < rd->num_fds; i++)
+    {
+        struct epoll_event ev = {.events = EPOLLIN, .data.fd = rd->fds[i]};
+        epoll_ctl(ep, EPOLL_CTL_ADD, rd->fds[i], &ev);
+    }
+    static __thread uint8_t buf[1 << 18];
+    struct epoll_event ev[64];
+    while (s_running)
+    {
+        int n = epoll_wait(ep, ev, 64, 10);
+        for (int i = 0; i < n; i++)
+        {
+            ssize_t r = recv(ev[i].data.fd, buf, sizeof(buf), MSG_DONTWAIT);
+            rd->bytes += r > 0 ? (uint64_t)r : 0;
+        }
+    }
+    close(ep);
+    return NULL;
+}
+
+static void encode_source(void)
+{
+    const size_t block_bytes = STREAM_HEADER_BYTES + stream_payload_bytes(STREAM_FMT_PACK13, BLOCK_SAMPLES);
+    s_blocks_bytes = block_bytes * SOURCE_BLOCKS;
+    s_blocks = malloc(s_blocks_bytes);
+    static sample_t samples[BLOCK_SAMPLES];
+    for (uint32_t b = 0; b < SOURCE_BLOCKS; b++)
+    {
+        for (int i = 0; i < BLOCK_SAMPLES; i++)
+        {
+            samples[i] = (sample_t)(bench_rand() & 0x1fff);
+        }
+        stream_block_t blk = {.format = STREAM_FMT_PACK13, .seq = b, .samples = BLOCK_SAMPLES};
+        stream_block_encode(&blk, samples, s_blocks + b * block_bytes);
+    }
+}
+
+static void bench_relay(int clients, bool copy, bool stalled)
+{
+    int pair[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, pair);
+    relay_t *r = calloc(1, sizeof(*r));
+    relay_config_t cfg = {.copy = copy};
+    if (!relay_start(r, &cfg, pair[0]))
+    {
+        printf("relay start failed\n");
+        close(pair[1]);
+        free(r);
+        return;
+    }
+    int *fds = malloc(sizeof(int) * (size_t)(clients + 1));
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(relay_port(r))};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int i = 0; i < clients + stalled; i++)
+    {
+        fds[i] = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(fds[i], (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            printf("connect failed\n");
+        }
+    }
+    relay_stats_t st = {0};
+    while (st.clients < clients + stalled)
+    {
+        usleep(1000);
+        relay_stats(r, &st);
+    }
+
+    // The stalled client is the last one and belongs to no reader
+    reader_t rd[READERS] = {0};
+    const int readers = clients < READERS ? clients : READERS;
+    s_running = 1;
+    for (int i = 0; i < readers; i++)
+    {
+        rd[i].fds = fds + i * clients / readers;
+        rd[i].num_fds = (i + 1) * clients / readers - i * clients / readers;
+        pthread_create(&rd[i].thread, NULL, reader_main, &rd[i]);
+    }
+    pthread_t source;
+    pthread_create(&source, NULL, source_main, &pair[1]);
+    relay_stats_t before, after;
+    relay_stats(r, &before);
+    double t0 = bench_now_s();
+    usleep((useconds_t)(RUN_S * 1e6));
+    relay_stats(r, &after);
+    double dt = bench_now_s() - t0;
+    s_running = 0;
+    shutdown(pair[1], SHUT_RDWR);
+    pthread_join(source, NULL);
+    uint64_t received = 0;
+    for (int i = 0; i < readers; i++)
+    {
+        pthread_join(rd[i].thread, NULL);
+        received += rd[i].bytes;
+    }
+    relay_stop(r);
+    for (int i = 0; i < clients + stalled; i++)
+    {
+        close(fds[i]);
+    }
+    close(pair[1]);
+
+    double in_mb_s = (after.bytes_in - before.bytes_in) / dt / 1e6;
+    double out_mb_s = (after.bytes_out - before.bytes_out) / dt / 1e6;
+    printf("  %-8s  clients %4d%s  in %7.1f MB/s  out %8.1f MB/s  (%6.1f per client)  dropped chunks %5" PRIu64
+           "  kicked %" PRIu64 "\n",
+           copy ? "send" : "sendfile", clients, stalled ? "+1 stalled" : "          ", in_mb_s, out_mb_s,
+           out_mb_s / clients, after.dropped_chunks, after.kicked);
+    bench_sink += received;
+    free(fds);
+    free(r);
+}
+
+int main(void)
+{
+    printf("Fan-out relay, %d-sample 13-bit blocks, 32 x 1 MB ring, %ld core(s)\n", BLOCK_SAMPLES,
+           sysconf(_SC_NPROCESSORS_ONLN));
+    encode_source();
+    static const int clients[] = {1, 4, 16, 64, 256};
+    for (size_t i = 0; i < sizeof(clients) / sizeof(clients[0]); i++)
+    {
+        bench_relay(clients[i], false, false);
+        bench_relay(clients[i], true, false);
+    }
+    bench_relay(16, false, true);
+    bench_relay(16, true, true);
+    free(s_blocks);
+    return 0;
+}
@@ -0,0 +1,131 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Host sample decoding: every vector version against scalar and against the portable
+// stream_block_decode(), in Msamples/s over a buffer that stays in L2
+#include <stdlib.h>
+#include "bench_util.h"
+#include "stream_decode.h"
+
+#define N 32768
+#define REPS 2000
+
+static sample_t s_codes[N], s_out[N];
+static int16_t s_delta[N];
+static uint32_t s_zz[N];
+static float s_float[N];
+static uint8_t s_payload[STREAM_FMT_COUNT][2 * N];
+static stream_block_t s_blk[STREAM_FMT_COUNT];
+
+typedef enum
+{
+    OP_UNPACK12,
+    OP_UNPACK13,
+    OP_DELTA,
+    OP_ZIGZAG,
+    OP_CALIBRATE,
+    OP_BLOCK_FLOAT,
+    OP_COUNT,
+} op_t;
+
+static const char *const s_op_names[OP_COUNT] = {
+    "unpack 12-bit", "unpack 13-bit", "delta", "zigzag delta", "calibrate", "13-bit block to float",
+};
+
+static double run(op_t op)
+{
+    int16_t prev = 0;
+    double t0 = bench_now_s();
+    for (int r = 0; r < REPS; r++)
+    {
+        switch (op)
+        {
+        case OP_UNPACK12:
+            stream_decode_unpack(STREAM_FMT_PACK12, s_payload[STREAM_FMT_PACK12], N, s_out);
+            break;
+        case OP_UNPACK13:
+            stream_decode_unpack(STREAM_FMT_PACK13, s_payload[STREAM_FMT_PACK13], N, s_out);
+            break;
+        case OP_DELTA:
+            stream_decode_delta(s_delta, N, &prev, s_out);
+            break;
+        case OP_ZIGZAG:
+            stream_decode_zigzag_delta(s_zz, N, &prev, s_out);
+            break;
+        case OP_CALIBRATE:
+            stream_decode_calibrate(s_codes, N, 0.3176f, -12.5f, s_float);
+            break;
+        default:
+            stream_decode_block_float(&s_blk[STREAM_FMT_PACK13], s_payload[STREAM_FMT_PACK13], 0.3176f, -12.5f,
+                                      s_float);
+            break;
+        }
+        bench_sink += (uint64_t)s_out[r & (N - 1)] + (uint64_t)s_float[r & (N - 1)];
+    }
+    return (double)N * REPS / (bench_now_s() - t0) / 1e6;
+}
+
+int main(void)
+{
+    static uint8_t block[STREAM_HEADER_BYTES + 2 * N];
+    int32_t prev = 0;
+    for (int i = 0; i < N; i++)
+    {
+        s_codes[i] = (sample_t)(2048 + (int)(bench_rand() % 400) - 200);
+        int32_t d = s_codes[i] - prev;
+        s_delta[i] = (int16_t)d;
+        s_zz[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+        prev = s_codes[i];
+    }
+    for (uint8_t fmt = 0; fmt < STREAM_FMT_COUNT; fmt++)
+    {
+        s_blk[fmt] = (stream_block_t){.format = fmt, .samples = N};
+        stream_block_encode(&s_blk[fmt], s_codes, block);
+        for (uint32_t i = 0; i < s_blk[fmt].payload; i++)
+        {
+            s_payload[fmt][i] = block[STREAM_HEADER_BYTES + i];
+        }
+    }
+
+    printf("Sample decoding, %d samples x %d, Msamples/s\n", N, REPS);
+    double t0 = bench_now_s();
+    for (int r = 0; r < REPS; r++)
+    {
+        stream_block_decode(&s_blk[STREAM_FMT_PACK13], s_payload[STREAM_FMT_PACK13], s_out);
+        bench_sink += (uint64_t)s_out[r & (N - 1)];
+    }
+    printf("  stream_block_decode, 13-bit (portable): %8.0f\n", (double)N * REPS / (bench_now_s() - t0) / 1e6);
+
+    double scalar[OP_COUNT];
+    printf("  %-24s", "");
+    for (int isa = 0; isa < STREAM_DECODE_ISA_COUNT; isa++)
+    {
+        if (stream_decode_isa_supported((stream_decode_isa_t)isa))
+        {
+            printf("%10s", stream_decode_isa_name((stream_decode_isa_t)isa));
+        }
+    }
+    printf("   speedup\n");
+    for (int op = 0; op < OP_COUNT; op++)
+    {
+        printf("  %-24s", s_op_names[op]);
+        double best = 0;
+        for (int isa = 0; isa < STREAM_DECODE_ISA_COUNT; isa++)
+        {
+            if (!stream_decode_use_isa((stream_decode_isa_t)isa))
+            {
+                continue;
+            }
+            double rate = run((op_t)op);
+            scalar[op] = isa == STREAM_DECODE_SCALAR ? rate : scalar[op];
+            best = rate > best ? rate : best;
+            printf("%10.0f", rate);
+        }
+        printf("   %5.1fx\n", best / scalar[op]);
+    }
+    stream_decode_use_isa(stream_decode_best_isa());
+    return 0;
+}
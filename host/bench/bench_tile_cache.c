@@ -0,0 +1,145 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Tile cache on a 128M-sample capture: build time by threads and format, and query latency
+// for a 1920-column view by zoom, against computing the columns from the samples
+#include <stdlib.h>
+#include <unistd.h>
+#include "bench_util.h"
+#include "tile_cache.h"
+
+#define SAMPLES (1u << 27)
+#define BLOCK 8192
+#define COLUMNS 1920
+#define QUERIES 200
+
+static tile_t s_out[COLUMNS];
+
+static void write_capture(const char *path, uint8_t format)
+{
+    FILE *f = fopen(path, "wb");
+    static sample_t samples[BLOCK];
+    static uint8_t buf[STREAM_HEADER_BYTES + 2 * BLOCK];
+    for (uint32_t seq = 0; seq < SAMPLES / BLOCK; seq++)
+    {
+        stream_block_t blk = {.format = format, .seq = seq, .samples = BLOCK, .pos = (uint64_t)seq * BLOCK};
+        for (uint32_t i = 0; i < BLOCK; i++)
+        {
+            samples[i] = (sample_t)(2048 + (int)((blk.pos + i) / 1000 % 1000) - 500 + (int)(bench_rand() % 64));
+        }
+        fwrite(buf, 1, stream_block_encode(&blk, samples, buf), f);
+    }
+    fclose(f);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Without the cache: decode the whole view and take min/max per column
+static void columns_from_samples(const capture_file_t *cf, uint64_t from, uint64_t to)
+{
+    static sample_t buf[BLOCK];
+    const uint64_t span = to - from;
+    for (size_t c = 0; c < COLUMNS; c++)
+    {
+        tile_t t = {INT16_MAX, INT16_MIN};
+        for (uint64_t a = from + span * c / COLUMNS, b = from + span * (c + 1) / COLUMNS; a < b;)
+        {
+            size_t got = capture_file_read(cf, a, b - a < BLOCK ? (size_t)(b - a) : BLOCK, buf);
+            for (size_t j = 0; j < got; j++)
+            {
+                t.min = buf[j] < t.min ? buf[j] : t.min;
+                t.max = buf[j] > t.max ? buf[j] : t.max;
+            }
+            a += got ? got : b - a;
+        }
+        s_out[c] = t;
+    }
+}
+
+int main(void)
+{
+    char path[] = "/tmp/bench_tiles_XXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+    char cache[64];
+    snprintf(cache, sizeof(cache), "%s" TILE_CACHE_SUFFIX, path);
+    printf("Tile cache, %u samples in %u-sample blocks, %ld CPUs\n", SAMPLES, BLOCK,
+           sysconf(_SC_NPROCESSORS_ONLN));
+
+    capture_file_t cf;
+    static const char *const formats[] = {"raw16", "pack12"};
+    printf("  build, ms       threads:");
+    for (int threads = 1; threads <= 8; threads *= 2)
+    {
+        printf("%8d", threads);
+    }
+    printf("\n");
+    for (uint8_t fmt = STREAM_FMT_RAW16; fmt <= STREAM_FMT_PACK12; fmt++)
+    {
+        write_capture(path, fmt);
+        capture_file_open(&cf, path, false);
+        printf("  %-24s", formats[fmt]);
+        for (int threads = 1; threads <= 8; threads *= 2)
+        {
+            tile_cache_config_t cfg = {.threads = threads};
+            double best = 1e9;
+            for (int r = 0; r < 3; r++)
+            {
+                double t0 = bench_now_s();
+                tile_cache_build(&cf, cache, &cfg);
+                double t = bench_now_s() - t0;
+                best = t < best ? t : best;
+            }
+            printf("%8.1f", best * 1e3);
+        }
+        printf("\n");
+        if (fmt == STREAM_FMT_PACK12)
+        {
+            break; // keep the pack12 capture for the queries
+        }
+        capture_file_close(&cf);
+    }
+
+    tile_cache_t tc;
+    if (!tile_cache_open(&tc, cache, &cf))
+    {
+        printf("cannot open the cache\n");
+        return 1;
+    }
+    FILE *f = fopen(cache, "rb");
+    fseek(f, 0, SEEK_END);
+    printf("  cache %.1f MB for a %.1f MB capture, %u levels\n", ftell(f) / 1e6, cf.size / 1e6, tc.hdr->levels);
+    fclose(f);
+
+    printf("  query, %d columns     median us    max us   from samples, ms\n", COLUMNS);
+    for (uint64_t span = SAMPLES; span >= 1000; span /= 16)
+    {
+        static double lat[QUERIES];
+        for (int q = 0; q < QUERIES; q++)
+        {
+            uint64_t from = span == SAMPLES ? 0 : bench_rand() % (SAMPLES - span);
+            double t0 = bench_now_s();
+            tile_cache_query(&tc, from, from + span, COLUMNS, s_out);
+            lat[q] = (bench_now_s() - t0) * 1e6;
+            bench_sink += (uint64_t)s_out[q % COLUMNS].max;
+        }
+        qsort(lat, QUERIES, sizeof(lat[0]), cmp_double);
+        double t0 = bench_now_s();
+        columns_from_samples(&cf, 0, span);
+        double raw_ms = (bench_now_s() - t0) * 1e3;
+        bench_sink += (uint64_t)s_out[0].max;
+        printf("  %12" PRIu64 " samples %12.1f %9.1f %14.2f\n", span, lat[QUERIES / 2], lat[QUERIES - 1], raw_ms);
+    }
+    tile_cache_close(&tc);
+    capture_file_close(&cf);
+    unlink(cache);
+    unlink(path);
+    return 0;
+}
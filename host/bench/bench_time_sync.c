@@ -0,0 +1,171 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Multi-device time sync on simulated clocks: alignment error of the shared pulse by fit window,
+// of UDP exchanges by network queuing, and the cost of an update
+#include <math.h>
+#include "bench_util.h"
+#include "time_sync.h"
+
+#define RATE 1e6
+#define DEVICES 4
+#define SECONDS 600
+
+// Sample clock: ppm0 offset plus a thermal swing of ppm_amp over ppm_period_s, counter `phase` at t = 0
+typedef struct
+{
+    double ppm0, ppm_amp, ppm_period_s, phase;
+} sim_clock_t;
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (bench_rand() / 4294967296.0);
+}
+
+static double exp_rand(double mean)
+{
+    return -mean * log((bench_rand() + 1.0) / 4294967297.0);
+}
+
+static double sim_cycles(const sim_clock_t *c, double t)
+{
+    double w = 2 * M_PI / c->ppm_period_s;
+    return c->phase + RATE * (t + 1e-6 * (c->ppm0 * t + c->ppm_amp / w * (1 - cos(w * t))));
+}
+
+static double sim_time_of(const sim_clock_t *c, double n)
+{
+    double t = (n - c->phase) / RATE;
+    for (int i = 0; i < 3; i++)
+    {
+        double ppm = c->ppm0 + c->ppm_amp * sin(2 * M_PI * t / c->ppm_period_s);
+        t -= (sim_cycles(c, t) - n) / (RATE * (1 + 1e-6 * ppm));
+    }
+    return t;
+}
+
+static void sim_devices(sim_clock_t *clk)
+{
+    for (int d = 0; d < DEVICES; d++)
+    {
+        clk[d] = (sim_clock_t){uniform(-50, 50), uniform(1, 3), uniform(300, 900), uniform(0, 1e7)};
+    }
+}
+
+// 1 Hz pulse; error of each device against true time (half-sample edge bias removed) and between devices
+static void bench_pulses(uint8_t window)
+{
+    sim_clock_t clk[DEVICES];
+    tsync_t sync[DEVICES];
+    tsync_config_t cfg = {.nominal_hz = RATE, .window = window, .max_residual_ns = 20000};
+    sim_devices(clk);
+    for (int d = 0; d < DEVICES; d++)
+    {
+        tsync_init(&sync[d], &cfg);
+    }
+    double sq = 0, worst = 0, worst_align = 0;
+    int n = 0;
+    for (int k = 0; k < SECONDS; k++)
+    {
+        double tp = 0.5 + k;
+        for (int d = 0; d < DEVICES; d++)
+        {
+            tsync_add_pulse_periodic(&sync[d], (uint64_t)ceil(sim_cycles(&clk[d], tp)), 1000000000);
+        }
+        if (k < 64)
+        {
+            continue;
+        }
+        for (int j = 0; j < 10; j++)
+        {
+            double t = tp + uniform(0, 1), err[DEVICES];
+            for (int d = 0; d < DEVICES; d++)
+            {
+                uint64_t c = (uint64_t)llround(sim_cycles(&clk[d], t));
+                err[d] = tsync_to_ref(&sync[d], c) - (sim_time_of(&clk[d], (double)c) - 0.5) * 1e9 + 500;
+                sq += err[d] * err[d];
+                worst = fmax(worst, fabs(err[d]));
+                n++;
+            }
+            for (int d = 1; d < DEVICES; d++)
+            {
+                worst_align = fmax(worst_align, fabs(err[d] - err[0]));
+            }
+        }
+    }
+    printf("pulse  window %2u        error rms %6.0f ns max %6.0f ns, between devices max %6.0f ns\n", window,
+           sqrt(sq / n), worst, worst_align);
+}
+
+// Exchanges every 100 ms, 100 us each way plus exponential queuing in either direction
+static void bench_exchanges(double queue_us)
+{
+    sim_clock_t clk[DEVICES];
+    tsync_t sync[DEVICES];
+    tsync_config_t cfg = {.nominal_hz = RATE, .window = 32, .max_excess_ns = 20000, .max_residual_ns = 200000};
+    sim_devices(clk);
+    double sq = 0, worst = 0;
+    int n = 0, accepted = 0, sent = 0;
+    for (int d = 0; d < DEVICES; d++)
+    {
+        tsync_init(&sync[d], &cfg);
+        for (int k = 0; k < SECONDS * 10; k++)
+        {
+            double t1 = 1 + k * 0.1;
+            double t2 = t1 + 100e-6 + exp_rand(queue_us * 1e-6);
+            uint64_t c2 = (uint64_t)ceil(sim_cycles(&clk[d], t2));
+            uint64_t c3 = c2 + 500;
+            double t4 = sim_time_of(&clk[d], (double)c3) + 100e-6 + exp_rand(queue_us * 1e-6);
+            accepted += tsync_add_exchange(&sync[d], llround(t1 * 1e9), c2, c3, llround(t4 * 1e9));
+            sent++;
+            if (k < 300)
+            {
+                continue;
+            }
+            uint64_t c = (uint64_t)llround(sim_cycles(&clk[d], t1 + uniform(0, 0.1)));
+            double err = tsync_to_ref(&sync[d], c) - sim_time_of(&clk[d], (double)c) * 1e9;
+            sq += err * err;
+            worst = fmax(worst, fabs(err));
+            n++;
+        }
+    }
+    printf("udp    queuing %5.0f us  error rms %6.0f ns max %6.0f ns, %4.1f%% of exchanges kept\n", queue_us,
+           sqrt(sq / n), worst, 100.0 * accepted / sent);
+}
+
+int main(void)
+{
+    static const uint8_t windows[] = {4, 8, 16, 32, 64};
+    for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+    {
+        bench_pulses(windows[i]);
+    }
+    static const double queues[] = {0, 30, 100, 300, 1000};
+    for (size_t i = 0; i < sizeof(queues) / sizeof(queues[0]); i++)
+    {
+        bench_exchanges(queues[i]);
+    }
+
+    enum { UPDATES = 1000000 };
+    tsync_t sync;
+    tsync_config_t cfg = {.nominal_hz = RATE, .window = 16, .max_residual_ns = 20000};
+    tsync_init(&sync, &cfg);
+    double t0 = bench_now_s();
+    for (uint64_t k = 0; k < UPDATES; k++)
+    {
+        tsync_add_pulse(&sync, k * 1000003 + (bench_rand() & 1), (int64_t)k * 1000000000);
+    }
+    double t_add = bench_now_s() - t0;
+    t0 = bench_now_s();
+    for (uint64_t k = 0; k < UPDATES; k++)
+    {
+        bench_sink += (uint64_t)tsync_to_ref(&sync, k * 977);
+    }
+    double t_map = bench_now_s() - t0;
+    printf("cost: %.0f ns per pulse (window 16 refit), %.1f ns per counter mapped\n", t_add / UPDATES * 1e9,
+           t_map / UPDATES * 1e9);
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Trend compression ratio vs tolerance on slow signals, and cost per input point
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "trend_compress.h"
+
+#define LEN (1u << 20)
+#define FRAC 16 // values in 1/16 code, as the firmware's block averages
+
+static int32_t s_val[LEN];
+
+static double noise(double amp)
+{
+    return amp * ((int)(bench_rand() % 2001) - 1000) / 1000.0;
+}
+
+// 0: temperature-like drift with a little noise, 1: slow sine, 2: setpoint steps between plateaus
+static void make_signal(int kind)
+{
+    double walk = 0, level = 2000;
+    for (size_t i = 0; i < LEN; i++)
+    {
+        double v;
+        if (kind == 0)
+        {
+            walk += noise(0.05);
+            v = 2000 + 400 * i / LEN + walk + noise(0.5);
+        }
+        else if (kind == 1)
+        {
+            v = 4096 + 1000 * sin(2 * M_PI * i / 100000.0) + noise(0.5);
+        }
+        else
+        {
+            if (bench_rand() % 20000 == 0)
+            {
+                level = 1000 + bench_rand() % 6000;
+            }
+            v = level + noise(0.5);
+        }
+        s_val[i] = (int32_t)lrint(v * FRAC);
+    }
+}
+
+int main(void)
+{
+    static const char *kinds[] = {"drift", "sine", "steps"};
+    static const double tols[] = {0.5, 1, 2, 4, 8};
+    static trend_point_t out[2];
+    printf("signal  tol codes  deadband ratio  swinging-door ratio  ns/point (door)\n");
+    for (int kind = 0; kind < 3; kind++)
+    {
+        make_signal(kind);
+        for (size_t k = 0; k < sizeof(tols) / sizeof(tols[0]); k++)
+        {
+            double ratio[2], ns = 0;
+            for (int mode = 0; mode < 2; mode++)
+            {
+                trend_config_t cfg = {.mode = mode, .tol = (int32_t)(tols[k] * FRAC), .max_gap = TREND_MAX_GAP};
+                trend_t tr;
+                trend_init(&tr, &cfg);
+                double t0 = bench_now_s();
+                for (size_t i = 0; i < LEN; i++)
+                {
+                    trend_push(&tr, i, s_val[i], out);
+                }
+                trend_flush(&tr, out);
+                ns = (bench_now_s() - t0) * 1e9 / LEN;
+                ratio[mode] = (double)tr.inputs / tr.archived;
+            }
+            printf("%-6s  %9.1f  %14.1f  %19.1f  %15.2f\n", kinds[kind], tols[k], ratio[0], ratio[1], ns);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Feature extraction cost per sample: moments alone, then with band filters at several decimations
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include "bench_util.h"
+#include "vib_features.h"
+
+#define RATE 1000000
+#define LEN (1u << 22)
+#define BLOCK 256
+
+static void count_vector(void *ctx, const vib_features_t *f)
+{
+    ++*(uint32_t *)ctx;
+    bench_sink += (uint64_t)f->kurtosis;
+}
+
+int main(void)
+{
+    static sample_t in[LEN];
+    for (size_t i = 0; i < LEN; i++)
+    {
+        in[i] = (sample_t)lrint(4096 + 600 * sin(2 * M_PI * 1000 * i / RATE) + (int)(bench_rand() % 201) - 100);
+    }
+
+    static const vib_band_t bands[VIB_MAX_BANDS] = {
+        {10, 20}, {20, 40}, {40, 80}, {80, 160}, {160, 320}, {320, 640}, {640, 1280}, {1280, 2560},
+    };
+    static const struct
+    {
+        uint8_t num_bands;
+        uint8_t decim_shift;
+    } runs[] = {{0, 0}, {1, 0}, {4, 0}, {8, 0}, {8, 2}, {8, 4}, {8, 6}};
+
+    printf("bands  band rate  ns/sample  of 1 MSPS budget  vectors\n");
+    for (size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); r++)
+    {
+        vib_config_t cfg = {
+            .sample_rate_hz = RATE,
+            .window_shift = 16,
+            .band_decim_shift = runs[r].decim_shift,
+            .num_bands = runs[r].num_bands,
+        };
+        for (int b = 0; b < cfg.num_bands; b++)
+        {
+            cfg.bands[b] = bands[b];
+        }
+        vib_t v;
+        uint32_t vectors = 0;
+        if (!vib_init(&v, &cfg, count_vector, &vectors))
+        {
+            printf("bad config\n");
+            return 1;
+        }
+        double t0 = bench_now_s();
+        for (size_t off = 0; off < LEN; off += BLOCK)
+        {
+            vib_process(&v, &in[off], BLOCK, off);
+        }
+        double ns = (bench_now_s() - t0) * 1e9 / LEN;
+        printf("%5u  %7.1f k  %9.2f  %15.1f%%  %7" PRIu32 "\n", cfg.num_bands,
+               RATE / 1000.0 / (1u << cfg.band_decim_shift), ns, ns / 10, vectors);
+    }
+    return 0;
+}
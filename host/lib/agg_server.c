@@ -0,0 +1,599 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include "agg_server.h"
+
+#define AGG_RUN_BLOCKS 64 // blocks per file write at most
+#define AGG_DEFAULT_SUB_QUEUE (4u << 20)
+
+typedef enum
+{
+    CONN_NEW, // role decided by the first bytes
+    CONN_DEVICE,
+    CONN_SUB,
+} conn_role_t;
+
+struct agg_conn
+{
+    int fd;
+    agg_worker_t *worker;
+    agg_conn_t *prev, *next; // in the owning worker's list
+    conn_role_t role;
+    uint8_t *rx;
+    size_t rx_len;
+    agg_stream_t *stream;  // subscribed stream
+    pthread_mutex_t lock;  // subscriber queue, filled from any worker
+    uint8_t *q;
+    size_t q_head, q_len;  // queued bytes are q[q_head, q_head + q_len)
+};
+
+// One run of consecutive valid blocks of a stream in a receive buffer
+typedef struct
+{
+    agg_stream_t *stream;
+    const uint8_t *start;
+    size_t bytes;
+    int num_blocks;
+    stream_block_t blocks[AGG_RUN_BLOCKS];
+} run_t;
+
+static void stat_add(uint64_t *v, uint64_t n)
+{
+    __atomic_fetch_add(v, n, __ATOMIC_RELAXED);
+}
+
+static bool write_all(int fd, const uint8_t *p, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t r = write(fd, p, n);
+        if (r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (r <= 0)
+        {
+            return false;
+        }
+        p += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+// Streams are created once and never removed, so a slot can be read without the lock once used is set
+static agg_stream_t *find_stream(agg_server_t *srv, uint16_t device, uint8_t channel, bool create)
+{
+    uint32_t h = (((uint32_t)device << 8 | channel) * 2654435761u) >> 16;
+    for (uint32_t i = 0; i < AGG_MAX_STREAMS; i++)
+    {
+        agg_stream_t *s = &srv->streams[(h + i) & (AGG_MAX_STREAMS - 1)];
+        if (!__atomic_load_n(&s->used, __ATOMIC_ACQUIRE))
+        {
+            if (!create)
+            {
+                return NULL;
+            }
+            pthread_mutex_lock(&srv->streams_lock);
+            bool mine = !s->used;
+            if (mine)
+            {
+                s->device = device;
+                s->channel = channel;
+                __atomic_store_n(&s->used, true, __ATOMIC_RELEASE);
+            }
+            pthread_mutex_unlock(&srv->streams_lock);
+            if (mine)
+            {
+                return s;
+            }
+        }
+        if (s->device == device && s->channel == channel)
+        {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void sub_flush_locked(agg_conn_t *c)
+{
+    while (c->q_len > 0)
+    {
+        ssize_t r = send(c->fd, c->q + c->q_head, c->q_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (r < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                c->q_len = 0; // the owner sees the error and closes the connection
+            }
+            break;
+        }
+        c->q_head += (size_t)r;
+        c->q_len -= (size_t)r;
+    }
+    if (c->q_len == 0)
+    {
+        c->q_head = 0;
+    }
+}
+
+// Queue one block for a subscriber, sending straight from the receive buffer when nothing is queued.
+// Only whole blocks are dropped, so the subscriber's stream stays framed.
+static void sub_push(agg_worker_t *w, agg_conn_t *c, const uint8_t *b, size_t n)
+{
+    pthread_mutex_lock(&c->lock);
+    size_t sent = 0;
+    if (c->q_len == 0)
+    {
+        ssize_t r;
+        do
+        {
+            r = send(c->fd, b, n, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (r < 0 && errno == EINTR);
+        sent = r > 0 ? (size_t)r : 0;
+    }
+    size_t rest = n - sent;
+    if (sent == 0 && c->q_len + rest > w->srv->cfg.sub_queue_bytes)
+    {
+        stat_add(&w->stats.sub_drops, 1);
+    }
+    else
+    {
+        // A partly sent block lands in an empty queue, which holds the largest block
+        if (c->q_head + c->q_len + rest > w->srv->cfg.sub_queue_bytes)
+        {
+            memmove(c->q, c->q + c->q_head, c->q_len);
+            c->q_head = 0;
+        }
+        memcpy(c->q + c->q_head + c->q_len, b + sent, rest);
+        c->q_len += rest;
+        stat_add(&w->stats.sub_blocks, 1);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void flush_run(agg_worker_t *w, run_t *run)
+{
+    agg_stream_t *s = run->stream;
+    if (run->num_blocks == 0)
+    {
+        return;
+    }
+    pthread_mutex_lock(&s->lock);
+    if (s->fd < 0 && w->srv->cfg.dir)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/dev%u_ch%u.asb", w->srv->cfg.dir, s->device, s->channel);
+        s->fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (s->fd < 0)
+        {
+            fprintf(stderr, "agg: cannot open %s: %s\n", path, strerror(errno));
+        }
+    }
+    if (s->fd >= 0 && !write_all(s->fd, run->start, run->bytes))
+    {
+        fprintf(stderr, "agg: write to dev%u_ch%u failed: %s\n", s->device, s->channel, strerror(errno));
+    }
+    const uint8_t *b = run->start;
+    for (int i = 0; i < run->num_blocks; i++)
+    {
+        const stream_block_t *blk = &run->blocks[i];
+        uint32_t ahead = blk->seq - s->next_seq;
+        if (s->seen && ahead != 0 && ahead < (1u << 31)) // late or repeated blocks are not gaps
+        {
+            s->stats.gaps += ahead;
+        }
+        s->seen = true;
+        s->next_seq = blk->seq + 1;
+        s->stats.blocks++;
+        s->stats.samples += blk->samples;
+        size_t size = STREAM_HEADER_BYTES + blk->payload;
+        for (int k = 0; k < s->num_subs; k++)
+        {
+            sub_push(w, s->subs[k], b, size);
+        }
+        b += size;
+    }
+    pthread_mutex_unlock(&s->lock);
+    stat_add(&w->stats.blocks, (uint64_t)run->num_blocks);
+    stat_add(&w->stats.bytes, run->bytes);
+    run->num_blocks = 0;
+    run->bytes = 0;
+}
+
+static bool subscribe(agg_worker_t *w, agg_conn_t *c)
+{
+    const uint8_t *p = c->rx;
+    agg_stream_t *s = find_stream(w->srv, (uint16_t)(p[4] | p[5] << 8), p[6], true);
+    c->q = malloc(w->srv->cfg.sub_queue_bytes);
+    if (s == NULL || c->q == NULL)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&s->lock);
+    bool ok = s->num_subs < AGG_MAX_SUBS;
+    if (ok)
+    {
+        s->subs[s->num_subs++] = c;
+        c->stream = s;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ok;
+}
+
+// Handle what the receive buffer holds; false closes the connection
+static bool conn_consume(agg_worker_t *w, agg_conn_t *c)
+{
+    if (c->role == CONN_NEW)
+    {
+        static const uint8_t sub_magic[4] = {'A', 'S', 'U', 'B'};
+        size_t n = c->rx_len < 4 ? c->rx_len : 4;
+        if (memcmp(c->rx, sub_magic, n) != 0)
+        {
+            c->role = CONN_DEVICE;
+        }
+        else if (c->rx_len >= AGG_SUB_REQUEST_BYTES)
+        {
+            c->role = CONN_SUB;
+            if (!subscribe(w, c))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return true;
+        }
+    }
+    if (c->role == CONN_SUB)
+    {
+        c->rx_len = 0; // nothing more is expected from subscribers
+        return true;
+    }
+
+    static __thread run_t run;
+    run.num_blocks = 0;
+    run.bytes = 0;
+    size_t off = 0;
+    while (off < c->rx_len)
+    {
+        stream_block_t blk;
+        stream_status_t st = stream_block_parse(c->rx + off, c->rx_len - off, &blk);
+        if (st == STREAM_NEED_MORE)
+        {
+            break;
+        }
+        if (st != STREAM_OK)
+        {
+            flush_run(w, &run);
+            if (st == STREAM_BAD_CRC)
+            {
+                stat_add(&w->stats.bad_blocks, 1);
+            }
+            size_t skip = stream_resync(c->rx + off, c->rx_len - off);
+            stat_add(&w->stats.skipped_bytes, skip);
+            off += skip;
+            continue;
+        }
+        agg_stream_t *s = run.num_blocks > 0 && run.stream->device == blk.device && run.stream->channel == blk.channel
+                              ? run.stream
+                              : find_stream(w->srv, blk.device, blk.channel, true);
+        if (s != run.stream || run.num_blocks == AGG_RUN_BLOCKS)
+        {
+            flush_run(w, &run);
+        }
+        if (s == NULL)
+        {
+            off += STREAM_HEADER_BYTES + blk.payload; // stream table full
+            continue;
+        }
+        if (run.num_blocks == 0)
+        {
+            run.stream = s;
+            run.start = c->rx + off;
+        }
+        run.blocks[run.num_blocks++] = blk;
+        run.bytes += STREAM_HEADER_BYTES + blk.payload;
+        off += STREAM_HEADER_BYTES + blk.payload;
+    }
+    flush_run(w, &run);
+    memmove(c->rx, c->rx + off, c->rx_len - off);
+    c->rx_len -= off;
+    return true;
+}
+
+// Drain the socket (edge-triggered); false on end of stream or error
+static bool conn_read(agg_worker_t *w, agg_conn_t *c)
+{
+    for (;;)
+    {
+        ssize_t r = recv(c->fd, c->rx + c->rx_len, AGG_RX_BYTES - c->rx_len, 0);
+        if (r > 0)
+        {
+            c->rx_len += (size_t)r;
+            if (!conn_consume(w, c))
+            {
+                return false;
+            }
+            continue;
+        }
+        if (r < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        return r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+}
+
+static void conn_close(agg_worker_t *w, agg_conn_t *c)
+{
+    agg_stream_t *s = c->stream;
+    if (s)
+    {
+        pthread_mutex_lock(&s->lock);
+        for (int k = 0; k < s->num_subs; k++)
+        {
+            if (s->subs[k] == c)
+            {
+                s->subs[k] = s->subs[--s->num_subs];
+                break;
+            }
+        }
+        pthread_mutex_unlock(&s->lock);
+    }
+    epoll_ctl(w->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    if (c->prev)
+    {
+        c->prev->next = c->next;
+    }
+    else
+    {
+        w->conns = c->next;
+    }
+    if (c->next)
+    {
+        c->next->prev = c->prev;
+    }
+    pthread_mutex_destroy(&c->lock);
+    free(c->rx);
+    free(c->q);
+    free(c);
+}
+
+static void accept_one(agg_worker_t *w)
+{
+    int fd = accept4(w->srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0)
+    {
+        return; // another worker took it
+    }
+    agg_conn_t *c = calloc(1, sizeof(*c));
+    if (c)
+    {
+        c->rx = malloc(AGG_RX_BYTES);
+    }
+    if (c == NULL || c->rx == NULL)
+    {
+        free(c);
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    c->worker = w;
+    pthread_mutex_init(&c->lock, NULL);
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = c};
+    if (epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        pthread_mutex_destroy(&c->lock);
+        free(c->rx);
+        free(c);
+        close(fd);
+        return;
+    }
+    c->next = w->conns;
+    if (w->conns)
+    {
+        w->conns->prev = c;
+    }
+    w->conns = c;
+    stat_add(&w->stats.connections, 1);
+}
+
+static void *worker_main(void *arg)
+{
+    agg_worker_t *w = arg;
+    agg_server_t *srv = w->srv;
+    struct epoll_event ev[64];
+    bool running = true;
+    while (running)
+    {
+        int n = epoll_wait(w->epoll_fd, ev, 64, -1);
+        for (int i = 0; i < n; i++)
+        {
+            void *p = ev[i].data.ptr;
+            if (p == &srv->stop_fd)
+            {
+                running = false;
+                continue;
+            }
+            if (p == &srv->listen_fd)
+            {
+                accept_one(w);
+                continue;
+            }
+            agg_conn_t *c = p;
+            bool ok = true;
+            if (ev[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            {
+                ok = conn_read(w, c);
+            }
+            if (ok && (ev[i].events & EPOLLOUT) && c->role == CONN_SUB)
+            {
+                pthread_mutex_lock(&c->lock);
+                sub_flush_locked(c);
+                pthread_mutex_unlock(&c->lock);
+            }
+            if (!ok)
+            {
+                conn_close(w, c);
+            }
+        }
+    }
+    return NULL;
+}
+
+bool agg_server_start(agg_server_t *srv, const agg_config_t *cfg)
+{
+    memset(srv, 0, sizeof(*srv));
+    srv->cfg = *cfg;
+    if (srv->cfg.sub_queue_bytes == 0)
+    {
+        srv->cfg.sub_queue_bytes = AGG_DEFAULT_SUB_QUEUE;
+    }
+    if (cfg->workers < 1 || cfg->workers > AGG_MAX_WORKERS || srv->cfg.sub_queue_bytes < AGG_MIN_SUB_QUEUE)
+    {
+        return false;
+    }
+    pthread_mutex_init(&srv->streams_lock, NULL);
+    for (int i = 0; i < AGG_MAX_STREAMS; i++)
+    {
+        pthread_mutex_init(&srv->streams[i].lock, NULL);
+        srv->streams[i].fd = -1;
+    }
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    srv->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int one = 1;
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(cfg->port), .sin_addr.s_addr = htonl(INADDR_ANY)};
+    socklen_t len = sizeof(addr);
+    bool ok = srv->listen_fd >= 0 && srv->stop_fd >= 0 &&
+              setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0 &&
+              bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(srv->listen_fd, 256) == 0 &&
+              getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) == 0;
+    srv->port = ntohs(addr.sin_port);
+
+    int started = 0;
+    for (int i = 0; ok && i < cfg->workers; i++)
+    {
+        agg_worker_t *w = &srv->workers[i];
+        w->srv = srv;
+        w->index = i;
+        w->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event lev = {.events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = &srv->listen_fd};
+        struct epoll_event sev = {.events = EPOLLIN, .data.ptr = &srv->stop_fd};
+        ok = w->epoll_fd >= 0 && epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &lev) == 0 &&
+             epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, srv->stop_fd, &sev) == 0 &&
+             pthread_create(&w->thread, NULL, worker_main, w) == 0;
+        started += ok;
+        if (!ok && w->epoll_fd >= 0)
+        {
+            close(w->epoll_fd);
+        }
+    }
+    if (!ok)
+    {
+        srv->cfg.workers = started;
+        agg_server_stop(srv);
+    }
+    return ok;
+}
+
+void agg_server_stop(agg_server_t *srv)
+{
+    uint64_t one = 1;
+    if (srv->stop_fd >= 0 && write(srv->stop_fd, &one, sizeof(one)) < 0)
+    {
+        fprintf(stderr, "agg: cannot signal the workers: %s\n", strerror(errno));
+    }
+    for (int i = 0; i < srv->cfg.workers; i++)
+    {
+        agg_worker_t *w = &srv->workers[i];
+        pthread_join(w->thread, NULL);
+    }
+    // Subscribers may be registered on streams fed by another worker: close them all once every worker is idle
+    for (int i = 0; i < srv->cfg.workers; i++)
+    {
+        agg_worker_t *w = &srv->workers[i];
+        while (w->conns)
+        {
+            conn_close(w, w->conns);
+        }
+        close(w->epoll_fd);
+    }
+    for (int i = 0; i < AGG_MAX_STREAMS; i++)
+    {
+        if (srv->streams[i].fd >= 0)
+        {
+            close(srv->streams[i].fd);
+        }
+        pthread_mutex_destroy(&srv->streams[i].lock);
+    }
+    pthread_mutex_destroy(&srv->streams_lock);
+    if (srv->listen_fd >= 0)
+    {
+        close(srv->listen_fd);
+    }
+    if (srv->stop_fd >= 0)
+    {
+        close(srv->stop_fd);
+    }
+}
+
+void agg_server_stats(agg_server_t *srv, agg_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < srv->cfg.workers; i++)
+    {
+        const agg_stats_t *s = &srv->workers[i].stats;
+        out->connections += __atomic_load_n(&s->connections, __ATOMIC_RELAXED);
+        out->blocks += __atomic_load_n(&s->blocks, __ATOMIC_RELAXED);
+        out->bytes += __atomic_load_n(&s->bytes, __ATOMIC_RELAXED);
+        out->bad_blocks += __atomic_load_n(&s->bad_blocks, __ATOMIC_RELAXED);
+        out->skipped_bytes += __atomic_load_n(&s->skipped_bytes, __ATOMIC_RELAXED);
+        out->sub_blocks += __atomic_load_n(&s->sub_blocks, __ATOMIC_RELAXED);
+        out->sub_drops += __atomic_load_n(&s->sub_drops, __ATOMIC_RELAXED);
+    }
+}
+
+bool agg_server_stream_stats(agg_server_t *srv, uint16_t device, uint8_t channel, agg_stream_stats_t *out)
+{
+    agg_stream_t *s = find_stream(srv, device, channel, false);
+    if (s == NULL)
+    {
+        return false;
+    }
+    pthread_mutex_lock(&s->lock);
+    *out = s->stats;
+    out->subscribers = s->num_subs;
+    pthread_mutex_unlock(&s->lock);
+    return true;
+}
+
+void agg_sub_request(uint16_t device, uint8_t channel, uint8_t out[AGG_SUB_REQUEST_BYTES])
+{
+    memcpy(out, "ASUB", 4);
+    out[4] = (uint8_t)device;
+    out[5] = (uint8_t)(device >> 8);
+    out[6] = channel;
+    out[7] = 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Aggregation server for device streams (Linux host)
+ *
+ * Devices connect over TCP and send stream blocks (stream_block.h). Every
+ * worker thread runs its own epoll loop over the shared listening socket,
+ * registered with EPOLLEXCLUSIVE so one worker takes each new connection,
+ * and over the connections it accepted. A device stays on one worker, and
+ * workers only meet at the per-stream lock, so throughput grows with the
+ * number of workers until the disk or the network saturates.
+ *
+ * Bytes are validated in the connection's receive buffer: header sanity and
+ * CRC-32C per block. Damaged data is skipped up to the next magic and
+ * counted. Valid blocks are demultiplexed by (device, channel) and appended
+ * to <dir>/dev<device>_ch<channel>.asb. A run of consecutive blocks of one
+ * stream goes out in a single write straight from the receive buffer.
+ * Sequence gaps are counted per stream.
+ *
+ * Live subscriptions: a client that starts with a subscribe request (u32
+ * magic "ASUB", u16 device, u8 channel, u8 0) instead of blocks receives
+ * every later valid block of that stream. Each subscriber has a bounded
+ * queue. A block that does not fit is dropped for that subscriber only, so
+ * a slow client never stalls the devices or the other subscribers.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "stream_block.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AGG_MAX_WORKERS 16
+#define AGG_MAX_STREAMS 256 // power of two
+#define AGG_MAX_SUBS 16     // per stream
+#define AGG_RX_BYTES (1u << 20) // per connection, holds the largest block twice
+#define AGG_SUB_REQUEST_BYTES 8
+#define AGG_MIN_SUB_QUEUE (STREAM_HEADER_BYTES + 2 * STREAM_MAX_SAMPLES) // the largest block
+
+typedef struct
+{
+    const char *dir;          // capture file directory, NULL to only serve subscriptions
+    uint16_t port;            // TCP port on all interfaces, 0 for any free one
+    int workers;              // 1..AGG_MAX_WORKERS
+    uint32_t sub_queue_bytes; // per subscriber, at least AGG_MIN_SUB_QUEUE; 0 for 4 MB
+} agg_config_t;
+
+typedef struct
+{
+    uint64_t connections;
+    uint64_t blocks;
+    uint64_t bytes;         // valid block bytes, headers included
+    uint64_t bad_blocks;    // CRC failures
+    uint64_t skipped_bytes; // bytes passed over while resynchronizing
+    uint64_t sub_blocks;    // blocks queued to subscribers
+    uint64_t sub_drops;     // blocks a full subscriber queue did not take
+} agg_stats_t;
+
+typedef struct
+{
+    uint64_t blocks;
+    uint64_t samples;
+    uint64_t gaps;   // blocks missing from the sequence
+    int subscribers;
+} agg_stream_stats_t;
+
+typedef struct agg_conn agg_conn_t;
+typedef struct agg_server agg_server_t;
+
+typedef struct
+{
+    bool used;          // set once, after the rest is initialized
+    uint16_t device;
+    uint8_t channel;
+    pthread_mutex_t lock;
+    int fd;             // capture file, opened on the first block
+    bool seen;
+    uint32_t next_seq;
+    agg_stream_stats_t stats;
+    agg_conn_t *subs[AGG_MAX_SUBS];
+    int num_subs;
+} agg_stream_t;
+
+typedef struct
+{
+    agg_server_t *srv;
+    int index;
+    int epoll_fd;
+    pthread_t thread;
+    agg_conn_t *conns; // connections this worker accepted
+    agg_stats_t stats; // updated by this worker only, read with relaxed atomics
+} agg_worker_t;
+
+struct agg_server
+{
+    agg_config_t cfg;
+    int listen_fd;
+    int stop_fd; // eventfd, readable once the server stops
+    uint16_t port;
+    agg_worker_t workers[AGG_MAX_WORKERS];
+    pthread_mutex_t streams_lock; // serializes stream creation; lookups are lock-free
+    agg_stream_t streams[AGG_MAX_STREAMS];
+};
+
+// Listen and start the workers. The server struct must stay in place until agg_server_stop().
+bool agg_server_start(agg_server_t *srv, const agg_config_t *cfg);
+
+// Close every connection and capture file and join the workers
+void agg_server_stop(agg_server_t *srv);
+
+static inline uint16_t agg_server_port(const agg_server_t *srv)
+{
+    return srv->port;
+}
+
+// Totals over all workers
+void agg_server_stats(agg_server_t *srv, agg_stats_t *out);
+
+// Counters of one stream; false if it has not been seen
+bool agg_server_stream_stats(agg_server_t *srv, uint16_t device, uint8_t channel, agg_stream_stats_t *out);
+
+// Subscribe request for a client to send after connecting
+void agg_sub_request(uint16_t device, uint8_t channel, uint8_t out[AGG_SUB_REQUEST_BYTES]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,201 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture_file.h"
+#include "stream_decode.h"
+
+#define DECODE_CHUNK 4096 // samples decoded at a time when a read starts inside a block
+
+static bool add_block(capture_file_t *cf, size_t *cap, const stream_block_t *blk, uint64_t offset)
+{
+    if (cf->num_blocks == *cap)
+    {
+        size_t new_cap = *cap ? *cap * 2 : 1024;
+        capture_block_t *b = realloc(cf->blocks, new_cap * sizeof(*b));
+        if (b == NULL)
+        {
+            return false;
+        }
+        cf->blocks = b;
+        *cap = new_cap;
+    }
+    if (cf->num_blocks > 0)
+    {
+        uint32_t ahead = blk->seq - cf->blocks[cf->num_blocks - 1].seq - 1;
+        cf->seq_gaps += ahead < (1u << 31) ? ahead : 0;
+    }
+    cf->blocks[cf->num_blocks++] = (capture_block_t){
+        .offset = offset,
+        .pos = blk->pos,
+        .seq = blk->seq,
+        .samples = blk->samples,
+        .payload = blk->payload,
+        .device = blk->device,
+        .channel = blk->channel,
+        .format = blk->format,
+    };
+    cf->samples += blk->samples;
+    return true;
+}
+
+static bool build_index(capture_file_t *cf, bool verify)
+{
+    size_t cap = 0;
+    size_t off = 0;
+    while (off < cf->size)
+    {
+        const size_t left = cf->size - off;
+        stream_block_t blk;
+        stream_status_t st;
+        if (verify)
+        {
+            st = stream_block_parse(cf->data + off, left, &blk);
+        }
+        else
+        {
+            // A sane header alone asks for the payload; the payload only has to be there
+            st = stream_block_parse(cf->data + off, left < STREAM_HEADER_BYTES ? left : STREAM_HEADER_BYTES, &blk);
+            if (st == STREAM_NEED_MORE && left >= STREAM_HEADER_BYTES)
+            {
+                st = left >= STREAM_HEADER_BYTES + (size_t)blk.payload ? STREAM_OK : STREAM_NEED_MORE;
+            }
+        }
+        if (st == STREAM_NEED_MORE)
+        {
+            cf->truncated = true;
+            break;
+        }
+        if (st == STREAM_OK)
+        {
+            if (!add_block(cf, &cap, &blk, off))
+            {
+                return false;
+            }
+            off += STREAM_HEADER_BYTES + blk.payload;
+            continue;
+        }
+        cf->bad_blocks += st == STREAM_BAD_CRC;
+        size_t skip = stream_resync(cf->data + off, left);
+        cf->skipped_bytes += skip;
+        off += skip;
+    }
+    return true;
+}
+
+bool capture_file_open(capture_file_t *cf, const char *path, bool verify)
+{
+    memset(cf, 0, sizeof(*cf));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0;
+    cf->size = ok ? (size_t)st.st_size : 0;
+    if (ok && cf->size > 0)
+    {
+        void *p = mmap(NULL, cf->size, PROT_READ, MAP_SHARED, fd, 0);
+        ok = p != MAP_FAILED;
+        cf->data = ok ? p : NULL;
+    }
+    close(fd); // the mapping stays valid
+    if (ok && cf->data != NULL)
+    {
+        madvise((void *)cf->data, cf->size, MADV_SEQUENTIAL);
+        ok = build_index(cf, verify);
+        madvise((void *)cf->data, cf->size, MADV_NORMAL);
+    }
+    if (!ok)
+    {
+        capture_file_close(cf);
+    }
+    return ok;
+}
+
+void capture_file_close(capture_file_t *cf)
+{
+    if (cf->data != NULL)
+    {
+        munmap((void *)cf->data, cf->size);
+    }
+    free(cf->blocks);
+    memset(cf, 0, sizeof(*cf));
+}
+
+void capture_file_decode(const capture_file_t *cf, size_t i, sample_t *out)
+{
+    stream_decode_unpack(cf->blocks[i].format, capture_file_payload(cf, i), cf->blocks[i].samples, out);
+}
+
+size_t capture_file_find(const capture_file_t *cf, uint64_t pos)
+{
+    size_t lo = 0, hi = cf->num_blocks;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cf->blocks[mid].pos + cf->blocks[mid].samples <= pos)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t capture_file_read(const capture_file_t *cf, uint64_t pos, size_t n, sample_t *out)
+{
+    size_t done = 0;
+    for (size_t i = capture_file_find(cf, pos); i < cf->num_blocks && done < n; i++)
+    {
+        const capture_block_t *b = &cf->blocks[i];
+        if (b->pos > pos)
+        {
+            break; // gap
+        }
+        const size_t skip = (size_t)(pos - b->pos);
+        const size_t take = b->samples - skip < n - done ? b->samples - skip : n - done;
+        if (skip == 0 && take == b->samples)
+        {
+            capture_file_decode(cf, i, out + done);
+        }
+        else if (b->format == STREAM_FMT_RAW16 || skip % 8 == 0)
+        {
+            // Packed formats start on a byte every 8 samples
+            const size_t at = b->format == STREAM_FMT_RAW16 ? 2 * skip : stream_payload_bytes(b->format, 8) * (skip / 8);
+            stream_decode_unpack(b->format, capture_file_payload(cf, i) + at, take, out + done);
+        }
+        else
+        {
+            sample_t tmp[DECODE_CHUNK];
+            size_t from = skip - skip % 8;
+            const uint8_t *p = capture_file_payload(cf, i) + stream_payload_bytes(b->format, 8) * (from / 8);
+            size_t head = skip - from;
+            size_t m = head + take < DECODE_CHUNK ? head + take : DECODE_CHUNK;
+            stream_decode_unpack(b->format, p, m, tmp);
+            memcpy(out + done, tmp + head, (m - head) * sizeof(sample_t));
+            if (m - head < take)
+            {
+                // The rest starts on a byte boundary again
+                size_t next = from + m;
+                stream_decode_unpack(b->format, capture_file_payload(cf, i) + stream_payload_bytes(b->format, 8) * (next / 8),
+                                     take - (m - head), out + done + (m - head));
+            }
+        }
+        done += take;
+        pos += take;
+    }
+    return done;
+}
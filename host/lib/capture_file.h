@@ -0,0 +1,80 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Capture files on the host
+ *
+ * A capture file holds stream blocks back to back (stream_block.h), as the
+ * aggregation server writes them, normally one device channel per file.
+ * capture_file_open() maps the file read-only and indexes its blocks, and
+ * the data is then used in place: a raw block's samples can be read straight
+ * from the mapping, and packed blocks decode with stream_decode.h.
+ *
+ * Indexing checks every header, and with verify also every CRC (several
+ * GB/s). Damaged stretches are skipped and counted. An incomplete block at
+ * the end, from a file still being written, is left out and flagged.
+ *
+ * The index layout is fixed: the Python binding (python/adc_capture.py)
+ * reads it directly.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "stream_block.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    uint64_t offset;  // of the block header in the file
+    uint64_t pos;     // absolute position of the first sample
+    uint32_t seq;
+    uint32_t samples;
+    uint32_t payload; // bytes
+    uint16_t device;
+    uint8_t channel;
+    uint8_t format;   // stream_format_t
+} capture_block_t;
+
+typedef struct
+{
+    const uint8_t *data; // the mapped file
+    size_t size;
+    capture_block_t *blocks;
+    size_t num_blocks;
+    uint64_t samples;       // over all blocks
+    uint64_t skipped_bytes; // not part of any valid block
+    uint64_t bad_blocks;    // CRC failures, with verify
+    uint64_t seq_gaps;      // blocks missing from the sequence
+    bool truncated;         // the file ends inside a block
+} capture_file_t;
+
+bool capture_file_open(capture_file_t *cf, const char *path, bool verify);
+
+void capture_file_close(capture_file_t *cf);
+
+static inline const uint8_t *capture_file_payload(const capture_file_t *cf, size_t i)
+{
+    return cf->data + cf->blocks[i].offset + STREAM_HEADER_BYTES;
+}
+
+// Unpack block i into blocks[i].samples values
+void capture_file_decode(const capture_file_t *cf, size_t i, sample_t *out);
+
+// First block that ends after sample position pos, num_blocks if none
+size_t capture_file_find(const capture_file_t *cf, uint64_t pos);
+
+// Decode up to n samples from absolute position pos on. Stops at a gap in positions or at the end
+// of the file; returns the number of samples written.
+size_t capture_file_read(const capture_file_t *cf, uint64_t pos, size_t n, sample_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,424 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include "relay.h"
+
+#define RELAY_DEFAULT_CHUNK_BYTES (1u << 20)
+#define RELAY_DEFAULT_CHUNKS 32
+#define RELAY_DEFAULT_MAX_CLIENTS 1024
+
+static void stat_add(uint64_t *v, uint64_t n)
+{
+    __atomic_fetch_add(v, n, __ATOMIC_RELAXED);
+}
+
+static uint8_t *slot_data(relay_t *r, uint64_t chunk)
+{
+    return r->ring + (size_t)(chunk % (uint64_t)r->cfg.chunks) * r->cfg.chunk_bytes;
+}
+
+static uint32_t *slot_len(relay_t *r, uint64_t chunk)
+{
+    return &r->chunk_len[chunk % (uint64_t)r->cfg.chunks];
+}
+
+static void close_client(relay_t *r, relay_client_t *c)
+{
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->dead = true;
+    __atomic_store_n(&r->stats.clients, r->stats.clients - 1, __ATOMIC_RELAXED);
+}
+
+// Events later in the same batch may still point at a closed client, so it is freed afterwards
+static void reap_clients(relay_t *r)
+{
+    int kept = 0;
+    for (int i = 0; i < r->num_clients; i++)
+    {
+        if (r->clients[i]->dead)
+        {
+            free(r->clients[i]);
+        }
+        else
+        {
+            r->clients[kept++] = r->clients[i];
+        }
+    }
+    r->num_clients = kept;
+}
+
+// Send the client what it has not had yet, until it is caught up or its socket is full; false on error
+static bool client_send(relay_t *r, relay_client_t *c)
+{
+    while (!c->blocked)
+    {
+        const uint32_t len = *slot_len(r, c->chunk);
+        if (c->off < len)
+        {
+            ssize_t sent;
+            if (r->cfg.copy)
+            {
+                sent = send(c->fd, slot_data(r, c->chunk) + c->off, len - c->off, MSG_NOSIGNAL | MSG_DONTWAIT);
+            }
+            else
+            {
+                off_t pos = (slot_data(r, c->chunk) - r->ring) + c->off;
+                sent = sendfile(c->fd, r->mem_fd, &pos, len - c->off);
+            }
+            if (sent > 0)
+            {
+                c->off += (uint32_t)sent;
+                stat_add(&r->stats.bytes_out, (uint64_t)sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                c->blocked = true;
+                return true;
+            }
+            return false;
+        }
+        if (c->chunk == r->head)
+        {
+            return true;
+        }
+        // Done with a closed chunk: carry on, or skip the backlog if it is half the ring
+        c->chunk++;
+        c->off = 0;
+        if (r->head - c->chunk > (uint64_t)r->cfg.chunks / 2)
+        {
+            stat_add(&r->stats.dropped_chunks, r->head - c->chunk);
+            c->chunk = r->head;
+        }
+    }
+    return true;
+}
+
+static void serve_clients(relay_t *r)
+{
+    for (int i = 0; i < r->num_clients; i++)
+    {
+        relay_client_t *c = r->clients[i];
+        if (!c->dead && !c->blocked && !client_send(r, c))
+        {
+            close_client(r, c);
+        }
+    }
+}
+
+// Close the head chunk and start the next one in the following slot, carrying over an incomplete block
+static void next_chunk(relay_t *r)
+{
+    const uint8_t *old = slot_data(r, r->head);
+    const uint32_t published = *slot_len(r, r->head);
+    const uint32_t tail = r->fill - published;
+    r->head++;
+
+    // Clients still on the chunk this slot held
+    const uint64_t recycled = r->head - (uint64_t)r->cfg.chunks;
+    for (int i = 0; r->head >= (uint64_t)r->cfg.chunks && i < r->num_clients; i++)
+    {
+        relay_client_t *c = r->clients[i];
+        if (c->dead || c->chunk != recycled)
+        {
+            continue;
+        }
+        const bool finished = c->off > 0 && c->off == *slot_len(r, recycled);
+        if (c->off == 0 || finished)
+        {
+            stat_add(&r->stats.dropped_chunks, r->head - c->chunk - finished);
+            c->chunk = r->head;
+            c->off = 0;
+        }
+        else
+        {
+            stat_add(&r->stats.kicked, 1);
+            close_client(r, c);
+        }
+    }
+
+    // Sockets may still reference the slot's pages: give it new ones instead of overwriting them
+    uint8_t *p = slot_data(r, r->head);
+    if (fallocate(r->mem_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, p - r->ring, r->cfg.chunk_bytes) != 0)
+    {
+        fprintf(stderr, "relay: cannot release a ring slot: %s\n", strerror(errno));
+    }
+    *slot_len(r, r->head) = 0;
+    memcpy(p, old + published, tail);
+    r->fill = tail;
+}
+
+// Drain the source into the ring (edge-triggered) and publish its whole valid blocks; false at its end
+static bool source_read(relay_t *r)
+{
+    for (;;)
+    {
+        if (r->fill == r->cfg.chunk_bytes)
+        {
+            next_chunk(r);
+        }
+        uint8_t *p = slot_data(r, r->head);
+        ssize_t got = read(r->source_fd, p + r->fill, r->cfg.chunk_bytes - r->fill);
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got <= 0)
+        {
+            return got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        r->fill += (uint32_t)got;
+
+        uint32_t *len = slot_len(r, r->head);
+        uint32_t pub = *len;
+        while (pub < r->fill)
+        {
+            stream_block_t blk;
+            stream_status_t st = stream_block_parse(p + pub, r->fill - pub, &blk);
+            if (st == STREAM_NEED_MORE)
+            {
+                break;
+            }
+            if (st == STREAM_OK)
+            {
+                pub += STREAM_HEADER_BYTES + blk.payload;
+                stat_add(&r->stats.blocks, 1);
+                stat_add(&r->stats.bytes_in, STREAM_HEADER_BYTES + blk.payload);
+                continue;
+            }
+            if (st == STREAM_BAD_CRC)
+            {
+                stat_add(&r->stats.bad_blocks, 1);
+            }
+            // Nothing past pub has been published, so bad bytes are cut out in place
+            size_t skip = stream_resync(p + pub, r->fill - pub);
+            memmove(p + pub, p + pub + skip, r->fill - pub - skip);
+            r->fill -= (uint32_t)skip;
+            stat_add(&r->stats.skipped_bytes, skip);
+        }
+        if (pub != *len)
+        {
+            *len = pub;
+            serve_clients(r);
+        }
+    }
+}
+
+static void accept_clients(relay_t *r)
+{
+    for (;;)
+    {
+        int fd = accept4(r->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            return;
+        }
+        if (r->cfg.sndbuf > 0)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &r->cfg.sndbuf, sizeof(r->cfg.sndbuf));
+        }
+        relay_client_t *c = r->num_clients < r->cfg.max_clients ? calloc(1, sizeof(*c)) : NULL;
+        struct epoll_event ev = {.events = EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.ptr = c};
+        if (c == NULL || epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)
+        {
+            free(c);
+            close(fd);
+            continue;
+        }
+        // Start at the newest block boundary
+        c->fd = fd;
+        c->chunk = r->head;
+        c->off = *slot_len(r, r->head);
+        r->clients[r->num_clients++] = c;
+        stat_add(&r->stats.connections, 1);
+        __atomic_store_n(&r->stats.clients, r->stats.clients + 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void *relay_main(void *arg)
+{
+    relay_t *r = arg;
+    // sendfile() has no MSG_NOSIGNAL: a client that went away must not kill the process
+    sigset_t pipe_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_set, NULL);
+
+    struct epoll_event ev[64];
+    bool running = true;
+    while (running)
+    {
+        int n = epoll_wait(r->epoll_fd, ev, 64, -1);
+        for (int i = 0; i < n; i++)
+        {
+            void *p = ev[i].data.ptr;
+            if (p == &r->stop_fd)
+            {
+                running = false;
+                continue;
+            }
+            if (p == &r->listen_fd)
+            {
+                accept_clients(r);
+                continue;
+            }
+            if (p == &r->source_fd)
+            {
+                if (!source_read(r))
+                {
+                    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, r->source_fd, NULL);
+                    __atomic_store_n(&r->stats.source_done, true, __ATOMIC_RELAXED);
+                }
+                continue;
+            }
+            relay_client_t *c = p;
+            if (c->dead)
+            {
+                continue;
+            }
+            if (ev[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            {
+                close_client(r, c);
+                continue;
+            }
+            c->blocked = false;
+            if (!client_send(r, c))
+            {
+                close_client(r, c);
+            }
+        }
+        reap_clients(r);
+    }
+    return NULL;
+}
+
+static void relay_free(relay_t *r)
+{
+    for (int i = 0; i < r->num_clients; i++)
+    {
+        if (!r->clients[i]->dead)
+        {
+            close(r->clients[i]->fd);
+        }
+        free(r->clients[i]);
+    }
+    free(r->clients);
+    free(r->chunk_len);
+    if (r->ring != NULL)
+    {
+        munmap(r->ring, (size_t)r->cfg.chunks * r->cfg.chunk_bytes);
+    }
+    int *fds[] = {&r->source_fd, &r->listen_fd, &r->epoll_fd, &r->stop_fd, &r->mem_fd};
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++)
+    {
+        if (*fds[i] >= 0)
+        {
+            close(*fds[i]);
+        }
+    }
+}
+
+bool relay_start(relay_t *r, const relay_config_t *cfg, int source_fd)
+{
+    memset(r, 0, sizeof(*r));
+    r->cfg = *cfg;
+    r->cfg.chunk_bytes = cfg->chunk_bytes ? cfg->chunk_bytes : RELAY_DEFAULT_CHUNK_BYTES;
+    r->cfg.chunks = cfg->chunks ? cfg->chunks : RELAY_DEFAULT_CHUNKS;
+    r->cfg.max_clients = cfg->max_clients ? cfg->max_clients : RELAY_DEFAULT_MAX_CLIENTS;
+    r->source_fd = source_fd;
+    r->listen_fd = r->epoll_fd = r->stop_fd = r->mem_fd = -1;
+    const long page = sysconf(_SC_PAGESIZE);
+    if (r->cfg.chunk_bytes < RELAY_MIN_CHUNK_BYTES || r->cfg.chunk_bytes % page != 0 ||
+        r->cfg.chunks < RELAY_MIN_CHUNKS || r->cfg.max_clients < 1)
+    {
+        relay_free(r);
+        return false;
+    }
+
+    const size_t ring_bytes = (size_t)r->cfg.chunks * r->cfg.chunk_bytes;
+    r->mem_fd = memfd_create("relay_ring", MFD_CLOEXEC);
+    bool ok = r->mem_fd >= 0 && ftruncate(r->mem_fd, (off_t)ring_bytes) == 0;
+    if (ok)
+    {
+        r->ring = mmap(NULL, ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, r->mem_fd, 0);
+        ok = r->ring != MAP_FAILED;
+        r->ring = ok ? r->ring : NULL;
+    }
+    r->chunk_len = calloc((size_t)r->cfg.chunks, sizeof(*r->chunk_len));
+    r->clients = calloc((size_t)r->cfg.max_clients, sizeof(*r->clients));
+    ok = ok && r->chunk_len != NULL && r->clients != NULL;
+
+    r->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    r->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    int one = 1;
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(cfg->port), .sin_addr.s_addr = htonl(INADDR_ANY)};
+    socklen_t len = sizeof(addr);
+    ok = ok && r->listen_fd >= 0 && r->stop_fd >= 0 && r->epoll_fd >= 0 &&
+         setsockopt(r->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) == 0 &&
+         bind(r->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(r->listen_fd, 256) == 0 &&
+         getsockname(r->listen_fd, (struct sockaddr *)&addr, &len) == 0;
+    r->port = ntohs(addr.sin_port);
+
+    struct epoll_event lev = {.events = EPOLLIN, .data.ptr = &r->listen_fd};
+    struct epoll_event sev = {.events = EPOLLIN, .data.ptr = &r->stop_fd};
+    struct epoll_event dev = {.events = EPOLLIN | EPOLLRDHUP | EPOLLET, .data.ptr = &r->source_fd};
+    ok = ok && fcntl(source_fd, F_SETFL, fcntl(source_fd, F_GETFL) | O_NONBLOCK) == 0 &&
+         epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->listen_fd, &lev) == 0 &&
+         epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->stop_fd, &sev) == 0 &&
+         epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, source_fd, &dev) == 0 &&
+         pthread_create(&r->thread, NULL, relay_main, r) == 0;
+    if (!ok)
+    {
+        relay_free(r);
+    }
+    return ok;
+}
+
+void relay_stop(relay_t *r)
+{
+    uint64_t one = 1;
+    if (write(r->stop_fd, &one, sizeof(one)) < 0)
+    {
+        fprintf(stderr, "relay: cannot signal the relay thread: %s\n", strerror(errno));
+    }
+    pthread_join(r->thread, NULL);
+    relay_free(r);
+}
+
+void relay_stats(relay_t *r, relay_stats_t *out)
+{
+    const relay_stats_t *s = &r->stats;
+    out->connections = __atomic_load_n(&s->connections, __ATOMIC_RELAXED);
+    out->blocks = __atomic_load_n(&s->blocks, __ATOMIC_RELAXED);
+    out->bytes_in = __atomic_load_n(&s->bytes_in, __ATOMIC_RELAXED);
+    out->bad_blocks = __atomic_load_n(&s->bad_blocks, __ATOMIC_RELAXED);
+    out->skipped_bytes = __atomic_load_n(&s->skipped_bytes, __ATOMIC_RELAXED);
+    out->bytes_out = __atomic_load_n(&s->bytes_out, __ATOMIC_RELAXED);
+    out->dropped_chunks = __atomic_load_n(&s->dropped_chunks, __ATOMIC_RELAXED);
+    out->kicked = __atomic_load_n(&s->kicked, __ATOMIC_RELAXED);
+    out->clients = __atomic_load_n(&s->clients, __ATOMIC_RELAXED);
+    out->source_done = __atomic_load_n(&s->source_done, __ATOMIC_RELAXED);
+}
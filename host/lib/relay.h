@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Fan-out relay for one device stream (Linux host)
+ *
+ * The relay reads stream blocks (stream_block.h) from one source, such as a
+ * device connection or a subscription to the aggregation server, and sends
+ * them to any number of TCP clients. All clients share one ring of chunks in
+ * a memfd. The source is read straight into the ring, and each client is
+ * served with sendfile() from it, so the kernel passes page references to
+ * the sockets and never copies the data per client. Memory stays the size
+ * of the ring however many clients connect.
+ *
+ * A chunk starts on a block boundary, and only whole valid blocks are
+ * published, so clients always see a well-formed stream. Before a slot is
+ * reused its pages are punched out of the memfd: sockets that still hold
+ * references keep the old pages, and the new chunk gets fresh ones.
+ *
+ * Slow clients: a client that falls more than half the ring behind skips
+ * to the newest chunk when it finishes its current one, dropping whole
+ * chunks. A client still in the middle of a chunk when its slot comes round
+ * again is disconnected. Neither ever delays the source or other clients.
+ *
+ * A new client starts at the next block boundary. One thread runs the
+ * relay; the work per client is a sendfile() call per chunk or per wakeup.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "stream_block.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RELAY_MIN_CHUNK_BYTES (1u << 20) // holds the largest block with room to spare
+#define RELAY_MIN_CHUNKS 4
+
+typedef struct
+{
+    uint16_t port;        // TCP port for clients on all interfaces, 0 for any free one
+    uint32_t chunk_bytes; // a multiple of the page size, at least RELAY_MIN_CHUNK_BYTES; 0 for 1 MB
+    int chunks;           // ring slots, at least RELAY_MIN_CHUNKS; 0 for 32
+    int max_clients;      // 0 for 1024
+    uint32_t sndbuf;      // socket send buffer per client, 0 for the kernel's; bounds the pages a stalled client pins
+    bool copy;            // send() from the ring instead of sendfile(), for comparison
+} relay_config_t;
+
+typedef struct
+{
+    uint64_t connections;
+    uint64_t blocks;         // valid blocks from the source
+    uint64_t bytes_in;       // valid block bytes from the source
+    uint64_t bad_blocks;     // CRC failures
+    uint64_t skipped_bytes;  // bytes passed over while resynchronizing
+    uint64_t bytes_out;      // sent to all clients together
+    uint64_t dropped_chunks; // skipped by slow clients
+    uint64_t kicked;         // clients disconnected for stalling a whole ring
+    int clients;             // connected now
+    bool source_done;        // the source reached its end
+} relay_stats_t;
+
+typedef struct
+{
+    int fd;
+    uint64_t chunk; // sequence number of the chunk being sent
+    uint32_t off;   // bytes of it sent so far
+    bool blocked;   // the socket is full, waiting for EPOLLOUT
+    bool dead;      // closed, freed at the end of the event batch
+} relay_client_t;
+
+typedef struct
+{
+    relay_config_t cfg;
+    int source_fd;
+    int listen_fd;
+    int epoll_fd;
+    int stop_fd; // eventfd, readable once the relay stops
+    int mem_fd;  // the ring
+    uint16_t port;
+    pthread_t thread;
+    uint8_t *ring;
+    uint32_t *chunk_len; // published bytes per slot, final once the chunk is closed
+    uint64_t head;       // sequence number of the chunk being filled
+    uint32_t fill;       // bytes read into it, published or not
+    relay_client_t **clients;
+    int num_clients;
+    relay_stats_t stats; // written by the relay thread only, read with relaxed atomics
+} relay_t;
+
+// Take over source_fd, closed by relay_stop() or at once if the start fails, and start serving clients
+bool relay_start(relay_t *r, const relay_config_t *cfg, int source_fd);
+
+// Disconnect every client and join the relay thread
+void relay_stop(relay_t *r);
+
+static inline uint16_t relay_port(const relay_t *r)
+{
+    return r->port;
+}
+
+void relay_stats(relay_t *r, relay_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
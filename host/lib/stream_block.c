@@ -0,0 +1,243 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "stream_block.h"
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(ESP_PLATFORM)
+#include <nmmintrin.h>
+#define STREAM_CRC_SSE42 1
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define STREAM_CRC_ARM 1
+#endif
+
+static const uint8_t s_pack_bits[STREAM_FMT_COUNT] = {16, 12, 13};
+
+// CRC-32C a nibble at a time: 64 bytes of table, which suits the device
+static const uint32_t s_crc_nibble[16] = {
+    0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1, 0x417b1dbc, 0x5125dad3, 0x61c69362, 0x7198540d,
+    0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9, 0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75,
+};
+
+static uint32_t crc_nibbles(uint32_t c, const uint8_t *p, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        c ^= p[i];
+        c = (c >> 4) ^ s_crc_nibble[c & 15];
+        c = (c >> 4) ^ s_crc_nibble[c & 15];
+    }
+    return c;
+}
+
+#if STREAM_CRC_SSE42
+__attribute__((target("sse4.2"))) static uint32_t crc_sse42(uint32_t c, const uint8_t *p, size_t n)
+{
+    uint64_t c64 = c;
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c64 = _mm_crc32_u64(c64, v);
+    }
+    c = (uint32_t)c64;
+    for (; n > 0; n--, p++)
+    {
+        c = _mm_crc32_u8(c, *p);
+    }
+    return c;
+}
+#endif
+
+uint32_t stream_crc32c(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint32_t c = ~crc;
+#if STREAM_CRC_SSE42
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return ~crc_sse42(c, p, len);
+    }
+#elif STREAM_CRC_ARM
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = __crc32cd(c, v);
+    }
+#endif
+    return ~crc_nibbles(c, p, len);
+}
+
+size_t stream_payload_bytes(uint8_t format, uint32_t samples)
+{
+    if (format >= STREAM_FMT_COUNT)
+    {
+        return 0;
+    }
+    return ((size_t)samples * s_pack_bits[format] + 7) / 8;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | (uint32_t)get_u16(p + 2) << 16;
+}
+
+size_t stream_block_encode(stream_block_t *blk, const sample_t *samples, uint8_t *out)
+{
+    if (blk->format >= STREAM_FMT_COUNT || blk->samples == 0 || blk->samples > STREAM_MAX_SAMPLES)
+    {
+        return 0;
+    }
+    blk->payload = (uint32_t)stream_payload_bytes(blk->format, blk->samples);
+    uint8_t *p = out + STREAM_HEADER_BYTES;
+    if (blk->format == STREAM_FMT_RAW16)
+    {
+        for (uint32_t i = 0; i < blk->samples; i++)
+        {
+            put_u16(p + 2 * i, (uint16_t)samples[i]);
+        }
+    }
+    else
+    {
+        const int w = s_pack_bits[blk->format];
+        const uint32_t mask = (1u << w) - 1;
+        uint64_t acc = 0;
+        int bits = 0;
+        for (uint32_t i = 0; i < blk->samples; i++)
+        {
+            acc |= (uint64_t)((uint16_t)samples[i] & mask) << bits;
+            bits += w;
+            while (bits >= 8)
+            {
+                *p++ = (uint8_t)acc;
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0)
+        {
+            *p = (uint8_t)acc;
+        }
+    }
+
+    put_u32(out, STREAM_MAGIC);
+    put_u16(out + 4, blk->device);
+    out[6] = blk->channel;
+    out[7] = blk->format;
+    put_u32(out + 8, blk->seq);
+    put_u32(out + 12, blk->samples);
+    put_u32(out + 16, (uint32_t)blk->pos);
+    put_u32(out + 20, (uint32_t)(blk->pos >> 32));
+    put_u32(out + 24, blk->payload);
+    uint32_t crc = stream_crc32c(0, out, 28);
+    put_u32(out + 28, stream_crc32c(crc, out + STREAM_HEADER_BYTES, blk->payload));
+    return STREAM_HEADER_BYTES + blk->payload;
+}
+
+stream_status_t stream_block_parse(const uint8_t *buf, size_t len, stream_block_t *blk)
+{
+    if (len < 4)
+    {
+        // Too short to tell, unless what is there already differs from the magic
+        for (size_t i = 0; i < len; i++)
+        {
+            if (buf[i] != (uint8_t)(STREAM_MAGIC >> (8 * i)))
+            {
+                return STREAM_BAD_HEADER;
+            }
+        }
+        return STREAM_NEED_MORE;
+    }
+    if (get_u32(buf) != STREAM_MAGIC)
+    {
+        return STREAM_BAD_HEADER;
+    }
+    if (len < STREAM_HEADER_BYTES)
+    {
+        return STREAM_NEED_MORE;
+    }
+    blk->device = get_u16(buf + 4);
+    blk->channel = buf[6];
+    blk->format = buf[7];
+    blk->seq = get_u32(buf + 8);
+    blk->samples = get_u32(buf + 12);
+    blk->pos = get_u32(buf + 16) | (uint64_t)get_u32(buf + 20) << 32;
+    blk->payload = get_u32(buf + 24);
+    if (blk->samples == 0 || blk->samples > STREAM_MAX_SAMPLES ||
+        blk->payload != stream_payload_bytes(blk->format, blk->samples))
+    {
+        return STREAM_BAD_HEADER;
+    }
+    if (len < STREAM_HEADER_BYTES + (size_t)blk->payload)
+    {
+        return STREAM_NEED_MORE;
+    }
+    uint32_t crc = stream_crc32c(0, buf, 28);
+    crc = stream_crc32c(crc, buf + STREAM_HEADER_BYTES, blk->payload);
+    return crc == get_u32(buf + 28) ? STREAM_OK : STREAM_BAD_CRC;
+}
+
+size_t stream_resync(const uint8_t *buf, size_t len)
+{
+    for (size_t i = 1; i < len; i++)
+    {
+        if (buf[i] == (uint8_t)STREAM_MAGIC)
+        {
+            const size_t n = len - i < 4 ? len - i : 4;
+            if (memcmp(buf + i, "ASB1", n) == 0)
+            {
+                return i;
+            }
+        }
+    }
+    return len;
+}
+
+void stream_block_decode(const stream_block_t *blk, const uint8_t *payload, sample_t *out)
+{
+    if (blk->format == STREAM_FMT_RAW16)
+    {
+        for (uint32_t i = 0; i < blk->samples; i++)
+        {
+            out[i] = (sample_t)get_u16(payload + 2 * i);
+        }
+        return;
+    }
+    const int w = s_pack_bits[blk->format];
+    const uint32_t mask = (1u << w) - 1;
+    uint64_t acc = 0;
+    int bits = 0;
+    for (uint32_t i = 0; i < blk->samples; i++)
+    {
+        while (bits < w)
+        {
+            acc |= (uint64_t)*payload++ << bits;
+            bits += 8;
+        }
+        out[i] = (sample_t)(acc & mask);
+        acc >>= w;
+        bits -= w;
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Framed sample blocks for streaming to the host
+ *
+ * This is the wire and file format of the host tools (aggregation server,
+ * relay, capture files). The firmware does not send it yet; a device-side
+ * sender over UART, USB CDC or Wi-Fi would frame its ring blocks with
+ * stream_block_encode(), and the tests and benches stand in for devices.
+ *
+ * A device stream is a sequence of self-describing blocks, each a 32-byte
+ * header followed by its payload. The header names the device and channel,
+ * numbers the block in that channel's sequence and gives the absolute
+ * position of its first sample, so the host can demultiplex, spot lost
+ * blocks and line up channels without any connection state. A CRC-32C over
+ * the header and payload rejects damaged blocks; after one, the reader
+ * resynchronizes on the next magic.
+ *
+ * Capture files on the host are the same blocks back to back, so one parser
+ * serves sockets and files, and a raw block's payload can be used in place.
+ *
+ * Header, little endian:
+ *   u32 magic "ASB1", u16 device, u8 channel, u8 format, u32 seq,
+ *   u32 samples, u64 first sample position, u32 payload bytes,
+ *   u32 CRC-32C of the header up to here and the payload.
+ *
+ * Formats: raw int16, or ADC codes bit-packed LSB first at 12 or 13 bits,
+ * 25 % / 19 % smaller than raw. Continuous mode delivers 12-bit codes
+ * (SOC_ADC_DIGI_MAX_BITWIDTH) on every target; 13 bits carries the
+ * ESP32-S2's 13-bit one-shot (RTC) readings.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STREAM_MAGIC 0x31425341u // "ASB1"
+#define STREAM_HEADER_BYTES 32
+#define STREAM_MAX_SAMPLES (1u << 18)
+
+typedef enum
+{
+    STREAM_FMT_RAW16,
+    STREAM_FMT_PACK12,
+    STREAM_FMT_PACK13,
+    STREAM_FMT_COUNT,
+} stream_format_t;
+
+typedef struct
+{
+    uint16_t device;
+    uint8_t channel;
+    uint8_t format;      // stream_format_t
+    uint32_t seq;        // per device and channel, wraps
+    uint32_t samples;    // 1..STREAM_MAX_SAMPLES
+    uint64_t pos;        // absolute position of the first sample
+    uint32_t payload;    // bytes, set by stream_block_encode
+} stream_block_t;
+
+typedef enum
+{
+    STREAM_OK,           // a whole valid block is at the start of the buffer
+    STREAM_NEED_MORE,    // a plausible header, the rest has not arrived yet
+    STREAM_BAD_HEADER,   // no block starts here: skip a byte and look for the next magic
+    STREAM_BAD_CRC,      // the block is complete but damaged
+} stream_status_t;
+
+// Payload size of n samples in a format, 0 for an unknown format
+size_t stream_payload_bytes(uint8_t format, uint32_t samples);
+
+// Frame samples into out (STREAM_HEADER_BYTES + payload bytes); returns the block size, 0 if the header is invalid
+size_t stream_block_encode(stream_block_t *blk, const sample_t *samples, uint8_t *out);
+
+// Check the block at the start of buf. On STREAM_OK and STREAM_BAD_CRC blk is filled in
+// and the block spans STREAM_HEADER_BYTES + blk->payload bytes.
+stream_status_t stream_block_parse(const uint8_t *buf, size_t len, stream_block_t *blk);
+
+// Offset of the next possible magic after a bad header, or len if there is none
+size_t stream_resync(const uint8_t *buf, size_t len);
+
+// Unpack a valid block's payload into blk->samples values
+void stream_block_decode(const stream_block_t *blk, const uint8_t *payload, sample_t *out);
+
+// CRC-32C (Castagnoli), chained: pass 0 first, then the previous result
+uint32_t stream_crc32c(uint32_t crc, const void *data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
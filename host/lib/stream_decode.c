@@ -0,0 +1,459 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "stream_decode.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define DECODE_AVX2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DECODE_NEON 1
+#endif
+
+#define FLOAT_CHUNK 1024 // samples unpacked at a time by stream_decode_block_float
+
+typedef struct
+{
+    void (*unpack12)(const uint8_t *in, size_t n, sample_t *out);
+    void (*unpack13)(const uint8_t *in, size_t n, sample_t *out);
+    void (*delta)(const int16_t *delta, size_t n, int16_t *prev, sample_t *out);
+    void (*zigzag_delta)(const uint32_t *zz, size_t n, int16_t *prev, sample_t *out);
+    void (*calibrate)(const sample_t *in, size_t n, float gain, float offset, float *out);
+} decode_ops_t;
+
+// Scalar versions, also the tails of the vector ones
+
+static void unpack12_scalar(const uint8_t *in, size_t n, sample_t *out)
+{
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2, in += 3)
+    {
+        out[i] = (sample_t)(in[0] | (in[1] & 0x0f) << 8);
+        out[i + 1] = (sample_t)(in[1] >> 4 | in[2] << 4);
+    }
+    if (i < n)
+    {
+        out[i] = (sample_t)(in[0] | (in[1] & 0x0f) << 8);
+    }
+}
+
+static void unpack13_scalar(const uint8_t *in, size_t n, sample_t *out)
+{
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        while (bits < 13)
+        {
+            acc |= (uint32_t)*in++ << bits;
+            bits += 8;
+        }
+        out[i] = (sample_t)(acc & 0x1fff);
+        acc >>= 13;
+        bits -= 13;
+    }
+}
+
+static void delta_scalar(const int16_t *delta, size_t n, int16_t *prev, sample_t *out)
+{
+    uint16_t acc = (uint16_t)*prev;
+    for (size_t i = 0; i < n; i++)
+    {
+        acc += (uint16_t)delta[i];
+        out[i] = (sample_t)acc;
+    }
+    *prev = (int16_t)acc;
+}
+
+static void zigzag_delta_scalar(const uint32_t *zz, size_t n, int16_t *prev, sample_t *out)
+{
+    uint16_t acc = (uint16_t)*prev;
+    for (size_t i = 0; i < n; i++)
+    {
+        acc += (uint16_t)((zz[i] >> 1) ^ -(zz[i] & 1));
+        out[i] = (sample_t)acc;
+    }
+    *prev = (int16_t)acc;
+}
+
+static void calibrate_scalar(const sample_t *in, size_t n, float gain, float offset, float *out)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = (float)in[i] * gain + offset;
+    }
+}
+
+static const decode_ops_t s_scalar_ops = {
+    unpack12_scalar, unpack13_scalar, delta_scalar, zigzag_delta_scalar, calibrate_scalar,
+};
+
+#if DECODE_AVX2
+
+// 16 samples from 24 bytes: the two 12-byte halves go to the two lanes, then each 16-bit word is
+// gathered from the two bytes holding its sample and shifted into place
+__attribute__((target("avx2"))) static void unpack12_avx2(const uint8_t *in, size_t n, sample_t *out)
+{
+    const size_t bytes = (n * 12 + 7) / 8;
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+    const __m256i words = _mm256_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11,
+                                           0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const __m256i mask = _mm256_set1_epi16(0x0fff);
+    size_t i = 0;
+    for (; i / 2 * 3 + 32 <= bytes; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i / 2 * 3));
+        v = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(v, lanes), words);
+        __m256i even = _mm256_and_si256(v, mask);
+        __m256i odd = _mm256_srli_epi16(v, 4);
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_blend_epi16(even, odd, 0xaa));
+    }
+    unpack12_scalar(in + i / 2 * 3, n - i, out + i);
+}
+
+// 8 samples from 13 bytes: each into a 32-bit lane from the three bytes that can hold it, then
+// shifted right by its bit offset; two such groups are packed into 16 samples
+__attribute__((target("avx2"))) static void unpack13_avx2(const uint8_t *in, size_t n, sample_t *out)
+{
+    const size_t bytes = (n * 13 + 7) / 8;
+    const __m256i gather = _mm256_setr_epi8(0, 1, 2, -1, 1, 2, 3, -1, 3, 4, 5, -1, 4, 5, 6, -1,
+                                            6, 7, 8, -1, 8, 9, 10, -1, 9, 10, 11, -1, 11, 12, 13, -1);
+    const __m256i shifts = _mm256_setr_epi32(0, 5, 2, 7, 4, 1, 6, 3);
+    const __m256i mask = _mm256_set1_epi32(0x1fff);
+    size_t i = 0;
+    for (; i / 8 * 13 + 29 <= bytes; i += 16)
+    {
+        const uint8_t *p = in + i / 8 * 13;
+        __m256i a = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)p));
+        __m256i b = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(p + 13)));
+        a = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(a, gather), shifts), mask);
+        b = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(b, gather), shifts), mask);
+        // packus interleaves the lanes: samples 0-3, 8-11, 4-7, 12-15
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)(out + i), v);
+    }
+    unpack13_scalar(in + i / 8 * 13, n - i, out + i);
+}
+
+// Running sum of 16 words: within each lane by shifted adds, then lane 0's total into lane 1
+__attribute__((target("avx2"))) static inline __m256i prefix_sum16(__m256i x, __m256i carry)
+{
+    const __m256i last = _mm256_set1_epi16(0x0f0e);
+    x = _mm256_add_epi16(x, _mm256_slli_si256(x, 2));
+    x = _mm256_add_epi16(x, _mm256_slli_si256(x, 4));
+    x = _mm256_add_epi16(x, _mm256_slli_si256(x, 8));
+    __m256i low_total = _mm256_shuffle_epi8(_mm256_permute2x128_si256(x, x, 0x08), last);
+    return _mm256_add_epi16(_mm256_add_epi16(x, low_total), carry);
+}
+
+__attribute__((target("avx2"))) static inline __m256i broadcast_last16(__m256i x)
+{
+    return _mm256_shuffle_epi8(_mm256_permute2x128_si256(x, x, 0x11), _mm256_set1_epi16(0x0f0e));
+}
+
+__attribute__((target("avx2"))) static void delta_avx2(const int16_t *delta, size_t n, int16_t *prev, sample_t *out)
+{
+    __m256i carry = _mm256_set1_epi16(*prev);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i x = prefix_sum16(_mm256_loadu_si256((const __m256i *)(delta + i)), carry);
+        _mm256_storeu_si256((__m256i *)(out + i), x);
+        carry = broadcast_last16(x);
+    }
+    *prev = (int16_t)_mm256_extract_epi16(carry, 0);
+    delta_scalar(delta + i, n - i, prev, out + i);
+}
+
+__attribute__((target("avx2"))) static void zigzag_delta_avx2(const uint32_t *zz, size_t n, int16_t *prev,
+                                                               sample_t *out)
+{
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i low16 = _mm256_set1_epi32(0xffff);
+    __m256i carry = _mm256_set1_epi16(*prev);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(zz + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(zz + i + 8));
+        a = _mm256_xor_si256(_mm256_srli_epi32(a, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(a, one)));
+        b = _mm256_xor_si256(_mm256_srli_epi32(b, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(b, one)));
+        // Keep the low 16 bits (the sum wraps), in order
+        __m256i d = _mm256_packus_epi32(_mm256_and_si256(a, low16), _mm256_and_si256(b, low16));
+        __m256i x = prefix_sum16(_mm256_permute4x64_epi64(d, 0xd8), carry);
+        _mm256_storeu_si256((__m256i *)(out + i), x);
+        carry = broadcast_last16(x);
+    }
+    *prev = (int16_t)_mm256_extract_epi16(carry, 0);
+    zigzag_delta_scalar(zz + i, n - i, prev, out + i);
+}
+
+__attribute__((target("avx2"))) static void calibrate_avx2(const sample_t *in, size_t n, float gain, float offset,
+                                                            float *out)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 o = _mm256_set1_ps(offset);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(lo, g), o));
+        _mm256_storeu_ps(out + i + 8, _mm256_add_ps(_mm256_mul_ps(hi, g), o));
+    }
+    calibrate_scalar(in + i, n - i, gain, offset, out + i);
+}
+
+static const decode_ops_t s_avx2_ops = {
+    unpack12_avx2, unpack13_avx2, delta_avx2, zigzag_delta_avx2, calibrate_avx2,
+};
+
+#elif DECODE_NEON
+
+// 16 samples from 24 bytes: vld3 splits the byte triples of sample pairs, vst2 interleaves the pairs
+static void unpack12_neon(const uint8_t *in, size_t n, sample_t *out)
+{
+    const uint16x8_t nibble = vdupq_n_u16(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x8x3_t b = vld3_u8(in + i / 2 * 3);
+        uint16x8_t b0 = vmovl_u8(b.val[0]), b1 = vmovl_u8(b.val[1]), b2 = vmovl_u8(b.val[2]);
+        uint16x8x2_t s;
+        s.val[0] = vorrq_u16(b0, vshlq_n_u16(vandq_u16(b1, nibble), 8));
+        s.val[1] = vorrq_u16(vshrq_n_u16(b1, 4), vshlq_n_u16(b2, 4));
+        vst2q_u16((uint16_t *)(out + i), s);
+    }
+    unpack12_scalar(in + i / 2 * 3, n - i, out + i);
+}
+
+// 8 samples from 13 bytes: each into a 32-bit lane from the three bytes that can hold it, then
+// shifted right by its bit offset
+static void unpack13_neon(const uint8_t *in, size_t n, sample_t *out)
+{
+    const uint8x16_t gather_lo = {0, 1, 2, 255, 1, 2, 3, 255, 3, 4, 5, 255, 4, 5, 6, 255};
+    const uint8x16_t gather_hi = {6, 7, 8, 255, 8, 9, 10, 255, 9, 10, 11, 255, 11, 12, 13, 255};
+    const int32x4_t shift_lo = {0, -5, -2, -7};
+    const int32x4_t shift_hi = {-4, -1, -6, -3};
+    const uint32x4_t mask = vdupq_n_u32(0x1fff);
+    const size_t bytes = (n * 13 + 7) / 8;
+    size_t i = 0;
+    for (; i / 8 * 13 + 16 <= bytes; i += 8)
+    {
+        uint8x16_t v = vld1q_u8(in + i / 8 * 13);
+        uint32x4_t lo = vandq_u32(vshlq_u32(vreinterpretq_u32_u8(vqtbl1q_u8(v, gather_lo)), shift_lo), mask);
+        uint32x4_t hi = vandq_u32(vshlq_u32(vreinterpretq_u32_u8(vqtbl1q_u8(v, gather_hi)), shift_hi), mask);
+        vst1q_u16((uint16_t *)(out + i), vcombine_u16(vmovn_u32(lo), vmovn_u32(hi)));
+    }
+    unpack13_scalar(in + i / 8 * 13, n - i, out + i);
+}
+
+static inline int16x8_t prefix_sum8(int16x8_t x, int16x8_t carry)
+{
+    const int16x8_t zero = vdupq_n_s16(0);
+    x = vaddq_s16(x, vextq_s16(zero, x, 7));
+    x = vaddq_s16(x, vextq_s16(zero, x, 6));
+    x = vaddq_s16(x, vextq_s16(zero, x, 4));
+    return vaddq_s16(x, carry);
+}
+
+static void delta_neon(const int16_t *delta, size_t n, int16_t *prev, sample_t *out)
+{
+    int16x8_t carry = vdupq_n_s16(*prev);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        int16x8_t x = prefix_sum8(vld1q_s16(delta + i), carry);
+        vst1q_s16(out + i, x);
+        carry = vdupq_laneq_s16(x, 7);
+    }
+    *prev = vgetq_lane_s16(carry, 0);
+    delta_scalar(delta + i, n - i, prev, out + i);
+}
+
+static void zigzag_delta_neon(const uint32_t *zz, size_t n, int16_t *prev, sample_t *out)
+{
+    const uint32x4_t one = vdupq_n_u32(1);
+    int16x8_t carry = vdupq_n_s16(*prev);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        uint32x4_t a = vld1q_u32(zz + i);
+        uint32x4_t b = vld1q_u32(zz + i + 4);
+        a = veorq_u32(vshrq_n_u32(a, 1), vreinterpretq_u32_s32(vnegq_s32(vreinterpretq_s32_u32(vandq_u32(a, one)))));
+        b = veorq_u32(vshrq_n_u32(b, 1), vreinterpretq_u32_s32(vnegq_s32(vreinterpretq_s32_u32(vandq_u32(b, one)))));
+        // vmovn keeps the low 16 bits, as the wrapping sum needs
+        int16x8_t d = vreinterpretq_s16_u16(vcombine_u16(vmovn_u32(a), vmovn_u32(b)));
+        int16x8_t x = prefix_sum8(d, carry);
+        vst1q_s16(out + i, x);
+        carry = vdupq_laneq_s16(x, 7);
+    }
+    *prev = vgetq_lane_s16(carry, 0);
+    zigzag_delta_scalar(zz + i, n - i, prev, out + i);
+}
+
+static void calibrate_neon(const sample_t *in, size_t n, float gain, float offset, float *out)
+{
+    const float32x4_t g = vdupq_n_f32(gain);
+    const float32x4_t o = vdupq_n_f32(offset);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        int16x8_t v = vld1q_s16(in + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(out + i, vaddq_f32(vmulq_f32(lo, g), o));
+        vst1q_f32(out + i + 4, vaddq_f32(vmulq_f32(hi, g), o));
+    }
+    calibrate_scalar(in + i, n - i, gain, offset, out + i);
+}
+
+static const decode_ops_t s_neon_ops = {
+    unpack12_neon, unpack13_neon, delta_neon, zigzag_delta_neon, calibrate_neon,
+};
+
+#endif
+
+static const decode_ops_t *s_ops; // chosen on first use
+static stream_decode_isa_t s_isa;
+
+static const decode_ops_t *ops_of(stream_decode_isa_t isa)
+{
+#if DECODE_AVX2
+    if (isa == STREAM_DECODE_AVX2)
+    {
+        return &s_avx2_ops;
+    }
+#elif DECODE_NEON
+    if (isa == STREAM_DECODE_NEON)
+    {
+        return &s_neon_ops;
+    }
+#endif
+    return &s_scalar_ops;
+}
+
+static const decode_ops_t *ops(void)
+{
+    const decode_ops_t *o = __atomic_load_n(&s_ops, __ATOMIC_ACQUIRE);
+    if (o == NULL)
+    {
+        stream_decode_use_isa(stream_decode_best_isa());
+        o = __atomic_load_n(&s_ops, __ATOMIC_ACQUIRE);
+    }
+    return o;
+}
+
+bool stream_decode_isa_supported(stream_decode_isa_t isa)
+{
+    switch (isa)
+    {
+    case STREAM_DECODE_SCALAR:
+        return true;
+#if DECODE_AVX2
+    case STREAM_DECODE_AVX2:
+        return __builtin_cpu_supports("avx2");
+#elif DECODE_NEON
+    case STREAM_DECODE_NEON:
+        return true; // part of AArch64
+#endif
+    default:
+        return false;
+    }
+}
+
+stream_decode_isa_t stream_decode_best_isa(void)
+{
+    for (int isa = STREAM_DECODE_ISA_COUNT - 1; isa > STREAM_DECODE_SCALAR; isa--)
+    {
+        if (stream_decode_isa_supported((stream_decode_isa_t)isa))
+        {
+            return (stream_decode_isa_t)isa;
+        }
+    }
+    return STREAM_DECODE_SCALAR;
+}
+
+bool stream_decode_use_isa(stream_decode_isa_t isa)
+{
+    if (!stream_decode_isa_supported(isa))
+    {
+        return false;
+    }
+    __atomic_store_n(&s_isa, isa, __ATOMIC_RELAXED);
+    __atomic_store_n(&s_ops, ops_of(isa), __ATOMIC_RELEASE);
+    return true;
+}
+
+stream_decode_isa_t stream_decode_isa(void)
+{
+    ops();
+    return __atomic_load_n(&s_isa, __ATOMIC_RELAXED);
+}
+
+const char *stream_decode_isa_name(stream_decode_isa_t isa)
+{
+    static const char *const names[STREAM_DECODE_ISA_COUNT] = {"scalar", "AVX2", "NEON"};
+    return isa < STREAM_DECODE_ISA_COUNT ? names[isa] : "?";
+}
+
+bool stream_decode_unpack(uint8_t format, const uint8_t *payload, size_t n, sample_t *out)
+{
+    switch (format)
+    {
+    case STREAM_FMT_RAW16:
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        memcpy(out, payload, n * sizeof(sample_t));
+#else
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = (sample_t)(payload[2 * i] | payload[2 * i + 1] << 8);
+        }
+#endif
+        return true;
+    case STREAM_FMT_PACK12:
+        ops()->unpack12(payload, n, out);
+        return true;
+    case STREAM_FMT_PACK13:
+        ops()->unpack13(payload, n, out);
+        return true;
+    default:
+        return false;
+    }
+}
+
+void stream_decode_delta(const int16_t *delta, size_t n, int16_t *prev, sample_t *out)
+{
+    ops()->delta(delta, n, prev, out);
+}
+
+void stream_decode_zigzag_delta(const uint32_t *zz, size_t n, int16_t *prev, sample_t *out)
+{
+    ops()->zigzag_delta(zz, n, prev, out);
+}
+
+void stream_decode_calibrate(const sample_t *in, size_t n, float gain, float offset, float *out)
+{
+    ops()->calibrate(in, n, gain, offset, out);
+}
+
+void stream_decode_block_float(const stream_block_t *blk, const uint8_t *payload, float gain, float offset,
+                               float *out)
+{
+    const decode_ops_t *o = ops();
+    sample_t codes[FLOAT_CHUNK];
+    // FLOAT_CHUNK is a multiple of 8, so every piece starts on a byte boundary
+    const size_t bytes_per_8 = stream_payload_bytes(blk->format, 8);
+    for (size_t i = 0; i < blk->samples; i += FLOAT_CHUNK)
+    {
+        size_t n = blk->samples - i < FLOAT_CHUNK ? blk->samples - i : FLOAT_CHUNK;
+        stream_decode_unpack(blk->format, payload + i / 8 * bytes_per_8, n, codes);
+        o->calibrate(codes, n, gain, offset, out + i);
+    }
+}
@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Vectorized decoding of device samples on the host
+ *
+ * The same operations as the portable code, faster for host tools that
+ * decode whole capture files:
+ *  - unpacking 12- and 13-bit codes from stream block payloads (stream_block.h),
+ *  - delta decoding, a running sum that wraps at 16 bits, from plain int16
+ *    deltas or from zigzag-coded ones as in capture_codec.h,
+ *  - calibration of codes to float: code * gain + offset, e.g. mV from the
+ *    driver's line fit.
+ *
+ * Each operation has a scalar version and AVX2 (x86-64) or NEON (AArch64)
+ * versions. The best one the CPU supports is picked on first use. A version
+ * can also be forced, to compare against scalar or to work around a
+ * platform problem. Results are identical across versions, except that
+ * float rounding may differ in the last bit.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "stream_block.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    STREAM_DECODE_SCALAR,
+    STREAM_DECODE_AVX2,
+    STREAM_DECODE_NEON,
+    STREAM_DECODE_ISA_COUNT,
+} stream_decode_isa_t;
+
+// The fastest version this CPU runs
+stream_decode_isa_t stream_decode_best_isa(void);
+
+bool stream_decode_isa_supported(stream_decode_isa_t isa);
+
+// Use one version from now on, for every thread; false if the CPU lacks it
+bool stream_decode_use_isa(stream_decode_isa_t isa);
+
+stream_decode_isa_t stream_decode_isa(void);
+
+const char *stream_decode_isa_name(stream_decode_isa_t isa);
+
+// Unpack n samples of a payload in a stream format; false for an unknown format
+bool stream_decode_unpack(uint8_t format, const uint8_t *payload, size_t n, sample_t *out);
+
+// out[i] = prev + delta[0] + ... + delta[i], wrapping; *prev is updated, so a stream can be decoded in pieces.
+// out may be delta.
+void stream_decode_delta(const int16_t *delta, size_t n, int16_t *prev, sample_t *out);
+
+// The same from zigzag-coded deltas: (z >> 1) ^ -(z & 1), 17 bits for a full-range int16 difference
+void stream_decode_zigzag_delta(const uint32_t *zz, size_t n, int16_t *prev, sample_t *out);
+
+// out[i] = in[i] * gain + offset
+void stream_decode_calibrate(const sample_t *in, size_t n, float gain, float offset, float *out);
+
+// A valid block straight to calibrated floats, without a full intermediate buffer
+void stream_decode_block_float(const stream_block_t *blk, const uint8_t *payload, float gain, float offset,
+                               float *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,432 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "tile_cache.h"
+
+#define DEFAULT_BASE_SHIFT 6
+#define DEFAULT_LEVEL_SHIFT 2
+#define MAX_BASE_SHIFT 16
+#define MAX_LEVEL_SHIFT 8
+#define READ_CHUNK 4096 // samples per read when a query goes to the capture
+
+_Static_assert(sizeof(tile_cache_header_t) == 64, "sidecar header layout");
+_Static_assert(sizeof(tile_t) == 4, "sidecar tile layout");
+
+static const tile_t s_empty = {INT16_MAX, INT16_MIN};
+
+typedef struct
+{
+    uint8_t levels;
+    unsigned shift[TILE_CACHE_MAX_LEVELS]; // log2 sample positions per tile
+    uint64_t tiles[TILE_CACHE_MAX_LEVELS];
+    size_t bytes; // of the whole file
+} layout_t;
+
+// Levels from 0 up, until one tile covers everything or the shift would overflow
+static void make_layout(layout_t *lay, uint64_t span, unsigned base_shift, unsigned level_shift)
+{
+    lay->levels = 0;
+    lay->bytes = sizeof(tile_cache_header_t);
+    for (unsigned l = 0; l < TILE_CACHE_MAX_LEVELS; l++)
+    {
+        unsigned shift = base_shift + l * level_shift;
+        if (shift >= 64)
+        {
+            break;
+        }
+        lay->shift[l] = shift;
+        lay->tiles[l] = span ? ((span - 1) >> shift) + 1 : 0;
+        lay->bytes += lay->tiles[l] * sizeof(tile_t);
+        lay->levels = (uint8_t)(l + 1);
+        if (lay->tiles[l] <= 1)
+        {
+            break;
+        }
+    }
+}
+
+static uint32_t last_block_crc(const capture_file_t *cf)
+{
+    uint32_t crc = 0;
+    if (cf->num_blocks > 0)
+    {
+        memcpy(&crc, cf->data + cf->blocks[cf->num_blocks - 1].offset + 28, sizeof(crc));
+    }
+    return crc;
+}
+
+static inline void merge(tile_t *t, tile_t o)
+{
+    t->min = o.min < t->min ? o.min : t->min;
+    t->max = o.max > t->max ? o.max : t->max;
+}
+
+// Tiles [from, to) of a level from the level below
+static void merge_level(tile_t *dst, const tile_t *src, uint64_t src_tiles, unsigned level_shift, uint64_t from,
+                        uint64_t to)
+{
+    for (uint64_t j = from; j < to; j++)
+    {
+        tile_t t = s_empty;
+        uint64_t end = (j + 1) << level_shift;
+        end = end < src_tiles ? end : src_tiles;
+        for (uint64_t c = j << level_shift; c < end; c++)
+        {
+            merge(&t, src[c]);
+        }
+        dst[j] = t;
+    }
+}
+
+typedef struct
+{
+    const capture_file_t *cf;
+    const layout_t *lay;
+    tile_t *level[TILE_CACHE_MAX_LEVELS];
+    uint64_t first;
+    unsigned level_shift;
+    unsigned split_level; // the thread builds levels 0..split_level
+    uint64_t from, to;    // its tiles at split_level
+    sample_t *buf;        // one decoded block
+} build_job_t;
+
+static void tiles_from_samples(tile_t *tiles, uint64_t first, unsigned shift, uint64_t pos, const sample_t *s,
+                               size_t n)
+{
+    while (n > 0)
+    {
+        uint64_t t = (pos - first) >> shift;
+        uint64_t tile_end = first + ((t + 1) << shift);
+        size_t m = tile_end - pos < n ? (size_t)(tile_end - pos) : n;
+        sample_t mn = tiles[t].min, mx = tiles[t].max;
+        for (size_t j = 0; j < m; j++)
+        {
+            mn = s[j] < mn ? s[j] : mn;
+            mx = s[j] > mx ? s[j] : mx;
+        }
+        tiles[t] = (tile_t){mn, mx};
+        pos += m;
+        s += m;
+        n -= m;
+    }
+}
+
+static void *build_main(void *arg)
+{
+    build_job_t *job = arg;
+    const capture_file_t *cf = job->cf;
+    const layout_t *lay = job->lay;
+    const unsigned up = job->split_level * job->level_shift; // level-0 tiles per split_level tile, log2
+    uint64_t t0 = job->from << up;
+    uint64_t t1 = job->to << up;
+    t1 = t1 < lay->tiles[0] ? t1 : lay->tiles[0];
+    for (uint64_t t = t0; t < t1; t++)
+    {
+        job->level[0][t] = s_empty;
+    }
+
+    const uint64_t lo = job->first + (t0 << lay->shift[0]);
+    const uint64_t hi = job->first + (t1 << lay->shift[0]);
+    for (size_t i = capture_file_find(cf, lo); i < cf->num_blocks && cf->blocks[i].pos < hi; i++)
+    {
+        const capture_block_t *b = &cf->blocks[i];
+        const uint8_t *payload = capture_file_payload(cf, i);
+        const sample_t *s = job->buf;
+        if (b->format == STREAM_FMT_RAW16 && ((uintptr_t)payload & 1) == 0)
+        {
+            s = (const sample_t *)payload; // used in place
+        }
+        else
+        {
+            capture_file_decode(cf, i, job->buf);
+        }
+        uint64_t a = b->pos > lo ? b->pos : lo;
+        uint64_t e = b->pos + b->samples < hi ? b->pos + b->samples : hi;
+        if (a < e)
+        {
+            tiles_from_samples(job->level[0], job->first, lay->shift[0], a, s + (a - b->pos), (size_t)(e - a));
+        }
+    }
+
+    for (unsigned l = 1; l <= job->split_level; l++)
+    {
+        const unsigned down = (job->split_level - l) * job->level_shift;
+        uint64_t to = job->to << down;
+        merge_level(job->level[l], job->level[l - 1], lay->tiles[l - 1], job->level_shift, job->from << down,
+                    to < lay->tiles[l] ? to : lay->tiles[l]);
+    }
+    return NULL;
+}
+
+bool tile_cache_build(const capture_file_t *cf, const char *path, const tile_cache_config_t *cfg)
+{
+    const unsigned base_shift = cfg->base_shift ? cfg->base_shift : DEFAULT_BASE_SHIFT;
+    const unsigned level_shift = cfg->level_shift ? cfg->level_shift : DEFAULT_LEVEL_SHIFT;
+    int threads = cfg->threads ? cfg->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : threads > TILE_CACHE_MAX_THREADS ? TILE_CACHE_MAX_THREADS : threads;
+    if (base_shift > MAX_BASE_SHIFT || level_shift > MAX_LEVEL_SHIFT || cfg->threads < 0 ||
+        cfg->threads > TILE_CACHE_MAX_THREADS)
+    {
+        return false;
+    }
+
+    uint64_t first = cf->num_blocks ? cf->blocks[0].pos : 0;
+    uint64_t end = first;
+    for (size_t i = 0; i < cf->num_blocks; i++)
+    {
+        uint64_t e = cf->blocks[i].pos + cf->blocks[i].samples;
+        end = e > end ? e : end;
+    }
+    layout_t lay;
+    make_layout(&lay, end - first, base_shift, level_shift);
+
+    size_t tmp_len = strlen(path) + 5;
+    char *tmp = malloc(tmp_len);
+    if (tmp == NULL)
+    {
+        return false;
+    }
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool ok = fd >= 0 && ftruncate(fd, (off_t)lay.bytes) == 0;
+    uint8_t *map = MAP_FAILED;
+    if (ok)
+    {
+        map = mmap(NULL, lay.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ok = map != MAP_FAILED;
+    }
+
+    if (ok)
+    {
+        build_job_t proto = {.cf = cf, .lay = &lay, .first = first, .level_shift = level_shift};
+        size_t off = sizeof(tile_cache_header_t);
+        for (unsigned l = 0; l < lay.levels; l++)
+        {
+            proto.level[l] = (tile_t *)(map + off);
+            off += lay.tiles[l] * sizeof(tile_t);
+        }
+        // Split at the highest level that still gives every thread a subtree
+        threads = (uint64_t)threads > lay.tiles[0] ? (int)(lay.tiles[0] ? lay.tiles[0] : 1) : threads;
+        while (proto.split_level + 1u < lay.levels && lay.tiles[proto.split_level + 1] >= (uint64_t)threads)
+        {
+            proto.split_level++;
+        }
+
+        build_job_t jobs[TILE_CACHE_MAX_THREADS];
+        pthread_t tids[TILE_CACHE_MAX_THREADS];
+        int started = 0;
+        for (int t = 0; t < threads; t++)
+        {
+            jobs[t] = proto;
+            jobs[t].from = lay.tiles[proto.split_level] * (uint64_t)t / (uint64_t)threads;
+            jobs[t].to = lay.tiles[proto.split_level] * (uint64_t)(t + 1) / (uint64_t)threads;
+            jobs[t].buf = malloc(STREAM_MAX_SAMPLES * sizeof(sample_t));
+            ok = ok && jobs[t].buf != NULL;
+        }
+        // The calling thread takes the first share
+        for (int t = 1; ok && t < threads; t++)
+        {
+            ok = pthread_create(&tids[t], NULL, build_main, &jobs[t]) == 0;
+            started = ok ? t : started;
+        }
+        if (ok)
+        {
+            build_main(&jobs[0]);
+        }
+        for (int t = 1; t <= started; t++)
+        {
+            pthread_join(tids[t], NULL);
+        }
+        for (int t = 0; t < threads; t++)
+        {
+            free(jobs[t].buf);
+        }
+
+        for (unsigned l = proto.split_level + 1; ok && l < lay.levels; l++)
+        {
+            merge_level(proto.level[l], proto.level[l - 1], lay.tiles[l - 1], level_shift, 0, lay.tiles[l]);
+        }
+        *(tile_cache_header_t *)map = (tile_cache_header_t){
+            .magic = TILE_CACHE_MAGIC,
+            .base_shift = (uint8_t)base_shift,
+            .level_shift = (uint8_t)level_shift,
+            .levels = lay.levels,
+            .first = first,
+            .end = end,
+            .source_size = cf->size,
+            .source_blocks = cf->num_blocks,
+            .source_crc = last_block_crc(cf),
+        };
+        munmap(map, lay.bytes);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok)
+    {
+        unlink(tmp);
+    }
+    free(tmp);
+    return ok;
+}
+
+bool tile_cache_open(tile_cache_t *tc, const char *path, const capture_file_t *cf)
+{
+    memset(tc, 0, sizeof(*tc));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(tile_cache_header_t);
+    if (ok)
+    {
+        void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ok = p != MAP_FAILED;
+        tc->hdr = ok ? p : NULL;
+        tc->size = ok ? (size_t)st.st_size : 0;
+    }
+    close(fd);
+
+    const tile_cache_header_t *h = tc->hdr;
+    ok = ok && h->magic == TILE_CACHE_MAGIC && h->base_shift >= 1 && h->base_shift <= MAX_BASE_SHIFT &&
+         h->level_shift >= 1 && h->level_shift <= MAX_LEVEL_SHIFT && h->end >= h->first;
+    layout_t lay;
+    if (ok)
+    {
+        make_layout(&lay, h->end - h->first, h->base_shift, h->level_shift);
+        ok = lay.levels == h->levels && lay.bytes == tc->size;
+    }
+    // Stale: the capture has changed since the cache was built
+    ok = ok && h->source_size == cf->size && h->source_blocks == cf->num_blocks &&
+         h->source_crc == last_block_crc(cf);
+    if (!ok)
+    {
+        tile_cache_close(tc);
+        return false;
+    }
+    size_t off = sizeof(tile_cache_header_t);
+    for (unsigned l = 0; l < lay.levels; l++)
+    {
+        tc->level[l] = (const tile_t *)((const uint8_t *)h + off);
+        tc->tiles[l] = lay.tiles[l];
+        off += lay.tiles[l] * sizeof(tile_t);
+    }
+    tc->cf = cf;
+    return true;
+}
+
+void tile_cache_close(tile_cache_t *tc)
+{
+    if (tc->hdr != NULL)
+    {
+        munmap((void *)tc->hdr, tc->size);
+    }
+    memset(tc, 0, sizeof(*tc));
+}
+
+// Column c starts at from + floor(span * c / columns), computed without overflow
+static inline uint64_t column_edge(uint64_t from, uint64_t span, size_t columns, size_t c)
+{
+    return from + span / columns * c + span % columns * c / columns;
+}
+
+// Columns narrower than a level-0 tile, in one pass over the samples of [a, b); skips over gaps
+static void columns_from_samples(const tile_cache_t *tc, uint64_t from, uint64_t span, size_t columns, uint64_t a,
+                                 uint64_t b, tile_t *out)
+{
+    const capture_file_t *cf = tc->cf;
+    sample_t buf[READ_CHUNK];
+    size_t c = 0;
+    while (a < b)
+    {
+        size_t got = capture_file_read(cf, a, b - a < READ_CHUNK ? (size_t)(b - a) : READ_CHUNK, buf);
+        if (got == 0)
+        {
+            size_t i = capture_file_find(cf, a);
+            if (i == cf->num_blocks || cf->blocks[i].pos <= a)
+            {
+                break;
+            }
+            a = cf->blocks[i].pos;
+            continue;
+        }
+        for (size_t j = 0; j < got;)
+        {
+            while (column_edge(from, span, columns, c + 1) <= a + j)
+            {
+                c++;
+            }
+            uint64_t left = column_edge(from, span, columns, c + 1) - (a + j);
+            size_t n = left < got - j ? (size_t)left : got - j;
+            tile_t t = out[c];
+            for (size_t k = j; k < j + n; k++)
+            {
+                t.min = buf[k] < t.min ? buf[k] : t.min;
+                t.max = buf[k] > t.max ? buf[k] : t.max;
+            }
+            out[c] = t;
+            j += n;
+        }
+        a += got;
+    }
+}
+
+void tile_cache_query(const tile_cache_t *tc, uint64_t from, uint64_t to, size_t columns, tile_t *out)
+{
+    for (size_t c = 0; c < columns; c++)
+    {
+        out[c] = s_empty;
+    }
+    const tile_cache_header_t *h = tc->hdr;
+    if (columns == 0 || to <= from || h->levels == 0 || tc->tiles[0] == 0)
+    {
+        return;
+    }
+    const uint64_t span = to - from;
+    const uint64_t per_column = span / columns;
+    if (per_column < (1ull << h->base_shift))
+    {
+        uint64_t a = from > h->first ? from : h->first;
+        uint64_t b = to < h->end ? to : h->end;
+        columns_from_samples(tc, from, span, columns, a, b, out);
+        return;
+    }
+    unsigned l = 0;
+    while (l + 1u < h->levels && (1ull << (h->base_shift + (l + 1) * h->level_shift)) <= per_column)
+    {
+        l++;
+    }
+    const unsigned shift = h->base_shift + l * h->level_shift;
+
+    for (size_t c = 0; c < columns; c++)
+    {
+        uint64_t a = column_edge(from, span, columns, c);
+        uint64_t b = column_edge(from, span, columns, c + 1);
+        a = a > h->first ? a : h->first;
+        b = b < h->end ? b : h->end;
+        if (a >= b)
+        {
+            continue;
+        }
+        const uint64_t t1 = (b - 1 - h->first) >> shift;
+        for (uint64_t t = (a - h->first) >> shift; t <= t1; t++)
+        {
+            merge(&out[c], tc->level[l][t]);
+        }
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Min/max tile cache for waveform viewers (Linux host)
+ *
+ * A viewer drawing a capture file (capture_file.h) needs the min and max of
+ * the samples under each pixel column. For a zoomed-out view of a large
+ * file that means reading all of it. The tile cache precomputes these
+ * values once, in a sidecar file next to the capture (TILE_CACHE_SUFFIX).
+ *
+ * Level 0 holds one min/max tile per 2^base_shift sample positions, from the
+ * first block's position on. Each level above merges 2^level_shift tiles of
+ * the one below, up to a single tile for the whole file. The pyramid adds
+ * about a third to level 0, which itself is 4 bytes per tile.
+ *
+ * tile_cache_build() decodes the capture with several threads. Each thread
+ * takes a run of whole top-level subtrees, so the threads build the lower
+ * levels without sharing a tile; the few tiles above are merged at the end.
+ * The cache is written under a temporary name and renamed into place, so a
+ * viewer never opens a half-written one.
+ *
+ * tile_cache_query() renders any range into N columns. It picks the coarsest
+ * level whose tiles are no wider than a column, so it reads at most
+ * 2^level_shift + 2 tiles per column. A column is exact when its edges fall
+ * on tile edges. Otherwise it also takes in the rest of the tiles under its
+ * edges, less than one column's width on each side. When a column is
+ * narrower than a level-0 tile, the query reads the samples themselves
+ * from the capture.
+ *
+ * The cache records the size, block count and last block CRC of its
+ * capture; tile_cache_open() refuses a cache that does not match, and the
+ * caller builds a new one. Positions must increase through the file, as
+ * capture_file_read() also assumes.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "capture_file.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TILE_CACHE_SUFFIX ".tiles"
+#define TILE_CACHE_MAGIC 0x31435441u // "ATC1"
+#define TILE_CACHE_MAX_LEVELS 32
+#define TILE_CACHE_MAX_THREADS 64
+
+typedef struct
+{
+    sample_t min; // min > max: no samples under this tile
+    sample_t max;
+} tile_t;
+
+typedef struct
+{
+    int threads;         // 1..TILE_CACHE_MAX_THREADS, 0 for one per CPU
+    uint8_t base_shift;  // log2 samples per level-0 tile, 0 for 6 (64 samples)
+    uint8_t level_shift; // log2 tiles merged per level, 0 for 2 (x4)
+} tile_cache_config_t;
+
+// The sidecar file starts with this header, followed by the levels from 0 up
+typedef struct
+{
+    uint32_t magic; // TILE_CACHE_MAGIC
+    uint8_t base_shift;
+    uint8_t level_shift;
+    uint8_t levels;
+    uint8_t reserved;
+    uint64_t first; // position where tile 0 of every level starts
+    uint64_t end;   // one past the last sample position
+    uint64_t source_size;
+    uint64_t source_blocks;
+    uint32_t source_crc; // of the last block
+    uint32_t reserved2;
+    uint64_t reserved3[2];
+} tile_cache_header_t;
+
+typedef struct
+{
+    const tile_cache_header_t *hdr; // the mapped cache
+    size_t size;
+    const tile_t *level[TILE_CACHE_MAX_LEVELS];
+    uint64_t tiles[TILE_CACHE_MAX_LEVELS];
+    const capture_file_t *cf;
+} tile_cache_t;
+
+// Build the cache of an open capture at path, replacing any old one
+bool tile_cache_build(const capture_file_t *cf, const char *path, const tile_cache_config_t *cfg);
+
+// Map a cache; fails if it is damaged or was not built from cf. cf must stay open while tc is used.
+bool tile_cache_open(tile_cache_t *tc, const char *path, const capture_file_t *cf);
+
+void tile_cache_close(tile_cache_t *tc);
+
+// Min and max of [from, to) in columns equal parts, into out[columns]; columns without samples
+// come back empty (min > max)
+void tile_cache_query(const tile_cache_t *tc, uint64_t from, uint64_t to, size_t columns, tile_t *out);
+
+#ifdef __cplusplus
+}
+#endif
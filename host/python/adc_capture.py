@@ -0,0 +1,304 @@
+# SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: CC0-1.0
+"""Capture files from Python, without copying the samples.
+
+A thin ctypes binding to the host capture library (host/lib/capture_file.h,
+built as libadc_capture.so). The library maps and indexes the file; this
+module maps the same file once more and hands out views into that mapping:
+
+    with CaptureFile('ch1.asb') as cf:
+        for blk in cf.blocks():            # metadata only, nothing decoded
+            print(blk.seq, blk.pos, blk.samples)
+        x = cf.samples(0)                  # raw block: a view, no copy
+        y = cf.read(pos=123456, n=100000)  # any range, decoded into a new array
+
+Arrays are numpy arrays when numpy is installed, else memoryviews of
+int16 ('h'). Raw blocks come back as read-only views of the file; packed
+blocks have to be unpacked and are decoded into a fresh array by the C
+library. Views stay valid after close(): the mapping goes away with the
+last of them.
+
+The library is looked up in $ADC_CAPTURE_LIB, next to this file, in
+../../build-host/ and then on the system library path.
+"""
+import array
+import ctypes
+import ctypes.util
+import mmap
+import os
+from typing import Any, Iterator, List, NamedTuple, Optional
+
+try:
+    import numpy as np
+except ImportError:  # memoryviews instead
+    np = None
+
+HEADER_BYTES = 32
+FMT_RAW16, FMT_PACK12, FMT_PACK13 = 0, 1, 2
+FORMAT_NAMES = ('raw16', 'pack12', 'pack13')
+
+
+class _Block(ctypes.Structure):
+    # capture_block_t
+    _fields_ = [
+        ('offset', ctypes.c_uint64),
+        ('pos', ctypes.c_uint64),
+        ('seq', ctypes.c_uint32),
+        ('samples', ctypes.c_uint32),
+        ('payload', ctypes.c_uint32),
+        ('device', ctypes.c_uint16),
+        ('channel', ctypes.c_uint8),
+        ('format', ctypes.c_uint8),
+    ]
+
+
+class _File(ctypes.Structure):
+    # capture_file_t
+    _fields_ = [
+        ('data', ctypes.c_void_p),
+        ('size', ctypes.c_size_t),
+        ('blocks', ctypes.POINTER(_Block)),
+        ('num_blocks', ctypes.c_size_t),
+        ('samples', ctypes.c_uint64),
+        ('skipped_bytes', ctypes.c_uint64),
+        ('bad_blocks', ctypes.c_uint64),
+        ('seq_gaps', ctypes.c_uint64),
+        ('truncated', ctypes.c_bool),
+    ]
+
+
+class _StreamBlock(ctypes.Structure):
+    # stream_block_t, for encode_block()
+    _fields_ = [
+        ('device', ctypes.c_uint16),
+        ('channel', ctypes.c_uint8),
+        ('format', ctypes.c_uint8),
+        ('seq', ctypes.c_uint32),
+        ('samples', ctypes.c_uint32),
+        ('pos', ctypes.c_uint64),
+        ('payload', ctypes.c_uint32),
+    ]
+
+
+assert ctypes.sizeof(_Block) == 32
+
+
+class Block(NamedTuple):
+    index: int
+    offset: int  # of the header in the file
+    pos: int  # absolute position of the first sample
+    seq: int
+    samples: int
+    payload: int
+    device: int
+    channel: int
+    format: int
+
+
+def _find_library() -> str:
+    here = os.path.dirname(os.path.abspath(__file__))
+    candidates = [
+        os.environ.get('ADC_CAPTURE_LIB', ''),
+        os.path.join(here, 'libadc_capture.so'),
+        os.path.join(here, '..', '..', 'build-host', 'libadc_capture.so'),
+    ]
+    for path in candidates:
+        if path and os.path.exists(path):
+            return path
+    found = ctypes.util.find_library('adc_capture')
+    if found is None:
+        raise OSError('libadc_capture.so not found: build host/ or set ADC_CAPTURE_LIB')
+    return found
+
+
+_lib: Optional[ctypes.CDLL] = None
+
+
+def _library() -> ctypes.CDLL:
+    global _lib
+    if _lib is None:
+        lib = ctypes.CDLL(_find_library())
+        lib.capture_file_open.argtypes = [ctypes.POINTER(_File), ctypes.c_char_p, ctypes.c_bool]
+        lib.capture_file_open.restype = ctypes.c_bool
+        lib.capture_file_close.argtypes = [ctypes.POINTER(_File)]
+        lib.capture_file_close.restype = None
+        lib.capture_file_decode.argtypes = [ctypes.POINTER(_File), ctypes.c_size_t, ctypes.c_void_p]
+        lib.capture_file_decode.restype = None
+        lib.capture_file_find.argtypes = [ctypes.POINTER(_File), ctypes.c_uint64]
+        lib.capture_file_find.restype = ctypes.c_size_t
+        lib.capture_file_read.argtypes = [ctypes.POINTER(_File), ctypes.c_uint64, ctypes.c_size_t, ctypes.c_void_p]
+        lib.capture_file_read.restype = ctypes.c_size_t
+        lib.stream_block_encode.argtypes = [ctypes.POINTER(_StreamBlock), ctypes.c_void_p, ctypes.c_void_p]
+        lib.stream_block_encode.restype = ctypes.c_size_t
+        _lib = lib
+    return _lib
+
+
+def _new_samples(n: int) -> Any:
+    # A writable int16 array and its address
+    if np is not None:
+        arr = np.empty(n, dtype=np.int16)
+        return arr, arr.ctypes.data
+    buf = (ctypes.c_int16 * max(n, 1))()
+    return memoryview(buf).cast('B').cast('h')[:n], ctypes.addressof(buf)
+
+
+def encode_block(samples: Any, pos: int, seq: int = 0, fmt: int = FMT_RAW16,
+                 device: int = 0, channel: int = 0) -> bytes:
+    """One stream block of int16 samples, as the device sends it (for tests and tools)."""
+    values = array.array('h', samples)
+    n = len(values)
+    src = (ctypes.c_int16 * n).from_buffer(values)
+    out = ctypes.create_string_buffer(HEADER_BYTES + 2 * n)
+    blk = _StreamBlock(device=device, channel=channel, format=fmt, seq=seq, samples=n, pos=pos)
+    size = _library().stream_block_encode(ctypes.byref(blk), src, out)
+    return out.raw[:size]
+
+
+class CaptureFile:
+    """An indexed capture file; see the module doc."""
+
+    def __init__(self, path: str, verify: bool = True) -> None:
+        self._lib = _library()
+        self._cf = _File()
+        self._mm: Optional[mmap.mmap] = None
+        if not self._lib.capture_file_open(ctypes.byref(self._cf), os.fsencode(path), verify):
+            raise OSError('cannot open capture file {}'.format(path))
+        if self._cf.size > 0:
+            with open(path, 'rb') as f:
+                self._mm = mmap.mmap(f.fileno(), self._cf.size, access=mmap.ACCESS_READ)
+
+    def close(self) -> None:
+        if self._cf.data is not None or self._cf.blocks:
+            self._lib.capture_file_close(ctypes.byref(self._cf))
+        if self._mm is not None:
+            try:
+                self._mm.close()
+            except BufferError:
+                pass  # views are still out; unmapped when the last one goes
+            self._mm = None
+
+    def __enter__(self) -> 'CaptureFile':
+        return self
+
+    def __exit__(self, *exc: Any) -> None:
+        self.close()
+
+    def __del__(self) -> None:
+        if getattr(self, '_cf', None) is not None:
+            self.close()
+
+    def __len__(self) -> int:
+        return self._cf.num_blocks
+
+    # File summary, from the index
+    @property
+    def size(self) -> int:
+        return self._cf.size
+
+    @property
+    def num_samples(self) -> int:
+        return self._cf.samples
+
+    @property
+    def skipped_bytes(self) -> int:
+        return self._cf.skipped_bytes
+
+    @property
+    def bad_blocks(self) -> int:
+        return self._cf.bad_blocks
+
+    @property
+    def seq_gaps(self) -> int:
+        return self._cf.seq_gaps
+
+    @property
+    def truncated(self) -> bool:
+        return bool(self._cf.truncated)
+
+    def _check(self, i: int) -> int:
+        if i < 0:
+            i += self._cf.num_blocks
+        if not 0 <= i < self._cf.num_blocks:
+            raise IndexError('block {} out of range'.format(i))
+        return i
+
+    def block(self, i: int) -> Block:
+        i = self._check(i)
+        b = self._cf.blocks[i]
+        return Block(i, b.offset, b.pos, b.seq, b.samples, b.payload, b.device, b.channel, b.format)
+
+    def blocks(self) -> Iterator[Block]:
+        """Metadata of every block, in file order."""
+        for i in range(self._cf.num_blocks):
+            yield self.block(i)
+
+    def index(self) -> Any:
+        """The whole block index as one numpy structured array (numpy only).
+
+        A copy: the C index is freed on close(), and at 32 bytes per block copying is cheap.
+        """
+        if np is None:
+            raise RuntimeError('index() needs numpy; use blocks()')
+        dtype = np.dtype([('offset', '<u8'), ('pos', '<u8'), ('seq', '<u4'), ('samples', '<u4'),
+                          ('payload', '<u4'), ('device', '<u2'), ('channel', 'u1'), ('format', 'u1')])
+        n = self._cf.num_blocks
+        if n == 0:
+            return np.zeros(0, dtype=dtype)
+        raw = (ctypes.c_char * (n * ctypes.sizeof(_Block))).from_address(ctypes.addressof(self._cf.blocks.contents))
+        return np.frombuffer(raw, dtype=dtype).copy()
+
+    def payload(self, i: int) -> memoryview:
+        """The block's payload bytes, a view of the file."""
+        i = self._check(i)
+        b = self._cf.blocks[i]
+        assert self._mm is not None
+        start = b.offset + HEADER_BYTES
+        return memoryview(self._mm)[start:start + b.payload]
+
+    def samples(self, i: int) -> Any:
+        """Samples of block i: a read-only view for raw blocks, decoded otherwise."""
+        i = self._check(i)
+        b = self._cf.blocks[i]
+        if b.format == FMT_RAW16:
+            assert self._mm is not None
+            start = b.offset + HEADER_BYTES
+            if np is not None:
+                return np.frombuffer(self._mm, dtype='<i2', count=b.samples, offset=start)
+            return memoryview(self._mm)[start:start + b.payload].cast('h')
+        arr, addr = _new_samples(b.samples)
+        self._lib.capture_file_decode(ctypes.byref(self._cf), i, addr)
+        return arr
+
+    def iter_samples(self) -> Iterator[Any]:
+        """(block, samples) for every block."""
+        for i in range(self._cf.num_blocks):
+            yield self.block(i), self.samples(i)
+
+    def find(self, pos: int) -> int:
+        """First block that ends after sample position pos, len(self) if none."""
+        return self._lib.capture_file_find(ctypes.byref(self._cf), pos)
+
+    def read(self, pos: int, n: int) -> Any:
+        """Up to n samples from absolute position pos on, stopping at a gap or the end."""
+        arr, addr = _new_samples(n)
+        got = self._lib.capture_file_read(ctypes.byref(self._cf), pos, n, addr)
+        return arr[:got]
+
+    def summary(self) -> List[str]:
+        formats = sorted({FORMAT_NAMES[b.format] for b in self.blocks()})
+        return [
+            'size {} bytes, {} blocks, {} samples'.format(self.size, len(self), self.num_samples),
+            'formats {}'.format(', '.join(formats) or '-'),
+            'skipped {} bytes, {} bad blocks, {} missing, truncated {}'.format(
+                self.skipped_bytes, self.bad_blocks, self.seq_gaps, self.truncated),
+        ]
+
+
+if __name__ == '__main__':
+    import sys
+    for arg in sys.argv[1:]:
+        with CaptureFile(arg) as capture:
+            print(arg)
+            for line in capture.summary():
+                print('  ' + line)
@@ -0,0 +1,83 @@
+# SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: CC0-1.0
+# Loading a capture from Python: capture files through adc_capture against the same samples
+# as CSV (one value per line), in ms and Msamples/s. ADC_CAPTURE_LIB or build-host/ as for
+# adc_capture; numpy is used when installed.
+import csv
+import os
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import adc_capture  # noqa: E402
+
+SAMPLES = 1 << 23
+BLOCK = 4096
+
+
+def make_files(tmp: str) -> dict:
+    paths = {name: os.path.join(tmp, name + '.asb') for name in adc_capture.FORMAT_NAMES}
+    paths['csv'] = os.path.join(tmp, 'capture.csv')
+    files = {name: open(path, 'wb') for name, path in paths.items() if name != 'csv'}
+    with open(paths['csv'], 'w') as text:
+        for seq, pos in enumerate(range(0, SAMPLES, BLOCK)):
+            x = [2048 + ((pos + k) * 2654435761 >> 9) % 400 - 200 for k in range(BLOCK)]
+            for fmt, name in enumerate(adc_capture.FORMAT_NAMES):
+                files[name].write(adc_capture.encode_block(x, pos, seq, fmt))
+            text.write('\n'.join(map(str, x)) + '\n')
+    for f in files.values():
+        f.close()
+    return paths
+
+
+def timed(label: str, fn) -> None:
+    best = float('inf')
+    for _ in range(3):
+        t0 = time.perf_counter()
+        n = fn()
+        best = min(best, time.perf_counter() - t0)
+    print('  {:<34}{:9.1f} ms {:9.1f} Msamples/s'.format(label, best * 1e3, n / best / 1e6))
+
+
+def open_only(path: str, verify: bool) -> int:
+    with adc_capture.CaptureFile(path, verify) as cf:
+        return cf.num_samples
+
+
+def views(path: str) -> int:
+    with adc_capture.CaptureFile(path) as cf:
+        return sum(len(x) for _, x in cf.iter_samples())
+
+
+def read_all(path: str) -> int:
+    with adc_capture.CaptureFile(path) as cf:
+        return len(cf.read(0, cf.num_samples))
+
+
+def load_csv(path: str) -> int:
+    with open(path, newline='') as f:
+        values = [int(row[0]) for row in csv.reader(f)]
+    return len(values)
+
+
+def main() -> int:
+    with tempfile.TemporaryDirectory() as tmp:
+        paths = make_files(tmp)
+        print('Loading {} samples ({}), {} per block'.format(
+            SAMPLES, 'numpy' if adc_capture.np is not None else 'memoryview', BLOCK))
+        for name in adc_capture.FORMAT_NAMES:
+            print('{}, {:.1f} MB'.format(name, os.path.getsize(paths[name]) / 1e6))
+            timed('open and index, CRC checked', lambda: open_only(paths[name], True))
+            timed('open and index, headers only', lambda: open_only(paths[name], False))
+            timed('all blocks ({})'.format('views' if name == 'raw16' else 'decoded'), lambda: views(paths[name]))
+            timed('one array of everything', lambda: read_all(paths[name]))
+        print('csv, {:.1f} MB'.format(os.path.getsize(paths['csv']) / 1e6))
+        timed('csv module', lambda: load_csv(paths['csv']))
+        if adc_capture.np is not None:
+            timed('numpy.loadtxt', lambda: len(adc_capture.np.loadtxt(paths['csv'], dtype=adc_capture.np.int16)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
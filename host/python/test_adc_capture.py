@@ -0,0 +1,91 @@
+# SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+# SPDX-License-Identifier: CC0-1.0
+# Capture file bindings: index, zero-copy views and reads against what was written.
+# Run by ctest with ADC_CAPTURE_LIB set; runs without numpy too.
+import os
+import random
+import sys
+import tempfile
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import adc_capture  # noqa: E402
+
+
+def expected(pos: int) -> int:
+    return (pos * 2654435761 >> 7) & 0x0fff
+
+
+def write_capture(path: str) -> list:
+    blocks = []
+    with open(path, 'wb') as f:
+        pos = 0
+        for seq in range(30):
+            n = 1 + seq * 97 % 2000
+            fmt = seq % 3
+            f.write(adc_capture.encode_block([expected(pos + k) for k in range(n)], pos, seq, fmt, device=2, channel=5))
+            blocks.append((pos, n, fmt))
+            pos += n + (500 if seq == 20 else 0)
+        f.write(b'\x00' * 10)  # a header not yet complete
+    return blocks
+
+
+def main() -> int:
+    fd, path = tempfile.mkstemp(suffix='.asb')
+    os.close(fd)
+    try:
+        written = write_capture(path)
+        views = []
+        with adc_capture.CaptureFile(path) as cf:
+            assert len(cf) == len(written)
+            assert cf.num_samples == sum(n for _, n, _ in written)
+            assert cf.bad_blocks == 0 and cf.seq_gaps == 0
+            assert cf.skipped_bytes == 10 and not cf.truncated
+            for blk, (pos, n, fmt) in zip(cf.blocks(), written):
+                assert (blk.pos, blk.samples, blk.format, blk.device, blk.channel) == (pos, n, fmt, 2, 5)
+            for blk, x in cf.iter_samples():
+                assert len(x) == blk.samples
+                assert [int(v) for v in x] == [expected(blk.pos + k) for k in range(blk.samples)]
+                if blk.format == adc_capture.FMT_RAW16:
+                    views.append(x)
+            assert cf.samples(-1)[0] == expected(written[-1][0])
+
+            # Raw blocks are views of the file, not copies
+            assert bytes(cf.payload(0)) == bytes(memoryview(views[0]).cast('B'))
+            if adc_capture.np is not None:
+                assert not views[0].flags.writeable and not views[0].flags.owndata
+                idx = cf.index()
+                assert list(idx['pos']) == [pos for pos, _, _ in written]
+                assert idx.flags.owndata  # still valid after close()
+
+            rng = random.Random(1)
+            end = written[-1][0] + written[-1][1]
+            gap = written[21][0] - 500
+            for _ in range(300):
+                pos = rng.randrange(end)
+                n = rng.randrange(1, 5000)
+                x = cf.read(pos, n)
+                assert len(x) <= n and (len(x) > 0 or gap <= pos < gap + 500)
+                assert [int(v) for v in x] == [expected(pos + k) for k in range(len(x))]
+            assert len(cf.read(gap - 3, 100)) == 3
+            assert len(cf.read(gap, 100)) == 0
+            assert cf.find(0) == 0 and cf.find(end) == len(cf)
+            try:
+                cf.block(len(cf))
+                raise AssertionError('no IndexError')
+            except IndexError:
+                pass
+        # Views outlive the file object
+        assert int(views[-1][0]) == expected(written[-3][0])
+        try:
+            adc_capture.CaptureFile(path + '.missing')
+            raise AssertionError('no OSError')
+        except OSError:
+            pass
+    finally:
+        os.unlink(path)
+    print('PASS ({})'.format('numpy' if adc_capture.np is not None else 'memoryview'))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
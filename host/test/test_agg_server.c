@@ -0,0 +1,336 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "test_util.h"
+#include "agg_server.h"
+
+#define DEVICES 3
+#define BLOCK_SAMPLES 4096
+#define BLOCKS 300       // per channel, device 1 channel 0 sends HEAVY_BLOCKS
+#define HEAVY_BLOCKS 4000
+#define SKIPPED_SEQ 20   // never sent on channel 0
+#define DAMAGED_SEQ 10   // sent with a flipped payload bit on channel 1
+#define GARBAGE_AFTER 30 // 7 junk bytes follow this block of channel 0
+
+static agg_server_t s_srv;
+static uint32_t s_fast_received; // written by the subscriber, polled by device 1: atomic
+
+static sample_t expected_sample(uint16_t device, uint8_t channel, uint32_t seq, uint32_t i)
+{
+    return (sample_t)((device * 1000 + channel * 100 + seq * 7 + i * 13) & 0x1fff);
+}
+
+static int connect_local(int rcvbuf)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (rcvbuf > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(agg_server_port(&s_srv))};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const void *p, size_t n)
+{
+    const uint8_t *b = p;
+    while (n > 0)
+    {
+        ssize_t r = send(fd, b, n, MSG_NOSIGNAL);
+        if (r <= 0)
+        {
+            return false;
+        }
+        b += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+static bool recv_all(int fd, void *p, size_t n)
+{
+    uint8_t *b = p;
+    while (n > 0)
+    {
+        ssize_t r = recv(fd, b, n, 0);
+        if (r <= 0)
+        {
+            return false;
+        }
+        b += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+// One device: channels 0 (raw) and 1 (13-bit packed) interleaved, with a lost block, a damaged one
+// and junk between blocks. Device 1 keeps the fast subscriber at most 100 blocks behind.
+static void *device_main(void *arg)
+{
+    uint16_t device = (uint16_t)(uintptr_t)arg;
+    int fd = connect_local(0);
+    static __thread sample_t samples[BLOCK_SAMPLES];
+    static __thread uint8_t buf[STREAM_HEADER_BYTES + 2 * BLOCK_SAMPLES];
+    uint32_t blocks = device == 1 ? HEAVY_BLOCKS : BLOCKS;
+    for (uint32_t seq = 0; fd >= 0 && seq < blocks; seq++)
+    {
+        for (uint8_t ch = 0; ch < 2; ch++)
+        {
+            if ((ch == 0 && seq == SKIPPED_SEQ) || (ch == 1 && seq >= BLOCKS))
+            {
+                continue;
+            }
+            for (uint32_t i = 0; i < BLOCK_SAMPLES; i++)
+            {
+                samples[i] = expected_sample(device, ch, seq, i);
+            }
+            stream_block_t blk = {
+                .device = device,
+                .channel = ch,
+                .format = ch == 0 ? STREAM_FMT_RAW16 : STREAM_FMT_PACK13,
+                .seq = seq,
+                .samples = BLOCK_SAMPLES,
+                .pos = (uint64_t)seq * BLOCK_SAMPLES,
+            };
+            size_t n = stream_block_encode(&blk, samples, buf);
+            if (ch == 1 && seq == DAMAGED_SEQ)
+            {
+                buf[STREAM_HEADER_BYTES + 100] ^= 4;
+            }
+            send_all(fd, buf, n);
+            if (ch == 0 && seq == GARBAGE_AFTER)
+            {
+                send_all(fd, "junk!!!", 7);
+            }
+        }
+        while (device == 1 && seq > 100 && __atomic_load_n(&s_fast_received, __ATOMIC_ACQUIRE) + 100 < seq)
+        {
+            usleep(100);
+        }
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    return NULL;
+}
+
+// Reads every block of device 1 channel 0 and checks it
+static void *fast_sub_main(void *arg)
+{
+    int fd = *(int *)arg;
+    static uint8_t buf[STREAM_HEADER_BYTES + 2 * BLOCK_SAMPLES];
+    static sample_t samples[BLOCK_SAMPLES];
+    uint32_t expect_seq = 0;
+    while (__atomic_load_n(&s_fast_received, __ATOMIC_ACQUIRE) < HEAVY_BLOCKS - 1 &&
+           recv_all(fd, buf, STREAM_HEADER_BYTES))
+    {
+        stream_block_t blk;
+        if (stream_block_parse(buf, STREAM_HEADER_BYTES, &blk) != STREAM_NEED_MORE ||
+            !recv_all(fd, buf + STREAM_HEADER_BYTES, blk.payload) ||
+            stream_block_parse(buf, STREAM_HEADER_BYTES + blk.payload, &blk) != STREAM_OK)
+        {
+            break;
+        }
+        expect_seq += expect_seq == SKIPPED_SEQ;
+        stream_block_decode(&blk, buf + STREAM_HEADER_BYTES, samples);
+        if (blk.device != 1 || blk.channel != 0 || blk.seq != expect_seq ||
+            samples[77] != expected_sample(1, 0, blk.seq, 77))
+        {
+            break;
+        }
+        expect_seq++;
+        __atomic_fetch_add(&s_fast_received, 1, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void check_block_format(void)
+{
+    CHECK(stream_crc32c(0, "123456789", 9) == 0xe3069283);
+    CHECK(stream_crc32c(stream_crc32c(0, "1234", 4), "56789", 5) == 0xe3069283);
+
+    static sample_t in[1000], out[1000];
+    static uint8_t buf[STREAM_HEADER_BYTES + 2000];
+    for (uint8_t fmt = 0; fmt < STREAM_FMT_COUNT; fmt++)
+    {
+        const uint32_t n = 997; // odd, so the packed formats end mid-byte
+        for (uint32_t i = 0; i < n; i++)
+        {
+            in[i] = (sample_t)(fmt == STREAM_FMT_RAW16 ? test_rand() : test_rand() & (fmt == STREAM_FMT_PACK12 ? 0xfff : 0x1fff));
+        }
+        stream_block_t blk = {.device = 513, .channel = 3, .format = fmt, .seq = 0xfffffffe, .samples = n, .pos = 1ull << 40};
+        size_t len = stream_block_encode(&blk, in, buf);
+        CHECK(len == STREAM_HEADER_BYTES + stream_payload_bytes(fmt, n));
+        stream_block_t got;
+        CHECK(stream_block_parse(buf, len, &got) == STREAM_OK);
+        CHECK(got.device == 513 && got.channel == 3 && got.format == fmt && got.seq == 0xfffffffe);
+        CHECK(got.samples == n && got.pos == 1ull << 40 && got.payload == len - STREAM_HEADER_BYTES);
+        stream_block_decode(&got, buf + STREAM_HEADER_BYTES, out);
+        CHECK(memcmp(in, out, n * sizeof(sample_t)) == 0);
+
+        bool truncations_wait = true;
+        for (size_t k = 0; k < len; k++)
+        {
+            truncations_wait = truncations_wait && stream_block_parse(buf, k, &got) == STREAM_NEED_MORE;
+        }
+        CHECK(truncations_wait);
+        buf[len - 1] ^= 0x80;
+        CHECK(stream_block_parse(buf, len, &got) == STREAM_BAD_CRC);
+        buf[len - 1] ^= 0x80;
+        buf[9] ^= 1; // the header is covered too
+        CHECK(stream_block_parse(buf, len, &got) == STREAM_BAD_CRC);
+    }
+    stream_block_t blk = {.format = STREAM_FMT_COUNT, .samples = 10};
+    CHECK(stream_block_encode(&blk, in, buf) == 0);
+    blk.format = STREAM_FMT_RAW16;
+    blk.samples = 0;
+    CHECK(stream_block_encode(&blk, in, buf) == 0);
+
+    static const uint8_t junk[] = {'x', 'A', 'S', 'B', '2', 'A', 'S', 'B', '1', 0, 'A', 'S'};
+    stream_block_t got;
+    CHECK(stream_block_parse(junk, sizeof(junk), &got) == STREAM_BAD_HEADER);
+    CHECK(stream_resync(junk, sizeof(junk)) == 5);
+    CHECK(stream_resync(junk + 5, sizeof(junk) - 5) == 5); // a magic cut off at the end may continue
+    CHECK(stream_block_parse(junk + 10, 2, &got) == STREAM_NEED_MORE);
+}
+
+// Reads a capture file back: every block valid, in sequence, with the right samples
+static uint32_t check_file(const char *dir, uint16_t device, uint8_t channel, uint32_t *bad)
+{
+    char path[256];
+    snprintf(path, sizeof(path), "%s/dev%u_ch%u.asb", dir, device, channel);
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        (*bad)++;
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    size_t len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(len);
+    size_t got_len = fread(data, 1, len, f);
+    fclose(f);
+    static sample_t samples[BLOCK_SAMPLES];
+    uint32_t blocks = 0;
+    size_t off = 0;
+    while (got_len == len && off < len)
+    {
+        stream_block_t blk;
+        if (stream_block_parse(data + off, len - off, &blk) != STREAM_OK || blk.device != device ||
+            blk.channel != channel)
+        {
+            (*bad)++;
+            break;
+        }
+        stream_block_decode(&blk, data + off + STREAM_HEADER_BYTES, samples);
+        for (uint32_t i = 0; i < blk.samples; i += 511)
+        {
+            *bad += samples[i] != expected_sample(device, channel, blk.seq, i);
+        }
+        off += STREAM_HEADER_BYTES + blk.payload;
+        blocks++;
+    }
+    free(data);
+    unlink(path);
+    return blocks;
+}
+
+int main(void)
+{
+    check_block_format();
+
+    char dir[] = "/tmp/test_agg_XXXXXX";
+    CHECK(mkdtemp(dir) != NULL);
+    agg_config_t bad_cfg = {.dir = dir, .workers = 0};
+    CHECK(!agg_server_start(&s_srv, &bad_cfg));
+    agg_config_t cfg = {.dir = dir, .workers = 2, .sub_queue_bytes = AGG_MIN_SUB_QUEUE};
+    CHECK(agg_server_start(&s_srv, &cfg));
+    CHECK(agg_server_port(&s_srv) != 0);
+
+    // A fast and a stalled subscriber on device 1 channel 0, registered before the devices start
+    uint8_t req[AGG_SUB_REQUEST_BYTES];
+    agg_sub_request(1, 0, req);
+    int fast = connect_local(0), slow = connect_local(4096);
+    CHECK(fast >= 0 && slow >= 0);
+    send_all(fast, req, sizeof(req));
+    send_all(slow, req, sizeof(req));
+    agg_stream_stats_t st = {0};
+    for (int t = 0; t < 5000 && st.subscribers < 2; t++)
+    {
+        usleep(1000);
+        agg_server_stream_stats(&s_srv, 1, 0, &st);
+    }
+    CHECK(st.subscribers == 2);
+
+    pthread_t sub_thread, dev_threads[DEVICES];
+    pthread_create(&sub_thread, NULL, fast_sub_main, &fast);
+    for (uintptr_t d = 0; d < DEVICES; d++)
+    {
+        pthread_create(&dev_threads[d], NULL, device_main, (void *)d);
+    }
+    for (int d = 0; d < DEVICES; d++)
+    {
+        pthread_join(dev_threads[d], NULL);
+    }
+    pthread_join(sub_thread, NULL);
+    CHECK(s_fast_received == HEAVY_BLOCKS - 1);
+
+    // Sent minus one lost block per channel and the damaged one
+    const uint64_t expect_blocks = (DEVICES - 1) * (2 * BLOCKS - 2) + (HEAVY_BLOCKS - 1) + (BLOCKS - 1);
+    agg_stats_t stats = {0};
+    for (int t = 0; t < 10000 && stats.blocks < expect_blocks; t++)
+    {
+        usleep(1000);
+        agg_server_stats(&s_srv, &stats);
+    }
+    CHECK(stats.blocks == expect_blocks);
+    CHECK(stats.connections == DEVICES + 2);
+    CHECK(stats.bad_blocks == DEVICES);
+    CHECK(stats.skipped_bytes == DEVICES * (7 + STREAM_HEADER_BYTES + stream_payload_bytes(STREAM_FMT_PACK13, BLOCK_SAMPLES)));
+    CHECK(stats.sub_drops > 0); // all of them on the stalled subscriber
+    CHECK(stats.sub_blocks + stats.sub_drops == 2 * (HEAVY_BLOCKS - 1));
+    for (uint16_t d = 0; d < DEVICES; d++)
+    {
+        for (uint8_t ch = 0; ch < 2; ch++)
+        {
+            CHECK(agg_server_stream_stats(&s_srv, d, ch, &st));
+            CHECK(st.blocks == (d == 1 && ch == 0 ? HEAVY_BLOCKS - 1 : BLOCKS - 1));
+            CHECK(st.samples == st.blocks * BLOCK_SAMPLES);
+            CHECK(st.gaps == 1);
+        }
+    }
+    CHECK(!agg_server_stream_stats(&s_srv, 9, 0, &st));
+    close(fast);
+    close(slow);
+    agg_server_stop(&s_srv);
+
+    uint32_t bad = 0;
+    for (uint16_t d = 0; d < DEVICES; d++)
+    {
+        for (uint8_t ch = 0; ch < 2; ch++)
+        {
+            CHECK(check_file(dir, d, ch, &bad) == (d == 1 && ch == 0 ? HEAVY_BLOCKS - 1 : BLOCKS - 1));
+        }
+    }
+    CHECK(bad == 0);
+    CHECK(rmdir(dir) == 0);
+    return TEST_RESULT();
+}
@@ -0,0 +1,159 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "test_util.h"
+#include "autoset.h"
+
+#define BURST 8192
+#define RATE 1000000.0
+
+// Signal library, in millivolts at time t (seconds)
+typedef enum
+{
+    SIG_SINE,
+    SIG_SQUARE,
+    SIG_PULSE,
+    SIG_TRIANGLE,
+    SIG_DC,
+} sig_kind_t;
+
+typedef struct
+{
+    const char *name;
+    sig_kind_t kind;
+    double freq;
+    double low_mv;
+    double high_mv;
+    int expect_range;      // -1: depends on which part of a slow signal the bursts see
+    uint32_t expect_flags; // flags that must be set (besides the final no-retry)
+    uint32_t expect_decimation;
+} sig_t;
+
+static const autoset_config_t s_cfg = {
+    .code_min = 0,
+    .code_max = 8191,
+    .sample_rate_hz = (uint32_t)RATE,
+    .num_ranges = 4,
+    .range_full_scale_mv = {750, 1050, 1300, 2500}, // ESP32-S2 attenuations 0 / 2.5 / 6 / 11 dB
+    .capture_len = 1024,
+    .max_decimation = 64,
+    .periods_per_capture = 4,
+    .min_amplitude = 40,
+    .hist_shift = 4,
+};
+
+static double sig_mv(const sig_t *sig, double t)
+{
+    double ph = fmod(t * sig->freq, 1.0);
+    double u;
+    switch (sig->kind)
+    {
+    case SIG_SINE:
+        u = 0.5 + 0.5 * sin(2 * M_PI * ph);
+        break;
+    case SIG_SQUARE:
+        u = ph < 0.5 ? 1.0 : 0.0;
+        break;
+    case SIG_PULSE:
+        u = ph < 0.05 ? 1.0 : 0.0;
+        break;
+    case SIG_TRIANGLE:
+        u = ph < 0.5 ? 2 * ph : 2 - 2 * ph;
+        break;
+    default:
+        u = 0.0;
+        break;
+    }
+    return sig->low_mv + u * (sig->high_mv - sig->low_mv);
+}
+
+// What the ADC delivers for this signal in a range: scaled, noisy, clipped to the code range
+static void acquire(const sig_t *sig, int range, uint64_t t0, sample_t *out)
+{
+    for (size_t i = 0; i < BURST; i++)
+    {
+        double code = sig_mv(sig, (t0 + i) / RATE) * s_cfg.code_max / s_cfg.range_full_scale_mv[range];
+        code += (int)(test_rand() % 9) - 4;
+        out[i] = (sample_t)(code < 0 ? 0 : code > s_cfg.code_max ? s_cfg.code_max : code);
+    }
+}
+
+int main(void)
+{
+    static const sig_t sigs[] = {
+        {"sine 1k 100-700 mV", SIG_SINE, 1000, 100, 700, 1, AUTOSET_PERIODIC, 4},
+        {"square 10k 0-1200 mV", SIG_SQUARE, 10000, 0, 1200, 3, AUTOSET_PERIODIC, 1},
+        {"pulse 1k 0-500 mV", SIG_PULSE, 1000, 0, 500, 0, AUTOSET_PERIODIC, 4},
+        {"triangle 5k 200-2000 mV", SIG_TRIANGLE, 5000, 200, 2000, 3, AUTOSET_PERIODIC, 1},
+        {"sine 50k 600-650 mV", SIG_SINE, 50000, 600, 650, 0, AUTOSET_PERIODIC, 1},
+        {"dc 600 mV", SIG_DC, 0, 600, 600, 0, AUTOSET_NO_SIGNAL, 1},
+        {"sine 20 Hz 0-1000 mV", SIG_SINE, 20, 0, 1000, -1, 0, 64},
+        {"sine 300k 0-600 mV", SIG_SINE, 300000, 0, 600, 0, AUTOSET_PERIODIC | AUTOSET_UNDERSAMPLED, 1},
+        {"square 1k 0-3000 mV", SIG_SQUARE, 1000, 0, 3000, 3, AUTOSET_CLIPPED | AUTOSET_PERIODIC, 4},
+    };
+    static sample_t burst[BURST];
+    static meas_scratch_t scratch;
+
+    for (size_t k = 0; k < sizeof(sigs) / sizeof(sigs[0]); k++)
+    {
+        const sig_t *sig = &sigs[k];
+        // Start from both ends of the range table; bursts are bounded by the number of ranges
+        for (int start = 0; start < s_cfg.num_ranges; start += s_cfg.num_ranges - 1)
+        {
+            int range = start;
+            int bursts = 0;
+            autoset_result_t r;
+            do
+            {
+                acquire(sig, range, (uint64_t)bursts * 12345, burst);
+                CHECK(autoset_analyze(&s_cfg, range, burst, BURST, &r, &scratch));
+                range = r.range;
+                bursts++;
+            } while ((r.flags & AUTOSET_RETRY) && bursts <= s_cfg.num_ranges);
+
+            if ((sig->expect_range >= 0 && r.range != sig->expect_range) || (r.flags & sig->expect_flags) != sig->expect_flags ||
+                r.decimation != sig->expect_decimation)
+            {
+                printf("%s from %d: range %d flags 0x%x decimation %u\n", sig->name, start, r.range,
+                       (unsigned)r.flags, (unsigned)r.decimation);
+            }
+            CHECK(bursts <= s_cfg.num_ranges);
+            CHECK(sig->expect_range < 0 || r.range == sig->expect_range);
+            CHECK((r.flags & sig->expect_flags) == sig->expect_flags);
+            CHECK(r.decimation == sig->expect_decimation);
+            CHECK(r.pre + r.post == s_cfg.capture_len * r.decimation);
+
+            // Trigger at mid-swing in codes of the chosen range, 10 % hysteresis
+            double fs = s_cfg.range_full_scale_mv[r.range];
+            double hi = sig->high_mv < fs ? sig->high_mv : fs;
+            double mid_code = 0.5 * (sig->low_mv + hi) * s_cfg.code_max / fs;
+            double swing = (hi - sig->low_mv) * s_cfg.code_max / fs;
+            if (r.flags & AUTOSET_PERIODIC)
+            {
+                CHECK_NEAR((double)r.trigger_level, mid_code, 0.05 * swing + 8);
+                CHECK_NEAR((double)r.trigger_hysteresis, 0.1 * swing, 0.05 * swing + 8);
+            }
+            if ((r.flags & AUTOSET_PERIODIC) && !(r.flags & AUTOSET_UNDERSAMPLED))
+            {
+                CHECK_NEAR(r.frequency_hz, sig->freq, sig->freq * 0.01);
+            }
+            if (r.flags & AUTOSET_NO_SIGNAL)
+            {
+                CHECK_NEAR(r.dc_mv, sig->low_mv, 5.0);
+            }
+        }
+    }
+
+    autoset_config_t bad = s_cfg;
+    autoset_result_t r;
+    bad.max_decimation = 3;
+    CHECK(!autoset_analyze(&bad, 0, burst, BURST, &r, &scratch));
+    CHECK(!autoset_analyze(&s_cfg, 4, burst, BURST, &r, &scratch));
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "test_util.h"
+#include "block_index.h"
+
+#define RING_SAMPLES 4096
+
+static sample_t s_storage[RING_SAMPLES];
+static block_summary_t s_blocks[RING_SAMPLES / BLOCK_INDEX_SAMPLES];
+
+// Write in odd-sized frames like the ADC driver does and commit after each
+static void feed(sample_ring_t *ring, block_index_t *idx, size_t total)
+{
+    sample_t frame[100];
+    while (total > 0)
+    {
+        size_t n = 1 + test_rand() % 100;
+        n = n > total ? total : n;
+        for (size_t i = 0; i < n; i++)
+        {
+            frame[i] = (sample_t)(test_rand() % 4096);
+            if (test_rand() % 1000 == 0)
+            {
+                frame[i] = 8000; // rare spike for the search tests
+            }
+        }
+        sample_ring_write(ring, frame, n);
+        block_index_commit(idx, ring->head);
+        total -= n;
+    }
+}
+
+int main(void)
+{
+    sample_ring_t ring;
+    block_index_t idx;
+    sample_ring_init(&ring, s_storage, RING_SAMPLES);
+    block_index_init(&idx, &ring, s_blocks);
+
+    // Before the ring wraps and after it has wrapped several times
+    size_t feeds[] = {1000, 3 * RING_SAMPLES + 77};
+    for (size_t f = 0; f < sizeof(feeds) / sizeof(feeds[0]); f++)
+    {
+        feed(&ring, &idx, feeds[f]);
+        uint64_t lo = block_index_oldest_valid(&idx, ring.head);
+
+        for (int iter = 0; iter < 2000; iter++)
+        {
+            uint64_t span = ring.head - lo;
+            uint64_t a = lo + test_rand() % span;
+            uint64_t b = a + test_rand() % (ring.head - a + 1);
+
+            range_stats_t fast, raw;
+            bool ok_fast = block_index_range_stats(&idx, ring.head, a, b, &fast);
+            bool ok_raw = block_index_range_stats_raw(&ring, a, b, &raw);
+            CHECK(ok_fast == ok_raw);
+            if (ok_fast)
+            {
+                CHECK(fast.count == raw.count);
+                CHECK(fast.min == raw.min);
+                CHECK(fast.max == raw.max);
+                CHECK(fast.sum == raw.sum);
+                CHECK(fast.sum_sq == raw.sum_sq);
+            }
+
+            sample_t thr = (sample_t)(test_rand() % 2 ? 8000 : test_rand() % 4096);
+            block_search_dir_t dir = test_rand() % 2 ? BLOCK_SEARCH_ABOVE : BLOCK_SEARCH_BELOW;
+            uint64_t pos_fast = 0, pos_raw = 0;
+            bool hit_fast = block_index_find(&idx, ring.head, a, b, thr, dir, &pos_fast);
+            bool hit_raw = block_index_find_raw(&ring, a, b, thr, dir, &pos_raw);
+            CHECK(hit_fast == hit_raw);
+            CHECK(!hit_fast || pos_fast == pos_raw);
+        }
+    }
+
+    // Ranges that have been overwritten are clipped, not served from stale data
+    range_stats_t s;
+    CHECK(block_index_range_stats(&idx, ring.head, 0, ring.head, &s));
+    CHECK(s.count == ring.head - block_index_oldest_valid(&idx, ring.head));
+    CHECK(!block_index_range_stats(&idx, ring.head, 0, 10, &s));
+
+    // An index started mid-block only trusts summaries from the next block boundary
+    feed(&ring, &idx, 123);
+    block_index_init(&idx, &ring, s_blocks);
+    for (size_t i = 0; i < sizeof(s_blocks) / sizeof(s_blocks[0]); i++)
+    {
+        s_blocks[i] = (block_summary_t){.min = INT16_MIN, .max = INT16_MAX}; // stale garbage
+    }
+    feed(&ring, &idx, 3 * BLOCK_INDEX_SAMPLES);
+    range_stats_t raw;
+    CHECK(block_index_range_stats(&idx, ring.head, 0, ring.head, &s));
+    CHECK(block_index_range_stats_raw(&ring, block_index_oldest_valid(&idx, ring.head), ring.head, &raw));
+    CHECK(s.min == raw.min && s.max == raw.max && s.sum == raw.sum && s.sum_sq == raw.sum_sq);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,142 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "capture_codec.h"
+
+static bool roundtrip(dsp_sched_t *sched, const sample_t *in, size_t n, size_t *packed_len)
+{
+    size_t cap = capture_codec_bound(n);
+    uint8_t *packed = malloc(cap);
+    sample_t *out = malloc((n ? n : 1) * sizeof(sample_t));
+    size_t len = capture_codec_compress(sched, in, n, packed, cap);
+    size_t info_n = 0;
+    bool ok = len > 0 && capture_codec_info(packed, len, &info_n) && info_n == n &&
+              capture_codec_decompress(sched, packed, len, out, n) && memcmp(in, out, n * sizeof(sample_t)) == 0;
+    *packed_len = len;
+
+    // Truncated containers must be rejected, not read past
+    if (ok && n > 0)
+    {
+        ok = !capture_codec_decompress(sched, packed, len - 1, out, n);
+    }
+    free(packed);
+    free(out);
+    return ok;
+}
+
+// Bounded mode: every sample within max_err, same bytes with or without the pool
+static bool roundtrip_bounded(dsp_sched_t *sched, const sample_t *in, size_t n, uint32_t max_err, size_t *packed_len)
+{
+    size_t cap = capture_codec_bound(n);
+    uint8_t *packed = malloc(cap);
+    uint8_t *packed_par = malloc(cap);
+    sample_t *out = malloc((n ? n : 1) * sizeof(sample_t));
+    size_t len = capture_codec_compress_bounded(NULL, in, n, max_err, packed, cap);
+    size_t len_par = capture_codec_compress_bounded(sched, in, n, max_err, packed_par, cap);
+    size_t info_n = 0;
+    bool ok = len > 0 && len == len_par && memcmp(packed, packed_par, len) == 0 &&
+              capture_codec_info(packed, len, &info_n) && info_n == n &&
+              capture_codec_max_err(packed, len) == max_err && capture_codec_decompress(sched, packed, len, out, n);
+    for (size_t i = 0; ok && i < n; i++)
+    {
+        ok = abs(out[i] - in[i]) <= (int)max_err;
+    }
+    if (ok && n > 0)
+    {
+        ok = !capture_codec_decompress(sched, packed, len - 1, out, n);
+    }
+    *packed_len = len;
+    free(packed);
+    free(packed_par);
+    free(out);
+    return ok;
+}
+
+int main(void)
+{
+    dsp_sched_t sched;
+    CHECK(dsp_sched_start(&sched, 3));
+
+    size_t sizes[] = {0, 1, 31, 32, 33, CAPTURE_CODEC_CHUNK_SAMPLES, CAPTURE_CODEC_CHUNK_SAMPLES + 1, 100000};
+    sample_t *buf = malloc(100000 * sizeof(sample_t));
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        size_t n = sizes[s];
+        size_t len;
+
+        // Slow signal with a few LSB of noise: what the ADC usually delivers
+        for (size_t i = 0; i < n; i++)
+        {
+            buf[i] = (sample_t)(4096 + (int)(i % 2000) - 1000 + (int)(test_rand() % 8));
+        }
+        CHECK(roundtrip(NULL, buf, n, &len));
+        size_t single = len;
+        CHECK(roundtrip(&sched, buf, n, &len));
+        CHECK(len == single); // parallel output is byte-identical
+        if (n >= CAPTURE_CODEC_CHUNK_SAMPLES)
+        {
+            CHECK(len * 2 < n * sizeof(sample_t));
+        }
+
+        // Full-range int16 noise exercises the 17-bit delta width
+        for (size_t i = 0; i < n; i++)
+        {
+            buf[i] = (sample_t)(test_rand() & 1 ? INT16_MIN + (test_rand() % 4) : INT16_MAX - (test_rand() % 4));
+        }
+        CHECK(roundtrip(&sched, buf, n, &len));
+        CHECK(len <= capture_codec_bound(n));
+    }
+
+    // Bounded error: noisy sine, full-range noise and clamping at the int16 limits
+    static const uint32_t errs[] = {0, 1, 2, 4, 8, 100, CAPTURE_CODEC_MAX_ERR};
+    size_t n = 3 * CAPTURE_CODEC_CHUNK_SAMPLES + 77;
+    size_t prev_len = SIZE_MAX;
+    for (size_t i = 0; i < n; i++)
+    {
+        buf[i] = (sample_t)(4096 + 3000 * ((int)(i % 500) - 250) / 250 + (int)(test_rand() % 16));
+    }
+    for (size_t e = 0; e < sizeof(errs) / sizeof(errs[0]); e++)
+    {
+        size_t len;
+        CHECK(roundtrip_bounded(&sched, buf, n, errs[e], &len));
+        CHECK(len < prev_len); // coarser steps pack tighter
+        prev_len = len;
+    }
+    size_t lossless_len, bounded_len;
+    CHECK(roundtrip(NULL, buf, n, &lossless_len));
+    CHECK(roundtrip_bounded(&sched, buf, n, 0, &bounded_len));
+    CHECK(bounded_len == lossless_len + 4); // max_err 0 codes like ACZ1 plus the header word
+    for (size_t i = 0; i < n; i++)
+    {
+        buf[i] = (sample_t)(test_rand() & 1 ? INT16_MIN + (test_rand() % 4) : INT16_MAX - (test_rand() % 4));
+    }
+    for (size_t e = 0; e < sizeof(errs) / sizeof(errs[0]); e++)
+    {
+        size_t len;
+        CHECK(roundtrip_bounded(&sched, buf, n, errs[e], &len));
+    }
+    uint8_t *packed = malloc(capture_codec_bound(n));
+    CHECK(capture_codec_compress_bounded(NULL, buf, n, CAPTURE_CODEC_MAX_ERR + 1, packed, capture_codec_bound(n)) == 0);
+    free(packed);
+
+    // Constant data packs to one width byte per group
+    for (size_t i = 0; i < CAPTURE_CODEC_CHUNK_SAMPLES; i++)
+    {
+        buf[i] = 0;
+    }
+    uint8_t chunk[64 * 4];
+    CHECK(capture_codec_chunk_encode(buf, 1024, chunk) == 1024 / CAPTURE_CODEC_GROUP);
+
+    uint8_t junk[64] = {0};
+    CHECK(!capture_codec_info(junk, sizeof(junk), &n));
+
+    dsp_sched_stop(&sched);
+    free(buf);
+    return TEST_RESULT();
+}
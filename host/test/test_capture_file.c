@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "capture_file.h"
+
+#define BLOCKS 60
+#define MAX_BLOCK 3000
+#define LOST_SEQ 17    // never written
+#define DAMAGED_SEQ 30 // written with a flipped payload bit
+#define GAP_SEQ 40     // positions jump by 1000 here
+
+static sample_t expected_sample(uint64_t pos)
+{
+    return (sample_t)((pos * 2654435761u >> 7) & 0x0fff);
+}
+
+static uint64_t block_pos(uint32_t seq)
+{
+    return (uint64_t)seq * MAX_BLOCK + (seq >= GAP_SEQ ? 1000 : 0);
+}
+
+// Varying sizes and all formats; returns the number of samples in valid blocks
+static uint64_t write_capture(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    static sample_t samples[MAX_BLOCK];
+    static uint8_t buf[STREAM_HEADER_BYTES + 2 * MAX_BLOCK];
+    uint64_t total = 0;
+    for (uint32_t seq = 0; seq < BLOCKS; seq++)
+    {
+        stream_block_t blk = {
+            .device = 3,
+            .channel = 1,
+            .format = (uint8_t)(seq % STREAM_FMT_COUNT),
+            .seq = seq,
+            .samples = seq % 5 == 4 ? 1 + seq * 37 % MAX_BLOCK : MAX_BLOCK,
+            .pos = block_pos(seq),
+        };
+        for (uint32_t i = 0; i < blk.samples; i++)
+        {
+            samples[i] = expected_sample(blk.pos + i);
+        }
+        size_t n = stream_block_encode(&blk, samples, buf);
+        if (seq == LOST_SEQ)
+        {
+            continue;
+        }
+        if (seq == DAMAGED_SEQ)
+        {
+            buf[n - 1] ^= 0x10;
+        }
+        else
+        {
+            total += blk.samples;
+        }
+        fwrite(buf, 1, n, f);
+        if (seq == 10)
+        {
+            fwrite("garbage", 1, 7, f);
+        }
+        if (seq == BLOCKS - 1)
+        {
+            fwrite(buf, 1, 100, f); // a block still being written
+        }
+    }
+    fclose(f);
+    return total;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/test_capture_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    const uint64_t total = write_capture(path);
+
+    capture_file_t cf;
+    CHECK(!capture_file_open(&cf, "/nonexistent/capture.asb", true));
+    CHECK(capture_file_open(&cf, path, true));
+    CHECK(cf.num_blocks == BLOCKS - 2);
+    CHECK(cf.samples == total);
+    CHECK(cf.bad_blocks == 1);
+    CHECK(cf.seq_gaps == 2); // the lost block and the damaged one
+    CHECK(cf.truncated);
+    CHECK(cf.blocks[0].device == 3 && cf.blocks[0].channel == 1 && cf.blocks[0].offset == 0);
+
+    // Every block decodes to what was written
+    static sample_t out[MAX_BLOCK * 4];
+    bool blocks_ok = true;
+    for (size_t i = 0; i < cf.num_blocks; i++)
+    {
+        capture_file_decode(&cf, i, out);
+        for (uint32_t k = 0; k < cf.blocks[i].samples; k++)
+        {
+            blocks_ok = blocks_ok && out[k] == expected_sample(cf.blocks[i].pos + k);
+        }
+    }
+    CHECK(blocks_ok);
+
+    // Random ranges across block and format boundaries, stopping at gaps
+    bool reads_ok = true;
+    for (int t = 0; t < 2000; t++)
+    {
+        uint64_t pos = test_rand() % block_pos(BLOCKS);
+        size_t n = 1 + test_rand() % (3 * MAX_BLOCK);
+        size_t got = capture_file_read(&cf, pos, n, out);
+        // The reference: follow the blocks as long as positions continue
+        size_t expect = 0;
+        for (size_t i = capture_file_find(&cf, pos); i < cf.num_blocks && expect < n; i++)
+        {
+            const capture_block_t *b = &cf.blocks[i];
+            if (b->pos > pos + expect)
+            {
+                break;
+            }
+            size_t avail = (size_t)(b->pos + b->samples - (pos + expect));
+            expect += avail < n - expect ? avail : n - expect;
+        }
+        reads_ok = reads_ok && got == expect;
+        for (size_t k = 0; k < got; k++)
+        {
+            reads_ok = reads_ok && out[k] == expected_sample(pos + k);
+        }
+    }
+    CHECK(reads_ok);
+    CHECK(capture_file_find(&cf, 0) == 0);
+    CHECK(capture_file_find(&cf, block_pos(BLOCKS)) == cf.num_blocks);
+    CHECK(capture_file_read(&cf, block_pos(LOST_SEQ), 10, out) == 0);
+    capture_file_close(&cf);
+
+    // Without CRC checks the damaged block is indexed like the rest
+    CHECK(capture_file_open(&cf, path, false));
+    CHECK(cf.num_blocks == BLOCKS - 1);
+    CHECK(cf.bad_blocks == 0 && cf.seq_gaps == 1 && cf.truncated);
+    CHECK(cf.skipped_bytes == 7);
+    capture_file_close(&cf);
+
+    // An empty file
+    FILE *f = fopen(path, "wb");
+    fclose(f);
+    CHECK(capture_file_open(&cf, path, true));
+    CHECK(cf.num_blocks == 0 && cf.samples == 0 && !cf.truncated);
+    capture_file_close(&cf);
+    unlink(path);
+    return TEST_RESULT();
+}
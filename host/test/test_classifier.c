@@ -0,0 +1,215 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "classifier.h"
+#include "vib_features.h"
+
+#define RATE 1000000
+#define WINDOW_SHIFT 12
+#define WINDOW (1u << WINDOW_SHIFT)
+#define STATES 3
+#define PER_STATE 40 // windows per state, for each of the training and the test set
+#define NUM_BANDS 3
+#define NUM_FEATURES (5 + NUM_BANDS)
+
+static sample_t s_sig[WINDOW];
+static float s_train[STATES * PER_STATE][NUM_FEATURES];
+static float s_test[STATES * PER_STATE][NUM_FEATURES];
+static vib_features_t s_vec;
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (test_rand() / 4294967296.0);
+}
+
+static double gauss(void)
+{
+    double u1 = (test_rand() + 1.0) / 4294967297.0, u2 = test_rand() / 4294967296.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static void keep(void *ctx, const vib_features_t *f)
+{
+    *(vib_features_t *)ctx = *f;
+}
+
+// One window of a simulated machine: 0 healthy (noise), 1 unbalance (a strong low tone),
+// 2 bearing fault (periodic impacts ringing at a high resonance)
+static void machine_window(int state, float *features)
+{
+    double tone = uniform(60, 150), f0 = uniform(1500, 2500), phase = uniform(0, 2 * M_PI);
+    double period = uniform(250, 400), impact = uniform(200, 400), noise = uniform(15, 25);
+    for (size_t i = 0; i < WINDOW; i++)
+    {
+        double x = 4096 + noise * gauss();
+        if (state == 1)
+        {
+            x += tone * sin(2 * M_PI * f0 * i / RATE + phase);
+        }
+        if (state == 2)
+        {
+            double t = fmod(i, period);
+            x += impact * exp(-t / 15) * sin(2 * M_PI * 40000 * t / RATE);
+        }
+        s_sig[i] = (sample_t)lrint(x);
+    }
+    vib_config_t cfg = {
+        .sample_rate_hz = RATE,
+        .window_shift = WINDOW_SHIFT,
+        .band_decim_shift = 2,
+        .num_bands = NUM_BANDS,
+        .bands = {{500, 4000}, {4000, 16000}, {16000, 60000}},
+    };
+    vib_t v;
+    vib_init(&v, &cfg, keep, &s_vec);
+    vib_process(&v, s_sig, WINDOW, 0);
+    vib_features_to_array(&s_vec, NUM_BANDS, features);
+}
+
+// Random float MLPs: the int8 model picks the same class almost always
+static void check_random_mlp(void)
+{
+    enum { IN = 8, H = 16, OUT = 4, CALIB = 200, TRIALS = 2000 };
+    static float w1[H * IN], b1[H], w2[H * H], b2[H], w3[OUT * H], b3[OUT];
+    static float calib[CALIB * IN];
+    float mean[IN], std[IN];
+    for (int i = 0; i < IN; i++)
+    {
+        mean[i] = (float)uniform(-5, 5);
+        std[i] = (float)uniform(0.5, 3);
+    }
+    for (int k = 0; k < H * IN; k++)
+    {
+        w1[k] = (float)uniform(-0.5, 0.5);
+    }
+    for (int k = 0; k < H * H; k++)
+    {
+        w2[k] = (float)uniform(-0.5, 0.5);
+    }
+    for (int k = 0; k < OUT * H; k++)
+    {
+        w3[k] = (float)uniform(-0.5, 0.5);
+    }
+    for (int k = 0; k < H; k++)
+    {
+        b1[k] = (float)uniform(-0.2, 0.2);
+        b2[k] = (float)uniform(-0.2, 0.2);
+    }
+    for (int k = 0; k < OUT; k++)
+    {
+        b3[k] = (float)uniform(-0.2, 0.2);
+    }
+    const cls_float_layer_t layers[] = {
+        {IN, H, true, w1, b1},
+        {H, H, true, w2, b2},
+        {H, OUT, false, w3, b3},
+    };
+    for (int k = 0; k < CALIB * IN; k++)
+    {
+        calib[k] = mean[k % IN] + std[k % IN] * (float)gauss();
+    }
+    static cls_model_t m;
+    CHECK(!cls_quantize(&m, layers, 3, mean, std, calib, 0));
+    CHECK(cls_quantize(&m, layers, 3, mean, std, calib, CALIB));
+    CHECK(m.num_classes == OUT);
+    int agree = 0;
+    for (int t = 0; t < TRIALS; t++)
+    {
+        float x[IN];
+        for (int i = 0; i < IN; i++)
+        {
+            x[i] = mean[i] + std[i] * (float)gauss();
+        }
+        agree += cls_predict(&m, x, NULL) == cls_predict_float(layers, 3, mean, std, x);
+    }
+    CHECK(agree >= TRIALS * 97 / 100);
+}
+
+int main(void)
+{
+    check_random_mlp();
+
+    // Machine states from simulated vibration windows. The model is a nearest-centroid classifier
+    // in standardized feature space, written as a two-layer MLP: the hidden ReLU pair [z, -z] passes
+    // every feature through, and the output layer scores each class centroid.
+    for (int s = 0; s < STATES; s++)
+    {
+        for (int k = 0; k < PER_STATE; k++)
+        {
+            machine_window(s, s_train[s * PER_STATE + k]);
+            machine_window(s, s_test[s * PER_STATE + k]);
+        }
+    }
+    float mean[NUM_FEATURES] = {0}, std[NUM_FEATURES] = {0};
+    for (int j = 0; j < NUM_FEATURES; j++)
+    {
+        for (int k = 0; k < STATES * PER_STATE; k++)
+        {
+            mean[j] += s_train[k][j] / (STATES * PER_STATE);
+        }
+        for (int k = 0; k < STATES * PER_STATE; k++)
+        {
+            std[j] += (s_train[k][j] - mean[j]) * (s_train[k][j] - mean[j]) / (STATES * PER_STATE);
+        }
+        std[j] = sqrtf(std[j]) + 1e-3f;
+    }
+    static float w1[2 * NUM_FEATURES * NUM_FEATURES], b1[2 * NUM_FEATURES];
+    static float w2[STATES * 2 * NUM_FEATURES], b2[STATES];
+    for (int j = 0; j < NUM_FEATURES; j++)
+    {
+        w1[j * NUM_FEATURES + j] = 1;
+        w1[(NUM_FEATURES + j) * NUM_FEATURES + j] = -1;
+    }
+    for (int s = 0; s < STATES; s++)
+    {
+        float c[NUM_FEATURES] = {0}, norm = 0;
+        for (int k = 0; k < PER_STATE; k++)
+        {
+            for (int j = 0; j < NUM_FEATURES; j++)
+            {
+                c[j] += (s_train[s * PER_STATE + k][j] - mean[j]) / std[j] / PER_STATE;
+            }
+        }
+        for (int j = 0; j < NUM_FEATURES; j++)
+        {
+            w2[s * 2 * NUM_FEATURES + j] = c[j];
+            w2[s * 2 * NUM_FEATURES + NUM_FEATURES + j] = -c[j];
+            norm += c[j] * c[j];
+        }
+        b2[s] = -norm / 2;
+    }
+    const cls_float_layer_t layers[] = {
+        {NUM_FEATURES, 2 * NUM_FEATURES, true, w1, b1},
+        {2 * NUM_FEATURES, STATES, false, w2, b2},
+    };
+    static cls_model_t m;
+    CHECK(cls_quantize(&m, layers, 2, mean, std, &s_train[0][0], STATES * PER_STATE));
+    int correct = 0, correct_float = 0;
+    for (int k = 0; k < STATES * PER_STATE; k++)
+    {
+        correct += cls_predict(&m, s_test[k], NULL) == k / PER_STATE;
+        correct_float += cls_predict_float(layers, 2, mean, std, s_test[k]) == k / PER_STATE;
+    }
+    CHECK(correct >= STATES * PER_STATE * 95 / 100);
+    CHECK(correct >= correct_float - 2);
+
+    // Tracker: a class is reported after three windows in a row, single outliers are ignored
+    static const int seq[] = {0, 0, 0, 1, 0, 1, 1, 1, 2, 2, 2, 0, 2};
+    static const bool expect[] = {0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0};
+    cls_tracker_t t;
+    cls_tracker_init(&t, 3);
+    for (size_t i = 0; i < sizeof(seq) / sizeof(seq[0]); i++)
+    {
+        CHECK(cls_tracker_update(&t, seq[i]) == expect[i]);
+    }
+    CHECK(t.current == 2);
+    CHECK(t.changes == 3);
+    return TEST_RESULT();
+}
@@ -0,0 +1,143 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "ddc.h"
+
+#define RATE 1000000
+#define IN_MAX (1u << 19)
+#define IQ_SAMPLES (1u << 14)
+
+static sample_t s_in[IN_MAX];
+static sample_t s_iq_buf[IQ_SAMPLES], s_iq_buf2[IQ_SAMPLES];
+
+// Tones around mid-scale, outputs produced into a fresh ring in odd-sized chunks
+static size_t run(const ddc_config_t *cfg, double f1, double a1, double f2, double a2, size_t n, sample_ring_t *iq,
+                  sample_t *storage)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        s_in[i] = (sample_t)lrint(4096 + a1 * sin(2 * M_PI * f1 * i / RATE) + a2 * sin(2 * M_PI * f2 * i / RATE));
+    }
+    ddc_t d;
+    CHECK(ddc_init(&d, cfg));
+    sample_ring_init(iq, storage, IQ_SAMPLES);
+    size_t produced = 0;
+    for (size_t done = 0; done < n;)
+    {
+        size_t m = 1 + test_rand() % 3000;
+        m = m < n - done ? m : n - done;
+        produced += ddc_process(&d, &s_in[done], m, iq);
+        iq->head = 2 * d.outputs;
+        done += m;
+    }
+    CHECK(produced == d.outputs && iq->head == 2 * produced);
+    return produced;
+}
+
+// RMS magnitude over the second half of the outputs (after the filters settle), in input codes
+static double magnitude(const sample_ring_t *iq, size_t outputs)
+{
+    double sum = 0;
+    for (size_t k = outputs / 2; k < outputs; k++)
+    {
+        double i = sample_ring_at(iq, 2 * k), q = sample_ring_at(iq, 2 * k + 1);
+        sum += i * i + q * q;
+    }
+    return sqrt(sum / (outputs - outputs / 2)) / (1 << DDC_OUT_FRAC_BITS);
+}
+
+// Mean rotation per output, radians
+static double rotation(const sample_ring_t *iq, size_t outputs)
+{
+    double sum = 0;
+    for (size_t k = outputs / 2; k + 1 < outputs; k++)
+    {
+        double i0 = sample_ring_at(iq, 2 * k), q0 = sample_ring_at(iq, 2 * k + 1);
+        double i1 = sample_ring_at(iq, 2 * k + 2), q1 = sample_ring_at(iq, 2 * k + 3);
+        sum += atan2(q1 * i0 - i1 * q0, i1 * i0 + q1 * q0);
+    }
+    return sum / (outputs - outputs / 2 - 1);
+}
+
+int main(void)
+{
+    sample_ring_t iq, iq2;
+
+    ddc_config_t bad = {.sample_rate_hz = RATE, .center_hz = 600000, .cic_shift = 4, .cic_order = 3, .offset = 4096};
+    ddc_t d;
+    CHECK(!ddc_init(&d, &bad));
+    bad.center_hz = -100000;
+    bad.cic_order = 5;
+    CHECK(!ddc_init(&d, &bad));
+
+    ddc_config_t cfg = {.sample_rate_hz = RATE, .center_hz = 0, .cic_shift = 4, .cic_order = 3, .offset = 4096};
+    CHECK_NEAR(ddc_output_rate_hz(&cfg), 31250.0f, 1e-3f);
+    CHECK_NEAR(ddc_bandwidth_hz(&cfg), 25000.0f, 1e-3f);
+    CHECK(ddc_shift_for_bandwidth(RATE, 10000) == 5);
+    CHECK(ddc_shift_for_bandwidth(RATE, 400000) == 0);
+    CHECK(ddc_shift_for_bandwidth(RATE, 450000) == -1);
+
+    // Positive and negative offsets from the center rotate opposite ways at the right rate, at full gain.
+    // A real tone also has a mirror 2 * center_hz away, which must land out of band: hence no shift 0 here.
+    static const int8_t shifts[] = {1, 3, 6, 9};
+    for (size_t t = 0; t < sizeof(shifts); t++)
+    {
+        for (uint8_t order = 1; order <= DDC_MAX_ORDER; order++)
+        {
+            cfg = (ddc_config_t){.sample_rate_hz = RATE, .center_hz = -123000, .cic_shift = shifts[t],
+                                 .cic_order = order, .offset = 4096};
+            double fo = ddc_output_rate_hz(&cfg);
+            size_t n = 400 * (2u << cfg.cic_shift);
+            for (int sign = -1; sign <= 1; sign += 2)
+            {
+                double df = sign * 0.3 * fo;
+                size_t outs = run(&cfg, cfg.center_hz + df, 1000, 0, 0, n, &iq, s_iq_buf);
+                CHECK(outs == n / (2u << cfg.cic_shift));
+                CHECK_NEAR(magnitude(&iq, outs), 1000.0, 15.0);
+                CHECK_NEAR(rotation(&iq, outs), 2 * M_PI * df / fo, 1e-3);
+            }
+        }
+    }
+
+    // Passband is flat to 0.2 dB with the CIC droop compensated
+    cfg = (ddc_config_t){.sample_rate_hz = RATE, .center_hz = 200000, .cic_shift = 5, .cic_order = 4, .offset = 4096};
+    double fo = ddc_output_rate_hz(&cfg);
+    size_t n = 300 * (2u << cfg.cic_shift);
+    double lo = INFINITY, hi = 0;
+    for (double u = -0.4; u <= 0.401; u += 0.05)
+    {
+        double g = magnitude(&iq, run(&cfg, cfg.center_hz + u * fo, 2000, 0, 0, n, &iq, s_iq_buf)) / 2000;
+        lo = g < lo ? g : lo;
+        hi = g > hi ? g : hi;
+    }
+    CHECK(20 * log10(hi / lo) < 0.2 && hi < 1.005);
+
+    // Out-of-band tones: past the FIR transition, and onto the first CIC alias of the passband edge
+    double in_band = magnitude(&iq, run(&cfg, cfg.center_hz + 0.1 * fo, 2000, 0, 0, n, &iq, s_iq_buf));
+    double fir_stop = magnitude(&iq, run(&cfg, cfg.center_hz + 0.7 * fo, 2000, 0, 0, n, &iq, s_iq_buf));
+    double cic_alias = magnitude(&iq, run(&cfg, cfg.center_hz + 1.6 * fo, 2000, 0, 0, n, &iq, s_iq_buf));
+    CHECK(20 * log10(fir_stop / in_band) < -60);
+    CHECK(20 * log10(cic_alias / in_band) < -40);
+
+    // A small tone next to a large out-of-band one is recovered
+    size_t outs = run(&cfg, cfg.center_hz + 0.2 * fo, 20, cfg.center_hz + 2.5 * fo, 3000, n, &iq, s_iq_buf);
+    CHECK_NEAR(magnitude(&iq, outs), 20.0, 1.0);
+
+    // Chunking does not change the output
+    cfg.cic_shift = 3;
+    n = 3000 * (2u << cfg.cic_shift) + 77;
+    outs = run(&cfg, cfg.center_hz + 1000, 1500, cfg.center_hz - 7000, 300, n, &iq, s_iq_buf);
+    ddc_t whole;
+    CHECK(ddc_init(&whole, &cfg));
+    sample_ring_init(&iq2, s_iq_buf2, IQ_SAMPLES);
+    CHECK(ddc_process(&whole, s_in, n, &iq2) == outs);
+    CHECK(2 * whole.outputs == iq.head && memcmp(s_iq_buf, s_iq_buf2, sizeof(s_iq_buf)) == 0);
+    return TEST_RESULT();
+}
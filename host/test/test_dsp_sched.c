@@ -0,0 +1,112 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "test_util.h"
+#include "dsp_sched.h"
+
+#define UNITS 500
+#define WORKERS 3
+
+static dsp_sched_t s_sched;
+static int s_runs[UNITS];
+static int s_bad_worker;
+static dsp_port_lock_t s_lock = DSP_PORT_LOCK_INIT;
+
+static void count_unit(void *arg, int worker)
+{
+    int *slot = arg;
+    if (worker < 0 || worker > WORKERS)
+    {
+        s_bad_worker++;
+    }
+    // Some work so units overlap and get stolen
+    volatile uint32_t x = 0;
+    for (int i = 0; i < 2000; i++)
+    {
+        x += i;
+    }
+    dsp_port_lock(&s_lock);
+    (*slot)++;
+    dsp_port_unlock(&s_lock);
+}
+
+static int s_nested_children;
+
+static void child_unit(void *arg, int worker)
+{
+    (void)arg;
+    (void)worker;
+    dsp_port_lock(&s_lock);
+    s_nested_children++;
+    dsp_port_unlock(&s_lock);
+}
+
+// A unit that forks and joins from inside the pool must not deadlock it
+static void parent_unit(void *arg, int worker)
+{
+    (void)arg;
+    dsp_task_group_t group;
+    dsp_sched_group_init(&group);
+    for (int i = 0; i < 8; i++)
+    {
+        dsp_sched_group_submit(&s_sched, &group, worker + i, child_unit, NULL);
+    }
+    dsp_sched_group_wait(&s_sched, &group);
+    dsp_sched_group_deinit(&group);
+}
+
+int main(void)
+{
+    CHECK(dsp_sched_start(&s_sched, WORKERS));
+    CHECK(s_sched.num_workers == WORKERS);
+
+    // Everything lands on worker 0; overflow runs inline, the rest is stolen or popped
+    dsp_task_group_t group;
+    CHECK(dsp_sched_group_init(&group));
+    for (int i = 0; i < UNITS; i++)
+    {
+        dsp_sched_group_submit(&s_sched, &group, 0, count_unit, &s_runs[i]);
+    }
+    dsp_sched_group_wait(&s_sched, &group);
+    for (int i = 0; i < UNITS; i++)
+    {
+        CHECK(s_runs[i] == 1);
+    }
+    CHECK(s_bad_worker == 0);
+
+    // Nested fork/join from every worker at once
+    for (int i = 0; i < WORKERS * 4; i++)
+    {
+        dsp_sched_group_submit(&s_sched, &group, i, parent_unit, NULL);
+    }
+    dsp_sched_group_wait(&s_sched, &group);
+    CHECK(s_nested_children == WORKERS * 4 * 8);
+    dsp_sched_group_deinit(&group);
+
+    // Plain submissions are drained by stop
+    memset(s_runs, 0, sizeof(s_runs));
+    int submitted = 0;
+    for (int i = 0; i < DSP_SCHED_DEQUE_SIZE; i++)
+    {
+        submitted += dsp_sched_submit(&s_sched, i, count_unit, &s_runs[i]);
+    }
+    CHECK(submitted == DSP_SCHED_DEQUE_SIZE);
+    dsp_sched_stop(&s_sched);
+    for (int i = 0; i < DSP_SCHED_DEQUE_SIZE; i++)
+    {
+        CHECK(s_runs[i] == 1);
+    }
+
+    uint32_t executed = 0;
+    for (int w = 0; w < WORKERS; w++)
+    {
+        executed += s_sched.workers[w].executed;
+    }
+    CHECK(executed > 0);
+
+    return TEST_RESULT();
+}
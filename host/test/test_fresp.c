@@ -0,0 +1,187 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+#include "test_util.h"
+#include "fresp.h"
+
+#define MAX_POINTS 64
+#define SIM_LEN 65536
+#define DAC_TO_CODES 24 // loopback scale: one DAC step is 24 ADC codes
+#define STIM_AMPLITUDE 100
+#define LATENCY_ERROR 17 // the sweep believes each tone starts this many samples late
+
+static const fresp_config_t s_cfg = {
+    .adc_rate_hz = 1000000,
+    .dac_rate_hz = 250000,
+    .f_start_hz = 200,
+    .f_stop_hz = 50000,
+    .points = 30,
+    .min_table = 16,
+    .max_table = 2048,
+    .table_align = 4,
+    .settle_cycles = 4,
+    .min_window = 4096,
+    .max_window = 16384,
+};
+
+static double wrap(double a)
+{
+    while (a > M_PI)
+    {
+        a -= 2 * M_PI;
+    }
+    while (a <= -M_PI)
+    {
+        a += 2 * M_PI;
+    }
+    return a;
+}
+
+// DAC table held for adc/dac samples each, sampled as the reference (ref) and
+// through a one-pole low-pass loopback filter (dut), with +-noise codes on both
+static void simulate(const fresp_point_t *pt, const uint8_t *table, uint64_t start, double alpha, int noise,
+                     sample_t *ref, sample_t *dut, size_t n)
+{
+    double y = 128 * DAC_TO_CODES;
+    for (size_t m = 0; m < n; m++)
+    {
+        double x = 128 * DAC_TO_CODES;
+        if (m >= start)
+        {
+            uint64_t idx = (m - start) * s_cfg.dac_rate_hz / s_cfg.adc_rate_hz % pt->table_len;
+            x = table[idx] * DAC_TO_CODES;
+        }
+        y += alpha * (x - y);
+        int n1 = noise ? (int)(test_rand() % (2 * noise + 1)) - noise : 0;
+        int n2 = noise ? (int)(test_rand() % (2 * noise + 1)) - noise : 0;
+        ref[m] = (sample_t)lrint(x + n1);
+        dut[m] = (sample_t)lrint(y + n2);
+    }
+}
+
+static void measure(const fresp_point_t *pt, const sample_t *s, uint64_t start, fresp_result_t *res)
+{
+    fresp_acc_t acc;
+    fresp_acc_init(&acc, pt, start);
+    // Two uneven spans, as from a ring
+    uint64_t from = start + pt->settle;
+    fresp_acc_add(&acc, &s[from], 1000, from);
+    fresp_acc_add(&acc, &s[from + 1000], pt->window - 1000, from + 1000);
+    CHECK(fresp_acc_result(&acc, STIM_AMPLITUDE * DAC_TO_CODES, res));
+}
+
+int main(void)
+{
+    static fresp_point_t pts[MAX_POINTS];
+    static uint8_t table[2048];
+    static sample_t ref[SIM_LEN], dut[SIM_LEN];
+
+    // Plan: whole cycles per table, whole ADC samples per repeat, windows of whole repeats
+    uint32_t n = fresp_plan(&s_cfg, pts);
+    CHECK(n >= 20 && n <= s_cfg.points);
+    CHECK_NEAR(pts[0].freq_hz, 200.0f, 10.0f);
+    CHECK_NEAR(pts[n - 1].freq_hz, 50000.0f, 500.0f);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const fresp_point_t *p = &pts[i];
+        CHECK(i == 0 || p->freq_hz > pts[i - 1].freq_hz);
+        CHECK(p->table_len % 4 == 0 && p->table_len >= s_cfg.min_table && p->table_len <= s_cfg.max_table);
+        CHECK((uint64_t)p->span * s_cfg.dac_rate_hz == (uint64_t)p->table_len * s_cfg.adc_rate_hz);
+        CHECK(p->window % p->span == 0 && p->window >= s_cfg.min_window && p->window <= s_cfg.max_window);
+        CHECK(p->settle * p->cycles >= s_cfg.settle_cycles * p->span);
+        CHECK_NEAR(p->freq_hz, (float)p->cycles * s_cfg.dac_rate_hz / p->table_len, 1e-3f);
+    }
+    // Unaligned tables (a timer-driven DAC) may take any length with a whole repeat
+    fresp_config_t any = s_cfg;
+    any.table_align = 0;
+    static fresp_point_t any_pts[MAX_POINTS];
+    uint32_t any_n = fresp_plan(&any, any_pts);
+    CHECK(any_n >= 20);
+    bool unaligned = false;
+    for (uint32_t i = 0; i < any_n; i++)
+    {
+        const fresp_point_t *p = &any_pts[i];
+        CHECK((uint64_t)p->span * any.dac_rate_hz == (uint64_t)p->table_len * any.adc_rate_hz);
+        unaligned = unaligned || p->table_len % 4 != 0;
+    }
+    CHECK(unaligned);
+    CHECK(fresp_sweep_samples(pts, 2) == pts[0].settle + pts[0].window + pts[1].settle + pts[1].window);
+
+    fresp_config_t bad = s_cfg;
+    bad.f_stop_hz = 130000; // above the DAC Nyquist rate
+    CHECK(fresp_plan(&bad, pts) == 0);
+    bad = s_cfg;
+    bad.f_start_hz = 0;
+    CHECK(fresp_plan(&bad, pts) == 0);
+    n = fresp_plan(&s_cfg, pts);
+
+    // Table holds exactly `cycles` periods around the offset
+    fresp_fill_table(&pts[5], table, 128, STIM_AMPLITUDE);
+    int lo = 255, hi = 0;
+    for (uint32_t i = 0; i < pts[5].table_len; i++)
+    {
+        lo = table[i] < lo ? table[i] : lo;
+        hi = table[i] > hi ? table[i] : hi;
+    }
+    CHECK(table[0] == 128 && hi <= 128 + STIM_AMPLITUDE && lo >= 128 - STIM_AMPLITUDE && hi - lo >= 2 * STIM_AMPLITUDE - 2);
+
+    // Sweep a one-pole low-pass (fc ~ 8 kHz) through the simulated loopback
+    const double alpha = 0.05;
+    const double hold = (double)s_cfg.adc_rate_hz / s_cfg.dac_rate_hz;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const fresp_point_t *p = &pts[i];
+        uint64_t start = 1000 + test_rand() % 1000;
+        size_t len = start + LATENCY_ERROR + p->settle + p->window;
+        CHECK(len <= SIM_LEN);
+        fresp_fill_table(p, table, 128, STIM_AMPLITUDE);
+        simulate(p, table, start, alpha, 20, ref, dut, len);
+
+        double w = 2 * M_PI * p->freq_hz / s_cfg.adc_rate_hz;
+        double complex h = alpha / (1 - (1 - alpha) * cexp(-I * w));
+
+        // Counter-synced reference: the DAC hold is a sinc with a (hold - 1) / 2 sample delay
+        fresp_result_t r_ref, r_dut, rel;
+        measure(p, ref, start, &r_ref);
+        CHECK_NEAR(r_ref.gain, fabs(sin(hold * w / 2) / (hold * sin(w / 2))), 0.003f);
+        CHECK_NEAR(wrap(r_ref.phase_rad + w * (hold - 1) / 2), 0.0, 0.003);
+
+        // A start latency error shifts both channels alike and drops out of the ratio
+        measure(p, ref, start + LATENCY_ERROR, &r_ref);
+        measure(p, dut, start + LATENCY_ERROR, &r_dut);
+        CHECK_NEAR(wrap(r_ref.phase_rad + w * ((hold - 1) / 2 - LATENCY_ERROR)), 0.0, 0.003);
+        fresp_relative(&r_dut, &r_ref, &rel);
+        CHECK(rel.freq_hz == p->freq_hz);
+        CHECK_NEAR(rel.gain, cabs(h), 0.002f + 0.003f * cabs(h));
+        CHECK_NEAR(wrap(rel.phase_rad - carg(h)), 0.0, 0.003);
+    }
+
+    // Ring input: two spans across the wrap give the same sums as a linear buffer
+    {
+        static sample_t storage[16384];
+        sample_ring_t ring;
+        sample_ring_init(&ring, storage, 16384);
+        const fresp_point_t *p = &pts[n - 1];
+        fresp_fill_table(p, table, 128, STIM_AMPLITUDE);
+        simulate(p, table, 0, alpha, 20, ref, dut, 24000);
+        sample_ring_write(&ring, dut, 24000);
+        uint32_t len = p->span;
+        uint64_t from = 16384 - len / 2;
+        CHECK(len > 0 && from >= 24000 - 16384);
+        fresp_acc_t a, b;
+        fresp_acc_init(&a, p, 0);
+        fresp_acc_init(&b, p, 0);
+        CHECK(fresp_acc_add_ring(&a, &ring, ring.head, from, len));
+        fresp_acc_add(&b, &dut[from], len, from);
+        CHECK(a.ss == b.ss && a.sc == b.sc && a.sum_s == b.sum_s && a.count == len);
+        CHECK(!fresp_acc_add_ring(&a, &ring, ring.head, 3000, len));  // overwritten
+        CHECK(!fresp_acc_add_ring(&a, &ring, ring.head, 23999, len)); // not there yet
+    }
+    return TEST_RESULT();
+}
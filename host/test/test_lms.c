@@ -0,0 +1,116 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "lms.h"
+
+#define RATE 1000000
+#define LEN 400000
+
+static sample_t s_primary[LEN], s_ref[LEN], s_out[LEN], s_out2[LEN];
+static double s_signal[LEN];
+
+static int noise(int amp)
+{
+    return (int)(test_rand() % (2 * amp + 1)) - amp;
+}
+
+// Reference: mains-like harmonics plus broadband noise around its own DC. Primary: a wanted
+// tone plus the reference through a short coupling path (gain, delay, smoothing).
+static void make_inputs(double coupling)
+{
+    static const double path[] = {0.0, 0.0, 0.35, 0.5, -0.2, 0.1}; // two samples of delay
+    const int taps = sizeof(path) / sizeof(path[0]);
+    double r[sizeof(path) / sizeof(path[0])] = {0};
+    for (size_t i = 0; i < LEN; i++)
+    {
+        double t = (double)i / RATE;
+        double x = 600 * sin(2 * M_PI * 50 * t) + 250 * sin(2 * M_PI * 150 * t + 1) + noise(300);
+        memmove(&r[1], &r[0], (taps - 1) * sizeof(r[0]));
+        r[0] = x;
+        double coupled = 0;
+        for (int k = 0; k < taps; k++)
+        {
+            coupled += path[k] * r[k];
+        }
+        s_signal[i] = 40 * sin(2 * M_PI * 1234 * t);
+        s_ref[i] = (sample_t)lrint(3000 + x);
+        s_primary[i] = (sample_t)lrint(4000 + s_signal[i] + coupling * coupled);
+    }
+}
+
+// RMS of out - 4000 - signal over the last quarter, after adapting
+static double residual(const sample_t *out)
+{
+    double sum = 0;
+    for (size_t i = LEN * 3 / 4; i < LEN; i++)
+    {
+        double d = out[i] - 4000 - s_signal[i];
+        sum += d * d;
+    }
+    return sqrt(sum / (LEN / 4));
+}
+
+int main(void)
+{
+    lms_t lms;
+    lms_config_t bad = {.taps = 0, .mu_shift = 4, .normalized = true};
+    CHECK(!lms_init(&lms, &bad));
+    bad = (lms_config_t){.taps = 16, .mu_shift = 10, .normalized = false}; // LMS step of 2^-10 is far too big
+    CHECK(!lms_init(&lms, &bad));
+
+    make_inputs(1.0);
+    double before = residual(s_primary);
+    CHECK(before > 200);
+
+    // NLMS removes the coupled interference by 30 dB and keeps the tone and the DC level. The step is
+    // small: with a tonal reference the canceller acts as a notch whose width grows with the step,
+    // and a fast one would eat into the wanted tone.
+    lms_config_t cfg = {.taps = 16, .mu_shift = 10, .normalized = true};
+    CHECK(lms_init(&lms, &cfg));
+    lms_process(&lms, s_primary, s_ref, s_out, LEN);
+    double after = residual(s_out);
+    CHECK(20 * log10(after / before) < -30);
+    CHECK(lms.samples == LEN);
+    // The weights converge onto the coupling path
+    CHECK_NEAR(lms_weight(&lms, 2), 0.35f, 0.03f);
+    CHECK_NEAR(lms_weight(&lms, 3), 0.5f, 0.03f);
+    CHECK_NEAR(lms_weight(&lms, 4), -0.2f, 0.03f);
+    CHECK_NEAR(lms_weight(&lms, 10), 0.0f, 0.03f);
+
+    // Plain LMS with a step matched to the reference power gets there too
+    cfg = (lms_config_t){.taps = 16, .mu_shift = 30, .normalized = false};
+    CHECK(lms_init(&lms, &cfg));
+    lms_process(&lms, s_primary, s_ref, s_out, LEN);
+    CHECK(20 * log10(residual(s_out) / before) < -25);
+
+    // Uncorrelated reference: nothing to remove, the primary passes through nearly unchanged (the
+    // weights still jitter around zero and leave a few codes of the tone's own modulation)
+    make_inputs(0.0);
+    cfg = (lms_config_t){.taps = 16, .mu_shift = 10, .normalized = true};
+    CHECK(lms_init(&lms, &cfg));
+    lms_process(&lms, s_primary, s_ref, s_out, LEN);
+    CHECK(residual(s_out) < 4);
+
+    // Chunked and in place gives the same output as one call
+    make_inputs(0.7);
+    CHECK(lms_init(&lms, &cfg));
+    lms_process(&lms, s_primary, s_ref, s_out, LEN);
+    CHECK(lms_init(&lms, &cfg));
+    memcpy(s_out2, s_primary, sizeof(s_out2));
+    for (size_t done = 0; done < LEN;)
+    {
+        size_t m = 1 + test_rand() % 700;
+        m = m < LEN - done ? m : LEN - done;
+        lms_process(&lms, &s_out2[done], &s_ref[done], &s_out2[done], m);
+        done += m;
+    }
+    CHECK(memcmp(s_out, s_out2, sizeof(s_out)) == 0);
+    return TEST_RESULT();
+}
@@ -0,0 +1,118 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "test_util.h"
+#include "math_channel.h"
+
+#define N MATH_BLOCK_SAMPLES
+
+static sample_t s_a[N], s_b[N], s_out[N];
+static math_scratch_t s_scratch;
+
+typedef double (*ref_fn_t)(double a, double b);
+
+static double ref_diff(double a, double b) { return a - b; }
+static double ref_affine(double a, double b) { (void)b; return a * 0.5 + 100; }
+static double ref_abs(double a, double b) { (void)b; return fabs(a - 2048); }
+static double ref_prod(double a, double b) { return a * b / 4096; }
+static double ref_mix(double a, double b) { return -(a + b) * 0.25 - 3; }
+static double ref_lit_minus(double a, double b) { (void)b; return 1000 - a; }
+static double ref_sat(double a, double b) { return a * b; }
+
+static double clamp16(double v)
+{
+    return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v);
+}
+
+int main(void)
+{
+    const struct
+    {
+        const char *expr;
+        ref_fn_t ref;
+        int max_insns;
+    } cases[] = {
+        {"A-B", ref_diff, 3},
+        {"A*0.5+100", ref_affine, 2}, // scale and offset fuse into one instruction
+        {"abs(A - 2048)", ref_abs, 3},
+        {"A*B/4096", ref_prod, 4},
+        {"-(A+B)/4 - 3", ref_mix, 4},
+        {"1000 - A", ref_lit_minus, 2},
+        {"A*B", ref_sat, 3}, // exceeds sample_t, must saturate
+    };
+    const sample_t *src[2] = {s_a, s_b};
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++)
+    {
+        math_program_t prog;
+        const char *err = NULL;
+        CHECK(math_compile(cases[c].expr, &prog, &err));
+        CHECK(err == NULL);
+        CHECK(prog.len <= cases[c].max_insns);
+
+        for (int rep = 0; rep < 20; rep++)
+        {
+            for (int i = 0; i < N; i++)
+            {
+                s_a[i] = (sample_t)(test_rand() % 8192);
+                s_b[i] = (sample_t)(test_rand() % 8192);
+            }
+            math_eval(&prog, src, N, s_out, &s_scratch);
+            for (int i = 0; i < N; i++)
+            {
+                // Q16 scaling truncates toward -inf, allow one LSB
+                double want = clamp16(cases[c].ref(s_a[i], s_b[i]));
+                CHECK_NEAR(s_out[i], want, 1.0);
+            }
+        }
+    }
+
+    // Malformed expressions are rejected with a message
+    const char *bad[] = {"", "A+", "A/B", "A/0", "42", "E", "abs A", "(A", "A*100000", "A+(A+(A+(A+A)))"};
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        math_program_t prog;
+        const char *err = NULL;
+        CHECK(!math_compile(bad[i], &prog, &err));
+        CHECK(err != NULL);
+    }
+
+    // Derived ring follows the source rings block by block
+    static sample_t ra[1024], rb[1024], rout[512];
+    sample_ring_t ring_a, ring_b;
+    sample_ring_init(&ring_a, ra, 1024);
+    sample_ring_init(&ring_b, rb, 1024);
+    const sample_ring_t *rings[2] = {&ring_a, &ring_b};
+    math_channel_t ch;
+    CHECK(math_channel_init(&ch, "A-B", rings, 2, rout, 512, NULL));
+    CHECK(!math_channel_init(&ch, "A-C", rings, 2, rout, 512, NULL));
+    CHECK(math_channel_init(&ch, "A-B", rings, 2, rout, 512, NULL));
+
+    uint64_t published = 0;
+    for (int f = 0; f < 40; f++)
+    {
+        sample_t fa[100], fb[100];
+        for (int i = 0; i < 100; i++)
+        {
+            uint64_t pos = ring_a.head + i;
+            fa[i] = (sample_t)(pos % 5000);
+            fb[i] = (sample_t)(pos % 3000);
+        }
+        sample_ring_write(&ring_a, fa, 100);
+        sample_ring_write(&ring_b, fb, 100);
+        published = math_channel_run(&ch, &s_scratch);
+        ch.out.head = published;
+    }
+    CHECK(published == (4000 / MATH_BLOCK_SAMPLES) * MATH_BLOCK_SAMPLES);
+    for (uint64_t p = sample_ring_oldest(&ch.out); p < published; p++)
+    {
+        CHECK(sample_ring_at(&ch.out, p) == (sample_t)(p % 5000) - (sample_t)(p % 3000));
+    }
+
+    return TEST_RESULT();
+}
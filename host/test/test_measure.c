@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "test_util.h"
+#include "measure.h"
+
+#define N 2048
+
+static const meas_config_t s_cfg = {
+    .level = 3500,
+    .hysteresis = 300,
+    .hist_min = 0,
+    .hist_shift = 4,
+    .sample_rate_hz = 1000000,
+};
+
+// Trapezoid pulse train: linear edges of `ramp` samples, positive width `width` at 50 %,
+// optional decaying overshoot after the rising edge, and +-noise codes
+static void pulses(sample_t *s, double period, double width, double ramp, double over, int noise)
+{
+    for (size_t i = 0; i < N; i++)
+    {
+        double ph = fmod(i + 3 * period / 4, period); // start mid-low so the capture opens on a base
+        double v;
+        if (ph < ramp)
+        {
+            v = ph / ramp;
+        }
+        else if (ph < width)
+        {
+            v = 1.0 + over * exp(-(ph - ramp) / 3.0);
+        }
+        else if (ph < width + ramp)
+        {
+            v = 1.0 - (ph - width) / ramp;
+        }
+        else
+        {
+            v = 0.0;
+        }
+        s[i] = (sample_t)lround(1000 + 5000 * v + (noise ? (int)(test_rand() % (2 * noise + 1)) - noise : 0));
+    }
+}
+
+int main(void)
+{
+    sample_t *s = malloc(N * sizeof(sample_t));
+    meas_result_t m;
+    static meas_scratch_t scratch;
+
+    // Clean edges: 10 sample ramps (8 samples 10-90 %), 80 high / 120 low, 12 % overshoot
+    pulses(s, 200, 80, 10, 0.12, 0);
+    CHECK(meas_capture(&s_cfg, s, N, &m, &scratch));
+    CHECK((m.flags & (MEAS_HAVE_LEVELS | MEAS_HAVE_RISE | MEAS_HAVE_FALL | MEAS_HAVE_WIDTH | MEAS_HAVE_PERIOD)) == 0x1f);
+    CHECK_NEAR(m.top, 6000.0f, 10.0f);
+    CHECK_NEAR(m.base, 1000.0f, 10.0f);
+    CHECK_NEAR(m.amplitude, 5000.0f, 20.0f);
+    CHECK_NEAR(m.overshoot_pct, 12.0f, 0.5f);
+    CHECK_NEAR(m.undershoot_pct, 0.0f, 0.5f);
+    CHECK_NEAR(m.rise, 8.0f, 0.2f);
+    CHECK_NEAR(m.fall, 8.0f, 0.2f);
+    CHECK_NEAR(m.width_pos, 80.0f, 0.2f);
+    CHECK_NEAR(m.width_neg, 120.0f, 0.2f);
+    CHECK_NEAR(m.period, 200.0f, 0.05f);
+    CHECK_NEAR(m.frequency_hz, 5000.0f, 2.0f);
+    CHECK_NEAR(m.duty_pct, 40.0f, 0.2f);
+    CHECK(m.rising_edges == N / 200 || m.rising_edges == N / 200 + 1);
+    CHECK(m.max == 6600 && m.min == 1000);
+
+    // Fractional period with noise: interpolation keeps the timing sub-sample accurate
+    pulses(s, 137.3, 50.2, 6, 0.0, 40);
+    CHECK(meas_capture(&s_cfg, s, N, &m, &scratch));
+    CHECK(m.flags & MEAS_HAVE_LEVELS);
+    CHECK_NEAR(m.top, 6000.0f, 15.0f);
+    CHECK_NEAR(m.base, 1000.0f, 15.0f);
+    CHECK_NEAR(m.period, 137.3f, 0.1f);
+    CHECK_NEAR(m.width_pos, 50.2f, 0.5f);
+    CHECK_NEAR(m.rise, 4.8f, 0.6f);
+
+    // Sine: no distinct top/base, so max/min; the frequency is still exact
+    for (size_t i = 0; i < N; i++)
+    {
+        s[i] = (sample_t)lround(4000 + 2500 * sin(2 * M_PI * i / 91.7));
+    }
+    meas_config_t sine_cfg = s_cfg;
+    sine_cfg.level = 4000;
+    CHECK(meas_capture(&sine_cfg, s, N, &m, &scratch));
+    CHECK(!(m.flags & MEAS_HAVE_LEVELS));
+    CHECK(m.top == m.max && m.base == m.min);
+    CHECK_NEAR(m.frequency_hz, 1e6f / 91.7f, 2.0f);
+    CHECK_NEAR(m.duty_pct, 50.0f, 0.5f);
+
+    // A single step: rise time but no period
+    for (size_t i = 0; i < N; i++)
+    {
+        s[i] = (sample_t)(i < 1000 ? 1000 : i < 1020 ? 1000 + (i - 1000) * 250 : 6000);
+    }
+    CHECK(meas_capture(&s_cfg, s, N, &m, &scratch));
+    CHECK((m.flags & MEAS_HAVE_RISE) && !(m.flags & (MEAS_HAVE_PERIOD | MEAS_HAVE_FALL)));
+    CHECK_NEAR(m.rise, 16.0f, 0.2f);
+
+    // Flat input: levels only
+    for (size_t i = 0; i < N; i++)
+    {
+        s[i] = 2000;
+    }
+    CHECK(meas_capture(&s_cfg, s, N, &m, &scratch));
+    CHECK(m.rising_edges == 0 && m.amplitude == 0.0f && !(m.flags & MEAS_HAVE_PERIOD));
+
+    meas_config_t bad = s_cfg;
+    bad.hysteresis = 0;
+    CHECK(!meas_capture(&bad, s, N, &m, &scratch));
+    free(s);
+    return TEST_RESULT();
+}
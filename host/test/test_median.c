@@ -0,0 +1,151 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "median.h"
+
+#define LEN 20000
+
+static sample_t s_in[LEN], s_out[LEN], s_ref[LEN], s_work[LEN];
+
+static int cmp_i32(const void *a, const void *b)
+{
+    return *(const int32_t *)a - *(const int32_t *)b;
+}
+
+// Input j, holding the first sample before the start as the filter does
+static sample_t at(long j)
+{
+    return s_in[j < 0 ? 0 : j];
+}
+
+// Brute-force median or Hampel over the last w inputs
+static void reference(const median_config_t *cfg, const median_t *m)
+{
+    const int w = cfg->window, c = w / 2;
+    for (long j = 0; j < LEN; j++)
+    {
+        int32_t win[MEDIAN_MAX_WINDOW], dev[MEDIAN_MAX_WINDOW];
+        for (int k = 0; k < w; k++)
+        {
+            win[k] = at(j - w + 1 + k);
+        }
+        qsort(win, w, sizeof(win[0]), cmp_i32);
+        int32_t med = win[c];
+        if (!cfg->hampel)
+        {
+            s_ref[j] = (sample_t)med;
+            continue;
+        }
+        for (int k = 0; k < w; k++)
+        {
+            dev[k] = abs(win[k] - med);
+        }
+        qsort(dev, w, sizeof(dev[0]), cmp_i32);
+        int32_t x = at(j - c);
+        uint32_t d = (uint32_t)abs(x - med);
+        s_ref[j] = (sample_t)(d > cfg->min_dev && d * 256 > m->thresh_q8 * (uint32_t)dev[c] ? med : x);
+    }
+}
+
+// Filter s_in in place in random chunks
+static void run_chunked(median_t *m)
+{
+    memcpy(s_work, s_in, sizeof(s_work));
+    for (size_t done = 0; done < LEN;)
+    {
+        size_t n = 1 + test_rand() % 300;
+        n = n < LEN - done ? n : LEN - done;
+        median_process(m, &s_work[done], &s_work[done], n);
+        done += n;
+    }
+}
+
+int main(void)
+{
+    median_t m;
+    median_config_t bad = {.window = 4};
+    CHECK(!median_init(&m, &bad));
+    bad.window = 17;
+    CHECK(!median_init(&m, &bad));
+    bad = (median_config_t){.window = 5, .hampel = true, .n_sigma = 0};
+    CHECK(!median_init(&m, &bad));
+
+    // Every window and both modes match brute force, in one call and in random in-place chunks. The
+    // input is coarse noise so the windows hold many ties.
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s_in[i] = (sample_t)(4000 + (int)(test_rand() % 64) * 3);
+    }
+    for (int hampel = 0; hampel <= 1; hampel++)
+    {
+        for (uint8_t w = 3; w <= MEDIAN_MAX_WINDOW; w += 2)
+        {
+            median_config_t cfg = {.window = w, .hampel = hampel, .n_sigma = 2.0f, .min_dev = 10};
+            CHECK(median_init(&m, &cfg));
+            median_process(&m, s_in, s_out, LEN);
+            reference(&cfg, &m);
+            CHECK(memcmp(s_out, s_ref, sizeof(s_out)) == 0);
+            CHECK(median_init(&m, &cfg));
+            run_chunked(&m);
+            CHECK(memcmp(s_work, s_ref, sizeof(s_work)) == 0);
+        }
+    }
+
+    // Hampel on a noisy sine with isolated glitches and a step: every glitch is removed, everything
+    // else passes bit-exact, delayed by median_delay()
+    median_config_t cfg = {.window = 7, .hampel = true, .n_sigma = 3.0f, .min_dev = 8};
+    const uint32_t delay = median_delay(&cfg);
+    CHECK(delay == 3);
+    int spikes = 0;
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s_in[i] = (sample_t)lrint(4000 + 500 * sin(2 * M_PI * i / 1000.0) + (int)(test_rand() % 9) - 4 +
+                                  (i >= LEN / 2 ? 1500 : 0));
+        s_ref[i] = s_in[i];
+        if (i % 97 == 50)
+        {
+            s_in[i] += (i & 1) ? 2000 : -2000;
+            spikes++;
+        }
+    }
+    CHECK(median_init(&m, &cfg));
+    median_process(&m, s_in, s_out, LEN);
+    CHECK(m.replaced >= (uint32_t)spikes);
+    int spikes_left = 0, clean_changed = 0;
+    for (size_t i = delay; i < LEN; i++)
+    {
+        size_t src = i - delay;
+        if (src % 97 == 50)
+        {
+            spikes_left += abs(s_out[i] - s_ref[src]) > 50;
+        }
+        else
+        {
+            clean_changed += s_out[i] != s_in[src];
+        }
+    }
+    CHECK(spikes_left == 0);
+    CHECK(clean_changed == 0);
+
+    // The plain median removes glitches too, but also reshapes the noise
+    cfg.hampel = false;
+    CHECK(median_init(&m, &cfg));
+    median_process(&m, s_in, s_out, LEN);
+    spikes_left = clean_changed = 0;
+    for (size_t i = delay; i < LEN; i++)
+    {
+        size_t src = i - delay;
+        spikes_left += src % 97 == 50 && abs(s_out[i] - s_ref[src]) > 50;
+        clean_changed += src % 97 != 50 && s_out[i] != s_in[src];
+    }
+    CHECK(spikes_left == 0);
+    CHECK(clean_changed > LEN / 4);
+    return TEST_RESULT();
+}
@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include "test_util.h"
+#include "nco.h"
+
+int main(void)
+{
+    // Table: Q15 sine, cosine a quarter turn on, nearest-entry indexing
+    const int16_t *tab = nco_table();
+    CHECK(tab[0] == 0 && tab[NCO_SIN_LEN / 4] == NCO_ONE && tab[3 * NCO_SIN_LEN / 4] == -NCO_ONE);
+    CHECK(tab[nco_cos_index(0)] == NCO_ONE);
+    CHECK(nco_index(0xffffffffu) == 0); // just below a full turn rounds to the first entry
+    CHECK(nco_index(1u << (32 - NCO_SIN_BITS)) == 1);
+    CHECK(nco_index((1u << (31 - NCO_SIN_BITS)) - 1) == 0 && nco_index(1u << (31 - NCO_SIN_BITS)) == 1);
+
+    // Phase step: fraction of a turn per sample, aliased into [0, 1)
+    CHECK(nco_phase_inc(250000, 1000000) == 0x40000000u);
+    CHECK(nco_phase_inc(1250000, 1000000) == 0x40000000u);
+    CHECK(nco_phase_inc(1000, 1000000) == (uint32_t)llround(4294967296.0 / 1000));
+
+    // CORDIC atan2 over the whole circle and a wide range of magnitudes
+    double worst = 0;
+    for (int k = 0; k < 3600; k++)
+    {
+        double a = (k - 1800) * M_PI / 1800;
+        for (double r = 3; r < 1e15; r *= 97)
+        {
+            int64_t x = llround(r * cos(a)), y = llround(r * sin(a));
+            double got = nco_atan2(y, x) * (2 * M_PI / 4294967296.0);
+            double want = atan2((double)y, (double)x);
+            double err = fabs(remainder(got - want, 2 * M_PI));
+            // Small vectors are quantized: allow their own rounding
+            double tol = 2e-6 * 2 * M_PI + (r < 1000 ? 1.0 / r : 0);
+            CHECK(err <= tol);
+            worst = r >= 1000 && err > worst ? err : worst;
+        }
+    }
+    CHECK(worst < 1e-5);
+    CHECK((uint32_t)nco_atan2(0, -5) - 0x80000000u + 64 < 128); // half a turn
+    return TEST_RESULT();
+}
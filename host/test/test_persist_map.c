@@ -0,0 +1,158 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "persist_map.h"
+
+#define W 64
+#define H 32
+#define N 200000
+
+static uint16_t s_bins[W * H];
+static uint16_t s_bins2[W * H];
+
+static void test_triggered(void)
+{
+    // Clean square wave, period 100: rising edge at i % 100 == 50
+    sample_t *in = malloc(N * sizeof(sample_t));
+    for (size_t i = 0; i < N; i++)
+    {
+        in[i] = (i % 100) < 50 ? 7000 : 1000;
+    }
+    persist_config_t cfg = {
+        .mode = PERSIST_TRIGGERED,
+        .width = 100 > W ? W : 100,
+        .height = H,
+        .amp_min = 0,
+        .amp_max = 8192,
+        .low = 3000,
+        .high = 5000,
+        .pre = 10,
+    };
+    persist_map_t map;
+    CHECK(persist_map_init(&map, &cfg, s_bins));
+    persist_map_accumulate(&map, in, N);
+    CHECK(map.traces == N / 100 - 1); // the first high run is not preceded by a rising edge
+
+    int low_row = 1000 * H / 8192, high_row = 7000 * H / 8192;
+    for (int x = 0; x < cfg.width; x++)
+    {
+        int row = x < cfg.pre || x >= cfg.pre + 50 ? low_row : high_row;
+        CHECK(s_bins[row * W + x] == map.traces);
+    }
+
+    // Same histogram when fed in random blocks
+    persist_map_t map2;
+    CHECK(persist_map_init(&map2, &cfg, s_bins2));
+    for (size_t i = 0; i < N;)
+    {
+        size_t len = 1 + test_rand() % 700;
+        len = len > N - i ? N - i : len;
+        persist_map_accumulate(&map2, in + i, len);
+        i += len;
+    }
+    CHECK(memcmp(s_bins, s_bins2, sizeof(s_bins)) == 0);
+
+    // Decay and export
+    uint16_t peak = persist_map_peak(&map);
+    persist_map_decay(&map, 1);
+    CHECK(persist_map_peak(&map) == peak - (peak + 1) / 2);
+    for (int i = 0; i < 40; i++)
+    {
+        persist_map_decay(&map, 2);
+    }
+    CHECK(persist_map_peak(&map) == 0);
+
+    uint8_t img[32 + W * H];
+    CHECK(persist_map_export_pgm(&map2, img, sizeof(img) - 1) == 0);
+    size_t len = persist_map_export_pgm(&map2, img, sizeof(img));
+    CHECK(len > (size_t)W * H && memcmp(img, "P5\n64 32\n255\n", 13) == 0);
+    // Highest amplitude is the top row of the image
+    const uint8_t *px = img + len - (size_t)W * H;
+    CHECK(px[(H - 1 - high_row) * W + cfg.pre] == 255);
+    CHECK(px[(H - 1 - low_row) * W + cfg.pre] == 0);
+    free(in);
+}
+
+// NRZ random bits with one-sample edges and amplitude noise; ui in samples
+static void nrz(sample_t *out, size_t n, double ui)
+{
+    size_t nbits = (size_t)(n / ui) + 2;
+    uint8_t *bits = malloc(nbits);
+    for (size_t k = 0; k < nbits; k++)
+    {
+        bits[k] = test_rand() & 1;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t k = (size_t)(i / ui);
+        double t = i - k * ui;
+        int b = bits[k], p = k ? bits[k - 1] : b;
+        double lvl = t < 1.0 ? p + (b - p) * t : b;
+        out[i] = (sample_t)(1000 + 6000 * lvl + (int)(test_rand() % 201) - 100);
+    }
+    free(bits);
+}
+
+static void test_clock(double true_ui, double nominal_ui)
+{
+    sample_t *in = malloc(N * sizeof(sample_t));
+    nrz(in, N, true_ui);
+    persist_config_t cfg = {
+        .mode = PERSIST_CLOCK,
+        .width = W,
+        .height = H,
+        .amp_min = 0,
+        .amp_max = 8192,
+        .low = 3000,
+        .high = 5000,
+        .ui_q16 = (uint32_t)(nominal_ui * 65536),
+        .span_ui = 2,
+    };
+    persist_map_t map;
+    CHECK(persist_map_init(&map, &cfg, s_bins));
+    persist_map_accumulate(&map, in, N / 2); // acquisition
+    CHECK_NEAR(map.ui_q16 / 65536.0, true_ui, true_ui * 0.005);
+    persist_map_clear(&map);
+    persist_map_accumulate(&map, in + N / 2, N / 2);
+    CHECK_NEAR(map.ui_q16 / 65536.0, true_ui, true_ui * 0.005);
+
+    // Eye open at the centre (phase 1 UI), crossings at 0.5 and 1.5 UI
+    int mid_row = 4000 * H / 8192;
+    uint32_t centre = 0, cross = 0;
+    for (int row = mid_row - 2; row <= mid_row + 2; row++)
+    {
+        for (int dx = -2; dx <= 2; dx++)
+        {
+            centre += s_bins[row * W + W / 2 + dx];
+            cross += s_bins[row * W + W / 4 + dx] + s_bins[row * W + 3 * W / 4 + dx];
+        }
+    }
+    CHECK(cross > 100);
+    CHECK(centre * 50 < cross);
+    free(in);
+}
+
+int main(void)
+{
+    test_triggered();
+    test_clock(8.68, 8.68);  // 115200 baud at 1 MSPS
+    test_clock(8.68, 8.5);   // 2% off nominal
+    test_clock(20.3, 21.0);
+
+    persist_map_t map;
+    persist_config_t bad = {.mode = PERSIST_CLOCK, .width = W, .height = H, .amp_min = 0, .amp_max = 100,
+                            .low = 10, .high = 20, .ui_q16 = 1 << 16, .span_ui = 1};
+    CHECK(!persist_map_init(&map, &bad, s_bins)); // under 2 samples per UI
+    bad.mode = PERSIST_TRIGGERED;
+    bad.pre = W;
+    CHECK(!persist_map_init(&map, &bad, s_bins));
+
+    return TEST_RESULT();
+}
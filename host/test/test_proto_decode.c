@@ -0,0 +1,327 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "proto_decode.h"
+
+#define RATE 1000000
+#define LOW_CODE 500
+#define HIGH_CODE 7000
+#define MAX_SAMPLES 200000
+#define MAX_FRAMES 64
+
+typedef struct
+{
+    proto_frame_t f[MAX_FRAMES];
+    int count;
+} frames_t;
+
+static void collect(void *ctx, const proto_frame_t *frame)
+{
+    frames_t *fr = ctx;
+    if (fr->count < MAX_FRAMES)
+    {
+        fr->f[fr->count++] = *frame;
+    }
+}
+
+// Logic waveform builder: levels with noise, finite edges and ringing near the thresholds
+typedef struct
+{
+    sample_t *buf;
+    size_t len;
+} wave_t;
+
+static void hold(wave_t *w, int level, size_t n)
+{
+    for (size_t i = 0; i < n && w->len < MAX_SAMPLES; i++)
+    {
+        int v = level ? HIGH_CODE : LOW_CODE;
+        w->buf[w->len++] = (sample_t)(v + (int)(test_rand() % 601) - 300);
+    }
+}
+
+// Decode the lines in random-sized blocks to exercise state carried across calls
+static void decode_blocks(const proto_config_t *cfg, sample_t *const *lines, size_t n, uint64_t pos, frames_t *out)
+{
+    proto_decoder_t dec;
+    CHECK(proto_decoder_init(&dec, cfg, collect, out));
+    size_t i = 0;
+    while (i < n)
+    {
+        size_t len = 1 + test_rand() % 300;
+        len = len > n - i ? n - i : len;
+        const sample_t *at[PROTO_MAX_LINES];
+        for (int l = 0; l < proto_num_lines(cfg); l++)
+        {
+            at[l] = lines[l] + i;
+        }
+        proto_decoder_process(&dec, at, len, pos + i);
+        i += len;
+    }
+}
+
+static void test_uart(void)
+{
+    const uint32_t baud = 115200;
+    const char *msg = "Hi\x00\xff";
+    const size_t msg_len = 4;
+    sample_t *rx = malloc(MAX_SAMPLES * sizeof(sample_t));
+    wave_t w = {rx, 0};
+    uint64_t starts[8];
+
+    // 8E1; bit edges are placed from the exact fractional bit time
+    hold(&w, 1, 100);
+    double spb = (double)RATE / baud;
+    for (size_t c = 0; c < msg_len; c++)
+    {
+        uint8_t ch = (uint8_t)msg[c];
+        int bits[11];
+        int parity = __builtin_popcount(ch) & 1;
+        bits[0] = 0;
+        for (int b = 0; b < 8; b++)
+        {
+            bits[1 + b] = (ch >> b) & 1;
+        }
+        bits[9] = parity;
+        bits[10] = 1;
+        starts[c] = w.len;
+        size_t base = w.len;
+        for (int b = 0; b < 11; b++)
+        {
+            size_t end = base + (size_t)((b + 1) * spb + 0.5);
+            hold(&w, bits[b], end - w.len);
+        }
+        hold(&w, 1, 7 * c); // varying idle gaps
+    }
+    // A framing error: stop bit driven low
+    starts[msg_len] = w.len;
+    size_t base = w.len;
+    for (int b = 0; b < 11; b++)
+    {
+        int v = b == 0 || b == 10 ? 0 : 1; // 0xff data, odd parity bit, stop low
+        size_t end = base + (size_t)((b + 1) * spb + 0.5);
+        hold(&w, v, end - w.len);
+    }
+    hold(&w, 1, 200);
+    // A 2-sample glitch is rejected as a start bit
+    hold(&w, 0, 2);
+    hold(&w, 1, 200);
+
+    proto_config_t cfg = {
+        .kind = PROTO_UART,
+        .low = 2500,
+        .high = 4500,
+        .sample_rate_hz = RATE,
+        .uart = {.baud = baud, .data_bits = 8, .parity = PROTO_PARITY_EVEN},
+    };
+    frames_t fr = {0};
+    sample_t *lines[] = {rx};
+    decode_blocks(&cfg, lines, w.len, 1000000, &fr);
+
+    CHECK(fr.count == (int)msg_len + 1);
+    for (size_t c = 0; c < msg_len && (int)c < fr.count; c++)
+    {
+        CHECK(fr.f[c].type == PROTO_EVT_DATA);
+        CHECK(fr.f[c].data == (uint8_t)msg[c]);
+        CHECK(fr.f[c].flags == 0);
+        // Timestamp within a sample of the start edge, end near the stop bit centre
+        CHECK_NEAR((int64_t)fr.f[c].start, (int64_t)(1000000 + starts[c]), 1);
+        CHECK_NEAR((int64_t)(fr.f[c].end - fr.f[c].start), (int64_t)(10.5 * spb), 2);
+    }
+    if (fr.count > (int)msg_len)
+    {
+        CHECK(fr.f[msg_len].data == 0xff);
+        CHECK(fr.f[msg_len].flags == (PROTO_FLAG_FRAMING_ERR | PROTO_FLAG_PARITY_ERR));
+    }
+
+    // One-shot capture decode gives the same frames
+    frames_t once = {0};
+    const sample_t *clines[] = {rx};
+    CHECK(proto_decode_capture(&cfg, clines, w.len, 1000000, collect, &once));
+    CHECK(once.count == fr.count && memcmp(once.f, fr.f, fr.count * sizeof(proto_frame_t)) == 0);
+    free(rx);
+}
+
+// Emit I2C bits as quarter-period phases so SDA only moves while SCL is low
+static void i2c_bit(wave_t *scl, wave_t *sda, int bit, size_t q)
+{
+    hold(scl, 0, q);
+    hold(sda, bit, q);
+    hold(scl, 1, 2 * q);
+    hold(sda, bit, 2 * q);
+    hold(scl, 0, q);
+    hold(sda, bit, q);
+}
+
+static void test_i2c(void)
+{
+    sample_t *c = malloc(MAX_SAMPLES * sizeof(sample_t));
+    sample_t *d = malloc(MAX_SAMPLES * sizeof(sample_t));
+    wave_t scl = {c, 0}, sda = {d, 0};
+    const size_t q = 3; // 100 kHz SCL is 10 samples per bit at 1 MSPS
+    const uint8_t bytes[] = {0xa0, 0x3c, 0x81};
+    const int acks[] = {1, 1, 0};
+
+    hold(&scl, 1, 50);
+    hold(&sda, 1, 50);
+    for (int rep = 0; rep < 2; rep++)
+    {
+        // Start: SDA falls while SCL is high
+        hold(&scl, 1, q);
+        hold(&sda, 0, q);
+        for (int b = 0; b < 3; b++)
+        {
+            for (int i = 7; i >= 0; i--)
+            {
+                i2c_bit(&scl, &sda, (bytes[b] >> i) & 1, q);
+            }
+            i2c_bit(&scl, &sda, !acks[b], q);
+        }
+        // Stop: SDA rises while SCL is high
+        hold(&scl, 0, q);
+        hold(&sda, 0, q);
+        hold(&scl, 1, q);
+        hold(&sda, 0, q);
+        hold(&scl, 1, 40);
+        hold(&sda, 1, 40);
+    }
+
+    proto_config_t cfg = {.kind = PROTO_I2C, .low = 2500, .high = 4500, .sample_rate_hz = RATE};
+    frames_t fr = {0};
+    sample_t *lines[] = {c, d};
+    decode_blocks(&cfg, lines, scl.len, 0, &fr);
+
+    CHECK(fr.count == 2 * 5);
+    for (int rep = 0; rep < 2 && fr.count == 10; rep++)
+    {
+        const proto_frame_t *f = &fr.f[rep * 5];
+        CHECK(f[0].type == PROTO_EVT_START);
+        for (int b = 0; b < 3; b++)
+        {
+            CHECK(f[1 + b].type == PROTO_EVT_DATA);
+            CHECK(f[1 + b].data == bytes[b]);
+            CHECK(!!(f[1 + b].flags & PROTO_FLAG_ACK) == acks[b]);
+            CHECK(!!(f[1 + b].flags & PROTO_FLAG_ADDRESS) == (b == 0));
+            CHECK(f[1 + b].start > f[0].start && f[1 + b].end > f[1 + b].start);
+        }
+        CHECK(f[4].type == PROTO_EVT_STOP);
+    }
+    free(c);
+    free(d);
+}
+
+static void test_spi(int mode)
+{
+    sample_t *lines_buf[4];
+    wave_t w[4];
+    for (int l = 0; l < 4; l++)
+    {
+        lines_buf[l] = malloc(MAX_SAMPLES * sizeof(sample_t));
+        w[l] = (wave_t){lines_buf[l], 0};
+    }
+    const int cpol = mode >> 1, cpha = mode & 1;
+    const uint16_t mosi_words[] = {0x5a, 0x01, 0xff};
+    const uint16_t miso_words[] = {0xc3, 0x80, 0x00};
+    const size_t half = 4;
+
+    // sclk, mosi, miso, cs; idle CS high with SCLK at CPOL
+    for (int l = 0; l < 4; l++)
+    {
+        hold(&w[l], l == 0 ? cpol : 1, 30);
+    }
+    // A partial word while deselected must not produce frames
+    for (int i = 0; i < 3; i++)
+    {
+        hold(&w[0], !cpol, half);
+        hold(&w[0], cpol, half);
+        hold(&w[1], 1, 2 * half);
+        hold(&w[2], 1, 2 * half);
+        hold(&w[3], 1, 2 * half);
+    }
+    for (int l = 0; l < 4; l++)
+    {
+        hold(&w[l], l == 0 ? cpol : l == 3 ? 0 : 1, 10);
+    }
+    for (int word = 0; word < 3; word++)
+    {
+        for (int i = 7; i >= 0; i--)
+        {
+            int mo = (mosi_words[word] >> i) & 1, mi = (miso_words[word] >> i) & 1;
+            // CPHA 0: data is set up before the leading edge; CPHA 1: on the leading edge
+            if (cpha == 0)
+            {
+                hold(&w[0], cpol, half);
+                hold(&w[0], !cpol, half);
+            }
+            else
+            {
+                hold(&w[0], !cpol, half);
+                hold(&w[0], cpol, half);
+            }
+            hold(&w[1], mo, 2 * half);
+            hold(&w[2], mi, 2 * half);
+            hold(&w[3], 0, 2 * half);
+        }
+        hold(&w[0], cpol, 6);
+        hold(&w[1], 1, 6);
+        hold(&w[2], 1, 6);
+        hold(&w[3], 0, 6);
+    }
+    for (int l = 0; l < 4; l++)
+    {
+        hold(&w[l], l == 0 ? cpol : 1, 30);
+    }
+
+    proto_config_t cfg = {
+        .kind = PROTO_SPI,
+        .low = 2500,
+        .high = 4500,
+        .sample_rate_hz = RATE,
+        .spi = {.mode = (uint8_t)mode, .word_bits = 8, .has_miso = true, .has_cs = true},
+    };
+    CHECK(proto_num_lines(&cfg) == 4);
+    frames_t fr = {0};
+    decode_blocks(&cfg, lines_buf, w[0].len, 0, &fr);
+    CHECK(fr.count == 3);
+    for (int i = 0; i < fr.count && i < 3; i++)
+    {
+        CHECK(fr.f[i].data == mosi_words[i]);
+        CHECK(fr.f[i].data2 == miso_words[i]);
+    }
+    for (int l = 0; l < 4; l++)
+    {
+        free(lines_buf[l]);
+    }
+}
+
+int main(void)
+{
+    test_uart();
+    test_i2c();
+    for (int mode = 0; mode < 4; mode++)
+    {
+        test_spi(mode);
+    }
+
+    // Invalid configurations
+    proto_decoder_t dec;
+    frames_t fr;
+    proto_config_t bad = {.kind = PROTO_UART, .low = 4500, .high = 2500, .sample_rate_hz = RATE,
+                          .uart = {.baud = 9600, .data_bits = 8}};
+    CHECK(!proto_decoder_init(&dec, &bad, collect, &fr));
+    bad.low = 2500;
+    bad.high = 4500;
+    bad.uart.baud = RATE;
+    CHECK(!proto_decoder_init(&dec, &bad, collect, &fr));
+    bad.kind = PROTO_SPI;
+    bad.spi.word_bits = 17;
+    CHECK(!proto_decoder_init(&dec, &bad, collect, &fr));
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,283 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "test_util.h"
+#include "relay.h"
+
+#define BLOCK_SAMPLES 4096 // 6688-byte blocks, 156 to a 1 MB chunk
+#define BLOCKS 3000        // wraps the 8-chunk ring more than twice
+#define DAMAGED_SEQ 50
+#define GARBAGE_AFTER 60
+#define LATE_JOIN_SEQ 500
+#define PAUSE_SEQ 1000 // the source waits here for the slow client to catch up by skipping
+#define MAX_LAG 200    // blocks a paced client may be behind the source
+
+typedef struct
+{
+    int fd;
+    pthread_t thread;
+    bool allow_gaps;
+    bool wait_for_pause;
+    int64_t pace_seq; // last block received, -1 while the source need not wait for this client
+    int64_t first_seq;
+    uint32_t blocks;
+    uint32_t errors;  // with pace_seq and eof, read by the source thread: atomic
+    bool eof;
+} test_client_t;
+
+static relay_t s_relay;
+static test_client_t s_fast[2], s_late, s_slow, s_stalled;
+static bool s_paused; // atomic
+
+static sample_t expected_sample(uint32_t seq, uint32_t i)
+{
+    return (sample_t)((seq * 31 + i * 7) & 0x1fff);
+}
+
+static int connect_local(int rcvbuf)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (rcvbuf > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(relay_port(&s_relay))};
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool send_all(int fd, const void *p, size_t n)
+{
+    const uint8_t *b = p;
+    while (n > 0)
+    {
+        ssize_t r = send(fd, b, n, MSG_NOSIGNAL);
+        if (r <= 0)
+        {
+            return false;
+        }
+        b += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+// Whole bytes or false, with eof set if the relay closed the connection
+static bool recv_all(int fd, void *p, size_t n, bool *eof)
+{
+    uint8_t *b = p;
+    while (n > 0)
+    {
+        ssize_t r = recv(fd, b, n, 0);
+        if (r <= 0)
+        {
+            __atomic_store_n(eof, r == 0, __ATOMIC_RELEASE);
+            return false;
+        }
+        b += r;
+        n -= (size_t)r;
+    }
+    return true;
+}
+
+// Reads blocks until the last one or the end of the connection, checking order and content
+static void *client_main(void *arg)
+{
+    test_client_t *c = arg;
+    uint8_t *buf = malloc(STREAM_HEADER_BYTES + 2 * BLOCK_SAMPLES);
+    sample_t *samples = malloc(BLOCK_SAMPLES * sizeof(sample_t));
+    while (c->wait_for_pause && !__atomic_load_n(&s_paused, __ATOMIC_ACQUIRE))
+    {
+        usleep(100);
+    }
+    int64_t last = -1;
+    while (last != BLOCKS - 1 && recv_all(c->fd, buf, STREAM_HEADER_BYTES, &c->eof))
+    {
+        stream_block_t blk;
+        if (stream_block_parse(buf, STREAM_HEADER_BYTES, &blk) != STREAM_NEED_MORE)
+        {
+            __atomic_fetch_add(&c->errors, 1, __ATOMIC_RELEASE);
+            break;
+        }
+        if (!recv_all(c->fd, buf + STREAM_HEADER_BYTES, blk.payload, &c->eof))
+        {
+            break; // a kicked client may stop in the middle of a block
+        }
+        stream_block_parse(buf, STREAM_HEADER_BYTES + blk.payload, &blk);
+        stream_block_decode(&blk, buf + STREAM_HEADER_BYTES, samples);
+        int64_t expect = last + 1 + (last + 1 == DAMAGED_SEQ);
+        bool in_order = last < 0 || blk.seq == expect || (c->allow_gaps && blk.seq > expect);
+        if (stream_block_parse(buf, STREAM_HEADER_BYTES + blk.payload, &blk) != STREAM_OK || blk.device != 7 ||
+            !in_order || samples[0] != expected_sample(blk.seq, 0) ||
+            samples[BLOCK_SAMPLES - 1] != expected_sample(blk.seq, BLOCK_SAMPLES - 1))
+        {
+            __atomic_fetch_add(&c->errors, 1, __ATOMIC_RELEASE);
+            break;
+        }
+        if (last < 0)
+        {
+            c->first_seq = blk.seq;
+        }
+        last = blk.seq;
+        c->blocks++;
+        if (!c->wait_for_pause || blk.seq > PAUSE_SEQ - 200)
+        {
+            __atomic_store_n(&c->pace_seq, last, __ATOMIC_RELEASE);
+        }
+    }
+    free(buf);
+    free(samples);
+    return NULL;
+}
+
+static void start_client(test_client_t *c, int rcvbuf, bool paced)
+{
+    c->fd = connect_local(rcvbuf);
+    c->pace_seq = paced ? 0 : -1;
+    c->first_seq = -1;
+    CHECK(c->fd >= 0);
+    pthread_create(&c->thread, NULL, client_main, c);
+}
+
+static void pace(const test_client_t *c, uint32_t seq)
+{
+    int64_t at;
+    while ((at = __atomic_load_n(&c->pace_seq, __ATOMIC_ACQUIRE)) >= 0 && at + MAX_LAG < seq &&
+           __atomic_load_n(&c->errors, __ATOMIC_ACQUIRE) == 0)
+    {
+        usleep(100);
+    }
+}
+
+// The device: every block once, except a damaged one, with junk after another
+static void *source_main(void *arg)
+{
+    int fd = *(int *)arg;
+    sample_t *samples = malloc(BLOCK_SAMPLES * sizeof(sample_t));
+    uint8_t *buf = malloc(STREAM_HEADER_BYTES + 2 * BLOCK_SAMPLES);
+    for (uint32_t seq = 0; seq < BLOCKS; seq++)
+    {
+        for (uint32_t i = 0; i < BLOCK_SAMPLES; i++)
+        {
+            samples[i] = expected_sample(seq, i);
+        }
+        stream_block_t blk = {.device = 7, .format = STREAM_FMT_PACK13, .seq = seq, .samples = BLOCK_SAMPLES};
+        size_t n = stream_block_encode(&blk, samples, buf);
+        if (seq == DAMAGED_SEQ)
+        {
+            buf[n - 1] ^= 1;
+        }
+        send_all(fd, buf, n);
+        if (seq == GARBAGE_AFTER)
+        {
+            send_all(fd, "ASjunk!", 7);
+        }
+        if (seq == LATE_JOIN_SEQ)
+        {
+            start_client(&s_late, 0, true);
+            __atomic_store_n(&s_late.pace_seq, seq, __ATOMIC_RELEASE);
+        }
+        if (seq == PAUSE_SEQ)
+        {
+            __atomic_store_n(&s_paused, true, __ATOMIC_RELEASE);
+            while (__atomic_load_n(&s_slow.pace_seq, __ATOMIC_ACQUIRE) < 0 &&
+                   __atomic_load_n(&s_slow.errors, __ATOMIC_ACQUIRE) == 0 &&
+                   !__atomic_load_n(&s_slow.eof, __ATOMIC_ACQUIRE))
+            {
+                usleep(100);
+            }
+        }
+        pace(&s_fast[0], seq);
+        pace(&s_fast[1], seq);
+        pace(&s_late, seq);
+        pace(&s_slow, seq);
+    }
+    free(samples);
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+int main(void)
+{
+    int pair[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+    relay_config_t bad = {.chunk_bytes = 4096};
+    CHECK(!relay_start(&s_relay, &bad, dup(pair[0])));
+    relay_config_t cfg = {.chunks = 8, .sndbuf = 64 << 10};
+    CHECK(relay_start(&s_relay, &cfg, pair[0]));
+    CHECK(relay_port(&s_relay) != 0);
+
+    // Two paced clients, one that reads only once the source pauses, and one that never reads
+    s_late.pace_seq = -1;
+    start_client(&s_fast[0], 0, true);
+    start_client(&s_fast[1], 0, true);
+    s_slow.wait_for_pause = true;
+    s_slow.allow_gaps = true;
+    start_client(&s_slow, 4096, false);
+    s_stalled.fd = connect_local(4096);
+    CHECK(s_stalled.fd >= 0);
+    relay_stats_t st = {0};
+    for (int t = 0; t < 5000 && st.clients < 4; t++)
+    {
+        usleep(1000);
+        relay_stats(&s_relay, &st);
+    }
+    CHECK(st.clients == 4);
+
+    pthread_t source;
+    pthread_create(&source, NULL, source_main, &pair[1]);
+    pthread_join(source, NULL);
+    pthread_join(s_fast[0].thread, NULL);
+    pthread_join(s_fast[1].thread, NULL);
+    pthread_join(s_late.thread, NULL);
+    pthread_join(s_slow.thread, NULL);
+    for (int t = 0; t < 5000 && !st.source_done; t++)
+    {
+        usleep(1000);
+        relay_stats(&s_relay, &st);
+    }
+    relay_stats(&s_relay, &st);
+    CHECK(st.source_done);
+    CHECK(st.blocks == BLOCKS - 1);
+    CHECK(st.bad_blocks == 1);
+    CHECK(st.skipped_bytes == 7 + STREAM_HEADER_BYTES + stream_payload_bytes(STREAM_FMT_PACK13, BLOCK_SAMPLES));
+    CHECK(st.connections == 5);
+    CHECK(st.kicked == 1); // the stalled client, caught in the middle of its first chunk
+    CHECK(st.dropped_chunks >= 4);
+
+    for (int i = 0; i < 2; i++)
+    {
+        CHECK(s_fast[i].errors == 0 && s_fast[i].first_seq == 0 && s_fast[i].blocks == BLOCKS - 1);
+    }
+    CHECK(s_late.errors == 0 && s_late.first_seq >= LATE_JOIN_SEQ);
+    CHECK(s_late.blocks == BLOCKS - s_late.first_seq);
+    CHECK(s_slow.errors == 0 && s_slow.first_seq == 0 && s_slow.pace_seq == BLOCKS - 1);
+    CHECK(s_slow.blocks < BLOCKS - 600); // skipped at least 4 chunks
+
+    // The stalled client's socket still holds the start of the stream although its ring slot has
+    // been reused several times since
+    relay_stop(&s_relay);
+    client_main(&s_stalled);
+    CHECK(s_stalled.errors == 0 && s_stalled.first_seq == 0 && s_stalled.blocks >= 1 && s_stalled.eof);
+    close(s_stalled.fd);
+    close(s_fast[0].fd);
+    close(s_fast[1].fd);
+    close(s_late.fd);
+    close(s_slow.fd);
+    return TEST_RESULT();
+}
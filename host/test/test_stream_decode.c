@@ -0,0 +1,136 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "stream_decode.h"
+
+#define MAX_N 3000
+
+static sample_t s_in[MAX_N], s_ref[MAX_N], s_out[MAX_N + 1]; // s_out has a guard after the longest run
+static uint8_t s_block[STREAM_HEADER_BYTES + 2 * MAX_N];
+
+// Unpacking against the portable decoder, at every length around the vector widths and at random
+// ones, with the payload at the very end of its allocation so over-reads would show under ASan
+static void check_unpack(void)
+{
+    for (uint8_t fmt = 0; fmt < STREAM_FMT_COUNT; fmt++)
+    {
+        const uint16_t mask = fmt == STREAM_FMT_PACK12 ? 0x0fff : fmt == STREAM_FMT_PACK13 ? 0x1fff : 0xffff;
+        bool same = true;
+        for (int t = 0; t < 200; t++)
+        {
+            uint32_t n = t < 80 ? (uint32_t)t + 1 : 1 + test_rand() % MAX_N;
+            for (uint32_t i = 0; i < n; i++)
+            {
+                s_in[i] = (sample_t)(test_rand() & mask);
+            }
+            stream_block_t blk = {.format = fmt, .samples = n};
+            stream_block_encode(&blk, s_in, s_block);
+            uint8_t *payload = malloc(blk.payload);
+            memcpy(payload, s_block + STREAM_HEADER_BYTES, blk.payload);
+            stream_block_decode(&blk, payload, s_ref);
+            s_out[n] = 0x5555;
+            same = same && stream_decode_unpack(fmt, payload, n, s_out) && s_out[n] == 0x5555 &&
+                   memcmp(s_out, s_ref, n * sizeof(sample_t)) == 0 && memcmp(s_out, s_in, n * sizeof(sample_t)) == 0;
+            free(payload);
+        }
+        CHECK(same);
+    }
+    CHECK(!stream_decode_unpack(STREAM_FMT_COUNT, s_block, 1, s_out));
+}
+
+// Running sums in random pieces, from plain and zigzag deltas of full-range samples
+static void check_delta(void)
+{
+    static int16_t delta[MAX_N];
+    static uint32_t zz[MAX_N];
+    for (int t = 0; t < 50; t++)
+    {
+        uint32_t n = 1 + test_rand() % MAX_N;
+        int32_t prev = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            s_in[i] = (sample_t)(t & 1 ? test_rand() : (test_rand() & 0x1fff));
+            int32_t d = s_in[i] - prev;
+            delta[i] = (int16_t)d;
+            zz[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31); // as capture_codec, up to 17 bits
+            prev = s_in[i];
+        }
+        int16_t p1 = 0, p2 = 0;
+        for (uint32_t i = 0; i < n;)
+        {
+            uint32_t k = 1 + test_rand() % 100;
+            k = k < n - i ? k : n - i;
+            stream_decode_delta(delta + i, k, &p1, s_out + i);
+            stream_decode_zigzag_delta(zz + i, k, &p2, s_ref + i);
+            i += k;
+        }
+        CHECK(memcmp(s_out, s_in, n * sizeof(sample_t)) == 0);
+        CHECK(memcmp(s_ref, s_in, n * sizeof(sample_t)) == 0);
+        CHECK(p1 == s_in[n - 1] && p2 == s_in[n - 1]);
+
+        // In place
+        int16_t p3 = 0;
+        stream_decode_delta(delta, n, &p3, delta);
+        CHECK(memcmp(delta, s_in, n * sizeof(sample_t)) == 0);
+    }
+}
+
+static void check_calibrate(void)
+{
+    static float out[MAX_N];
+    const float gain = 0.3176f, offset = -12.5f;
+    for (uint32_t n = 1; n < 100; n += 7)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            s_in[i] = (sample_t)test_rand();
+        }
+        stream_decode_calibrate(s_in, n, gain, offset, out);
+        float max_err = 0;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            float e = out[i] - (float)((double)s_in[i] * gain + offset);
+            max_err = e > max_err ? e : -e > max_err ? -e : max_err;
+        }
+        CHECK(max_err <= 2e-3f); // a few ulp of values up to 1e4
+    }
+
+    // A whole block, across several internal pieces, against unpack then calibrate
+    stream_block_t blk = {.format = STREAM_FMT_PACK13, .samples = 2500};
+    for (uint32_t i = 0; i < blk.samples; i++)
+    {
+        s_in[i] = (sample_t)(test_rand() & 0x1fff);
+    }
+    stream_block_encode(&blk, s_in, s_block);
+    static float ref[MAX_N];
+    stream_decode_block_float(&blk, s_block + STREAM_HEADER_BYTES, gain, offset, out);
+    stream_decode_calibrate(s_in, blk.samples, gain, offset, ref);
+    CHECK(memcmp(out, ref, blk.samples * sizeof(float)) == 0);
+}
+
+int main(void)
+{
+    CHECK(stream_decode_isa_supported(STREAM_DECODE_SCALAR));
+    CHECK(stream_decode_isa() == stream_decode_best_isa());
+    CHECK(!stream_decode_use_isa(STREAM_DECODE_ISA_COUNT));
+    for (int isa = 0; isa < STREAM_DECODE_ISA_COUNT; isa++)
+    {
+        if (!stream_decode_use_isa((stream_decode_isa_t)isa))
+        {
+            printf("  %s: not supported here\n", stream_decode_isa_name((stream_decode_isa_t)isa));
+            continue;
+        }
+        printf("  %s\n", stream_decode_isa_name((stream_decode_isa_t)isa));
+        CHECK(stream_decode_isa() == (stream_decode_isa_t)isa);
+        check_unpack();
+        check_delta();
+        check_calibrate();
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,202 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_util.h"
+#include "tile_cache.h"
+
+#define BLOCKS 300
+#define BLOCK 1000
+#define FIRST 12345           // position of the first sample
+#define GAP_BLOCK 200         // a 5000-sample hole in positions before this block
+#define GAP 5000
+#define END (FIRST + BLOCKS * BLOCK + GAP)
+
+static sample_t sample_at(uint64_t pos)
+{
+    // A slow wave with spikes, so min/max differ from tile to tile
+    uint32_t h = (uint32_t)(pos * 2654435761u);
+    return (sample_t)((int)(pos / 97 % 800) - 400 + (h % 1000 == 0 ? (int)(h >> 20) - 2048 : 0));
+}
+
+static bool in_gap(uint64_t pos)
+{
+    return pos >= FIRST + GAP_BLOCK * BLOCK && pos < FIRST + GAP_BLOCK * BLOCK + GAP;
+}
+
+static void write_capture(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    static sample_t samples[BLOCK];
+    static uint8_t buf[STREAM_HEADER_BYTES + 2 * BLOCK];
+    for (uint32_t seq = 0; seq < BLOCKS; seq++)
+    {
+        stream_block_t blk = {
+            .format = (uint8_t)(seq % STREAM_FMT_COUNT),
+            .seq = seq,
+            .samples = BLOCK,
+            .pos = FIRST + (uint64_t)seq * BLOCK + (seq >= GAP_BLOCK ? GAP : 0),
+        };
+        for (uint32_t i = 0; i < BLOCK; i++)
+        {
+            samples[i] = sample_at(blk.pos + i);
+            samples[i] = blk.format == STREAM_FMT_PACK12 ? (sample_t)(samples[i] & 0x0fff) : samples[i];
+            samples[i] = blk.format == STREAM_FMT_PACK13 ? (sample_t)(samples[i] & 0x1fff) : samples[i];
+        }
+        size_t n = stream_block_encode(&blk, samples, buf);
+        fwrite(buf, 1, n, f);
+        if (seq == 7)
+        {
+            fwrite("x", 1, 1, f); // later raw blocks land on odd addresses
+        }
+    }
+    fclose(f);
+}
+
+// Brute-force min/max of [a, b) from the capture itself
+static tile_t reference(const capture_file_t *cf, uint64_t a, uint64_t b)
+{
+    static sample_t buf[END];
+    tile_t t = {INT16_MAX, INT16_MIN};
+    for (uint64_t pos = a; pos < b;)
+    {
+        size_t got = capture_file_read(cf, pos, (size_t)(b - pos), buf);
+        for (size_t j = 0; j < got; j++)
+        {
+            t.min = buf[j] < t.min ? buf[j] : t.min;
+            t.max = buf[j] > t.max ? buf[j] : t.max;
+        }
+        pos += got ? got : 1;
+    }
+    return t;
+}
+
+static bool same_file(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    bool same = fa && fb;
+    int ca = 0, cb = 0;
+    while (same && ca != EOF)
+    {
+        ca = fgetc(fa);
+        cb = fgetc(fb);
+        same = ca == cb;
+    }
+    if (fa)
+    {
+        fclose(fa);
+    }
+    if (fb)
+    {
+        fclose(fb);
+    }
+    return same;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/test_tiles_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    write_capture(path);
+    char cache1[64], cache3[64];
+    snprintf(cache1, sizeof(cache1), "%s.1" TILE_CACHE_SUFFIX, path);
+    snprintf(cache3, sizeof(cache3), "%s.3" TILE_CACHE_SUFFIX, path);
+
+    capture_file_t cf;
+    CHECK(capture_file_open(&cf, path, true));
+    CHECK(cf.num_blocks == BLOCKS);
+    tile_cache_config_t cfg = {.threads = 1, .base_shift = 4, .level_shift = 2};
+    CHECK(tile_cache_build(&cf, cache1, &cfg));
+    cfg.threads = 3;
+    CHECK(tile_cache_build(&cf, cache3, &cfg));
+    CHECK(same_file(cache1, cache3));
+    cfg.threads = -1;
+    CHECK(!tile_cache_build(&cf, cache3, &cfg));
+
+    tile_cache_t tc;
+    CHECK(tile_cache_open(&tc, cache3, &cf));
+    CHECK(tc.hdr->first == FIRST && tc.hdr->end == END);
+    CHECK(tc.tiles[tc.hdr->levels - 1] == 1);
+    tile_t whole = reference(&cf, FIRST, END);
+    const tile_t *top = &tc.level[tc.hdr->levels - 1][0];
+    CHECK(top->min == whole.min && top->max == whole.max);
+
+    // Columns on tile edges are exact; others cover their samples and no more than a column beyond
+    static tile_t out[5000];
+    bool exact = true, bounded = true, gaps_empty = true;
+    for (int t = 0; t < 400; t++)
+    {
+        size_t columns = 1 + test_rand() % 2000;
+        uint64_t from, to;
+        if (t % 2 == 0)
+        {
+            const uint64_t w = 16u << (2 * (test_rand() % 4)); // a tile width of some level
+            from = FIRST + w * (test_rand() % 50);
+            to = from + w * columns * (1 + test_rand() % 3);
+        }
+        else
+        {
+            from = FIRST - 100 + test_rand() % (END - FIRST);
+            to = from + 1 + test_rand() % (END + 200 - from);
+        }
+        tile_cache_query(&tc, from, to, columns, out);
+        const uint64_t span = to - from;
+        for (size_t c = 0; c < columns; c++)
+        {
+            uint64_t a = from + span * c / columns, b = from + span * (c + 1) / columns;
+            tile_t ref = reference(&cf, a, b);
+            if (t % 2 == 0)
+            {
+                exact = exact && out[c].min == ref.min && out[c].max == ref.max;
+                continue;
+            }
+            uint64_t w = b - a;
+            tile_t wide = reference(&cf, a > w ? a - w : 0, b + w);
+            bounded = bounded && out[c].min <= ref.min && out[c].max >= ref.max && out[c].min >= wide.min &&
+                      out[c].max <= wide.max;
+            if (a < b && in_gap(a) && in_gap(b - 1) && w < 16)
+            {
+                gaps_empty = gaps_empty && out[c].min > out[c].max;
+            }
+        }
+    }
+    CHECK(exact);
+    CHECK(bounded);
+    CHECK(gaps_empty);
+    tile_cache_query(&tc, 0, FIRST, 10, out);
+    CHECK(out[0].min > out[0].max && out[9].min > out[9].max);
+    tile_cache_close(&tc);
+
+    // A cache of another capture is refused, as is a cut-off one
+    capture_file_t other = cf;
+    other.num_blocks--;
+    CHECK(!tile_cache_open(&tc, cache3, &other));
+    CHECK(truncate(cache3, 1000) == 0);
+    CHECK(!tile_cache_open(&tc, cache3, &cf));
+    CHECK(!tile_cache_open(&tc, "/nonexistent.tiles", &cf));
+    capture_file_close(&cf);
+
+    // An empty capture has an empty cache
+    FILE *f = fopen(path, "wb");
+    fclose(f);
+    CHECK(capture_file_open(&cf, path, true));
+    cfg.threads = 0;
+    CHECK(tile_cache_build(&cf, cache1, &cfg));
+    CHECK(tile_cache_open(&tc, cache1, &cf));
+    tile_cache_query(&tc, 0, 1000, 4, out);
+    CHECK(out[0].min > out[0].max);
+    tile_cache_close(&tc);
+    capture_file_close(&cf);
+
+    unlink(path);
+    unlink(cache1);
+    unlink(cache3);
+    return TEST_RESULT();
+}
@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include "test_util.h"
+#include "time_sync.h"
+
+#define RATE 1e6
+#define DEVICES 4
+
+// Simulated sample clock: ppm0 offset plus a slow thermal swing of ppm_amp, counter `phase` at t = 0
+typedef struct
+{
+    double ppm0, ppm_amp, ppm_period_s, phase;
+} sim_clock_t;
+
+static double uniform(double lo, double hi)
+{
+    return lo + (hi - lo) * (test_rand() / 4294967296.0);
+}
+
+static double sim_ppm(const sim_clock_t *c, double t)
+{
+    return c->ppm0 + c->ppm_amp * sin(2 * M_PI * t / c->ppm_period_s);
+}
+
+// Samples counted by true time t, fractional
+static double sim_cycles(const sim_clock_t *c, double t)
+{
+    double w = 2 * M_PI / c->ppm_period_s;
+    return c->phase + RATE * (t + 1e-6 * (c->ppm0 * t + c->ppm_amp / w * (1 - cos(w * t))));
+}
+
+// True time of sample n
+static double sim_time_of(const sim_clock_t *c, double n)
+{
+    double t = (n - c->phase) / RATE;
+    for (int i = 0; i < 3; i++)
+    {
+        t -= (sim_cycles(c, t) - n) / (RATE * (1 + 1e-6 * sim_ppm(c, t)));
+    }
+    return t;
+}
+
+static double exp_rand(double mean)
+{
+    return -mean * log((test_rand() + 1.0) / 4294967297.0);
+}
+
+// Shared 1 Hz pulse, edge found at the first sample at or after it. Devices line up to about a sample
+// of each other, and the fit follows the thermal drift.
+static void check_pulses(void)
+{
+    const double t0 = 0.5; // first pulse, common time 0
+    sim_clock_t clk[DEVICES];
+    tsync_t sync[DEVICES];
+    tsync_config_t cfg = {.nominal_hz = RATE, .window = 16, .max_residual_ns = 20000};
+    for (int d = 0; d < DEVICES; d++)
+    {
+        clk[d] = (sim_clock_t){uniform(-50, 50), uniform(1, 3), uniform(300, 900), uniform(0, 1e7)};
+        CHECK(tsync_init(&sync[d], &cfg));
+    }
+    double worst_align = 0, worst_abs = 0, worst_ppm = 0;
+    for (int k = 0; k < 300; k++)
+    {
+        double tp = t0 + k;
+        for (int d = 0; d < DEVICES; d++)
+        {
+            if (d == 1 && k % 37 == 5)
+            {
+                continue; // missed pulses must not shift the numbering
+            }
+            CHECK(tsync_add_pulse_periodic(&sync[d], (uint64_t)ceil(sim_cycles(&clk[d], tp)), 1000000000));
+        }
+        if (k < 20)
+        {
+            continue;
+        }
+        // Somewhere before the next pulse: each device's nearest sample, mapped to common time
+        double t = tp + uniform(0, 1);
+        double err[DEVICES];
+        for (int d = 0; d < DEVICES; d++)
+        {
+            uint64_t c = (uint64_t)llround(sim_cycles(&clk[d], t));
+            err[d] = tsync_to_ref(&sync[d], c) - (sim_time_of(&clk[d], (double)c) - t0) * 1e9;
+            worst_abs = fmax(worst_abs, fabs(err[d] + 500)); // the edge is found half a sample late on average
+            worst_ppm = fmax(worst_ppm, fabs(tsync_drift_ppm(&sync[d]) - sim_ppm(&clk[d], tp)));
+            CHECK(fabs(tsync_from_ref(&sync[d], tsync_to_ref(&sync[d], c)) - (double)c) < 0.01);
+        }
+        for (int d = 1; d < DEVICES; d++)
+        {
+            worst_align = fmax(worst_align, fabs(err[d] - err[0]));
+        }
+    }
+    CHECK(worst_align < 1500);
+    CHECK(worst_abs < 1000);
+    CHECK(worst_ppm < 0.5);
+    for (int d = 0; d < DEVICES; d++)
+    {
+        CHECK(sync[d].rejected == 0);
+    }
+}
+
+// Two-way exchanges over a loaded link: the round-trip filter keeps the error at a few us
+// although queuing adds 50 us on average in either direction
+static void check_exchanges(void)
+{
+    sim_clock_t clk = {37, 2, 600, 123456};
+    tsync_t sync;
+    tsync_config_t cfg = {.nominal_hz = RATE, .window = 32, .max_excess_ns = 20000, .max_residual_ns = 100000};
+    CHECK(tsync_init(&sync, &cfg));
+    double sq = 0, worst = 0;
+    int n = 0, accepted = 0;
+    for (int k = 0; k < 3000; k++)
+    {
+        double t1 = 1 + k * 0.1;
+        double t2 = t1 + 100e-6 + exp_rand(50e-6);
+        uint64_t c2 = (uint64_t)ceil(sim_cycles(&clk, t2));
+        uint64_t c3 = c2 + 500;
+        double t4 = sim_time_of(&clk, (double)c3) + 100e-6 + exp_rand(50e-6);
+        accepted += tsync_add_exchange(&sync, llround(t1 * 1e9), c2, c3, llround(t4 * 1e9));
+        if (k < 300)
+        {
+            continue;
+        }
+        uint64_t c = (uint64_t)llround(sim_cycles(&clk, t1 + uniform(0, 0.1)));
+        double err = tsync_to_ref(&sync, c) - sim_time_of(&clk, (double)c) * 1e9;
+        sq += err * err;
+        worst = fmax(worst, fabs(err));
+        n++;
+    }
+    CHECK(sqrt(sq / n) < 5000);
+    CHECK(worst < 20000);
+    CHECK(accepted > 100 && accepted < 2000);
+}
+
+// A single bad pulse is dropped; a lasting step of the master clock restarts the fit
+static void check_outliers(void)
+{
+    tsync_t sync;
+    tsync_config_t cfg = {.nominal_hz = RATE, .window = 8, .max_residual_ns = 5000};
+    CHECK(tsync_init(&sync, &cfg));
+    CHECK(!tsync_locked(&sync));
+    uint64_t c = 777;
+    for (int k = 0; k < 10; k++, c += 1000000)
+    {
+        CHECK(tsync_add_pulse(&sync, c, k * 1000000000ll));
+    }
+    CHECK(tsync_locked(&sync));
+    CHECK(fabs(tsync_drift_ppm(&sync)) < 1e-6);
+    CHECK(!tsync_add_pulse(&sync, c, 10 * 1000000000ll + 50000));
+    CHECK(tsync_add_pulse(&sync, c, 10 * 1000000000ll));
+    c += 1000000;
+    int dropped = 0;
+    for (int k = 11; k < 20; k++, c += 1000000)
+    {
+        dropped += !tsync_add_pulse(&sync, c, k * 1000000000ll + 3000000);
+    }
+    CHECK(dropped == 3);
+    CHECK(sync.restarts == 1);
+    CHECK(tsync_to_ref(&sync, c) == 20 * 1000000000ll + 3000000);
+
+    tsync_config_t bad = {.nominal_hz = RATE, .window = 1};
+    CHECK(!tsync_init(&sync, &bad));
+}
+
+int main(void)
+{
+    check_pulses();
+    check_exchanges();
+    check_outliers();
+    return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "test_util.h"
+#include "trend_compress.h"
+
+#define LEN 50000
+
+static trend_point_t s_in[LEN];
+static trend_point_t s_arch[LEN + 2];
+
+// Compress s_in, then check the archive: first and last input kept, gaps bounded, and every input
+// within tol of the reconstruction. Returns the number of archived points.
+static size_t run_and_verify(const trend_config_t *cfg)
+{
+    trend_t tr;
+    CHECK(trend_init(&tr, cfg));
+    size_t n = 0;
+    for (size_t i = 0; i < LEN; i++)
+    {
+        n += trend_push(&tr, s_in[i].t, s_in[i].v, &s_arch[n]);
+    }
+    n += trend_flush(&tr, &s_arch[n]);
+    CHECK(tr.archived == n);
+    CHECK(n >= 2 && s_arch[0].t == s_in[0].t && s_arch[n - 1].t == s_in[LEN - 1].t);
+    CHECK(s_arch[n - 1].v == s_in[LEN - 1].v);
+    int bad = 0;
+    size_t seg = 0;
+    for (size_t k = 1; k < n; k++)
+    {
+        bad += s_arch[k].t <= s_arch[k - 1].t || s_arch[k].t - s_arch[k - 1].t > cfg->max_gap;
+    }
+    for (size_t i = 0; i < LEN; i++)
+    {
+        while (seg + 1 < n - 1 && s_arch[seg + 1].t <= s_in[i].t)
+        {
+            seg++;
+        }
+        int32_t r = trend_value_at(cfg->mode, &s_arch[seg], &s_arch[seg + 1], s_in[i].t);
+        bad += abs(s_in[i].v - r) > cfg->tol;
+    }
+    CHECK(bad == 0);
+    return n;
+}
+
+int main(void)
+{
+    trend_t tr;
+    CHECK(!trend_init(&tr, &(trend_config_t){.mode = TREND_DEADBAND, .tol = -1, .max_gap = 100}));
+    CHECK(!trend_init(&tr, &(trend_config_t){.mode = TREND_SWINGING_DOOR, .tol = 1, .max_gap = 0}));
+
+    // A pure ramp is its two end points, plus one point per max_gap
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s_in[i] = (trend_point_t){1000 + i, (int32_t)(3 * i) - 20000};
+    }
+    CHECK(run_and_verify(&(trend_config_t){TREND_SWINGING_DOOR, 0, TREND_MAX_GAP}) == 2);
+    CHECK(run_and_verify(&(trend_config_t){TREND_SWINGING_DOOR, 0, 10000}) == 6);
+
+    // Slow drift, a step, a slow sine and noise at irregular times: the bound holds for every
+    // tolerance in both modes. Once the tolerance clears the noise the swinging door keeps far
+    // fewer points than the deadband.
+    uint64_t t = 0;
+    double walk = 0;
+    for (size_t i = 0; i < LEN; i++)
+    {
+        t += 1 + test_rand() % 3;
+        walk += ((int)(test_rand() % 201) - 100) / 50.0;
+        double v = 16 * (2000 + 300 * sin(i / 3000.0) + (i > LEN / 2 ? 400 : 0)) + walk + (int)(test_rand() % 17) - 8;
+        s_in[i] = (trend_point_t){t, (int32_t)lrint(v)};
+    }
+    static const int32_t tols[] = {0, 1, 8, 40, 300};
+    for (size_t k = 0; k < sizeof(tols) / sizeof(tols[0]); k++)
+    {
+        uint32_t gap = k % 2 ? 500 : TREND_MAX_GAP;
+        size_t dead = run_and_verify(&(trend_config_t){TREND_DEADBAND, tols[k], gap});
+        size_t door = run_and_verify(&(trend_config_t){TREND_SWINGING_DOOR, tols[k], gap});
+        CHECK(tols[k] < 40 || door < dead / 4);
+        if (tols[k] == 300)
+        {
+            CHECK(door < LEN / 100);
+        }
+    }
+
+    // Deadband reconstruction holds the archived value until the next point
+    trend_point_t a = {10, 5}, b = {20, 9};
+    CHECK(trend_value_at(TREND_DEADBAND, &a, &b, 19) == 5);
+    CHECK(trend_value_at(TREND_DEADBAND, &a, &b, 20) == 9);
+    CHECK(trend_value_at(TREND_SWINGING_DOOR, &a, &b, 15) == 7);
+    b.v = -9;
+    CHECK(trend_value_at(TREND_SWINGING_DOOR, &a, &b, 11) == 4); // 5 - 1.4
+    CHECK(trend_value_at(TREND_SWINGING_DOOR, &a, &b, 15) == -2);
+    return TEST_RESULT();
+}
@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "test_util.h"
+#include "trigger.h"
+
+#define N 100000
+
+int main(void)
+{
+    // Slow 1 kHz wave at 1 MSPS with +-60 codes of noise: every crossing is noisy.
+    // Rising crossings at 250 + 1000k, falling at 750 + 1000k.
+    sample_t *in = malloc(N * sizeof(sample_t));
+    for (size_t i = 0; i < N; i++)
+    {
+        in[i] = (sample_t)(4096 - 2000 * cos(2 * M_PI * i / 1000.0) + (int)(test_rand() % 121) - 60);
+    }
+
+    trigger_config_t cfg = {.edge = TRIGGER_RISING, .level = 4096, .hysteresis = 200, .pre = 100, .post = 300};
+    trigger_t trig;
+    CHECK(trigger_init(&trig, &cfg));
+
+    // Stream in odd block sizes; one trigger per period despite the noise
+    uint64_t hits[128];
+    int count = 0;
+    for (size_t i = 0; i < N;)
+    {
+        size_t len = 1 + test_rand() % 500;
+        len = len > N - i ? N - i : len;
+        trigger_scan(&trig, in + i, len, i);
+        i += len;
+        uint64_t at;
+        while (trigger_next_capture(&trig, i, &at))
+        {
+            CHECK(at + cfg.post <= i);
+            hits[count++ % 128] = at;
+        }
+    }
+    CHECK(count == N / 1000);
+    CHECK(trig.fired == N / 1000);
+    for (int k = 0; k < count && k < 128; k++)
+    {
+        CHECK_NEAR((int64_t)hits[k], (int64_t)(250 + 1000 * k), 5);
+    }
+
+    // Falling edge with a holdoff longer than the period: every other falling crossing
+    cfg.edge = TRIGGER_FALLING;
+    cfg.holdoff = 1500;
+    CHECK(trigger_init(&trig, &cfg));
+    uint64_t at = 0, prev = 0;
+    for (size_t i = 0; i < N; i += 1000)
+    {
+        trigger_scan(&trig, in + i, 1000, i);
+        while (trigger_next_capture(&trig, i + 1000, &at))
+        {
+            CHECK_NEAR((int64_t)(at % 1000), 750, 5);
+            if (prev)
+            {
+                CHECK_NEAR((int64_t)(at - prev), 2000, 10);
+            }
+            prev = at;
+        }
+    }
+    CHECK(trig.fired == (N / 1000) / 2);
+
+    // Queue overflow is counted, not overwritten
+    cfg.edge = TRIGGER_RISING;
+    cfg.holdoff = 0;
+    CHECK(trigger_init(&trig, &cfg));
+    trigger_scan(&trig, in, N, 0);
+    CHECK(trig.fired == TRIGGER_MAX_PENDING);
+    CHECK(trig.dropped == N / 1000 - TRIGGER_MAX_PENDING);
+    CHECK(trigger_next_capture(&trig, N, &at) && at == hits[0]);
+    trigger_reset(&trig);
+    CHECK(!trigger_next_capture(&trig, N, &at));
+
+    // Captures need pre samples of history
+    cfg.pre = 2000;
+    CHECK(trigger_init(&trig, &cfg));
+    trigger_scan(&trig, in, 2500, 0);
+    CHECK(trig.fired == 1);
+
+    cfg.hysteresis = 0;
+    CHECK(!trigger_init(&trig, &cfg));
+    cfg.hysteresis = 100;
+    cfg.level = INT16_MIN + 10;
+    CHECK(!trigger_init(&trig, &cfg));
+
+    free(in);
+    return TEST_RESULT();
+}
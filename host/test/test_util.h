@@ -0,0 +1,37 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+// Minimal check helpers for the host tests; each test binary returns non-zero on failure
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+static int s_test_failures = 0;
+
+#define CHECK(cond)                                                        \
+    do                                                                     \
+    {                                                                      \
+        if (!(cond))                                                       \
+        {                                                                  \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            s_test_failures++;                                             \
+        }                                                                  \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol) CHECK(((a) - (b)) <= (tol) && ((b) - (a)) <= (tol))
+
+#define TEST_RESULT() (s_test_failures == 0 ? (printf("PASS\n"), 0) : (printf("FAIL (%d)\n", s_test_failures), 1))
+
+// Deterministic xorshift so failures are reproducible
+static inline uint32_t test_rand(void)
+{
+    static uint32_t state = 0x12345678;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
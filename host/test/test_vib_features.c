@@ -0,0 +1,161 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_util.h"
+#include "vib_features.h"
+
+#define RATE 1000000
+#define WINDOW_SHIFT 16
+#define WINDOW (1u << WINDOW_SHIFT)
+#define WINDOWS 8
+#define LEN (WINDOW * WINDOWS)
+
+static sample_t s_in[LEN];
+static vib_features_t s_got[WINDOWS + 1], s_got2[WINDOWS + 1];
+static int s_count;
+
+static void collect(void *ctx, const vib_features_t *f)
+{
+    vib_features_t *out = ctx;
+    if (s_count <= WINDOWS)
+    {
+        out[s_count] = *f;
+    }
+    s_count++;
+}
+
+static double gauss(void)
+{
+    double u1 = (test_rand() + 1.0) / 4294967297.0, u2 = test_rand() / 4294967296.0;
+    return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// Two-pass double reference for one window
+static void reference(const sample_t *x, vib_features_t *f)
+{
+    double mean = 0, m2 = 0, m3 = 0, m4 = 0, lo = x[0], hi = x[0];
+    for (size_t i = 0; i < WINDOW; i++)
+    {
+        mean += x[i];
+    }
+    mean /= WINDOW;
+    for (size_t i = 0; i < WINDOW; i++)
+    {
+        double d = x[i] - mean;
+        m2 += d * d;
+        m3 += d * d * d;
+        m4 += d * d * d * d;
+        lo = fmin(lo, x[i]);
+        hi = fmax(hi, x[i]);
+    }
+    m2 /= WINDOW;
+    m3 /= WINDOW;
+    m4 /= WINDOW;
+    f->mean = (float)mean;
+    f->rms = (float)sqrt(m2);
+    f->peak = (float)fmax(hi - mean, mean - lo);
+    f->crest = f->peak / f->rms;
+    f->skewness = (float)(m3 / pow(m2, 1.5));
+    f->kurtosis = (float)(m4 / (m2 * m2));
+}
+
+static void check_against_reference(void)
+{
+    for (int w = 0; w < WINDOWS; w++)
+    {
+        vib_features_t ref;
+        reference(&s_in[w * WINDOW], &ref);
+        CHECK(s_got[w].pos == (uint64_t)w * WINDOW);
+        CHECK_NEAR(s_got[w].mean, ref.mean, 1e-3f);
+        CHECK_NEAR(s_got[w].rms, ref.rms, 1e-4f * ref.rms);
+        CHECK_NEAR(s_got[w].peak, ref.peak, 1e-3f);
+        CHECK_NEAR(s_got[w].crest, ref.crest, 1e-4f * ref.crest);
+        CHECK_NEAR(s_got[w].skewness, ref.skewness, 1e-4f);
+        CHECK_NEAR(s_got[w].kurtosis, ref.kurtosis, 1e-4f * ref.kurtosis);
+    }
+}
+
+int main(void)
+{
+    vib_t v;
+    vib_config_t cfg = {
+        .sample_rate_hz = RATE,
+        .window_shift = WINDOW_SHIFT,
+        .band_decim_shift = 4, // bands at 62.5 kHz
+        .num_bands = 3,
+        .bands = {{700, 1400}, {5000, 10000}, {20, 40}},
+    };
+    vib_config_t bad = cfg;
+    bad.bands[1].hi_hz = 40000; // above the band filters' Nyquist
+    CHECK(!vib_init(&v, &bad, NULL, NULL));
+    bad = cfg;
+    bad.band_decim_shift = WINDOW_SHIFT;
+    CHECK(!vib_init(&v, &bad, NULL, NULL));
+
+    // A 1 kHz tone: moments of a sine, all of its energy in the first band
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s_in[i] = (sample_t)lrint(4096 + 1000 * sin(2 * M_PI * 1000 * i / RATE) + gauss());
+    }
+    CHECK(vib_init(&v, &cfg, collect, s_got));
+    s_count = 0;
+    vib_process(&v, s_in, LEN, 0);
+    CHECK(s_count == WINDOWS);
+    check_against_reference();
+    const vib_features_t *f = &s_got[WINDOWS - 1];
+    CHECK_NEAR(f->rms, 1000 / sqrtf(2), 2.0f);
+    CHECK_NEAR(f->crest, sqrtf(2), 0.02f);
+    CHECK_NEAR(f->kurtosis, 1.5f, 0.02f);
+    CHECK_NEAR(f->skewness, 0.0f, 0.02f);
+    CHECK_NEAR(f->band_rms[0], 1000 / sqrtf(2), 0.03f * 1000 / sqrtf(2));
+    CHECK(f->band_rms[1] < 0.02f * f->band_rms[0]);
+    CHECK(f->band_rms[2] < 0.01f * f->band_rms[0]);
+
+    // Gaussian noise with one-sided impacts: kurtosis and crest rise, skew turns positive. Chunked
+    // input gives the same vectors as one call.
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s_in[i] = (sample_t)lrint(3000 + 50 * gauss() + (i % 5000 < 3 ? 1500 : 0));
+    }
+    CHECK(vib_init(&v, &cfg, collect, s_got));
+    s_count = 0;
+    vib_process(&v, s_in, LEN, 0);
+    check_against_reference();
+    f = &s_got[WINDOWS - 1];
+    CHECK(f->kurtosis > 20);
+    CHECK(f->skewness > 3);
+    CHECK(f->crest > 8);
+    CHECK(vib_init(&v, &cfg, collect, s_got2));
+    s_count = 0;
+    for (size_t done = 0; done < LEN;)
+    {
+        size_t m = 1 + test_rand() % 3000;
+        m = m < LEN - done ? m : LEN - done;
+        vib_process(&v, &s_in[done], m, done);
+        done += m;
+    }
+    CHECK(s_count == WINDOWS);
+    CHECK(memcmp(s_got, s_got2, WINDOWS * sizeof(s_got[0])) == 0);
+
+    // Plain Gaussian noise: kurtosis near 3; a reset drops the partial window
+    for (size_t i = 0; i < LEN; i++)
+    {
+        s_in[i] = (sample_t)lrint(4096 + 200 * gauss());
+    }
+    CHECK(vib_init(&v, &cfg, collect, s_got));
+    s_count = 0;
+    vib_process(&v, s_in, WINDOW / 2, 0);
+    vib_reset(&v);
+    vib_process(&v, s_in, LEN, 0);
+    CHECK(s_count == WINDOWS);
+    check_against_reference();
+    CHECK_NEAR(s_got[0].kurtosis, 3.0f, 0.1f);
+    CHECK_NEAR(s_got[0].rms, 200.0f, 3.0f);
+    return TEST_RESULT();
+}
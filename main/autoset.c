@@ -0,0 +1,132 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "autoset.h"
+
+#define CLIP_MARGIN 4      // codes from either end of the range count as clipped
+#define HEADROOM_PCT 110   // a range fits when full scale >= 110 % of the peak
+#define MIN_HYSTERESIS 8   // codes
+
+static float code_to_mv(const autoset_config_t *cfg, int range, float code)
+{
+    return (code - cfg->code_min) * cfg->range_full_scale_mv[range] / (float)(cfg->code_max - cfg->code_min);
+}
+
+// Window the capture around the trigger: periods_per_capture periods, decimated to fit
+static void choose_timebase(const autoset_config_t *cfg, autoset_result_t *out)
+{
+    uint32_t decimation = 1;
+    if (out->flags & AUTOSET_PERIODIC)
+    {
+        float span = out->meas.period * cfg->periods_per_capture;
+        while (decimation < cfg->max_decimation && span > (float)cfg->capture_len * decimation)
+        {
+            decimation *= 2;
+        }
+    }
+    else if (!(out->flags & AUTOSET_NO_SIGNAL))
+    {
+        // Edges but no full period in the burst: the signal is slow, use the longest window
+        decimation = cfg->max_decimation;
+    }
+    out->decimation = decimation;
+    uint32_t window = cfg->capture_len * decimation;
+    // Single events keep more of the window after the trigger
+    out->pre = (out->flags & AUTOSET_PERIODIC) ? window / 2 : window / 4;
+    out->post = window - out->pre;
+}
+
+bool autoset_analyze(const autoset_config_t *cfg, int current_range, const sample_t *s, size_t n,
+                     autoset_result_t *out, meas_scratch_t *scratch)
+{
+    memset(out, 0, sizeof(*out));
+    if (cfg->num_ranges < 1 || cfg->num_ranges > AUTOSET_MAX_RANGES || current_range < 0 ||
+        current_range >= cfg->num_ranges || cfg->code_max <= cfg->code_min || cfg->capture_len == 0 ||
+        cfg->max_decimation == 0 || (cfg->max_decimation & (cfg->max_decimation - 1)) || n < 4)
+    {
+        return false;
+    }
+    out->range = current_range;
+
+    // Only the top rail counts as clipping: 0 V sits at code_min for ordinary unipolar signals
+    int32_t mn = s[0], mx = s[0];
+    uint32_t rail = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        mn = s[i] < mn ? s[i] : mn;
+        mx = s[i] > mx ? s[i] : mx;
+        rail += s[i] >= cfg->code_max - CLIP_MARGIN;
+    }
+
+    // Clipped: step to the next less sensitive range and look again
+    if (rail > 0)
+    {
+        if (current_range + 1 < cfg->num_ranges)
+        {
+            out->range = current_range + 1;
+            out->flags |= AUTOSET_RETRY;
+            return true;
+        }
+        out->flags |= AUTOSET_CLIPPED;
+    }
+    else
+    {
+        // Unclipped, so the peak is known: go straight to the most sensitive range holding it
+        float peak_mv = code_to_mv(cfg, current_range, (float)mx);
+        int best = cfg->num_ranges - 1;
+        for (int r = cfg->num_ranges - 1; r >= 0; r--)
+        {
+            if (cfg->range_full_scale_mv[r] * 100 >= peak_mv * HEADROOM_PCT)
+            {
+                best = r;
+            }
+        }
+        if (best != current_range)
+        {
+            out->range = best;
+            out->flags |= AUTOSET_RETRY;
+            return true;
+        }
+    }
+
+    int32_t amplitude = mx - mn;
+    sample_t hyst = (sample_t)(amplitude / 10 > MIN_HYSTERESIS ? amplitude / 10 : MIN_HYSTERESIS);
+    meas_config_t mcfg = {
+        .level = (sample_t)((mn + mx + 1) / 2),
+        .hysteresis = hyst,
+        .hist_min = cfg->code_min,
+        .hist_shift = cfg->hist_shift,
+        .sample_rate_hz = cfg->sample_rate_hz,
+    };
+    if (amplitude < cfg->min_amplitude)
+    {
+        out->flags |= AUTOSET_NO_SIGNAL;
+        out->trigger_level = mcfg.level;
+        out->trigger_hysteresis = hyst;
+        out->dc_mv = code_to_mv(cfg, out->range, (mn + mx) * 0.5f);
+        choose_timebase(cfg, out);
+        return true;
+    }
+
+    // Trigger between the extremes: histogram top/base are unreliable for sparse samples of fast signals
+    meas_capture(&mcfg, s, n, &out->meas, scratch);
+    out->trigger_level = mcfg.level;
+    out->trigger_hysteresis = hyst;
+    out->dc_mv = code_to_mv(cfg, out->range, out->meas.mean);
+    out->amplitude_mv = out->meas.amplitude * cfg->range_full_scale_mv[out->range] / (float)(cfg->code_max - cfg->code_min);
+    if (out->meas.flags & MEAS_HAVE_PERIOD)
+    {
+        out->flags |= AUTOSET_PERIODIC;
+        out->frequency_hz = out->meas.frequency_hz;
+        if (out->meas.period < 4.0f)
+        {
+            out->flags |= AUTOSET_UNDERSAMPLED;
+        }
+    }
+    choose_timebase(cfg, out);
+    return true;
+}
@@ -0,0 +1,73 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Autoset: pick input range, trigger and timebase for an unknown signal
+ *
+ * autoset_analyze() looks at one short burst: a min/max pass, then the
+ * one-sweep measurements of measure.c. Time is linear in the burst length.
+ * A clipped burst steps one range up; an unclipped one knows its peak and
+ * jumps straight to the most sensitive range that holds it with 10 %
+ * headroom. Either way the result asks for another burst in the new range
+ * (AUTOSET_RETRY), and a full autoset takes at most num_ranges bursts.
+ *
+ * The trigger goes midway between min and max with 10 % of the swing as
+ * hysteresis. The capture window spans about periods_per_capture periods,
+ * with the smallest power-of-two decimation that fits it in capture_len
+ * samples.
+ */
+#pragma once
+
+#include "measure.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOSET_MAX_RANGES 8
+
+#define AUTOSET_RETRY 0x01       // take another burst in result.range
+#define AUTOSET_NO_SIGNAL 0x02   // amplitude below min_amplitude: DC level only
+#define AUTOSET_PERIODIC 0x04    // frequency measured
+#define AUTOSET_CLIPPED 0x08     // still clipped in the least sensitive range
+#define AUTOSET_UNDERSAMPLED 0x10 // under 4 samples per period, frequency unreliable
+
+typedef struct
+{
+    sample_t code_min; // ADC code range
+    sample_t code_max;
+    uint32_t sample_rate_hz;
+    int num_ranges;
+    int32_t range_full_scale_mv[AUTOSET_MAX_RANGES]; // ascending: most sensitive first
+    uint32_t capture_len;        // samples per capture after decimation
+    uint32_t max_decimation;     // power of 2
+    uint32_t periods_per_capture;
+    sample_t min_amplitude;      // codes; smaller swings count as no signal
+    uint8_t hist_shift;          // measurement histogram bin width, see measure.h
+} autoset_config_t;
+
+typedef struct
+{
+    uint32_t flags; // AUTOSET_*
+    int range;      // index into range_full_scale_mv
+    sample_t trigger_level;
+    sample_t trigger_hysteresis;
+    uint32_t pre;        // raw samples before the trigger
+    uint32_t post;       // raw samples from the trigger on
+    uint32_t decimation; // raw samples per capture sample
+    float dc_mv;
+    float amplitude_mv;
+    float frequency_hz;
+    meas_result_t meas;
+} autoset_result_t;
+
+// Analyze a burst of n samples taken in range current_range
+bool autoset_analyze(const autoset_config_t *cfg, int current_range, const sample_t *s, size_t n,
+                     autoset_result_t *out, meas_scratch_t *scratch);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,238 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "block_index.h"
+
+#define BLOCK_OFFSET_MASK ((uint64_t)BLOCK_INDEX_SAMPLES - 1)
+
+static void stats_reset(range_stats_t *s)
+{
+    s->count = 0;
+    s->min = INT16_MAX;
+    s->max = INT16_MIN;
+    s->sum = 0;
+    s->sum_sq = 0;
+}
+
+static void stats_add_raw(range_stats_t *s, const sample_ring_t *ring, uint64_t from, uint64_t to)
+{
+    for (uint64_t p = from; p < to; p++)
+    {
+        sample_t v = sample_ring_at(ring, p);
+        if (v < s->min)
+        {
+            s->min = v;
+        }
+        if (v > s->max)
+        {
+            s->max = v;
+        }
+        s->sum += v;
+        s->sum_sq += (uint64_t)((int32_t)v * v);
+    }
+    s->count += to - from;
+}
+
+static bool raw_match(sample_t v, sample_t threshold, block_search_dir_t dir)
+{
+    return dir == BLOCK_SEARCH_ABOVE ? v >= threshold : v <= threshold;
+}
+
+static bool find_raw(const sample_ring_t *ring, uint64_t from, uint64_t to,
+                     sample_t threshold, block_search_dir_t dir, uint64_t *out_pos)
+{
+    for (uint64_t p = from; p < to; p++)
+    {
+        if (raw_match(sample_ring_at(ring, p), threshold, dir))
+        {
+            *out_pos = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+void block_index_init(block_index_t *idx, const sample_ring_t *ring, block_summary_t *blocks)
+{
+    idx->ring = ring;
+    idx->blocks = blocks;
+    idx->block_mask = (sample_ring_capacity(ring) >> BLOCK_INDEX_SHIFT) - 1;
+    idx->first = (ring->head + BLOCK_OFFSET_MASK) & ~BLOCK_OFFSET_MASK;
+    idx->indexed = idx->first;
+}
+
+void block_index_commit(block_index_t *idx, uint64_t head)
+{
+    // Nothing older than the ring contents can be summarized
+    uint64_t oldest = head > sample_ring_capacity(idx->ring) ? head - sample_ring_capacity(idx->ring) : 0;
+    if (idx->indexed < oldest)
+    {
+        idx->indexed = oldest & ~BLOCK_OFFSET_MASK;
+    }
+
+    while (idx->indexed + BLOCK_INDEX_SAMPLES <= head)
+    {
+        // The block was just written, so this re-read is served from cache
+        const sample_t *p = &idx->ring->buf[idx->indexed & idx->ring->mask];
+        sample_t mn = p[0];
+        sample_t mx = p[0];
+        int32_t sum = 0;
+        uint64_t sum_sq = 0;
+        for (size_t i = 0; i < BLOCK_INDEX_SAMPLES; i++)
+        {
+            sample_t v = p[i];
+            mn = v < mn ? v : mn;
+            mx = v > mx ? v : mx;
+            sum += v;
+            sum_sq += (uint32_t)((int32_t)v * v);
+        }
+
+        block_summary_t *b = &idx->blocks[(idx->indexed >> BLOCK_INDEX_SHIFT) & idx->block_mask];
+        b->min = mn;
+        b->max = mx;
+        b->sum = sum;
+        b->sum_sq = sum_sq;
+        idx->indexed += BLOCK_INDEX_SAMPLES;
+    }
+}
+
+uint64_t block_index_oldest_valid(const block_index_t *idx, uint64_t head)
+{
+    size_t cap = sample_ring_capacity(idx->ring);
+    if (head <= cap)
+    {
+        return 0;
+    }
+    return head - cap + BLOCK_INDEX_SAMPLES;
+}
+
+// Clip [from, to) to the queryable window; false if empty
+static bool clip_range(const block_index_t *idx, uint64_t head, uint64_t *from, uint64_t *to)
+{
+    uint64_t lo = block_index_oldest_valid(idx, head);
+    if (*from < lo)
+    {
+        *from = lo;
+    }
+    if (*to > head)
+    {
+        *to = head;
+    }
+    return *from < *to;
+}
+
+// First summarized block boundary at or after from
+static uint64_t summary_start(const block_index_t *idx, uint64_t from)
+{
+    uint64_t p = (from + BLOCK_OFFSET_MASK) & ~BLOCK_OFFSET_MASK;
+    return p < idx->first ? idx->first : p;
+}
+
+bool block_index_range_stats(const block_index_t *idx, uint64_t head, uint64_t from, uint64_t to, range_stats_t *out)
+{
+    stats_reset(out);
+    if (!clip_range(idx, head, &from, &to))
+    {
+        return false;
+    }
+
+    // Summaries exist for whole blocks from idx->first up to the published head
+    uint64_t first_block = summary_start(idx, from);
+    uint64_t last_block = to & ~BLOCK_OFFSET_MASK;
+    if (first_block >= last_block)
+    {
+        stats_add_raw(out, idx->ring, from, to);
+        return true;
+    }
+
+    stats_add_raw(out, idx->ring, from, first_block);
+    for (uint64_t p = first_block; p < last_block; p += BLOCK_INDEX_SAMPLES)
+    {
+        const block_summary_t *b = &idx->blocks[(p >> BLOCK_INDEX_SHIFT) & idx->block_mask];
+        if (b->min < out->min)
+        {
+            out->min = b->min;
+        }
+        if (b->max > out->max)
+        {
+            out->max = b->max;
+        }
+        out->sum += b->sum;
+        out->sum_sq += b->sum_sq;
+    }
+    out->count += last_block - first_block;
+    stats_add_raw(out, idx->ring, last_block, to);
+    return true;
+}
+
+bool block_index_find(const block_index_t *idx, uint64_t head, uint64_t from, uint64_t to,
+                      sample_t threshold, block_search_dir_t dir, uint64_t *out_pos)
+{
+    if (!clip_range(idx, head, &from, &to))
+    {
+        return false;
+    }
+
+    uint64_t p = from;
+    uint64_t first_block = summary_start(idx, from);
+    if (first_block > to)
+    {
+        first_block = to;
+    }
+    if (find_raw(idx->ring, p, first_block, threshold, dir, out_pos))
+    {
+        return true;
+    }
+
+    p = first_block;
+    while (p + BLOCK_INDEX_SAMPLES <= to)
+    {
+        const block_summary_t *b = &idx->blocks[(p >> BLOCK_INDEX_SHIFT) & idx->block_mask];
+        bool may_match = dir == BLOCK_SEARCH_ABOVE ? b->max >= threshold : b->min <= threshold;
+        if (may_match)
+        {
+            // Summary guarantees a hit inside this block
+            return find_raw(idx->ring, p, p + BLOCK_INDEX_SAMPLES, threshold, dir, out_pos);
+        }
+        p += BLOCK_INDEX_SAMPLES;
+    }
+    return find_raw(idx->ring, p, to, threshold, dir, out_pos);
+}
+
+bool block_index_range_stats_raw(const sample_ring_t *ring, uint64_t from, uint64_t to, range_stats_t *out)
+{
+    stats_reset(out);
+    uint64_t oldest = sample_ring_oldest(ring);
+    if (from < oldest)
+    {
+        from = oldest;
+    }
+    if (to > ring->head)
+    {
+        to = ring->head;
+    }
+    if (from >= to)
+    {
+        return false;
+    }
+    stats_add_raw(out, ring, from, to);
+    return true;
+}
+
+bool block_index_find_raw(const sample_ring_t *ring, uint64_t from, uint64_t to,
+                          sample_t threshold, block_search_dir_t dir, uint64_t *out_pos)
+{
+    uint64_t oldest = sample_ring_oldest(ring);
+    if (from < oldest)
+    {
+        from = oldest;
+    }
+    if (to > ring->head)
+    {
+        to = ring->head;
+    }
+    return find_raw(ring, from, to, threshold, dir, out_pos);
+}
@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Block summary index kept alongside a sample ring.
+ *
+ * Every BLOCK_INDEX_SAMPLES-aligned block of the ring gets a min/max/sum/sum²
+ * summary once the block is complete. Range statistics then only touch raw
+ * samples at the two ragged ends of a range, and threshold searches skip every
+ * block whose min/max shows it cannot contain a match.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLOCK_INDEX_SHIFT 8
+#define BLOCK_INDEX_SAMPLES (1u << BLOCK_INDEX_SHIFT) // 256 samples per summary
+
+typedef struct
+{
+    sample_t min;
+    sample_t max;
+    int32_t sum;     // 256 * 32767 fits comfortably
+    uint64_t sum_sq;
+} block_summary_t;
+
+typedef struct
+{
+    const sample_ring_t *ring;
+    block_summary_t *blocks; // sample_ring_capacity / BLOCK_INDEX_SAMPLES entries
+    size_t block_mask;
+    uint64_t first;   // first summarized sample, fixed at init
+    uint64_t indexed; // absolute sample number up to which summaries are complete; producer only
+} block_index_t;
+
+typedef struct
+{
+    uint64_t count;
+    sample_t min;
+    sample_t max;
+    int64_t sum;
+    uint64_t sum_sq;
+} range_stats_t;
+
+typedef enum
+{
+    BLOCK_SEARCH_ABOVE, // first sample >= threshold
+    BLOCK_SEARCH_BELOW, // first sample <= threshold
+} block_search_dir_t;
+
+// blocks must hold sample_ring_capacity(ring) / BLOCK_INDEX_SAMPLES entries and
+// the ring capacity must be a multiple of BLOCK_INDEX_SAMPLES
+void block_index_init(block_index_t *idx, const sample_ring_t *ring, block_summary_t *blocks);
+
+// Summarize every block completed since the last call. Call from the producer
+// after the samples are in the ring and before publishing head.
+void block_index_commit(block_index_t *idx, uint64_t head);
+
+// Oldest absolute sample a query may safely touch for a given head. One block of
+// slack is kept so a producer refilling the oldest block does not race the query.
+uint64_t block_index_oldest_valid(const block_index_t *idx, uint64_t head);
+
+// Queries never read idx->indexed. They take the head the consumer snapshotted
+// under its lock and use summaries only for whole blocks below it, which the
+// commit-before-publish order guarantees are complete. The slot the producer
+// rewrites next aliases a block below block_index_oldest_valid(), so a query
+// racing at most one block of new samples never sees a half-written summary.
+
+// Statistics over [from, to). The range is clipped to what the ring still holds;
+// returns false if nothing remains.
+bool block_index_range_stats(const block_index_t *idx, uint64_t head, uint64_t from, uint64_t to, range_stats_t *out);
+
+// First sample in [from, to) on the requested side of threshold. Returns false
+// when no sample matches.
+bool block_index_find(const block_index_t *idx, uint64_t head, uint64_t from, uint64_t to,
+                      sample_t threshold, block_search_dir_t dir, uint64_t *out_pos);
+
+// Reference implementations that scan raw samples, for benchmarks and checks
+bool block_index_range_stats_raw(const sample_ring_t *ring, uint64_t from, uint64_t to, range_stats_t *out);
+bool block_index_find_raw(const sample_ring_t *ring, uint64_t from, uint64_t to,
+                          sample_t threshold, block_search_dir_t dir, uint64_t *out_pos);
+
+#ifdef __cplusplus
+}
+#endif
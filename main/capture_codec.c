@@ -0,0 +1,385 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "capture_codec.h"
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline int bit_width(uint32_t v)
+{
+    int w = 0;
+    while (v)
+    {
+        w++;
+        v >>= 1;
+    }
+    return w;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+size_t capture_codec_chunk_bound(size_t n)
+{
+    return CAPTURE_CODEC_CHUNK_BOUND(n); // width bytes, bits, per-group byte alignment
+}
+
+static inline int32_t clamp16(int32_t v)
+{
+    return v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+}
+
+// Residual of v against the reconstructed previous sample, quantized to steps of 2 * max_err + 1
+// so the reconstruction stays within max_err. prev moves to the reconstruction, as in the decoder.
+// recip is ceil(2^32 / step): |e| + max_err stays below 2^18, where the multiply divides exactly.
+static inline int32_t quantize(int32_t v, int32_t *prev, uint32_t max_err, int32_t step, uint64_t recip)
+{
+    int32_t e = v - *prev;
+    uint32_t mag = (uint32_t)(e >= 0 ? e : -e) + max_err;
+    int32_t q = (int32_t)((mag * recip) >> 32);
+    q = e >= 0 ? q : -q;
+    *prev = clamp16(*prev + q * step);
+    return q;
+}
+
+static size_t encode_chunk(const sample_t *in, size_t n, uint32_t max_err, uint8_t *out)
+{
+    uint8_t *p = out;
+    int32_t prev = 0;
+    uint32_t zz[CAPTURE_CODEC_GROUP];
+
+    for (size_t g = 0; g < n; g += CAPTURE_CODEC_GROUP)
+    {
+        size_t len = n - g < CAPTURE_CODEC_GROUP ? n - g : CAPTURE_CODEC_GROUP;
+        uint32_t all = 0;
+        if (max_err == 0)
+        {
+            for (size_t i = 0; i < len; i++)
+            {
+                int32_t v = in[g + i];
+                zz[i] = zigzag(v - prev);
+                all |= zz[i];
+                prev = v;
+            }
+        }
+        else
+        {
+            const int32_t step = 2 * (int32_t)max_err + 1;
+            const uint64_t recip = UINT32_MAX / (uint32_t)step + 1;
+            for (size_t i = 0; i < len; i++)
+            {
+                zz[i] = zigzag(quantize(in[g + i], &prev, max_err, step, recip));
+                all |= zz[i];
+            }
+        }
+
+        int w = bit_width(all);
+        *p++ = (uint8_t)w;
+        uint64_t acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < len && w > 0; i++)
+        {
+            acc |= (uint64_t)zz[i] << bits;
+            bits += w;
+            while (bits >= 8)
+            {
+                *p++ = (uint8_t)acc;
+                acc >>= 8;
+                bits -= 8;
+            }
+        }
+        if (bits > 0)
+        {
+            *p++ = (uint8_t)acc; // groups stay byte aligned
+        }
+    }
+    return (size_t)(p - out);
+}
+
+size_t capture_codec_chunk_encode(const sample_t *in, size_t n, uint8_t *out)
+{
+    return encode_chunk(in, n, 0, out);
+}
+
+size_t capture_codec_chunk_encode_bounded(const sample_t *in, size_t n, uint32_t max_err, uint8_t *out)
+{
+    return encode_chunk(in, n, max_err, out);
+}
+
+static bool decode_chunk(const uint8_t *in, size_t len, uint32_t max_err, sample_t *out, size_t n)
+{
+    const uint8_t *p = in;
+    const uint8_t *end = in + len;
+    const int32_t step = 2 * (int32_t)max_err + 1;
+    int32_t prev = 0;
+
+    for (size_t g = 0; g < n; g += CAPTURE_CODEC_GROUP)
+    {
+        size_t cnt = n - g < CAPTURE_CODEC_GROUP ? n - g : CAPTURE_CODEC_GROUP;
+        if (p >= end)
+        {
+            return false;
+        }
+        int w = *p++;
+        if (w > CAPTURE_CODEC_MAX_WIDTH || (size_t)(end - p) < (cnt * w + 7) / 8)
+        {
+            return false;
+        }
+
+        uint32_t mask = w ? (uint32_t)((1ull << w) - 1) : 0;
+        uint64_t acc = 0;
+        int bits = 0;
+        for (size_t i = 0; i < cnt; i++)
+        {
+            while (bits < w)
+            {
+                acc |= (uint64_t)*p++ << bits;
+                bits += 8;
+            }
+            uint32_t z = (uint32_t)acc & mask;
+            acc >>= w;
+            bits -= w;
+            prev = clamp16(prev + unzigzag(z) * step);
+            out[g + i] = (sample_t)prev;
+        }
+    }
+    return true;
+}
+
+bool capture_codec_chunk_decode(const uint8_t *in, size_t len, sample_t *out, size_t n)
+{
+    return decode_chunk(in, len, 0, out, n);
+}
+
+bool capture_codec_chunk_decode_bounded(const uint8_t *in, size_t len, uint32_t max_err, sample_t *out, size_t n)
+{
+    return max_err <= CAPTURE_CODEC_MAX_ERR && decode_chunk(in, len, max_err, out, n);
+}
+
+size_t capture_codec_bound(size_t n)
+{
+    return CAPTURE_CODEC_BOUND(n);
+}
+
+// One chunk of work in either direction
+typedef struct
+{
+    const sample_t *samples_in; // encode
+    sample_t *samples_out;      // decode
+    size_t n;
+    uint32_t max_err;
+    uint8_t *dst;               // encode
+    const uint8_t *src;         // decode
+    uint32_t size;
+    bool ok;
+} chunk_job_t;
+
+static void encode_unit(void *arg, int worker)
+{
+    (void)worker;
+    chunk_job_t *job = arg;
+    job->size = (uint32_t)encode_chunk(job->samples_in, job->n, job->max_err, job->dst);
+}
+
+static void decode_unit(void *arg, int worker)
+{
+    (void)worker;
+    chunk_job_t *job = arg;
+    job->ok = decode_chunk(job->src, job->size, job->max_err, job->samples_out, job->n);
+}
+
+// Run one unit per job, on the scheduler when there is one
+static void run_jobs(dsp_sched_t *sched, chunk_job_t *jobs, size_t count, dsp_task_fn_t fn)
+{
+    dsp_task_group_t group;
+    if (sched == NULL || sched->num_workers == 0 || !dsp_sched_group_init(&group))
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            fn(&jobs[i], 0);
+        }
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        dsp_sched_group_submit(sched, &group, (int)i, fn, &jobs[i]);
+    }
+    dsp_sched_group_wait(sched, &group);
+    dsp_sched_group_deinit(&group);
+}
+
+// ACZ1 without max_err, ACZ2 with it after the common header
+static size_t compress(dsp_sched_t *sched, const sample_t *in, size_t n, uint32_t max_err, bool bounded, uint8_t *out,
+                       size_t out_cap)
+{
+    if (out_cap < capture_codec_bound(n) || n > UINT32_MAX || max_err > CAPTURE_CODEC_MAX_ERR)
+    {
+        return 0;
+    }
+    const size_t header = bounded ? CAPTURE_CODEC_BOUNDED_HEADER_BYTES : CAPTURE_CODEC_HEADER_BYTES;
+    size_t chunks = (n + CAPTURE_CODEC_CHUNK_SAMPLES - 1) / CAPTURE_CODEC_CHUNK_SAMPLES;
+    chunk_job_t *jobs = calloc(chunks ? chunks : 1, sizeof(chunk_job_t));
+    if (jobs == NULL)
+    {
+        return 0;
+    }
+
+    // Every chunk codes into its own worst-case slot, then slots are compacted
+    uint8_t *data = out + header + (chunks + 1) * 4;
+    size_t slot = capture_codec_chunk_bound(CAPTURE_CODEC_CHUNK_SAMPLES);
+    for (size_t c = 0; c < chunks; c++)
+    {
+        size_t start = c * CAPTURE_CODEC_CHUNK_SAMPLES;
+        jobs[c].samples_in = in + start;
+        jobs[c].n = n - start < CAPTURE_CODEC_CHUNK_SAMPLES ? n - start : CAPTURE_CODEC_CHUNK_SAMPLES;
+        jobs[c].max_err = max_err;
+        jobs[c].dst = data + c * slot;
+    }
+    run_jobs(sched, jobs, chunks, encode_unit);
+
+    put_u32(out, bounded ? CAPTURE_CODEC_MAGIC_BOUNDED : CAPTURE_CODEC_MAGIC);
+    put_u32(out + 4, (uint32_t)n);
+    put_u32(out + 8, CAPTURE_CODEC_CHUNK_SAMPLES);
+    put_u32(out + 12, (uint32_t)chunks);
+    if (bounded)
+    {
+        put_u32(out + CAPTURE_CODEC_HEADER_BYTES, max_err);
+    }
+    uint8_t *index = out + header;
+    size_t cursor = 0;
+    for (size_t c = 0; c < chunks; c++)
+    {
+        // The cursor never passes the slot start, so this is a safe forward move
+        memmove(data + cursor, jobs[c].dst, jobs[c].size);
+        put_u32(index + c * 4, (uint32_t)cursor);
+        cursor += jobs[c].size;
+    }
+    put_u32(index + chunks * 4, (uint32_t)cursor);
+    free(jobs);
+    return (size_t)(data - out) + cursor;
+}
+
+size_t capture_codec_compress(dsp_sched_t *sched, const sample_t *in, size_t n, uint8_t *out, size_t out_cap)
+{
+    return compress(sched, in, n, 0, false, out, out_cap);
+}
+
+size_t capture_codec_compress_bounded(dsp_sched_t *sched, const sample_t *in, size_t n, uint32_t max_err, uint8_t *out,
+                                      size_t out_cap)
+{
+    return compress(sched, in, n, max_err, true, out, out_cap);
+}
+
+// Header size and max_err of a container, or 0 if the magic is unknown
+static size_t parse_header(const uint8_t *in, size_t len, uint32_t *max_err)
+{
+    if (len < CAPTURE_CODEC_HEADER_BYTES)
+    {
+        return 0;
+    }
+    uint32_t magic = get_u32(in);
+    if (magic == CAPTURE_CODEC_MAGIC)
+    {
+        *max_err = 0;
+        return CAPTURE_CODEC_HEADER_BYTES;
+    }
+    if (magic == CAPTURE_CODEC_MAGIC_BOUNDED && len >= CAPTURE_CODEC_BOUNDED_HEADER_BYTES)
+    {
+        *max_err = get_u32(in + CAPTURE_CODEC_HEADER_BYTES);
+        return *max_err <= CAPTURE_CODEC_MAX_ERR ? CAPTURE_CODEC_BOUNDED_HEADER_BYTES : 0;
+    }
+    return 0;
+}
+
+bool capture_codec_info(const uint8_t *in, size_t len, size_t *num_samples)
+{
+    uint32_t max_err;
+    size_t header = parse_header(in, len, &max_err);
+    if (header == 0)
+    {
+        return false;
+    }
+    uint32_t n = get_u32(in + 4);
+    uint32_t chunk = get_u32(in + 8);
+    uint32_t chunks = get_u32(in + 12);
+    if (chunk == 0 || chunks != (n + (uint64_t)chunk - 1) / chunk || len < header + ((size_t)chunks + 1) * 4)
+    {
+        return false;
+    }
+    *num_samples = n;
+    return true;
+}
+
+uint32_t capture_codec_max_err(const uint8_t *in, size_t len)
+{
+    uint32_t max_err = 0;
+    parse_header(in, len, &max_err);
+    return max_err;
+}
+
+bool capture_codec_decompress(dsp_sched_t *sched, const uint8_t *in, size_t len, sample_t *out, size_t out_cap)
+{
+    size_t n;
+    if (!capture_codec_info(in, len, &n) || out_cap < n)
+    {
+        return false;
+    }
+    uint32_t max_err = 0;
+    size_t header = parse_header(in, len, &max_err);
+    size_t chunk = get_u32(in + 8);
+    size_t chunks = get_u32(in + 12);
+    const uint8_t *index = in + header;
+    const uint8_t *data = index + (chunks + 1) * 4;
+    size_t data_len = len - (size_t)(data - in);
+
+    chunk_job_t *jobs = calloc(chunks ? chunks : 1, sizeof(chunk_job_t));
+    if (jobs == NULL)
+    {
+        return false;
+    }
+    bool ok = true;
+    for (size_t c = 0; c < chunks && ok; c++)
+    {
+        uint32_t from = get_u32(index + c * 4);
+        uint32_t to = get_u32(index + (c + 1) * 4);
+        ok = from <= to && to <= data_len;
+        jobs[c].samples_out = out + c * chunk;
+        jobs[c].n = n - c * chunk < chunk ? n - c * chunk : chunk;
+        jobs[c].max_err = max_err;
+        jobs[c].src = data + from;
+        jobs[c].size = to - from;
+    }
+    if (ok)
+    {
+        run_jobs(sched, jobs, chunks, decode_unit);
+        for (size_t c = 0; c < chunks; c++)
+        {
+            ok = ok && jobs[c].ok;
+        }
+    }
+    free(jobs);
+    return ok;
+}
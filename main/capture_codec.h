@@ -0,0 +1,89 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Chunked codec for capture exports, lossless or with bounded error
+ *
+ * A capture is cut into CAPTURE_CODEC_CHUNK_SAMPLES chunks that are coded
+ * independently: sample deltas, zigzag mapped, then bit-packed in groups of 32
+ * with one width byte per group. The container starts with a chunk index, so
+ * chunks can be compressed on every core and later decompressed in parallel
+ * or individually (random access into long captures).
+ *
+ * The bounded mode is near-lossless: each delta is taken against the
+ * previous reconstructed sample and quantized to steps of 2 * max_err + 1,
+ * so every decoded sample is within max_err LSB of the original. The noise
+ * in the deltas shrinks by the step, saving about log2(step) bits per
+ * sample. max_err 0 codes exactly as the lossless mode. It applies to
+ * capture containers only; no stream block format carries it.
+ *
+ * Container layout, little endian:
+ *   u32 magic "ACZ1" (lossless) or "ACZ2" (bounded), u32 total samples,
+ *   u32 chunk samples, u32 chunk count, ACZ2 only: u32 max_err,
+ *   u32 offsets[chunk count + 1] relative to the end of the index, chunk data.
+ */
+#pragma once
+
+#include "sample_ring.h"
+#include "dsp_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CAPTURE_CODEC_MAGIC 0x315a4341u // "ACZ1"
+#define CAPTURE_CODEC_CHUNK_SAMPLES 4096
+#define CAPTURE_CODEC_GROUP 32
+#define CAPTURE_CODEC_HEADER_BYTES 16
+#define CAPTURE_CODEC_MAGIC_BOUNDED 0x325a4341u // "ACZ2"
+#define CAPTURE_CODEC_BOUNDED_HEADER_BYTES 20
+#define CAPTURE_CODEC_MAX_ERR 1024 // LSB
+#define CAPTURE_CODEC_MAX_WIDTH 17 // bits of the zigzag of a full-range int16 delta
+
+// Compile-time forms of the bounds below, for static buffers
+#define CAPTURE_CODEC_CHUNKS(n) (((n) + CAPTURE_CODEC_CHUNK_SAMPLES - 1) / CAPTURE_CODEC_CHUNK_SAMPLES)
+#define CAPTURE_CODEC_CHUNK_BOUND(n) \
+    (2 * (((n) + CAPTURE_CODEC_GROUP - 1) / CAPTURE_CODEC_GROUP) + ((n) * CAPTURE_CODEC_MAX_WIDTH + 7) / 8)
+#define CAPTURE_CODEC_BOUND(n) \
+    (CAPTURE_CODEC_BOUNDED_HEADER_BYTES + (CAPTURE_CODEC_CHUNKS(n) + 1) * 4 + \
+     CAPTURE_CODEC_CHUNKS(n) * CAPTURE_CODEC_CHUNK_BOUND(CAPTURE_CODEC_CHUNK_SAMPLES))
+
+// Worst-case size of one coded chunk of n samples
+size_t capture_codec_chunk_bound(size_t n);
+
+// Code one chunk; out must hold capture_codec_chunk_bound(n). Returns bytes written.
+size_t capture_codec_chunk_encode(const sample_t *in, size_t n, uint8_t *out);
+
+// Decode exactly n samples; false if the data is truncated or malformed
+bool capture_codec_chunk_decode(const uint8_t *in, size_t len, sample_t *out, size_t n);
+
+// Bounded-error versions of the chunk coder; max_err up to CAPTURE_CODEC_MAX_ERR
+size_t capture_codec_chunk_encode_bounded(const sample_t *in, size_t n, uint32_t max_err, uint8_t *out);
+bool capture_codec_chunk_decode_bounded(const uint8_t *in, size_t len, uint32_t max_err, sample_t *out, size_t n);
+
+// Worst-case container size for n samples, either mode
+size_t capture_codec_bound(size_t n);
+
+// Compress into a container. out_cap must be at least capture_codec_bound(n).
+// sched may be NULL for single-threaded compression. Returns bytes written, 0 on error.
+size_t capture_codec_compress(dsp_sched_t *sched, const sample_t *in, size_t n, uint8_t *out, size_t out_cap);
+
+// Compress with every sample within max_err LSB (an ACZ2 container)
+size_t capture_codec_compress_bounded(dsp_sched_t *sched, const sample_t *in, size_t n, uint32_t max_err, uint8_t *out,
+                                      size_t out_cap);
+
+// Read the sample count of a container; false if the header is invalid
+bool capture_codec_info(const uint8_t *in, size_t len, size_t *num_samples);
+
+// Error bound of a container in LSB, 0 for lossless ones
+uint32_t capture_codec_max_err(const uint8_t *in, size_t len);
+
+// Decompress a whole container of either kind (sched may be NULL). out_cap is in samples.
+bool capture_codec_decompress(dsp_sched_t *sched, const uint8_t *in, size_t len, sample_t *out, size_t out_cap);
+
+#ifdef __cplusplus
+}
+#endif
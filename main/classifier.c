@@ -0,0 +1,237 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include "classifier.h"
+
+#define IN_STEPS_PER_SIGMA 32 // +/-4 standard deviations span the int8 inputs
+
+static int8_t sat8(int32_t v)
+{
+    return (int8_t)(v > 127 ? 127 : v < -127 ? -127 : v);
+}
+
+static void standardize(const float *x, int n, const float *mean, const float *std, float *z)
+{
+    for (int i = 0; i < n; i++)
+    {
+        z[i] = (x[i] - mean[i]) / std[i];
+    }
+}
+
+// Float forward pass from standardized inputs; act[l] receives layer l's outputs
+static void forward_float(const cls_float_layer_t *layers, int num_layers, const float *z,
+                          float act[CLS_MAX_LAYERS][CLS_MAX_WIDTH])
+{
+    const float *in = z;
+    for (int l = 0; l < num_layers; l++)
+    {
+        const cls_float_layer_t *ly = &layers[l];
+        for (int o = 0; o < ly->outputs; o++)
+        {
+            float acc = ly->b[o];
+            for (int i = 0; i < ly->inputs; i++)
+            {
+                acc += ly->w[o * ly->inputs + i] * in[i];
+            }
+            act[l][o] = ly->relu && acc < 0 ? 0 : acc;
+        }
+        in = act[l];
+    }
+}
+
+static int argmax_f(const float *v, int n)
+{
+    int best = 0;
+    for (int i = 1; i < n; i++)
+    {
+        best = v[i] > v[best] ? i : best;
+    }
+    return best;
+}
+
+int cls_predict_float(const cls_float_layer_t *layers, int num_layers, const float *in_mean, const float *in_std,
+                      const float *x)
+{
+    float z[CLS_MAX_INPUTS];
+    float act[CLS_MAX_LAYERS][CLS_MAX_WIDTH];
+    standardize(x, layers[0].inputs, in_mean, in_std, z);
+    forward_float(layers, num_layers, z, act);
+    return argmax_f(act[num_layers - 1], layers[num_layers - 1].outputs);
+}
+
+bool cls_quantize(cls_model_t *m, const cls_float_layer_t *layers, int num_layers, const float *in_mean,
+                  const float *in_std, const float *calib, size_t n_calib)
+{
+    memset(m, 0, sizeof(*m));
+    if (num_layers < 1 || num_layers > CLS_MAX_LAYERS || layers[0].inputs > CLS_MAX_INPUTS || n_calib == 0)
+    {
+        return false;
+    }
+    for (int l = 0; l < num_layers; l++)
+    {
+        if (layers[l].inputs < 1 || layers[l].outputs < 1 || layers[l].inputs > CLS_MAX_WIDTH ||
+            layers[l].outputs > CLS_MAX_WIDTH || (l > 0 && layers[l].inputs != layers[l - 1].outputs))
+        {
+            return false;
+        }
+    }
+    const int n_in = layers[0].inputs;
+    for (int i = 0; i < n_in; i++)
+    {
+        if (!(in_std[i] > 0))
+        {
+            return false;
+        }
+        m->in_mean[i] = in_mean[i];
+        m->in_scale[i] = IN_STEPS_PER_SIGMA / in_std[i];
+    }
+
+    // Activation ranges over the calibration set
+    float act_max[CLS_MAX_LAYERS] = {0};
+    for (size_t k = 0; k < n_calib; k++)
+    {
+        float z[CLS_MAX_INPUTS];
+        float act[CLS_MAX_LAYERS][CLS_MAX_WIDTH];
+        standardize(&calib[k * n_in], n_in, in_mean, in_std, z);
+        forward_float(layers, num_layers, z, act);
+        for (int l = 0; l < num_layers; l++)
+        {
+            for (int o = 0; o < layers[l].outputs; o++)
+            {
+                act_max[l] = fmaxf(act_max[l], fabsf(act[l][o]));
+            }
+        }
+    }
+
+    float in_scale = 1.0f / IN_STEPS_PER_SIGMA; // real value of one int8 step at this layer's input
+    for (int l = 0; l < num_layers; l++)
+    {
+        const cls_float_layer_t *fl = &layers[l];
+        cls_layer_t *ql = &m->layers[l];
+        ql->inputs = fl->inputs;
+        ql->outputs = fl->outputs;
+        ql->relu = fl->relu;
+        float w_max = 0;
+        for (int k = 0; k < fl->inputs * fl->outputs; k++)
+        {
+            w_max = fmaxf(w_max, fabsf(fl->w[k]));
+        }
+        float w_scale = w_max > 0 ? w_max / 127 : 1;
+        for (int k = 0; k < fl->inputs * fl->outputs; k++)
+        {
+            ql->w[k] = sat8((int32_t)lrintf(fl->w[k] / w_scale));
+        }
+        float acc_scale = w_scale * in_scale;
+        for (int o = 0; o < fl->outputs; o++)
+        {
+            ql->bias[o] = (int32_t)lrint(fl->b[o] / acc_scale);
+        }
+        if (l == num_layers - 1)
+        {
+            break; // the argmax reads the accumulators directly
+        }
+        float out_scale = act_max[l] > 0 ? act_max[l] / 127 : 1;
+        int e;
+        double frac = frexp((double)acc_scale / out_scale, &e); // ratio = frac * 2^e, frac in [0.5, 1)
+        ql->mult = (int32_t)lrint(frac * 2147483648.0);
+        if (ql->mult == INT32_MIN) // frac rounded up to 1
+        {
+            ql->mult = 1 << 30;
+            e++;
+        }
+        if (e > 30 || e < -30)
+        {
+            return false;
+        }
+        ql->shift = (int8_t)-e;
+        in_scale = out_scale;
+    }
+    m->num_inputs = (uint8_t)n_in;
+    m->num_layers = (uint8_t)num_layers;
+    m->num_classes = layers[num_layers - 1].outputs;
+    return true;
+}
+
+int cls_predict(const cls_model_t *m, const float *x, int32_t *logits)
+{
+    int8_t buf[2][CLS_MAX_WIDTH];
+    int32_t acc[CLS_MAX_WIDTH];
+    for (int i = 0; i < m->num_inputs; i++)
+    {
+        buf[0][i] = sat8((int32_t)lrintf((x[i] - m->in_mean[i]) * m->in_scale[i]));
+    }
+    int cur = 0;
+    for (int l = 0; l < m->num_layers; l++)
+    {
+        const cls_layer_t *ly = &m->layers[l];
+        const int8_t *in = buf[cur];
+        for (int o = 0; o < ly->outputs; o++)
+        {
+            const int8_t *w = &ly->w[o * ly->inputs];
+            int32_t a = ly->bias[o];
+            for (int i = 0; i < ly->inputs; i++)
+            {
+                a += (int32_t)w[i] * in[i];
+            }
+            acc[o] = a;
+        }
+        if (l == m->num_layers - 1)
+        {
+            break;
+        }
+        const int s = 31 + ly->shift;
+        for (int o = 0; o < ly->outputs; o++)
+        {
+            int32_t q = (int32_t)(((int64_t)acc[o] * ly->mult + ((int64_t)1 << (s - 1))) >> s);
+            buf[cur ^ 1][o] = sat8(ly->relu && q < 0 ? 0 : q);
+        }
+        cur ^= 1;
+    }
+    int best = 0;
+    for (int o = 1; o < m->num_classes; o++)
+    {
+        best = acc[o] > acc[best] ? o : best;
+    }
+    if (logits)
+    {
+        memcpy(logits, acc, m->num_classes * sizeof(acc[0]));
+    }
+    return best;
+}
+
+void cls_tracker_init(cls_tracker_t *t, uint8_t confirm)
+{
+    memset(t, 0, sizeof(*t));
+    t->confirm = confirm ? confirm : 1;
+    t->current = -1;
+    t->candidate = -1;
+}
+
+bool cls_tracker_update(cls_tracker_t *t, int cls)
+{
+    if (cls == t->current)
+    {
+        t->streak = 0;
+        t->candidate = -1;
+        return false;
+    }
+    if (cls != t->candidate)
+    {
+        t->candidate = cls;
+        t->streak = 0;
+    }
+    if (++t->streak < t->confirm)
+    {
+        return false;
+    }
+    t->current = cls;
+    t->candidate = -1;
+    t->streak = 0;
+    t->changes++;
+    return true;
+}
@@ -0,0 +1,96 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Quantized MLP classifier for feature vectors
+ *
+ * A small multilayer perceptron trained off-line in float is quantized once
+ * with cls_quantize(), on the host or at start-up: symmetric int8 weights
+ * per layer, int32 biases, and int8 activations whose scales come from a
+ * calibration set. Inference is then integer only: int8 x int8 dot products
+ * into int32, a Q31 multiplier and shift back to int8 between layers, ReLU
+ * on hidden layers, and an argmax over the last layer's int32 outputs.
+ *
+ * Inputs are standardized with the training mean and standard deviation
+ * before quantization, mapping +/-4 standard deviations onto the int8 range.
+ *
+ * cls_tracker_t turns per-window predictions into state changes: a new
+ * class is only reported after it wins `confirm` windows in a row.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CLS_MAX_INPUTS 16
+#define CLS_MAX_WIDTH 32 // widest layer, inputs included
+#define CLS_MAX_LAYERS 4
+
+// Float layer as trained: out[o] = act(b[o] + sum_i w[o * inputs + i] * in[i])
+typedef struct
+{
+    uint8_t inputs;
+    uint8_t outputs;
+    bool relu; // hidden layers; the last layer is linear
+    const float *w;
+    const float *b;
+} cls_float_layer_t;
+
+typedef struct
+{
+    uint8_t inputs;
+    uint8_t outputs;
+    bool relu;
+    int8_t w[CLS_MAX_WIDTH * CLS_MAX_WIDTH]; // [outputs][inputs]
+    int32_t bias[CLS_MAX_WIDTH];             // in units of the accumulator
+    int32_t mult;                            // accumulator to next layer's int8, Q31
+    int8_t shift;                            // applied after mult, positive to the right
+} cls_layer_t;
+
+typedef struct
+{
+    uint8_t num_inputs;
+    uint8_t num_layers;
+    uint8_t num_classes;
+    float in_mean[CLS_MAX_INPUTS];
+    float in_scale[CLS_MAX_INPUTS]; // int8 steps per unit of input
+    cls_layer_t layers[CLS_MAX_LAYERS];
+} cls_model_t;
+
+// Quantize a float MLP; in_mean/in_std standardize the inputs, calib holds n_calib input vectors
+// (num_inputs floats each) for the activation ranges
+bool cls_quantize(cls_model_t *m, const cls_float_layer_t *layers, int num_layers, const float *in_mean,
+                  const float *in_std, const float *calib, size_t n_calib);
+
+// Integer inference; returns the class and, if logits is not NULL, the last layer's accumulators
+int cls_predict(const cls_model_t *m, const float *x, int32_t *logits);
+
+// Float inference of the unquantized model, with the same input standardization, for comparison
+int cls_predict_float(const cls_float_layer_t *layers, int num_layers, const float *in_mean, const float *in_std,
+                      const float *x);
+
+typedef struct
+{
+    uint8_t confirm;   // consecutive windows a new class must win
+    int current;       // reported class, -1 until the first one is confirmed
+    int candidate;
+    uint8_t streak;
+    uint32_t changes;
+} cls_tracker_t;
+
+void cls_tracker_init(cls_tracker_t *t, uint8_t confirm);
+
+// Feed one prediction; returns true when the reported class changes
+bool cls_tracker_update(cls_tracker_t *t, int cls);
+
+#ifdef __cplusplus
+}
+#endif
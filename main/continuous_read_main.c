@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <math.h>
 #include "sdkconfig.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
@@ -38,14 +39,51 @@
 #include "esp_adc/adc_continuous.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
+#include "soc/soc_caps.h"
+#if SOC_DAC_SUPPORTED
+#include "driver/dac_oneshot.h"
+#include "driver/gptimer.h"
+#include "hal/dac_ll.h"
+#endif
+#include "esp_timer.h"
+#include "sample_ring.h"
+#include "block_index.h"
+#include "math_channel.h"
+#include "dsp_graph.h"
+#include "capture_codec.h"
+#include "proto_decode.h"
+#include "persist_map.h"
+#include "trigger.h"
+#include "mask_test.h"
+#include "measure.h"
+#include "autoset.h"
+#include "fresp.h"
+#include "lockin.h"
+#include "ddc.h"
+#include "lms.h"
+#include "median.h"
+#include "vib_features.h"
+#include "classifier.h"
+#include "trend_compress.h"
+#include "time_sync.h"
 
 #define EXAMPLE_ADC_UNIT ADC_UNIT_1
 #define _EXAMPLE_ADC_UNIT_STR(unit) #unit
 #define EXAMPLE_ADC_UNIT_STR(unit) _EXAMPLE_ADC_UNIT_STR(unit)
 #define EXAMPLE_ADC_CONV_MODE ADC_CONV_SINGLE_UNIT_1
-#define EXAMPLE_ADC_ATTEN ADC_ATTEN_DB_0
 #define EXAMPLE_ADC_BIT_WIDTH SOC_ADC_DIGI_MAX_BITWIDTH
 
+// Raw code scale from the continuous-mode bit width (12 bits on current targets)
+#define ADC_CODE_FULL_SCALE (1 << EXAMPLE_ADC_BIT_WIDTH)
+#define ADC_CODE_MID (ADC_CODE_FULL_SCALE / 2)
+#if EXAMPLE_ADC_BIT_WIDTH == 13
+#define ADC_CODE_MID_STR "4096" // for math expressions
+#elif EXAMPLE_ADC_BIT_WIDTH == 12
+#define ADC_CODE_MID_STR "2048"
+#else
+#error "unexpected ADC bit width"
+#endif
+
 #if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
 #define EXAMPLE_ADC_OUTPUT_TYPE ADC_DIGI_OUTPUT_FORMAT_TYPE1
 #define EXAMPLE_ADC_GET_CHANNEL(p_data) ((p_data)->type1.channel)
@@ -64,15 +102,366 @@
 #define CIRC_BUF_MASK (CIRC_BUF_SAMPLES - 1)
 #define SAMPLE_FREQ_HZ 1000000 // 1 MHz as per README specifications - optimized critical sections enable this rate
 
-static adc_channel_t channel[1] = {ADC_CHANNEL_6}; // Changed to channel 6 as per your log
+// Sampled channels; each gets its own ring of CHANNEL_RING_SAMPLES (A, B, ... in math expressions)
+#define ADC_CHANNEL_COUNT 1
+#define CHANNEL_RING_SAMPLES (CIRC_BUF_SAMPLES / ADC_CHANNEL_COUNT)
+#define CHANNEL_RING_MASK (CHANNEL_RING_SAMPLES - 1)
+static adc_channel_t channel[ADC_CHANNEL_COUNT] = {ADC_CHANNEL_6}; // Changed to channel 6 as per your log
+
+// Derived channels evaluated per 256-sample block, e.g. "A-B", "A*0.5+100", "abs(A-2048)", "A*B/4096"
+#define MATH_RING_SAMPLES 8192
+static const char *s_math_exprs[] = {
+    "abs(A-" ADC_CODE_MID_STR ")", // rectified signal around mid-scale
+};
+#define MATH_CHANNEL_COUNT (sizeof(s_math_exprs) / sizeof(s_math_exprs[0]))
+
+// Serial decoder on the sampled channels (lines in the order of proto_decode.h), PROTO_NONE to disable
+#define PROTO_DECODER PROTO_NONE
+#define PROTO_LOGIC_LOW (ADC_CODE_FULL_SCALE * 5 / 16)  // raw code, a high line goes low at or below this
+#define PROTO_LOGIC_HIGH (ADC_CODE_FULL_SCALE * 9 / 16) // raw code, a low line goes high at or above this
+#define PROTO_UART_BAUD 115200
+#define PROTO_LOG_FRAMES 32 // decoded frames buffered for the processing task
+
+// Persistence map / eye diagram of channel A (PERSIST_CLOCK folds at PROTO_UART_BAUD)
+#define PERSIST_ENABLE 1
+#define PERSIST_MODE PERSIST_TRIGGERED
+#define PERSIST_WIDTH 128
+#define PERSIST_HEIGHT 64
+#define PERSIST_PRE 16
+#define PERSIST_DECAY_BLOCKS 4096 // fade by half about every second at 1 MSPS
+
+// Edge trigger on channel A; a capture is [trigger - TRIGGER_PRE, trigger + TRIGGER_POST)
+#define TRIGGER_EDGE TRIGGER_RISING
+#define TRIGGER_LEVEL ADC_CODE_MID
+#define TRIGGER_HYSTERESIS 200
+#define TRIGGER_PRE 256
+#define TRIGGER_POST 768
+#define CAPTURE_SAMPLES (TRIGGER_PRE + TRIGGER_POST)
+
+// Mask test of every capture; the first capture is the golden reference unless the
+// envelope is filled in before the graph starts
+#define MASK_ENABLE 1
+#define MASK_TOL_CODES 200    // vertical margin around the reference
+#define MASK_SLACK_SAMPLES 2  // horizontal margin (edge jitter)
+#define MASK_SAVE_SLOTS 4     // failing captures kept, newest overwrite oldest
+
+// Automatic measurements on every capture, reported with the capture metadata
+#define MEAS_ENABLE 1
+
+// Input ranges: attenuation and the target's recommended full scale, most sensitive first.
+// The driver starts in range 0; autoset switches range at runtime.
+static const adc_atten_t s_range_atten[] = {ADC_ATTEN_DB_0, ADC_ATTEN_DB_2_5, ADC_ATTEN_DB_6, ADC_ATTEN_DB_12};
+#if CONFIG_IDF_TARGET_ESP32
+static const int32_t s_range_fs_mv[] = {950, 1250, 1750, 2450};
+#elif CONFIG_IDF_TARGET_ESP32S2 || CONFIG_IDF_TARGET_ESP32C3
+static const int32_t s_range_fs_mv[] = {750, 1050, 1300, 2500};
+#elif CONFIG_IDF_TARGET_ESP32S3
+static const int32_t s_range_fs_mv[] = {950, 1250, 1750, 3100};
+#else
+#error "add the recommended input ranges of this target"
+#endif
+#define RANGE_COUNT (sizeof(s_range_atten) / sizeof(s_range_atten[0]))
+
+// Autoset at boot: range, trigger and timebase from bursts of channel A
+#define AUTOSET_ENABLE 1
+#define AUTOSET_BURST 4096        // samples analyzed per burst
+#define AUTOSET_MAX_DECIMATION 16 // longest capture window is CAPTURE_SAMPLES * 16, half the ring
+#define AUTOSET_PERIODS 4         // signal periods per capture
+#define AUTOSET_MIN_AMPLITUDE 64  // codes; anything smaller is DC
+
+// Frequency response mode: DAC channel 0 (GPIO17) plays a sine sweep into the device
+// under test, channel A samples its output. ADC continuous mode holds the DMA the DAC
+// would stream from (SPI3 on ESP32-S2), so a timer interrupt writes the tone instead.
+#define FRESP_ENABLE 0
+#define FRESP_DAC_RATE_HZ 20000 // timer interrupts per second; divides FRESP_TIMER_HZ
+#define FRESP_TIMER_HZ 1000000
+#define FRESP_START_HZ 200 // lowest tone is FRESP_DAC_RATE_HZ / FRESP_MAX_TABLE
+#define FRESP_STOP_HZ 5000
+#define FRESP_POINTS 50
+#define FRESP_MAX_TABLE 2048 // DAC samples per tone table
+#define FRESP_SETTLE_CYCLES 4
+#define FRESP_MIN_WINDOW 4096   // samples correlated per tone
+#define FRESP_DAC_AMPLITUDE 100 // DAC codes around mid-scale
+#define FRESP_STIM_CODES 2400   // stimulus amplitude in channel A codes through a plain loopback
+#define FRESP_REF_SLOT -1       // ring slot wired to the DAC output for exact phase, -1 for none
+#define FRESP_TASK_STACK_SIZE 4096
+#if FRESP_REF_SLOT >= ADC_CHANNEL_COUNT
+#error "FRESP_REF_SLOT must be a sampled channel"
+#endif
+#if FRESP_ENABLE && !SOC_DAC_SUPPORTED
+#error "FRESP_ENABLE needs a target with a DAC"
+#endif
+#if FRESP_TIMER_HZ % FRESP_DAC_RATE_HZ
+#error "FRESP_DAC_RATE_HZ must divide FRESP_TIMER_HZ"
+#endif
+
+// Lock-in amplifier on channel A: amplitude and phase of a small tone at LOCKIN_FREQ_HZ,
+// optionally phase-locked to a reference tone sampled in another slot
+#define LOCKIN_ENABLE 0
+#define LOCKIN_FREQ_HZ 1000  // NCO frequency, or the starting guess with a reference
+#define LOCKIN_DECIM_SHIFT 8 // integrate and dump over 256 samples, one output per DSP block
+#define LOCKIN_ORDER 2       // 12 dB/octave
+#define LOCKIN_TAU_MS 100
+#define LOCKIN_REF_SLOT -1   // ring slot carrying the reference, -1 for the internal NCO
+#if LOCKIN_REF_SLOT >= ADC_CHANNEL_COUNT
+#error "LOCKIN_REF_SLOT must be a sampled channel"
+#endif
+
+// Digital downconverter on channel A: complex baseband around DDC_CENTER_HZ into an I/Q ring
+// that later graph stages can read like any other ring
+#define DDC_ENABLE 0
+#define DDC_CENTER_HZ 100000
+#define DDC_BANDWIDTH_HZ 20000 // rounded up to the next octave of decimation
+#define DDC_ORDER 4            // CIC stages
+#define DDC_RING_SAMPLES 8192  // interleaved I/Q, 4096 complex samples
+
+// Adaptive noise cancellation: channel A less what an NLMS filter predicts from the interference
+// source sampled in LMS_REF_SLOT, into a cleaned ring
+#define LMS_ENABLE 0
+#define LMS_REF_SLOT 1
+#define LMS_TAPS 16           // covers the delay spread of the coupling path, in samples
+#define LMS_MU_SHIFT 10       // NLMS step 2^-10; larger steps adapt faster but notch wider
+#define LMS_RING_SAMPLES 8192
+#if LMS_ENABLE && (LMS_REF_SLOT < 1 || LMS_REF_SLOT >= ADC_CHANNEL_COUNT)
+#error "LMS_REF_SLOT must be a sampled channel other than channel A"
+#endif
+
+// Spike rejection on channel A ahead of the trigger, measurements and mask test, which then read
+// the filtered ring. Hampel replaces only outliers; the plain median also smooths the noise.
+#define MEDIAN_ENABLE 0
+#define MEDIAN_WINDOW 5      // odd, 3..15; the filtered stream lags by MEDIAN_WINDOW / 2 samples
+#define MEDIAN_HAMPEL 1
+#define MEDIAN_N_SIGMA 3.0f  // Hampel threshold in robust standard deviations
+#define MEDIAN_MIN_DEV 16    // codes; smaller deviations always pass, so quiet signals are left alone
+#define MEDIAN_RING_SAMPLES (MEDIAN_ENABLE ? CHANNEL_RING_SAMPLES : DSP_BLOCK_SAMPLES) // captures need the full depth
+
+// Vibration monitoring on channel A: one feature vector (RMS, peak, crest, skewness, kurtosis and
+// band RMS) per window instead of raw samples
+#define VIB_ENABLE 0
+#define VIB_WINDOW_SHIFT 16     // 65536 samples, 15 vectors/s at 1 MSPS
+#define VIB_BAND_DECIM_SHIFT 4  // band filters at 62.5 kHz, bands must end below 31 kHz
+static const vib_band_t s_vib_bands[] = {
+    {10, 100}, {100, 1000}, {1000, 5000}, {5000, 25000}, // unbalance, bearings, gear mesh, impacts
+};
+#define VIB_BAND_COUNT (sizeof(s_vib_bands) / sizeof(s_vib_bands[0]))
+
+// Long-term trend log of channel A: block averages over 2^TREND_DECIM_SHIFT samples, of which only
+// the points needed to stay within TREND_TOL_CODES of the reconstruction are kept
+#define TREND_ENABLE 0
+#define TREND_MODE TREND_SWINGING_DOOR // or TREND_DEADBAND
+#define TREND_DECIM_SHIFT 10           // 977 averages/s at 1 MSPS
+#define TREND_FRAC_BITS 4              // averages keep 1/16 code
+#define TREND_TOL_CODES 2
+#define TREND_MAX_GAP_S 60             // a point at least this often, so a flat log still shows liveness
+#define TREND_LOG_POINTS 64            // archived points buffered for the processing task
+
+// Multi-device time sync: the master's periodic pulse, wired to every board and sampled in
+// TSYNC_SLOT, maps this device's sample counter to the master's timebase. Start the pulse train
+// once every device runs; its first pulse is time 0 on all of them.
+#define TSYNC_ENABLE 0
+#define TSYNC_SLOT 1
+#define TSYNC_LEVEL ADC_CODE_MID // rising edges through mid-scale
+#define TSYNC_PERIOD_MS 1000
+#define TSYNC_WINDOW 16         // pulses per fit; longer windows average more edges but lag thermal drift
+#define TSYNC_MAX_RESIDUAL_US 20
+#if TSYNC_ENABLE && (TSYNC_SLOT < 1 || TSYNC_SLOT >= ADC_CHANNEL_COUNT)
+#error "TSYNC_SLOT must be a sampled channel other than channel A"
+#endif
+
+// Machine state classifier on the vibration features (needs VIB_ENABLE). A change of state is
+// logged and the last CAPTURE_SAMPLES of the window that confirmed it are saved.
+#define CLS_ENABLE 0
+#define CLS_CONFIRM 3    // windows a new state must win in a row
+#define CLS_SAVE_SLOTS (CLS_ENABLE ? 4 : 1) // state-change captures kept
+#define CLS_FEATURES (5 + VIB_BAND_COUNT)
+// Example model for the bands above: nearest class centroid in standardized feature space, from
+// simulated machines. Replace with a model trained on the machine, same feature order
+// (vib_features_to_array).
+static const char *const s_cls_names[] = {"normal", "unbalance", "bearing"};
+#define CLS_CLASSES (sizeof(s_cls_names) / sizeof(s_cls_names[0]))
+static const float s_cls_mean[CLS_FEATURES] = {5.111f, 7.296f, 5.441f, 0.725f, 2.139f, 3.762f, 2.185f, 2.006f, 2.827f};
+static const float s_cls_std[CLS_FEATURES] = {0.843f, 0.671f, 2.993f, 1.127f, 1.432f, 2.267f, 0.925f, 0.693f, 0.785f};
+static const float s_cls_w[CLS_CLASSES * CLS_FEATURES] = {
+    -0.897f, -1.274f, -0.341f, -0.646f, -0.386f, -1.116f, -0.952f, -0.691f, -0.695f,
+    1.334f, 0.342f, -0.991f, -0.599f, -0.928f, 1.055f, 1.023f, -0.657f, -0.659f,
+    -0.437f, 0.932f, 1.332f, 1.245f, 1.314f, 0.061f, -0.072f, 1.349f, 1.353f,
+};
+static const float s_cls_b[CLS_CLASSES] = {-3.111f, -3.562f, -4.884f};
+static const float s_cls_calib[CLS_CLASSES * CLS_FEATURES] = { // class centroids, for the activation ranges
+    4.355f, 6.442f, 4.421f, -0.003f, 1.586f, 1.233f, 1.305f, 1.527f, 2.282f,
+    6.236f, 7.526f, 2.476f, 0.050f, 0.809f, 6.154f, 3.132f, 1.550f, 2.310f,
+    4.743f, 7.922f, 9.427f, 2.129f, 4.021f, 3.899f, 2.119f, 2.941f, 3.889f,
+};
 
 static TaskHandle_t s_task_handle;
 static const char *TAG = "EXAMPLE";
 
-// Circular buffer for oscilloscope-style capture
-static uint16_t circ_buf[CIRC_BUF_SAMPLES] __attribute__((aligned(4))); // DMA-capable internal RAM
-static volatile size_t circ_buf_wr = 0;                                 // Write pointer
-static portMUX_TYPE s_data_lock = portMUX_INITIALIZER_UNLOCKED;         // Spinlock to protect shared data
+// Circular buffer for oscilloscope-style capture, split into one ring per channel
+static sample_t circ_buf[CIRC_BUF_SAMPLES] __attribute__((aligned(4))); // DMA-capable internal RAM
+static sample_ring_t s_ring[ADC_CHANNEL_COUNT];                        // Ring state, head is an absolute sample count
+static portMUX_TYPE s_data_lock = portMUX_INITIALIZER_UNLOCKED;        // Spinlock to protect shared data
+static int8_t s_channel_slot[16];                                      // ADC channel number -> ring index, -1 if not sampled
+
+// Per-block min/max/sum summaries of circ_buf, updated by the main task on commit
+static block_summary_t s_block_summaries[CIRC_BUF_SAMPLES / BLOCK_INDEX_SAMPLES];
+static block_index_t s_block_index[ADC_CHANNEL_COUNT];
+
+// DSP stage graph fed from the channel rings, work-stealing workers on every core
+#define DSP_WORKER_COUNT portNUM_PROCESSORS
+static dsp_graph_t s_graph;
+
+// Math channels and their derived rings, evaluated as graph stages
+static sample_t s_math_buf[MATH_CHANNEL_COUNT][MATH_RING_SAMPLES];
+static math_channel_t s_math[MATH_CHANNEL_COUNT];
+static bool s_math_ok[MATH_CHANNEL_COUNT];
+static math_scratch_t s_math_scratch[DSP_WORKER_COUNT + 1]; // + 1 for units run outside the pool
+
+// Serial decoder stage and the frames it hands to the processing task
+static proto_decoder_t s_proto;
+static proto_frame_t s_proto_log[PROTO_LOG_FRAMES];
+static uint32_t s_proto_log_wr;
+static uint32_t s_proto_log_rd;
+
+// Persistence map stage, 16 KB of bins
+static persist_map_t s_persist;
+static uint16_t s_persist_bins[PERSIST_WIDTH * PERSIST_HEIGHT];
+static uint32_t s_persist_blocks;
+
+// Trigger and mask test stage; only failing captures are copied out of the ring
+typedef struct
+{
+    uint64_t trigger_pos;
+    uint32_t violations;
+    int32_t first;
+    meas_result_t meas;
+} saved_capture_t;
+typedef struct
+{
+    bool ready;
+    uint32_t tested;
+    uint32_t passed;
+    uint32_t failed;
+    uint32_t dropped;
+} mask_stats_t;
+static trigger_t s_trigger;
+static mask_t s_mask;
+static bool s_mask_ready;
+static sample_t s_mask_upper[CAPTURE_SAMPLES];
+static sample_t s_mask_lower[CAPTURE_SAMPLES];
+static sample_t s_fail_buf[MASK_SAVE_SLOTS][CAPTURE_SAMPLES];
+static saved_capture_t s_fail_meta[MASK_SAVE_SLOTS];
+static uint32_t s_fail_saved;  // total saved, slot = count % MASK_SAVE_SLOTS
+static uint32_t s_fail_logged; // processing task's read position
+static mask_stats_t s_mask_stats; // copy of the counters for the processing task
+
+// Newest failing capture, compressed by the processing task and kept for export
+static sample_t s_export_samples[CAPTURE_SAMPLES];
+static uint8_t s_export_packed[CAPTURE_CODEC_BOUND(CAPTURE_SAMPLES)];
+static size_t s_export_len; // 0 until a capture has been compressed
+static uint64_t s_export_pos;
+static uint32_t s_export_saved; // s_fail_saved when it was taken
+
+// Measurement workspace (capture stage only) and the newest result
+static sample_t s_meas_buf[CAPTURE_SAMPLES];
+static meas_scratch_t s_meas_scratch;
+static meas_config_t s_meas_cfg;
+static meas_result_t s_last_meas;
+static uint64_t s_last_meas_pos;
+static uint32_t s_decimation = 1;            // raw samples averaged into each capture sample
+static uint32_t s_capture_pre = TRIGGER_PRE; // capture samples before the trigger
+static bool s_capture_running;               // capture stage registered and the graph started
+
+// Autoset: the processing task analyzes bursts, the main task switches range and
+// the capture stage adopts the result, each acting only in its own state
+enum
+{
+    AUTOSET_IDLE,
+    AUTOSET_MEASURE, // processing task: wait for a burst in the current range
+    AUTOSET_SWITCH,  // main task: restart the driver in s_range_request
+    AUTOSET_APPLY,   // capture stage: take the trigger and timebase from s_autoset
+};
+static volatile int s_autoset_state;
+static int s_range;                  // index into s_range_atten, written by the main task
+static int s_range_request;
+static uint64_t s_autoset_from;      // first sample taken in the current range
+static int s_autoset_bursts;
+static sample_t s_autoset_buf[AUTOSET_BURST];
+static meas_scratch_t s_autoset_scratch;
+static autoset_result_t s_autoset;
+
+// Frequency response sweep; the timer interrupt plays s_fresp_table, which only changes while it is stopped
+#if SOC_DAC_SUPPORTED
+static fresp_point_t s_fresp_pts[FRESP_POINTS];
+static fresp_result_t s_fresp_results[FRESP_POINTS];
+static uint8_t s_fresp_table[FRESP_MAX_TABLE];
+static uint32_t s_fresp_len;
+static uint32_t s_fresp_idx;
+#endif
+
+// Lock-in stage; the processing task reads the newest result under s_data_lock
+static lockin_t s_lockin;
+static lockin_result_t s_lockin_result;
+
+// DDC stage and its output ring
+static ddc_t s_ddc;
+static sample_t s_ddc_buf[DDC_RING_SAMPLES];
+static sample_ring_t s_ddc_ring;
+
+// Noise canceller stage, its cleaned ring and the weights published for the processing task
+static lms_t s_lms;
+static float s_lms_w[LMS_TAPS];
+static sample_t s_lms_buf[LMS_RING_SAMPLES];
+static sample_ring_t s_lms_ring;
+
+// Spike filter stage, its ring, and the ring the capture stage reads (channel A or the filtered one)
+static median_t s_median;
+static uint32_t s_median_replaced; // published under s_data_lock
+static sample_t s_median_buf[MEDIAN_RING_SAMPLES];
+static sample_ring_t s_median_ring;
+static sample_ring_t *s_capture_ring = &s_ring[0];
+
+// Vibration feature stage; the processing task logs the newest vector
+static vib_t s_vib;
+static vib_features_t s_vib_last;
+
+// Trend stage: the running block average and the archived points
+static trend_t s_trend;
+static int32_t s_trend_sum;
+static uint32_t s_trend_count;
+static trend_point_t s_trend_log[TREND_LOG_POINTS];
+static uint32_t s_trend_log_wr;
+static uint32_t s_trend_log_rd;
+
+// Time sync stage: an edge trigger on the pulse channel feeds the fit, whose state is published
+// for the processing task after every pulse
+typedef struct
+{
+    uint64_t edge;      // sample position of the newest pulse
+    int64_t edge_ns;    // its common time
+    double drift_ppm;
+    double residual_ns;
+    uint32_t pulses;
+    uint32_t rejected;
+    uint32_t restarts;
+} tsync_status_t;
+static trigger_t s_tsync_trigger;
+static tsync_t s_tsync;
+static tsync_status_t s_tsync_status;
+
+// Classifier run from the feature callback; state changes and their captures go to the processing task
+typedef struct
+{
+    uint64_t pos; // first sample of the window that confirmed the change
+    int from;
+    int to;
+} cls_event_t;
+static cls_model_t s_cls_model;
+static bool s_cls_ready;
+static cls_tracker_t s_cls_tracker;
+static sample_t s_cls_buf[CLS_SAVE_SLOTS][CAPTURE_SAMPLES];
+static cls_event_t s_cls_events[CLS_SAVE_SLOTS];
+static uint32_t s_cls_saved;  // total saved, slot = count % CLS_SAVE_SLOTS
+static uint32_t s_cls_logged; // processing task's read position
 
 // Statistics for display
 static volatile uint64_t s_voltage_sum = 0;
@@ -87,20 +476,17 @@ static volatile bool trigger_seen = false;
 static volatile bool capture_complete = false;
 
 // Helper function to linearize circular buffer for export (as mentioned in README)
-static void export_circular_buffer(uint16_t *out_buffer, size_t pre_samples, size_t total_samples)
+static size_t export_circular_buffer(sample_t *out_buffer, size_t pre_samples, size_t total_samples)
 {
     portENTER_CRITICAL(&s_data_lock);
-    size_t current_wr = circ_buf_wr;
+    uint64_t current_wr = s_ring[0].head;
     portEXIT_CRITICAL(&s_data_lock);
 
     // Calculate start position (pre-trigger samples)
-    size_t start = (current_wr - pre_samples) & CIRC_BUF_MASK;
+    uint64_t start = current_wr > pre_samples ? current_wr - pre_samples : 0;
 
     // Linearize the ring buffer
-    for (size_t i = 0; i < total_samples && i < CIRC_BUF_SAMPLES; i++)
-    {
-        out_buffer[i] = circ_buf[(start + i) & CIRC_BUF_MASK];
-    }
+    return sample_ring_copy(&s_ring[0], start, total_samples, out_buffer);
 }
 
 // Example trigger handler (as mentioned in README trigger pattern)
@@ -119,7 +505,7 @@ static void handle_trigger_capture(adc_continuous_handle_t handle, size_t pre_tr
         adc_continuous_stop(handle);
 
         // Export the circular buffer data
-        uint16_t *export_buffer = malloc((pre_trigger_samples + post_trigger_samples) * sizeof(uint16_t));
+        sample_t *export_buffer = malloc((pre_trigger_samples + post_trigger_samples) * sizeof(sample_t));
         if (export_buffer)
         {
             export_circular_buffer(export_buffer, pre_trigger_samples, pre_trigger_samples + post_trigger_samples);
@@ -129,7 +515,7 @@ static void handle_trigger_capture(adc_continuous_handle_t handle, size_t pre_tr
             // For now, just log the first few samples
             for (int i = 0; i < 10 && i < (pre_trigger_samples + post_trigger_samples); i++)
             {
-                ESP_LOGI(TAG, "Sample[%d]: %u", i, export_buffer[i]);
+                ESP_LOGI(TAG, "Sample[%d]: %d", i, export_buffer[i]);
             }
 
             free(export_buffer);
@@ -186,167 +572,1433 @@ static bool IRAM_ATTR s_pool_ovf_cb(adc_continuous_handle_t handle, const adc_co
     return (mustYield == pdTRUE);
 }
 
-// =================================================================================
-// PROCESSING AND DISPLAY TASK
-// =================================================================================
-static void processing_task(void *arg)
+// Graph stage wrapper: evaluate one block of a math channel and publish it
+static void math_stage_process(void *ctx, const dsp_block_t *blk)
 {
-    char unit[] = EXAMPLE_ADC_UNIT_STR(EXAMPLE_ADC_UNIT);
+    math_channel_t *ch = ctx;
+    math_eval(&ch->prog, blk->in, blk->len, &ch->out.buf[blk->pos & ch->out.mask], &s_math_scratch[blk->worker]);
+    dsp_graph_publish(&s_graph, &ch->out, blk->pos + blk->len);
+}
 
-    while (1)
+// Decoder callback on a DSP worker: keep the newest frames, the display task drains them
+static void proto_frame_logged(void *ctx, const proto_frame_t *frame)
+{
+    portENTER_CRITICAL(&s_data_lock);
+    s_proto_log[s_proto_log_wr % PROTO_LOG_FRAMES] = *frame;
+    s_proto_log_wr++;
+    if (s_proto_log_wr - s_proto_log_rd > PROTO_LOG_FRAMES)
     {
-        // Delay for 1 second to print results at a readable rate
-        vTaskDelay(pdMS_TO_TICKS(1000));
+        s_proto_log_rd = s_proto_log_wr - PROTO_LOG_FRAMES;
+    }
+    portEXIT_CRITICAL(&s_data_lock);
+}
 
-        // Atomically copy and reset the shared variables
-        portENTER_CRITICAL(&s_data_lock);
-        uint64_t temp_sum = s_voltage_sum;
-        uint32_t temp_count = s_sample_count;
-        size_t temp_wr_pos = circ_buf_wr;
-        s_voltage_sum = 0;
-        s_sample_count = 0;
-        portEXIT_CRITICAL(&s_data_lock);
+static void proto_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    proto_decoder_process(ctx, blk->in, blk->len, blk->pos);
+}
 
-        // Calculate and print the average voltage for the last second
-        if (temp_count > 0)
-        {
-            uint32_t average_voltage = temp_sum / temp_count;
-            ESP_LOGI(TAG, "Unit: %s, Channel: %d, Avg Voltage: %" PRIu32 " mV, Samples: %" PRIu32 ", BufPos: %zu",
-                     unit, channel[0], average_voltage, temp_count, temp_wr_pos);
-        }
-        else
-        {
-            ESP_LOGI(TAG, "No new samples in the last second. BufPos: %zu", temp_wr_pos);
-        }
+static void proto_stage_flush(void *ctx)
+{
+    proto_decoder_reset(ctx);
+}
+
+// Accumulate one block of channel A; the display persists for a few decay periods
+static void persist_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    persist_map_accumulate(ctx, blk->in[0], blk->len);
+    if (++s_persist_blocks % PERSIST_DECAY_BLOCKS == 0)
+    {
+        persist_map_decay(ctx, 1);
     }
 }
 
-static void continuous_adc_init(adc_channel_t *channel, uint8_t channel_num, adc_continuous_handle_t *out_handle)
+static void persist_stage_flush(void *ctx)
 {
-    adc_continuous_handle_t handle = NULL;
+    persist_map_reset(ctx);
+}
 
-    adc_continuous_handle_cfg_t adc_config = {
-        .max_store_buf_size = 4096,
-        .conv_frame_size = EXAMPLE_READ_LEN,
-        .flags.flush_pool = false, // Set to false to detect overflows properly
-    };
-    ESP_ERROR_CHECK(adc_continuous_new_handle(&adc_config, &handle));
+static void lockin_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    lockin_result_t res;
+    lockin_process(ctx, blk->in[0], LOCKIN_REF_SLOT >= 0 ? blk->in[1] : NULL, blk->len);
+    lockin_result(ctx, &res);
+    portENTER_CRITICAL(&s_data_lock);
+    s_lockin_result = res;
+    portEXIT_CRITICAL(&s_data_lock);
+}
 
-    adc_continuous_config_t dig_cfg = {
-        .sample_freq_hz = SAMPLE_FREQ_HZ, // 1 MSPS as per README specifications
-        .conv_mode = EXAMPLE_ADC_CONV_MODE,
-        .format = EXAMPLE_ADC_OUTPUT_TYPE,
-    };
+// A gap breaks the NCO phase against the signal: start settling again
+static void lockin_stage_flush(void *ctx)
+{
+    lockin_t *lk = ctx;
+    lockin_config_t cfg = lk->cfg;
+    lockin_init(lk, &cfg);
+}
 
-    adc_digi_pattern_config_t adc_pattern[SOC_ADC_PATT_LEN_MAX] = {0};
-    dig_cfg.pattern_num = channel_num;
-    for (int i = 0; i < channel_num; i++)
+static void ddc_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    ddc_t *d = ctx;
+    if (ddc_process(d, blk->in[0], blk->len, &s_ddc_ring) > 0)
     {
-        adc_pattern[i].atten = EXAMPLE_ADC_ATTEN;
-        adc_pattern[i].channel = channel[i] & 0x7;
-        adc_pattern[i].unit = EXAMPLE_ADC_UNIT;
-        adc_pattern[i].bit_width = EXAMPLE_ADC_BIT_WIDTH;
+        dsp_graph_publish(&s_graph, &s_ddc_ring, 2 * d->outputs);
     }
-    dig_cfg.adc_pattern = adc_pattern;
-    ESP_ERROR_CHECK(adc_continuous_config(handle, &dig_cfg));
-
-    *out_handle = handle;
 }
 
-void app_main(void)
+// Restart the filters after a gap; the output ring carries on from its head
+static void ddc_stage_flush(void *ctx)
 {
-    esp_err_t ret;
-    uint32_t ret_num = 0;
-    uint8_t result[EXAMPLE_READ_LEN] __attribute__((aligned(4))) = {0};
-
-    // RAM usage calculation (as per README):
-    // - READ_LEN (256 bytes) for frame buffer
-    // - CIRC_BUF_SAMPLES * 2 (32768 * 2 = 64KB) for circular buffer
-    // - Task stacks and other overhead
-    // Total ≈ 64KB as mentioned in README
-    ESP_LOGI(TAG, "Initializing ADC continuous capture with %d sample circular buffer (%.1f KB)",
-             CIRC_BUF_SAMPLES, (CIRC_BUF_SAMPLES * sizeof(uint16_t)) / 1024.0);
+    ddc_t *d = ctx;
+    ddc_config_t cfg = d->cfg;
+    uint64_t outputs = d->outputs;
+    ddc_init(d, &cfg);
+    d->outputs = outputs;
+}
 
-    s_task_handle = xTaskGetCurrentTaskHandle();
+// Blocks are aligned and the ring is a whole number of blocks, so the output never wraps mid-block.
+// No flush: the coupling path outlives a gap, and stale history only lasts LMS_TAPS samples.
+static void lms_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    lms_process(ctx, blk->in[0], blk->in[1], &s_lms_ring.buf[blk->pos & s_lms_ring.mask], blk->len);
+    float w[LMS_TAPS];
+    for (int k = 0; k < LMS_TAPS; k++)
+    {
+        w[k] = lms_weight(ctx, k);
+    }
+    portENTER_CRITICAL(&s_data_lock);
+    memcpy(s_lms_w, w, sizeof(w));
+    portEXIT_CRITICAL(&s_data_lock);
+    dsp_graph_publish(&s_graph, &s_lms_ring, blk->pos + blk->len);
+}
 
-    // REMOVED: Queue is no longer needed
-    // NEW: Create the processing and display task
-    xTaskCreate(processing_task, "processing_task", PROCESSING_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
+static void median_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    median_t *m = ctx;
+    median_process(m, blk->in[0], &s_median_ring.buf[blk->pos & s_median_ring.mask], blk->len);
+    portENTER_CRITICAL(&s_data_lock);
+    s_median_replaced = m->replaced;
+    portEXIT_CRITICAL(&s_data_lock);
+    dsp_graph_publish(&s_graph, &s_median_ring, blk->pos + blk->len);
+}
 
-    do_calibration = adc_calibration_init(EXAMPLE_ADC_UNIT, EXAMPLE_ADC_ATTEN, &cali_handle);
+// Refill the window from the first sample after a gap rather than mixing in stale history
+static void median_stage_flush(void *ctx)
+{
+    median_t *m = ctx;
+    m->primed = false;
+}
 
-    adc_continuous_handle_t handle = NULL;
-    continuous_adc_init(channel, sizeof(channel) / sizeof(adc_channel_t), &handle);
+// Average aligned groups of 2^TREND_DECIM_SHIFT samples; t counts groups from the start of the stream
+static void trend_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    const sample_t *in = blk->in[0];
+    const uint64_t mask = (1u << TREND_DECIM_SHIFT) - 1;
+    for (size_t i = 0; i < blk->len; i++)
+    {
+        s_trend_sum += in[i];
+        s_trend_count++;
+        uint64_t pos = blk->pos + i;
+        if ((pos & mask) != mask)
+        {
+            continue;
+        }
+        // Groups cut short by a start or a gap are dropped
+        trend_point_t pts[2];
+        int n = s_trend_count == mask + 1
+                    ? trend_push(ctx, pos >> TREND_DECIM_SHIFT,
+                                 (int32_t)(((int64_t)s_trend_sum << TREND_FRAC_BITS) >> TREND_DECIM_SHIFT), pts)
+                    : 0;
+        s_trend_sum = 0;
+        s_trend_count = 0;
+        if (n == 0)
+        {
+            continue;
+        }
+        portENTER_CRITICAL(&s_data_lock);
+        for (int k = 0; k < n; k++)
+        {
+            s_trend_log[s_trend_log_wr % TREND_LOG_POINTS] = pts[k];
+            s_trend_log_wr++;
+        }
+        if (s_trend_log_wr - s_trend_log_rd > TREND_LOG_POINTS)
+        {
+            s_trend_log_rd = s_trend_log_wr - TREND_LOG_POINTS;
+        }
+        portEXIT_CRITICAL(&s_data_lock);
+    }
+}
 
-    adc_continuous_evt_cbs_t cbs = {
-        .on_conv_done = s_conv_done_cb,
-        .on_pool_ovf = s_pool_ovf_cb, // Register the overflow callback
-    };
-    ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(handle, &cbs, NULL));
-    ESP_ERROR_CHECK(adc_continuous_start(handle));
+// The trend carries on across a gap: only the partial average is dropped
+static void trend_stage_flush(void *ctx)
+{
+    s_trend_sum = 0;
+    s_trend_count = 0;
+}
 
-    while (1)
+// Classify the window on the DSP worker; on a confirmed change keep the window's tail, still in the ring
+static void classify_window(const vib_features_t *f)
+{
+    float x[CLS_MAX_INPUTS];
+    vib_features_to_array(f, VIB_BAND_COUNT, x);
+    int from = s_cls_tracker.current;
+    if (!cls_tracker_update(&s_cls_tracker, cls_predict(&s_cls_model, x, NULL)))
     {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        return;
+    }
+    uint32_t slot = s_cls_saved % CLS_SAVE_SLOTS;
+    uint64_t end = f->pos + (1u << VIB_WINDOW_SHIFT);
+    if (sample_ring_copy(&s_ring[0], end - CAPTURE_SAMPLES, CAPTURE_SAMPLES, s_cls_buf[slot]) != CAPTURE_SAMPLES)
+    {
+        memset(s_cls_buf[slot], 0, sizeof(s_cls_buf[slot])); // overwritten already: keep the event only
+    }
+    portENTER_CRITICAL(&s_data_lock);
+    s_cls_events[slot] = (cls_event_t){f->pos, from, s_cls_tracker.current};
+    s_cls_saved++;
+    portEXIT_CRITICAL(&s_data_lock);
+}
 
-        while (1)
-        {
-            ret = adc_continuous_read(handle, result, EXAMPLE_READ_LEN, &ret_num, 0);
+static void vib_features_ready(void *ctx, const vib_features_t *f)
+{
+    portENTER_CRITICAL(&s_data_lock);
+    s_vib_last = *f;
+    portEXIT_CRITICAL(&s_data_lock);
+    if (CLS_ENABLE && s_cls_ready)
+    {
+        classify_window(f);
+    }
+}
 
-            if (ret == ESP_OK)
-            {
-                // Batch process the entire frame to minimize critical sections
-                size_t samples_in_frame = ret_num / SOC_ADC_DIGI_RESULT_BYTES;
-                uint64_t frame_voltage_sum = 0;
-                uint32_t frame_sample_count = 0;
+static void vib_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    vib_process(ctx, blk->in[0], blk->len, blk->pos);
+}
 
-                // Get current write position once at start of frame
-                size_t local_wr_pos;
-                portENTER_CRITICAL(&s_data_lock);
-                local_wr_pos = circ_buf_wr;
-                portEXIT_CRITICAL(&s_data_lock);
+static void vib_stage_flush(void *ctx)
+{
+    vib_reset(ctx);
+}
 
-                // Process all samples in the frame without any critical sections
-                for (int i = 0; i < ret_num; i += SOC_ADC_DIGI_RESULT_BYTES)
-                {
-                    adc_digi_output_data_t *p = (adc_digi_output_data_t *)&result[i];
-                    uint32_t raw_data = EXAMPLE_ADC_GET_DATA(p);
+// Each rising edge of the sync pulse is one observation. The pulse channel is converted
+// TSYNC_SLOT pattern steps after channel A, well inside the one-sample edge resolution.
+static void tsync_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    trigger_scan(&s_tsync_trigger, blk->in[0], blk->len, blk->pos);
+    uint64_t edge;
+    while (trigger_next_capture(&s_tsync_trigger, blk->pos + blk->len, &edge))
+    {
+        tsync_t *sync = ctx;
+        tsync_add_pulse_periodic(sync, edge, (int64_t)TSYNC_PERIOD_MS * 1000000);
+        tsync_status_t st = {
+            .edge = edge,
+            .edge_ns = tsync_to_ref(sync, edge),
+            .drift_ppm = tsync_drift_ppm(sync),
+            .residual_ns = sync->residual_ns,
+            .pulses = sync->count,
+            .rejected = sync->rejected,
+            .restarts = sync->restarts,
+        };
+        portENTER_CRITICAL(&s_data_lock);
+        s_tsync_status = st;
+        portEXIT_CRITICAL(&s_data_lock);
+    }
+}
 
-                    // Store in circular buffer (no critical section needed per sample)
-                    circ_buf[local_wr_pos] = (uint16_t)raw_data;
-                    local_wr_pos = (local_wr_pos + 1) & CIRC_BUF_MASK;
+// The fit outlives a gap; only a half-seen edge is dropped
+static void tsync_stage_flush(void *ctx)
+{
+    trigger_reset(&s_tsync_trigger);
+}
 
-                    // Count every sample for statistics
-                    frame_sample_count++;
+// Linear copy of a capture, averaging s_decimation raw samples into each capture sample
+static bool capture_linearize(uint64_t trigger_pos, uint64_t head, sample_t *out)
+{
+    const uint32_t d = s_decimation;
+    uint64_t from = trigger_pos - (uint64_t)s_capture_pre * d;
+    if (d == 1)
+    {
+        return sample_ring_copy(s_capture_ring, from, CAPTURE_SAMPLES, out) == CAPTURE_SAMPLES;
+    }
+    if (head - from > sample_ring_capacity(s_capture_ring))
+    {
+        return false;
+    }
+    for (size_t i = 0; i < CAPTURE_SAMPLES; i++, from += d)
+    {
+        int32_t sum = 0;
+        for (uint32_t k = 0; k < d; k++)
+        {
+            sum += sample_ring_at(s_capture_ring, from + k);
+        }
+        out[i] = (sample_t)(sum / (int32_t)d);
+    }
+    return true;
+}
 
-                    // Only do voltage calibration on every 8th sample to reduce CPU load
-                    // This still gives accurate average while preventing watchdog timeout
-                    if (do_calibration && (frame_sample_count & 0x7) == 0)
-                    {
-                        int voltage_mv = 0;
-                        if (adc_cali_raw_to_voltage(cali_handle, raw_data, &voltage_mv) == ESP_OK)
-                        {
-                            frame_voltage_sum += voltage_mv * 8; // Scale up to compensate for sampling
-                        }
-                    }
-                }
+// Golden reference: the envelope comes from the first complete capture
+static void mask_learn(uint64_t trigger_pos, uint64_t head)
+{
+    sample_t *ref = s_fail_buf[0]; // free until the first failure
+    if (capture_linearize(trigger_pos, head, ref))
+    {
+        mask_from_reference(ref, CAPTURE_SAMPLES, MASK_TOL_CODES, MASK_SLACK_SAMPLES, s_mask_upper, s_mask_lower);
+        s_mask_ready = mask_init(&s_mask, s_mask_upper, s_mask_lower, CAPTURE_SAMPLES, s_capture_pre);
+    }
+}
 
-                // Update all shared variables once per frame (single critical section)
-                portENTER_CRITICAL(&s_data_lock);
-                circ_buf_wr = local_wr_pos;
-                s_voltage_sum += frame_voltage_sum;
-                s_sample_count += frame_sample_count;
-                portEXIT_CRITICAL(&s_data_lock);
-            }
-            else if (ret == ESP_ERR_TIMEOUT)
-            {
-                // Buffer is empty, break to wait for next notification
-                break;
-            }
-            else
-            {
-                ESP_LOGE(TAG, "ADC read error: %s", esp_err_to_name(ret));
+// Full-rate captures are tested in place; decimated ones from their linear copy in s_meas_buf
+static void mask_capture(uint64_t trigger_pos, uint64_t head, bool linear, const meas_result_t *meas)
+{
+    mask_result_t res;
+    if (s_decimation == 1)
+    {
+        if (!mask_check_ring(&s_mask, s_capture_ring, head, trigger_pos, &res))
+        {
+            return;
+        }
+    }
+    else if (linear)
+    {
+        mask_check(&s_mask, s_meas_buf, &res);
+    }
+    else
+    {
+        return;
+    }
+    if (res.pass)
+    {
+        return;
+    }
+    uint32_t slot = s_fail_saved % MASK_SAVE_SLOTS;
+    if (linear)
+    {
+        memcpy(s_fail_buf[slot], s_meas_buf, sizeof(s_meas_buf));
+    }
+    else if (!capture_linearize(trigger_pos, head, s_fail_buf[slot]))
+    {
+        return; // overwritten while it was tested; a partial copy is not worth saving
+    }
+    portENTER_CRITICAL(&s_data_lock);
+    s_fail_meta[slot] = (saved_capture_t){trigger_pos, res.violations, res.first, *meas};
+    s_fail_saved++;
+    portEXIT_CRITICAL(&s_data_lock);
+}
+
+// Measure the linear copy in s_meas_buf; the walks around edges need contiguous samples
+static void capture_measure(uint64_t trigger_pos, meas_result_t *meas)
+{
+    if (!meas_capture(&s_meas_cfg, s_meas_buf, CAPTURE_SAMPLES, meas, &s_meas_scratch))
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_data_lock);
+    s_last_meas = *meas;
+    s_last_meas_pos = trigger_pos;
+    portEXIT_CRITICAL(&s_data_lock);
+}
+
+// Adopt the autoset trigger and timebase; the capture stage owns the trigger, so it switches itself
+// (the processing task does it when that stage is not running)
+static void capture_apply_autoset(void)
+{
+    const autoset_result_t *a = &s_autoset;
+    trigger_config_t cfg = {
+        .edge = TRIGGER_EDGE,
+        .level = a->trigger_level,
+        .hysteresis = a->trigger_hysteresis,
+        .pre = a->pre,
+        .post = a->post,
+    };
+    const trigger_config_t old = s_trigger.cfg;
+    if (trigger_init(&s_trigger, &cfg))
+    {
+        s_decimation = a->decimation;
+        s_capture_pre = a->pre / a->decimation;
+        s_meas_cfg.level = a->trigger_level;
+        s_meas_cfg.hysteresis = a->trigger_hysteresis;
+        s_meas_cfg.sample_rate_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT / a->decimation;
+        s_mask_ready = false; // learn a new reference with the new settings
+    }
+    else
+    {
+        trigger_init(&s_trigger, &old); // keep the old settings, disarmed after the range switch
+    }
+    s_autoset_state = AUTOSET_IDLE;
+}
+
+// Scan channel A (or its spike-filtered ring) for triggers and handle every capture whose post-trigger part has arrived
+static void capture_stage_process(void *ctx, const dsp_block_t *blk)
+{
+    int autoset = s_autoset_state;
+    if (autoset == AUTOSET_APPLY)
+    {
+        capture_apply_autoset();
+    }
+    else if (autoset != AUTOSET_IDLE)
+    {
+        // Range and trigger are still being worked out; forget edges from before a range switch
+        trigger_reset(&s_trigger);
+        return;
+    }
+
+    trigger_scan(&s_trigger, blk->in[0], blk->len, blk->pos);
+
+    // Validate against the live head: the producer may have moved on since this block
+    uint64_t head = dsp_graph_head(&s_graph, s_capture_ring);
+    uint64_t trigger_pos;
+    while (trigger_next_capture(&s_trigger, blk->pos + blk->len, &trigger_pos))
+    {
+        // Decimated captures are always linearized, full-rate ones only for measurements
+        bool linear = (MEAS_ENABLE || s_decimation > 1) && capture_linearize(trigger_pos, head, s_meas_buf);
+        meas_result_t meas = {0};
+        if (MEAS_ENABLE && linear)
+        {
+            capture_measure(trigger_pos, &meas);
+        }
+        if (!MASK_ENABLE)
+        {
+            continue;
+        }
+        if (!s_mask_ready)
+        {
+            mask_learn(trigger_pos, head);
+            continue;
+        }
+        mask_capture(trigger_pos, head, linear, &meas);
+    }
+
+    mask_stats_t stats = {s_mask_ready, s_mask.tested, s_mask.passed, s_mask.failed, s_trigger.dropped};
+    portENTER_CRITICAL(&s_data_lock);
+    s_mask_stats = stats;
+    portEXIT_CRITICAL(&s_data_lock);
+}
+
+static void capture_stage_flush(void *ctx)
+{
+    trigger_reset(&s_trigger);
+}
+
+// =================================================================================
+// PROCESSING AND DISPLAY TASK
+// =================================================================================
+
+// Analyze the newest burst once AUTOSET_BURST samples have arrived in the current range
+static void autoset_poll(void)
+{
+    if (s_autoset_state != AUTOSET_MEASURE)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&s_data_lock);
+    uint64_t head = s_ring[0].head;
+    uint64_t from = s_autoset_from;
+    portEXIT_CRITICAL(&s_data_lock);
+    if (head < from + AUTOSET_BURST ||
+        sample_ring_copy(&s_ring[0], head - AUTOSET_BURST, AUTOSET_BURST, s_autoset_buf) != AUTOSET_BURST)
+    {
+        return;
+    }
+
+    autoset_config_t cfg = {
+        .code_min = 0,
+        .code_max = (1 << EXAMPLE_ADC_BIT_WIDTH) - 1,
+        .sample_rate_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT,
+        .num_ranges = RANGE_COUNT,
+        .capture_len = CAPTURE_SAMPLES,
+        .max_decimation = AUTOSET_MAX_DECIMATION,
+        .periods_per_capture = AUTOSET_PERIODS,
+        .min_amplitude = AUTOSET_MIN_AMPLITUDE,
+        .hist_shift = 4,
+    };
+    memcpy(cfg.range_full_scale_mv, s_range_fs_mv, sizeof(s_range_fs_mv));
+    if (!autoset_analyze(&cfg, s_range, s_autoset_buf, AUTOSET_BURST, &s_autoset, &s_autoset_scratch))
+    {
+        ESP_LOGE(TAG, "Autoset: invalid configuration");
+        s_autoset_state = AUTOSET_IDLE;
+        return;
+    }
+    // A steady signal settles within RANGE_COUNT bursts; one that keeps moving leaves the defaults
+    if (s_autoset.flags & AUTOSET_RETRY)
+    {
+        if (++s_autoset_bursts > (int)RANGE_COUNT)
+        {
+            ESP_LOGW(TAG, "Autoset: signal did not settle, keeping the current settings");
+            s_autoset_state = AUTOSET_IDLE;
+            return;
+        }
+        s_range_request = s_autoset.range;
+        s_autoset_state = AUTOSET_SWITCH;
+        return;
+    }
+
+    const autoset_result_t *a = &s_autoset;
+    ESP_LOGI(TAG, "Autoset: range %d (%" PRId32 " mV), flags 0x%02" PRIx32 ", dc %.0f mV, ampl %.0f mV, freq %.1f Hz",
+             s_range, s_range_fs_mv[s_range], a->flags, a->dc_mv, a->amplitude_mv, a->frequency_hz);
+    ESP_LOGI(TAG, "Autoset: trigger %d +/- %d, pre %" PRIu32 " post %" PRIu32 ", decimation %" PRIu32,
+             a->trigger_level, a->trigger_hysteresis, a->pre, a->post, a->decimation);
+    if (!s_capture_running)
+    {
+        capture_apply_autoset(); // no stage scans the trigger, so take the settings here
+        return;
+    }
+    s_autoset_state = AUTOSET_APPLY;
+}
+
+// Compress the newest failing capture into s_export_packed. Its slot is copied under the lock, while the
+// capture stage can only be writing the next slot. A capture is one codec chunk, so forking it onto the
+// pool gains nothing and would nest stage units on a worker's stack; it is coded on this task.
+static void export_newest_failure(void)
+{
+    portENTER_CRITICAL(&s_data_lock);
+    uint32_t saved = s_fail_saved;
+    bool fresh = saved != s_export_saved;
+    if (fresh)
+    {
+        uint32_t slot = (saved - 1) % MASK_SAVE_SLOTS;
+        memcpy(s_export_samples, s_fail_buf[slot], sizeof(s_export_samples));
+        s_export_pos = s_fail_meta[slot].trigger_pos;
+    }
+    portEXIT_CRITICAL(&s_data_lock);
+    if (!fresh)
+    {
+        return;
+    }
+    s_export_saved = saved;
+
+    int64_t t0 = esp_timer_get_time();
+    s_export_len = capture_codec_compress(NULL, s_export_samples, CAPTURE_SAMPLES, s_export_packed, sizeof(s_export_packed));
+    if (s_export_len)
+    {
+        ESP_LOGI(TAG, "Export @%" PRIu64 ": %d samples packed to %zu bytes (%.2fx) in %" PRId64 " us", s_export_pos,
+                 CAPTURE_SAMPLES, s_export_len, (double)sizeof(s_export_samples) / s_export_len,
+                 esp_timer_get_time() - t0);
+    }
+}
+
+static void processing_task(void *arg)
+{
+    char unit[] = EXAMPLE_ADC_UNIT_STR(EXAMPLE_ADC_UNIT);
+
+    while (1)
+    {
+        // Print results about once a second; autoset bursts are picked up in between
+        for (int t = 0; t < 100; t++)
+        {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            autoset_poll();
+        }
+
+        // Atomically copy and reset the shared variables
+        portENTER_CRITICAL(&s_data_lock);
+        uint64_t temp_sum = s_voltage_sum;
+        uint32_t temp_count = s_sample_count;
+        uint64_t temp_head = s_ring[0].head;
+        size_t temp_wr_pos = temp_head & CHANNEL_RING_MASK;
+        uint64_t math_head[MATH_CHANNEL_COUNT];
+        for (size_t m = 0; m < MATH_CHANNEL_COUNT; m++)
+        {
+            math_head[m] = s_math[m].out.head;
+        }
+        s_voltage_sum = 0;
+        s_sample_count = 0;
+        portEXIT_CRITICAL(&s_data_lock);
+
+        // Raw-code min/max/RMS over the whole ring history, mostly served from block summaries.
+        // The reader commits summaries before publishing head, so temp_head is also the
+        // commit point; the query never reads the reader's own index cursor.
+        range_stats_t hist;
+        if (block_index_range_stats(&s_block_index[0], temp_head, 0, temp_head, &hist))
+        {
+            float mean = (float)hist.sum / hist.count;
+            float rms = sqrtf((float)hist.sum_sq / hist.count);
+            ESP_LOGI(TAG, "History: %" PRIu64 " samples, min %d, max %d, mean %.1f, rms %.1f",
+                     hist.count, hist.min, hist.max, mean, rms);
+        }
+
+        // Mean of the newest block of every math channel
+        for (size_t m = 0; m < MATH_CHANNEL_COUNT; m++)
+        {
+            range_stats_t ms;
+            if (s_math_ok[m] && math_head[m] >= MATH_BLOCK_SAMPLES &&
+                block_index_range_stats_raw(&s_math[m].out, math_head[m] - MATH_BLOCK_SAMPLES, math_head[m], &ms))
+            {
+                ESP_LOGI(TAG, "Math[%zu] %s: mean %.1f", m, s_math_exprs[m], (float)ms.sum / ms.count);
+            }
+        }
+
+        // Per-stage CPU time over the last second
+        for (int st = 0; st < s_graph.num_stages; st++)
+        {
+            dsp_stage_stats_t stats;
+            dsp_graph_get_stats(&s_graph, st, &stats, true);
+            if (stats.blocks > 0)
+            {
+                ESP_LOGI(TAG, "Stage %s (worker %d): %" PRIu32 " blocks, avg %" PRId64 " us, max %" PRId64 " us, gaps %" PRIu32,
+                         s_graph.stages[st].desc.name, s_graph.stages[st].desc.worker, stats.blocks,
+                         stats.total_us / stats.blocks, stats.max_us, stats.gaps);
+            }
+        }
+
+        // Frames decoded since the last print, timestamped in seconds of sample time
+        while (1)
+        {
+            proto_frame_t f;
+            portENTER_CRITICAL(&s_data_lock);
+            bool more = s_proto_log_rd != s_proto_log_wr;
+            if (more)
+            {
+                f = s_proto_log[s_proto_log_rd % PROTO_LOG_FRAMES];
+                s_proto_log_rd++;
+            }
+            portEXIT_CRITICAL(&s_data_lock);
+            if (!more)
+            {
+                break;
+            }
+            ESP_LOGI(TAG, "Decoded @%.6f s: type %d data 0x%02x/0x%02x flags 0x%02x",
+                     (double)f.start * ADC_CHANNEL_COUNT / SAMPLE_FREQ_HZ, f.type, f.data, f.data2, f.flags);
+        }
+
+        // The map is read while the stage may be accumulating; a torn read only costs a few counts
+        if (PERSIST_ENABLE && s_persist.bins)
+        {
+            ESP_LOGI(TAG, "Persistence: %" PRIu32 " %s, peak bin %u", s_persist.traces,
+                     PERSIST_MODE == PERSIST_CLOCK ? "edges" : "traces", persist_map_peak(&s_persist));
+        }
+
+        // Mask test counters and the failing captures saved since the last print
+        portENTER_CRITICAL(&s_data_lock);
+        mask_stats_t mask_stats = s_mask_stats;
+        uint32_t saved = s_fail_saved;
+        portEXIT_CRITICAL(&s_data_lock);
+        if (mask_stats.ready)
+        {
+            ESP_LOGI(TAG, "Mask: %" PRIu32 " tested, %" PRIu32 " passed, %" PRIu32 " failed, %" PRIu32 " triggers dropped",
+                     mask_stats.tested, mask_stats.passed, mask_stats.failed, mask_stats.dropped);
+        }
+        if (saved - s_fail_logged > MASK_SAVE_SLOTS)
+        {
+            s_fail_logged = saved - MASK_SAVE_SLOTS;
+        }
+        for (; s_fail_logged != saved; s_fail_logged++)
+        {
+            portENTER_CRITICAL(&s_data_lock);
+            saved_capture_t meta = s_fail_meta[s_fail_logged % MASK_SAVE_SLOTS];
+            portEXIT_CRITICAL(&s_data_lock);
+            ESP_LOGW(TAG, "Mask fail @%" PRIu64 ": %" PRIu32 " samples outside, first at %" PRId32 " (slot %" PRIu32 ")",
+                     meta.trigger_pos, meta.violations, meta.first - (int32_t)s_capture_pre, s_fail_logged % MASK_SAVE_SLOTS);
+        }
+        export_newest_failure();
+
+        // Newest capture measurements, in codes and microseconds of sample time
+        portENTER_CRITICAL(&s_data_lock);
+        meas_result_t meas = s_last_meas;
+        uint64_t meas_pos = s_last_meas_pos;
+        portEXIT_CRITICAL(&s_data_lock);
+        if (MEAS_ENABLE && meas_pos != 0)
+        {
+            const float us = 1e6f / s_meas_cfg.sample_rate_hz;
+            ESP_LOGI(TAG, "Meas @%" PRIu64 ": top %.0f base %.0f ampl %.0f overshoot %.1f%% rise %.2f us fall %.2f us "
+                          "width %.2f us freq %.1f Hz duty %.1f%%",
+                     meas_pos, meas.top, meas.base, meas.amplitude, meas.overshoot_pct, meas.rise * us, meas.fall * us,
+                     meas.width_pos * us, meas.frequency_hz, meas.duty_pct);
+        }
+
+        // Lock-in output, amplitude in codes; with a reference the frequency is the tracked one
+        portENTER_CRITICAL(&s_data_lock);
+        lockin_result_t lockin = s_lockin_result;
+        portEXIT_CRITICAL(&s_data_lock);
+        if (LOCKIN_ENABLE && lockin.outputs > 0)
+        {
+            ESP_LOGI(TAG, "Lock-in %.3f Hz: X %.2f Y %.2f, amplitude %.2f codes, phase %.1f deg (%" PRIu32 " outputs)",
+                     lockin.ref_hz, lockin.x, lockin.y, lockin.amplitude, lockin.phase_rad * 180 / (float)M_PI,
+                     lockin.outputs);
+        }
+
+        // Interference removed over the newest block: AC power before and after cancellation
+        portENTER_CRITICAL(&s_data_lock);
+        uint64_t lms_head = s_lms_ring.head;
+        float lms_w[LMS_TAPS];
+        memcpy(lms_w, s_lms_w, sizeof(lms_w));
+        portEXIT_CRITICAL(&s_data_lock);
+        range_stats_t raw_st, clean_st;
+        if (LMS_ENABLE && lms_head >= DSP_BLOCK_SAMPLES &&
+            block_index_range_stats_raw(&s_ring[0], lms_head - DSP_BLOCK_SAMPLES, lms_head, &raw_st) &&
+            block_index_range_stats_raw(&s_lms_ring, lms_head - DSP_BLOCK_SAMPLES, lms_head, &clean_st))
+        {
+            int peak = 0;
+            for (int k = 1; k < LMS_TAPS; k++)
+            {
+                peak = fabsf(lms_w[k]) > fabsf(lms_w[peak]) ? k : peak;
             }
+            float n = DSP_BLOCK_SAMPLES;
+            float raw_var = raw_st.sum_sq / n - ((float)raw_st.sum / n) * ((float)raw_st.sum / n);
+            float clean_var = clean_st.sum_sq / n - ((float)clean_st.sum / n) * ((float)clean_st.sum / n);
+            ESP_LOGI(TAG, "LMS: rms %.1f -> %.1f codes (%.1f dB), strongest tap %d at %.3f",
+                     sqrtf(raw_var), sqrtf(clean_var), 10 * log10f((clean_var + 1e-3f) / (raw_var + 1e-3f)),
+                     peak, lms_w[peak]);
+        }
+
+        // Spike filter: samples replaced so far and the filtered range over the newest block
+        portENTER_CRITICAL(&s_data_lock);
+        uint64_t median_head = s_median_ring.head;
+        uint32_t median_replaced = s_median_replaced;
+        portEXIT_CRITICAL(&s_data_lock);
+        range_stats_t median_st;
+        if (MEDIAN_ENABLE && median_head >= DSP_BLOCK_SAMPLES &&
+            block_index_range_stats_raw(&s_median_ring, median_head - DSP_BLOCK_SAMPLES, median_head, &median_st))
+        {
+            ESP_LOGI(TAG, "%s %u: %" PRIu32 " samples replaced, filtered min %d max %d",
+                     MEDIAN_HAMPEL ? "Hampel" : "Median", MEDIAN_WINDOW, median_replaced, median_st.min, median_st.max);
+        }
+
+        // Newest vibration feature vector
+        portENTER_CRITICAL(&s_data_lock);
+        vib_features_t vib = s_vib_last;
+        uint32_t vib_vectors = s_vib.vectors;
+        portEXIT_CRITICAL(&s_data_lock);
+        if (VIB_ENABLE && vib_vectors > 0)
+        {
+            ESP_LOGI(TAG, "Vib @%" PRIu64 ": rms %.1f peak %.1f crest %.2f skew %.2f kurt %.2f, bands %.1f %.1f %.1f %.1f codes",
+                     vib.pos, vib.rms, vib.peak, vib.crest, vib.skewness, vib.kurtosis, vib.band_rms[0],
+                     vib.band_rms[1], vib.band_rms[2], vib.band_rms[3]);
+        }
+
+        // Archived trend points since the last report, times in seconds of sample time
+        while (TREND_ENABLE)
+        {
+            trend_point_t pt;
+            portENTER_CRITICAL(&s_data_lock);
+            bool more = s_trend_log_rd != s_trend_log_wr;
+            if (more)
+            {
+                pt = s_trend_log[s_trend_log_rd % TREND_LOG_POINTS];
+                s_trend_log_rd++;
+            }
+            portEXIT_CRITICAL(&s_data_lock);
+            if (!more)
+            {
+                break;
+            }
+            ESP_LOGI(TAG, "Trend %.3f s: %.2f codes (%" PRIu64 " averages, %" PRIu64 " kept)",
+                     (double)(pt.t << TREND_DECIM_SHIFT) / (SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT),
+                     (float)pt.v / (1 << TREND_FRAC_BITS), s_trend.inputs, s_trend.archived);
+        }
+
+        // Machine state changes, oldest first
+        portENTER_CRITICAL(&s_data_lock);
+        uint32_t cls_saved = s_cls_saved;
+        portEXIT_CRITICAL(&s_data_lock);
+        if (cls_saved - s_cls_logged > CLS_SAVE_SLOTS)
+        {
+            s_cls_logged = cls_saved - CLS_SAVE_SLOTS; // older slots were reused
+        }
+        for (; s_cls_logged != cls_saved; s_cls_logged++)
+        {
+            portENTER_CRITICAL(&s_data_lock);
+            cls_event_t ev = s_cls_events[s_cls_logged % CLS_SAVE_SLOTS];
+            portEXIT_CRITICAL(&s_data_lock);
+            ESP_LOGW(TAG, "State @%" PRIu64 ": %s -> %s (capture slot %" PRIu32 ")", ev.pos,
+                     ev.from >= 0 ? s_cls_names[ev.from] : "unknown", s_cls_names[ev.to], s_cls_logged % CLS_SAVE_SLOTS);
+        }
+
+        // Sync pulse fit: common time of the newest edge and the clock error it implies
+        portENTER_CRITICAL(&s_data_lock);
+        tsync_status_t sync = s_tsync_status;
+        portEXIT_CRITICAL(&s_data_lock);
+        if (TSYNC_ENABLE && sync.pulses >= 2)
+        {
+            ESP_LOGI(TAG, "Sync: sample %" PRIu64 " at %.6f s common time, clock %+.2f ppm, fit rms %.0f ns "
+                     "(%" PRIu32 " dropped, %" PRIu32 " restarts)",
+                     sync.edge, sync.edge_ns / 1e9, sync.drift_ppm, sync.residual_ns, sync.rejected, sync.restarts);
+        }
+
+        // Newest DDC output
+        portENTER_CRITICAL(&s_data_lock);
+        uint64_t ddc_head = s_ddc_ring.head;
+        portEXIT_CRITICAL(&s_data_lock);
+        if (DDC_ENABLE && ddc_head >= 2)
+        {
+            float i = sample_ring_at(&s_ddc_ring, ddc_head - 2), q = sample_ring_at(&s_ddc_ring, ddc_head - 1);
+            ESP_LOGI(TAG, "DDC %.0f Hz +/- %.0f Hz: %" PRIu64 " I/Q samples at %.0f Hz, newest |IQ| %.1f codes",
+                     s_ddc.cfg.center_hz, ddc_bandwidth_hz(&s_ddc.cfg) / 2, ddc_head / 2, ddc_output_rate_hz(&s_ddc.cfg),
+                     sqrtf(i * i + q * q) / (1 << DDC_OUT_FRAC_BITS));
+        }
+
+        // Calculate and print the average voltage for the last second
+        if (temp_count > 0)
+        {
+            uint32_t average_voltage = temp_sum / temp_count;
+            ESP_LOGI(TAG, "Unit: %s, Channel: %d, Avg Voltage: %" PRIu32 " mV, Samples: %" PRIu32 ", BufPos: %zu",
+                     unit, channel[0], average_voltage, temp_count, temp_wr_pos);
+        }
+        else
+        {
+            ESP_LOGI(TAG, "No new samples in the last second. BufPos: %zu", temp_wr_pos);
+        }
+    }
+}
+
+// =================================================================================
+// FREQUENCY RESPONSE SWEEP
+// =================================================================================
+
+#if SOC_DAC_SUPPORTED
+
+static uint64_t ring_head_locked(void)
+{
+    portENTER_CRITICAL(&s_data_lock);
+    uint64_t head = s_ring[0].head;
+    portEXIT_CRITICAL(&s_data_lock);
+    return head;
+}
+
+// Next table sample on every alarm. The timer and the ADC run off the same clock, so the
+// tone frequency holds exactly against the sample counter; interrupt jitter is averaged out.
+// The oneshot driver call takes a lock, so the interrupt writes the DAC register directly.
+static bool IRAM_ATTR fresp_timer_cb(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx)
+{
+    dac_ll_update_output_value(DAC_CHAN_0, s_fresp_table[s_fresp_idx]);
+    s_fresp_idx = s_fresp_idx + 1 == s_fresp_len ? 0 : s_fresp_idx + 1;
+    return false;
+}
+
+// One sweep: each tone loops from the timer interrupt while its window is placed and phased by the
+// ring's sample counter. The start anchor is only frame-accurate, so absolute phase needs FRESP_REF_SLOT.
+static void fresp_task(void *arg)
+{
+    const uint32_t rate = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT;
+    fresp_config_t cfg = {
+        .adc_rate_hz = rate,
+        .dac_rate_hz = FRESP_DAC_RATE_HZ,
+        .f_start_hz = FRESP_START_HZ,
+        .f_stop_hz = FRESP_STOP_HZ,
+        .points = FRESP_POINTS,
+        .min_table = 16,
+        .max_table = FRESP_MAX_TABLE,
+        .table_align = 1, // no DMA, any length plays
+        .settle_cycles = FRESP_SETTLE_CYCLES,
+        .min_window = FRESP_MIN_WINDOW,
+        .max_window = CHANNEL_RING_SAMPLES / 2, // leave time to correlate before the ring wraps
+    };
+    uint32_t n = fresp_plan(&cfg, s_fresp_pts);
+
+    dac_oneshot_handle_t dac = NULL; // powers and routes the channel; the interrupt writes it
+    dac_oneshot_config_t dac_cfg = {
+        .chan_id = DAC_CHAN_0,
+    };
+    gptimer_handle_t timer = NULL;
+    gptimer_config_t timer_cfg = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = FRESP_TIMER_HZ,
+    };
+    gptimer_alarm_config_t alarm_cfg = {
+        .alarm_count = FRESP_TIMER_HZ / FRESP_DAC_RATE_HZ,
+        .reload_count = 0,
+        .flags.auto_reload_on_alarm = true,
+    };
+    gptimer_event_callbacks_t cbs = {
+        .on_alarm = fresp_timer_cb,
+    };
+    esp_err_t err = n == 0 ? ESP_ERR_INVALID_ARG : dac_oneshot_new_channel(&dac_cfg, &dac);
+    if (err == ESP_OK)
+    {
+        err = gptimer_new_timer(&timer_cfg, &timer);
+        if (err != ESP_OK)
+        {
+            dac_oneshot_del_channel(dac);
+        }
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Fresp: cannot start the sweep: %s", esp_err_to_name(err));
+        vTaskDelete(NULL);
+        return;
+    }
+    ESP_ERROR_CHECK(gptimer_register_event_callbacks(timer, &cbs, NULL));
+    ESP_ERROR_CHECK(gptimer_set_alarm_action(timer, &alarm_cfg));
+    ESP_ERROR_CHECK(gptimer_enable(timer));
+
+    // Ranges must hold still for the whole sweep
+    while (s_autoset_state != AUTOSET_IDLE)
+    {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+
+    int64_t t0 = esp_timer_get_time();
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const fresp_point_t *p = &s_fresp_pts[i];
+        fresp_fill_table(p, s_fresp_table, 128, FRESP_DAC_AMPLITUDE);
+        s_fresp_len = p->table_len;
+        s_fresp_idx = 0;
+        ESP_ERROR_CHECK(gptimer_set_raw_count(timer, 0));
+        ESP_ERROR_CHECK(gptimer_start(timer));
+        uint64_t start = ring_head_locked();
+        uint64_t from = start + p->settle;
+        uint64_t head;
+        while ((head = ring_head_locked()) < from + p->window)
+        {
+            vTaskDelay(pdMS_TO_TICKS(1));
+        }
+        ESP_ERROR_CHECK(gptimer_stop(timer));
+
+        fresp_acc_t acc;
+        fresp_result_t *r = &s_fresp_results[i];
+        fresp_acc_init(&acc, p, start);
+        if (!fresp_acc_add_ring(&acc, &s_ring[0], head, from, p->window) ||
+            !fresp_acc_result(&acc, FRESP_STIM_CODES, r))
+        {
+            ESP_LOGW(TAG, "Fresp %.1f Hz: window overwritten", p->freq_hz);
+            continue;
+        }
+#if FRESP_REF_SLOT >= 0
+        fresp_result_t ref;
+        fresp_acc_init(&acc, p, start);
+        if (fresp_acc_add_ring(&acc, &s_ring[FRESP_REF_SLOT], head, from, p->window) &&
+            fresp_acc_result(&acc, FRESP_STIM_CODES, &ref))
+        {
+            // The reference is converted FRESP_REF_SLOT pattern steps after channel A
+            ref.phase_rad -= 2 * (float)M_PI * p->freq_hz * FRESP_REF_SLOT / ADC_CHANNEL_COUNT / rate;
+            fresp_result_t dut = *r;
+            fresp_relative(&dut, &ref, r);
+        }
+#endif
+        ESP_LOGI(TAG, "Fresp %8.1f Hz: gain %.4f (%6.2f dB), phase %7.2f deg", r->freq_hz, r->gain,
+                 20 * log10f(r->gain), r->phase_rad * 180 / (float)M_PI);
+    }
+    ESP_ERROR_CHECK(gptimer_disable(timer));
+    ESP_ERROR_CHECK(gptimer_del_timer(timer));
+    ESP_ERROR_CHECK(dac_oneshot_del_channel(dac));
+    ESP_LOGI(TAG, "Fresp: %" PRIu32 " points in %.2f s (%.2f s of settle and windows)", n,
+             (esp_timer_get_time() - t0) / 1e6, (double)fresp_sweep_samples(s_fresp_pts, n) / rate);
+    vTaskDelete(NULL);
+}
+#endif
+
+static void continuous_adc_init(adc_channel_t *channel, uint8_t channel_num, adc_continuous_handle_t *out_handle)
+{
+    adc_continuous_handle_t handle = NULL;
+
+    adc_continuous_handle_cfg_t adc_config = {
+        .max_store_buf_size = 4096,
+        .conv_frame_size = EXAMPLE_READ_LEN,
+        .flags.flush_pool = false, // Set to false to detect overflows properly
+    };
+    ESP_ERROR_CHECK(adc_continuous_new_handle(&adc_config, &handle));
+
+    adc_continuous_config_t dig_cfg = {
+        .sample_freq_hz = SAMPLE_FREQ_HZ, // 1 MSPS as per README specifications
+        .conv_mode = EXAMPLE_ADC_CONV_MODE,
+        .format = EXAMPLE_ADC_OUTPUT_TYPE,
+    };
+
+    adc_digi_pattern_config_t adc_pattern[SOC_ADC_PATT_LEN_MAX] = {0};
+    dig_cfg.pattern_num = channel_num;
+    for (int i = 0; i < channel_num; i++)
+    {
+        adc_pattern[i].atten = s_range_atten[s_range];
+        adc_pattern[i].channel = channel[i] & 0x7;
+        adc_pattern[i].unit = EXAMPLE_ADC_UNIT;
+        adc_pattern[i].bit_width = EXAMPLE_ADC_BIT_WIDTH;
+    }
+    dig_cfg.adc_pattern = adc_pattern;
+    ESP_ERROR_CHECK(adc_continuous_config(handle, &dig_cfg));
+
+    *out_handle = handle;
+}
+
+// Calibrate for the current range, then create and start the driver
+static void adc_start(adc_continuous_handle_t *out_handle)
+{
+    do_calibration = adc_calibration_init(EXAMPLE_ADC_UNIT, s_range_atten[s_range], &cali_handle);
+    continuous_adc_init(channel, ADC_CHANNEL_COUNT, out_handle);
+
+    adc_continuous_evt_cbs_t cbs = {
+        .on_conv_done = s_conv_done_cb,
+        .on_pool_ovf = s_pool_ovf_cb, // Register the overflow callback
+    };
+    ESP_ERROR_CHECK(adc_continuous_register_event_callbacks(*out_handle, &cbs, NULL));
+    ESP_ERROR_CHECK(adc_continuous_start(*out_handle));
+}
+
+// Attenuation is fixed per driver instance: restart it in the new range.
+// The rings keep their history and heads, so stages see no gap.
+static void adc_switch_range(adc_continuous_handle_t *handle, int range)
+{
+    ESP_ERROR_CHECK(adc_continuous_stop(*handle));
+    ESP_ERROR_CHECK(adc_continuous_deinit(*handle));
+    if (do_calibration)
+    {
+        ESP_ERROR_CHECK(adc_cali_delete_scheme_line_fitting(cali_handle));
+    }
+    s_range = range;
+    adc_start(handle);
+
+    portENTER_CRITICAL(&s_data_lock);
+    s_autoset_from = s_ring[0].head;
+    portEXIT_CRITICAL(&s_data_lock);
+    s_autoset_state = AUTOSET_MEASURE;
+}
+
+void app_main(void)
+{
+    esp_err_t ret;
+    uint32_t ret_num = 0;
+    uint8_t result[EXAMPLE_READ_LEN] __attribute__((aligned(4))) = {0};
+
+    // RAM usage calculation (as per README):
+    // - READ_LEN (256 bytes) for frame buffer
+    // - CIRC_BUF_SAMPLES * 2 (32768 * 2 = 64KB) for circular buffer
+    // - Task stacks and other overhead
+    // Total ≈ 64KB as mentioned in README
+    ESP_LOGI(TAG, "Initializing ADC continuous capture with %d sample circular buffer (%.1f KB)",
+             CIRC_BUF_SAMPLES, (CIRC_BUF_SAMPLES * sizeof(uint16_t)) / 1024.0);
+
+    s_task_handle = xTaskGetCurrentTaskHandle();
+
+    memset(s_channel_slot, -1, sizeof(s_channel_slot));
+    const sample_ring_t *sources[ADC_CHANNEL_COUNT];
+    for (int c = 0; c < ADC_CHANNEL_COUNT; c++)
+    {
+        s_channel_slot[channel[c] & 0xF] = c;
+        sample_ring_init(&s_ring[c], &circ_buf[c * CHANNEL_RING_SAMPLES], CHANNEL_RING_SAMPLES);
+        block_index_init(&s_block_index[c], &s_ring[c], &s_block_summaries[c * (CHANNEL_RING_SAMPLES / BLOCK_INDEX_SAMPLES)]);
+        sources[c] = &s_ring[c];
+    }
+
+    dsp_graph_init(&s_graph, &s_data_lock);
+    for (size_t m = 0; m < MATH_CHANNEL_COUNT; m++)
+    {
+        const char *err;
+        s_math_ok[m] = math_channel_init(&s_math[m], s_math_exprs[m], sources, ADC_CHANNEL_COUNT,
+                                         s_math_buf[m], MATH_RING_SAMPLES, &err);
+        if (!s_math_ok[m])
+        {
+            ESP_LOGE(TAG, "Math channel \"%s\": %s", s_math_exprs[m], err);
+            continue;
+        }
+
+        dsp_stage_desc_t stage = {
+            .name = s_math_exprs[m],
+            .ctx = &s_math[m],
+            .process = math_stage_process,
+            .num_inputs = s_math[m].prog.num_sources,
+            .worker = DSP_PORT_CORE_ANY,
+        };
+        memcpy(stage.inputs, s_math[m].src, sizeof(stage.inputs));
+        dsp_graph_add_stage(&s_graph, &stage);
+    }
+
+    proto_config_t proto_cfg = {
+        .kind = PROTO_DECODER,
+        .low = PROTO_LOGIC_LOW,
+        .high = PROTO_LOGIC_HIGH,
+        .sample_rate_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT,
+        .uart = {.baud = PROTO_UART_BAUD, .data_bits = 8, .parity = PROTO_PARITY_NONE},
+        .spi = {.mode = 0, .word_bits = 8, .has_miso = ADC_CHANNEL_COUNT > 2},
+    };
+    int proto_lines = proto_num_lines(&proto_cfg);
+    if (PROTO_DECODER != PROTO_NONE)
+    {
+        if (proto_lines > ADC_CHANNEL_COUNT || !proto_decoder_init(&s_proto, &proto_cfg, proto_frame_logged, NULL))
+        {
+            ESP_LOGE(TAG, "Protocol decoder needs %d channels and a valid configuration", proto_lines);
+        }
+        else
+        {
+            dsp_stage_desc_t stage = {
+                .name = "proto",
+                .ctx = &s_proto,
+                .process = proto_stage_process,
+                .flush = proto_stage_flush,
+                .num_inputs = proto_lines,
+                .worker = DSP_PORT_CORE_ANY,
+            };
+            memcpy(stage.inputs, sources, proto_lines * sizeof(sources[0]));
+            dsp_graph_add_stage(&s_graph, &stage);
+        }
+    }
+
+    persist_config_t persist_cfg = {
+        .mode = PERSIST_MODE,
+        .width = PERSIST_WIDTH,
+        .height = PERSIST_HEIGHT,
+        .amp_min = 0,
+        .amp_max = ADC_CODE_FULL_SCALE,
+        .low = PROTO_LOGIC_LOW,
+        .high = PROTO_LOGIC_HIGH,
+        .pre = PERSIST_PRE,
+        .ui_q16 = (uint32_t)(((uint64_t)(SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT) << 16) / PROTO_UART_BAUD),
+        .span_ui = 2,
+    };
+    if (PERSIST_ENABLE && persist_map_init(&s_persist, &persist_cfg, s_persist_bins))
+    {
+        dsp_stage_desc_t stage = {
+            .name = "persist",
+            .ctx = &s_persist,
+            .process = persist_stage_process,
+            .flush = persist_stage_flush,
+            .inputs = {&s_ring[0]},
+            .num_inputs = 1,
+            .worker = DSP_PORT_CORE_ANY,
+        };
+        dsp_graph_add_stage(&s_graph, &stage);
+    }
+
+    median_config_t median_cfg = {
+        .window = MEDIAN_WINDOW,
+        .hampel = MEDIAN_HAMPEL,
+        .n_sigma = MEDIAN_N_SIGMA,
+        .min_dev = MEDIAN_MIN_DEV,
+    };
+    sample_ring_init(&s_median_ring, s_median_buf, MEDIAN_RING_SAMPLES);
+    if (MEDIAN_ENABLE)
+    {
+        if (!median_init(&s_median, &median_cfg))
+        {
+            ESP_LOGE(TAG, "Median: invalid window");
+        }
+        else
+        {
+            dsp_stage_desc_t stage = {
+                .name = "median",
+                .ctx = &s_median,
+                .process = median_stage_process,
+                .flush = median_stage_flush,
+                .inputs = {&s_ring[0]},
+                .num_inputs = 1,
+                .worker = DSP_PORT_CORE_ANY,
+            };
+            dsp_graph_add_stage(&s_graph, &stage);
+            s_capture_ring = &s_median_ring; // registered first, so the capture stage may read it
+        }
+    }
+
+    trigger_config_t trigger_cfg = {
+        .edge = TRIGGER_EDGE,
+        .level = TRIGGER_LEVEL,
+        .hysteresis = TRIGGER_HYSTERESIS,
+        .pre = TRIGGER_PRE,
+        .post = TRIGGER_POST,
+    };
+    s_meas_cfg = (meas_config_t){
+        .level = TRIGGER_LEVEL,
+        .hysteresis = TRIGGER_HYSTERESIS,
+        .hist_min = 0,
+        .hist_shift = EXAMPLE_ADC_BIT_WIDTH - 9, // MEAS_HIST_BINS (512) bins span the code range
+        .sample_rate_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT,
+    };
+    if (trigger_init(&s_trigger, &trigger_cfg))
+    {
+        dsp_stage_desc_t stage = {
+            .name = "capture",
+            .process = capture_stage_process,
+            .flush = capture_stage_flush,
+            .inputs = {s_capture_ring},
+            .num_inputs = 1,
+            .worker = DSP_PORT_CORE_ANY,
+        };
+        s_capture_running = dsp_graph_add_stage(&s_graph, &stage) >= 0;
+    }
+
+    lockin_config_t lockin_cfg = {
+        .sample_rate_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT,
+        .ref_hz = LOCKIN_FREQ_HZ,
+        .decim_shift = LOCKIN_DECIM_SHIFT,
+        .order = LOCKIN_ORDER,
+        .tau_s = LOCKIN_TAU_MS / 1000.0f,
+    };
+    if (LOCKIN_ENABLE)
+    {
+        if (!lockin_init(&s_lockin, &lockin_cfg))
+        {
+            ESP_LOGE(TAG, "Lock-in: invalid configuration");
+        }
+        else
+        {
+            dsp_stage_desc_t stage = {
+                .name = "lockin",
+                .ctx = &s_lockin,
+                .process = lockin_stage_process,
+                .flush = lockin_stage_flush,
+                .inputs = {&s_ring[0]},
+                .num_inputs = 1,
+                .worker = DSP_PORT_CORE_ANY,
+            };
+#if LOCKIN_REF_SLOT >= 0
+            stage.inputs[1] = &s_ring[LOCKIN_REF_SLOT];
+            stage.num_inputs = 2;
+#endif
+            dsp_graph_add_stage(&s_graph, &stage);
+        }
+    }
+
+    int ddc_shift = ddc_shift_for_bandwidth(SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT, DDC_BANDWIDTH_HZ);
+    ddc_config_t ddc_cfg = {
+        .sample_rate_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT,
+        .center_hz = DDC_CENTER_HZ,
+        .cic_shift = ddc_shift < 0 ? 0 : (uint8_t)ddc_shift,
+        .cic_order = DDC_ORDER,
+        .offset = ADC_CODE_MID,
+    };
+    sample_ring_init(&s_ddc_ring, s_ddc_buf, DDC_RING_SAMPLES);
+    if (DDC_ENABLE)
+    {
+        if (ddc_shift < 0 || !ddc_init(&s_ddc, &ddc_cfg))
+        {
+            ESP_LOGE(TAG, "DDC: invalid center frequency or bandwidth");
+        }
+        else
+        {
+            dsp_stage_desc_t stage = {
+                .name = "ddc",
+                .ctx = &s_ddc,
+                .process = ddc_stage_process,
+                .flush = ddc_stage_flush,
+                .inputs = {&s_ring[0]},
+                .num_inputs = 1,
+                .worker = DSP_PORT_CORE_ANY,
+            };
+            dsp_graph_add_stage(&s_graph, &stage);
+        }
+    }
+    sample_ring_init(&s_lms_ring, s_lms_buf, LMS_RING_SAMPLES);
+#if LMS_ENABLE
+    // The reference ring only exists with a second channel, hence #if rather than if
+    lms_config_t lms_cfg = {
+        .taps = LMS_TAPS,
+        .mu_shift = LMS_MU_SHIFT,
+        .normalized = true,
+    };
+    if (!lms_init(&s_lms, &lms_cfg))
+    {
+        ESP_LOGE(TAG, "LMS: invalid configuration");
+    }
+    else
+    {
+        dsp_stage_desc_t stage = {
+            .name = "lms",
+            .ctx = &s_lms,
+            .process = lms_stage_process,
+            .inputs = {&s_ring[0], &s_ring[LMS_REF_SLOT]},
+            .num_inputs = 2,
+            .worker = DSP_PORT_CORE_ANY,
+        };
+        dsp_graph_add_stage(&s_graph, &stage);
+    }
+#endif
+    vib_config_t vib_cfg = {
+        .sample_rate_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT,
+        .window_shift = VIB_WINDOW_SHIFT,
+        .band_decim_shift = VIB_BAND_DECIM_SHIFT,
+        .num_bands = VIB_BAND_COUNT,
+    };
+    memcpy(vib_cfg.bands, s_vib_bands, sizeof(s_vib_bands));
+    trend_config_t trend_cfg = {
+        .mode = TREND_MODE,
+        .tol = TREND_TOL_CODES << TREND_FRAC_BITS,
+        .max_gap = (uint32_t)(((uint64_t)TREND_MAX_GAP_S * (SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT)) >> TREND_DECIM_SHIFT),
+    };
+    if (TREND_ENABLE)
+    {
+        if (!trend_init(&s_trend, &trend_cfg))
+        {
+            ESP_LOGE(TAG, "Trend: invalid tolerance or gap");
+        }
+        else
+        {
+            dsp_stage_desc_t stage = {
+                .name = "trend",
+                .ctx = &s_trend,
+                .process = trend_stage_process,
+                .flush = trend_stage_flush,
+                .inputs = {&s_ring[0]},
+                .num_inputs = 1,
+                .worker = DSP_PORT_CORE_ANY,
+            };
+            dsp_graph_add_stage(&s_graph, &stage);
+        }
+    }
+    const cls_float_layer_t cls_layers[] = {
+        {.inputs = CLS_FEATURES, .outputs = CLS_CLASSES, .relu = false, .w = s_cls_w, .b = s_cls_b},
+    };
+    if (CLS_ENABLE)
+    {
+        s_cls_ready = cls_quantize(&s_cls_model, cls_layers, 1, s_cls_mean, s_cls_std, s_cls_calib, CLS_CLASSES);
+        cls_tracker_init(&s_cls_tracker, CLS_CONFIRM);
+        if (!s_cls_ready)
+        {
+            ESP_LOGE(TAG, "Classifier: invalid model");
+        }
+    }
+    if (VIB_ENABLE)
+    {
+        if (!vib_init(&s_vib, &vib_cfg, vib_features_ready, NULL))
+        {
+            ESP_LOGE(TAG, "Vibration: invalid window or bands");
+        }
+        else
+        {
+            dsp_stage_desc_t stage = {
+                .name = "vib",
+                .ctx = &s_vib,
+                .process = vib_stage_process,
+                .flush = vib_stage_flush,
+                .inputs = {&s_ring[0]},
+                .num_inputs = 1,
+                .worker = DSP_PORT_CORE_ANY,
+            };
+            dsp_graph_add_stage(&s_graph, &stage);
+        }
+    }
+#if TSYNC_ENABLE
+    // The pulse ring only exists with a second channel, as for LMS
+    trigger_config_t tsync_trig_cfg = {
+        .edge = TRIGGER_RISING,
+        .level = TSYNC_LEVEL,
+        .hysteresis = 200,
+        .pre = 0,
+        .post = 1,
+        .holdoff = (uint32_t)((uint64_t)TSYNC_PERIOD_MS * (SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT) / 2000),
+    };
+    tsync_config_t tsync_cfg = {
+        .nominal_hz = SAMPLE_FREQ_HZ / ADC_CHANNEL_COUNT,
+        .window = TSYNC_WINDOW,
+        .max_residual_ns = TSYNC_MAX_RESIDUAL_US * 1000,
+    };
+    if (!trigger_init(&s_tsync_trigger, &tsync_trig_cfg) || !tsync_init(&s_tsync, &tsync_cfg))
+    {
+        ESP_LOGE(TAG, "Sync: invalid pulse or fit configuration");
+    }
+    else
+    {
+        dsp_stage_desc_t stage = {
+            .name = "tsync",
+            .ctx = &s_tsync,
+            .process = tsync_stage_process,
+            .flush = tsync_stage_flush,
+            .inputs = {&s_ring[TSYNC_SLOT]},
+            .num_inputs = 1,
+            .worker = DSP_PORT_CORE_ANY,
+        };
+        dsp_graph_add_stage(&s_graph, &stage);
+    }
+#endif
+    // Register further stages here (filters, FFT, detectors) before the graph starts
+    if (!dsp_graph_start(&s_graph, DSP_WORKER_COUNT))
+    {
+        ESP_LOGE(TAG, "Failed to start DSP workers");
+        s_capture_running = false;
+    }
+
+    // REMOVED: Queue is no longer needed
+    // NEW: Create the processing and display task
+    xTaskCreate(processing_task, "processing_task", PROCESSING_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
+
+    adc_continuous_handle_t handle = NULL;
+    adc_start(&handle);
+    if (AUTOSET_ENABLE)
+    {
+        s_autoset_state = AUTOSET_MEASURE;
+    }
+#if SOC_DAC_SUPPORTED
+    if (FRESP_ENABLE)
+    {
+        xTaskCreate(fresp_task, "fresp", FRESP_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1, NULL);
+    }
+#endif
+
+    while (1)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (1)
+        {
+            ret = adc_continuous_read(handle, result, EXAMPLE_READ_LEN, &ret_num, 0);
+
+            if (ret == ESP_OK)
+            {
+                // Batch process the entire frame to minimize critical sections
+                size_t samples_in_frame = ret_num / SOC_ADC_DIGI_RESULT_BYTES;
+                uint64_t frame_voltage_sum = 0;
+                uint32_t frame_sample_count = 0;
+
+                // Get current write positions once at start of frame
+                // Only this task advances the heads, so no lock is needed to read them
+                uint64_t local_head[ADC_CHANNEL_COUNT];
+                for (int c = 0; c < ADC_CHANNEL_COUNT; c++)
+                {
+                    local_head[c] = s_ring[c].head;
+                }
+
+                // Process all samples in the frame without any critical sections
+                for (int i = 0; i < ret_num; i += SOC_ADC_DIGI_RESULT_BYTES)
+                {
+                    adc_digi_output_data_t *p = (adc_digi_output_data_t *)&result[i];
+                    uint32_t raw_data = EXAMPLE_ADC_GET_DATA(p);
+                    int slot = s_channel_slot[EXAMPLE_ADC_GET_CHANNEL(p) & 0xF];
+                    if (slot < 0)
+                    {
+                        continue;
+                    }
+
+                    // Store in the channel's ring (no critical section needed per sample)
+                    s_ring[slot].buf[local_head[slot] & CHANNEL_RING_MASK] = (sample_t)raw_data;
+                    local_head[slot]++;
+                    if (slot != 0)
+                    {
+                        continue;
+                    }
+
+                    // Count every sample of the first channel for statistics
+                    frame_sample_count++;
+
+                    // Only do voltage calibration on every 8th sample to reduce CPU load
+                    // This still gives accurate average while preventing watchdog timeout
+                    if (do_calibration && (frame_sample_count & 0x7) == 0)
+                    {
+                        int voltage_mv = 0;
+                        if (adc_cali_raw_to_voltage(cali_handle, raw_data, &voltage_mv) == ESP_OK)
+                        {
+                            frame_voltage_sum += voltage_mv * 8; // Scale up to compensate for sampling
+                        }
+                    }
+                }
+
+                // Summarize completed blocks before readers can see them
+                for (int c = 0; c < ADC_CHANNEL_COUNT; c++)
+                {
+                    block_index_commit(&s_block_index[c], local_head[c]);
+                }
+
+                // Update all shared variables once per frame (single critical section)
+                portENTER_CRITICAL(&s_data_lock);
+                for (int c = 0; c < ADC_CHANNEL_COUNT; c++)
+                {
+                    s_ring[c].head = local_head[c];
+                }
+                s_voltage_sum += frame_voltage_sum;
+                s_sample_count += frame_sample_count;
+                portEXIT_CRITICAL(&s_data_lock);
+
+                // Stages consume whole blocks on the DSP workers
+                dsp_graph_notify(&s_graph);
+            }
+            else if (ret == ESP_ERR_TIMEOUT)
+            {
+                // Buffer is empty, break to wait for next notification
+                break;
+            }
+            else
+            {
+                ESP_LOGE(TAG, "ADC read error: %s", esp_err_to_name(ret));
+            }
+        }
+
+        if (s_autoset_state == AUTOSET_SWITCH)
+        {
+            adc_switch_range(&handle, s_range_request);
         }
 
         // Give IDLE task more time to run and feed watchdog
@@ -0,0 +1,197 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include "ddc.h"
+#include "nco.h"
+
+#define FIR_GUARD_BITS 8     // extra fraction carried from the CIC into the FIR
+#define FIR_PASS 0.2         // passband edge in cycles per FIR input sample (0.4 of the output rate)
+#define FIR_CUTOFF 0.25      // ideal cutoff, midway to the first alias at 0.3
+#define FIR_KAISER_BETA 7.0  // about 70 dB of stopband for the 0.1 transition
+#define FIR_DESIGN_STEPS 2048
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double bessel_i0(double x)
+{
+    double sum = 1, term = 1;
+    for (int k = 1; k < 40; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+// CIC magnitude at u cycles per CIC output sample
+static double cic_gain(double u, uint32_t r, uint8_t order)
+{
+    if (u == 0 || r == 1)
+    {
+        return 1;
+    }
+    return pow(fabs(sin(M_PI * u) / (r * sin(M_PI * u / r))), order);
+}
+
+// Low-pass with the inverse CIC droop over the passband, by integrating the target response
+// and applying a Kaiser window. DC gain is 1, less the NCO table's 32767/32768.
+static void design_fir(ddc_t *d)
+{
+    const uint32_t r = 1u << d->cfg.cic_shift;
+    const int c = DDC_FIR_TAPS / 2;
+    double h[DDC_FIR_TAPS / 2 + 1];
+    double dc = 0;
+    for (int k = 0; k <= c; k++)
+    {
+        int m = c - k;
+        double acc = 0;
+        for (int j = 0; j < FIR_DESIGN_STEPS; j++)
+        {
+            double u = FIR_CUTOFF * (j + 0.5) / FIR_DESIGN_STEPS;
+            double target = 1 / cic_gain(u < FIR_PASS ? u : FIR_PASS, r, d->cfg.cic_order);
+            acc += target * cos(2 * M_PI * u * m);
+        }
+        double w = (double)m / c;
+        h[k] = 2 * acc * FIR_CUTOFF / FIR_DESIGN_STEPS * bessel_i0(FIR_KAISER_BETA * sqrt(1 - w * w)) /
+               bessel_i0(FIR_KAISER_BETA);
+        dc += k == c ? h[k] : 2 * h[k];
+    }
+    for (int k = 0; k <= c; k++)
+    {
+        d->taps[k] = (int16_t)lrint(h[k] / dc * 32768 * 32768 / NCO_ONE);
+    }
+}
+
+bool ddc_init(ddc_t *d, const ddc_config_t *cfg)
+{
+    memset(d, 0, sizeof(*d));
+    if (cfg->sample_rate_hz == 0 || 2 * fabsf(cfg->center_hz) > cfg->sample_rate_hz ||
+        cfg->cic_shift > DDC_MAX_SHIFT || cfg->cic_order < 1 || cfg->cic_order > DDC_MAX_ORDER)
+    {
+        return false;
+    }
+    d->cfg = *cfg;
+    d->inc = nco_phase_inc(cfg->center_hz, cfg->sample_rate_hz);
+    // Products fit 32 signed bits and the CIC grows order * shift bits; wrapping is harmless
+    // as long as the comb output fits the 64-bit registers
+    int growth = cfg->cic_order * cfg->cic_shift;
+    d->pre_shift = growth > 32 ? (uint8_t)(growth - 32) : 0;
+    // A tone of amplitude A mixes to A * 2^14 per sample; scale the CIC output to A << (frac + guard)
+    d->cic_out_shift = (uint8_t)(growth - d->pre_shift + 14 - DDC_OUT_FRAC_BITS - FIR_GUARD_BITS);
+    design_fir(d);
+    nco_table();
+    return true;
+}
+
+// Mix and integrate m samples; all of them belong to the same CIC output
+static void integrate(ddc_t *d, const sample_t *s, size_t m)
+{
+    const int16_t *tab = nco_table();
+    const int32_t offset = d->cfg.offset;
+    const uint8_t pre = d->pre_shift;
+    const int32_t round = pre ? 1 << (pre - 1) : 0;
+    const int order = d->cfg.cic_order;
+    uint32_t phase = d->phase;
+    for (size_t k = 0; k < m; k++)
+    {
+        uint32_t idx = nco_index(phase);
+        int32_t x = s[k] - offset;
+        uint64_t vi = (uint64_t)(int64_t)((x * tab[nco_cos_index(idx)] + round) >> pre);
+        uint64_t vq = (uint64_t)(int64_t)((-x * tab[idx] + round) >> pre);
+        for (int j = 0; j < order; j++)
+        {
+            vi = d->integ_i[j] += vi;
+            vq = d->integ_q[j] += vq;
+        }
+        phase += d->inc;
+    }
+    d->phase = phase;
+}
+
+static int32_t comb(uint64_t *delay, uint64_t v, int order, uint8_t shift)
+{
+    for (int j = 0; j < order; j++)
+    {
+        uint64_t t = v - delay[j];
+        delay[j] = v;
+        v = t;
+    }
+    return (int32_t)(((int64_t)v + ((int64_t)1 << (shift - 1))) >> shift);
+}
+
+static int16_t fir(const int16_t *taps, const int32_t *x)
+{
+    const int c = DDC_FIR_TAPS / 2;
+    int64_t acc = (int64_t)taps[c] * x[c];
+    for (int k = 0; k < c; k++)
+    {
+        acc += (int64_t)taps[k] * (x[k] + x[DDC_FIR_TAPS - 1 - k]);
+    }
+    acc = (acc + ((int64_t)1 << (14 + FIR_GUARD_BITS))) >> (15 + FIR_GUARD_BITS);
+    return (int16_t)(acc > INT16_MAX ? INT16_MAX : acc < INT16_MIN ? INT16_MIN : acc);
+}
+
+size_t ddc_process(ddc_t *d, const sample_t *s, size_t n, sample_ring_t *iq)
+{
+    const uint32_t r = 1u << d->cfg.cic_shift;
+    const int order = d->cfg.cic_order;
+    size_t produced = 0;
+    while (n > 0)
+    {
+        size_t m = r - d->count;
+        m = m < n ? m : n;
+        integrate(d, s, m);
+        d->count += (uint32_t)m;
+        s += m;
+        n -= m;
+        if (d->count < r)
+        {
+            break;
+        }
+        d->count = 0;
+
+        // CIC output into the FIR delay line; the FIR runs on every second one
+        uint32_t p = d->fir_pos;
+        d->fir_i[p] = d->fir_i[p + DDC_FIR_TAPS] = comb(d->comb_i, d->integ_i[order - 1], order, d->cic_out_shift);
+        d->fir_q[p] = d->fir_q[p + DDC_FIR_TAPS] = comb(d->comb_q, d->integ_q[order - 1], order, d->cic_out_shift);
+        d->fir_pos = p + 1 == DDC_FIR_TAPS ? 0 : p + 1;
+        d->fir_phase ^= 1;
+        if (d->fir_phase)
+        {
+            continue;
+        }
+        size_t w = (size_t)(2 * d->outputs) & iq->mask;
+        iq->buf[w] = fir(d->taps, &d->fir_i[d->fir_pos]);
+        iq->buf[w + 1] = fir(d->taps, &d->fir_q[d->fir_pos]);
+        d->outputs++;
+        produced++;
+    }
+    return produced;
+}
+
+float ddc_output_rate_hz(const ddc_config_t *cfg)
+{
+    return (float)cfg->sample_rate_hz / (2u << cfg->cic_shift);
+}
+
+float ddc_bandwidth_hz(const ddc_config_t *cfg)
+{
+    return 2 * FIR_PASS * 2 * ddc_output_rate_hz(cfg);
+}
+
+int ddc_shift_for_bandwidth(uint32_t sample_rate_hz, float bandwidth_hz)
+{
+    for (int shift = DDC_MAX_SHIFT; shift >= 0; shift--)
+    {
+        ddc_config_t cfg = {.sample_rate_hz = sample_rate_hz, .cic_shift = (uint8_t)shift};
+        if (ddc_bandwidth_hz(&cfg) >= bandwidth_hz)
+        {
+            return shift;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Digital downconverter: complex baseband around a chosen center frequency
+ *
+ * Each sample, less a fixed offset, is multiplied by the NCO cosine and
+ * negated sine (Q15), shifting center_hz to DC. A CIC filter of cic_order
+ * stages decimates by 2^cic_shift in wrapping 64-bit integers; a 47-tap FIR,
+ * designed at init to flatten the CIC droop, then low-passes and halves the
+ * rate again. Bandwidth is therefore chosen in octaves: the output rate is
+ * sample_rate / 2^(cic_shift + 1), and the flat passband is 0.8 of it
+ * (+-0.4 output rate around the center).
+ *
+ * Outputs are interleaved I/Q pairs of int16 in an ordinary sample ring, so
+ * the ring's head advances by two per complex sample and the existing ring
+ * readers, graph stages and capture export apply unchanged. A real tone of
+ * amplitude A codes in the passband gives |I + jQ| = A << DDC_OUT_FRAC_BITS.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DDC_MAX_ORDER 4
+#define DDC_MAX_SHIFT 10
+#define DDC_FIR_TAPS 47
+#define DDC_OUT_FRAC_BITS 2 // outputs are in quarter codes
+
+typedef struct
+{
+    uint32_t sample_rate_hz;
+    float center_hz;   // -rate/2 .. rate/2, lands at DC
+    uint8_t cic_shift; // CIC decimates by 2^cic_shift, 0..DDC_MAX_SHIFT; the FIR halves again
+    uint8_t cic_order; // 1..DDC_MAX_ORDER, more stages reject more aliasing
+    int16_t offset;    // code subtracted before mixing, usually mid-scale
+} ddc_config_t;
+
+typedef struct
+{
+    ddc_config_t cfg;
+    uint32_t phase; // NCO, Q32 turns
+    uint32_t inc;
+    uint32_t count;   // samples into the current CIC output
+    uint8_t pre_shift; // products are scaled down so the CIC cannot outgrow 64 bits
+    uint8_t cic_out_shift;
+    uint64_t integ_i[DDC_MAX_ORDER];
+    uint64_t integ_q[DDC_MAX_ORDER];
+    uint64_t comb_i[DDC_MAX_ORDER];
+    uint64_t comb_q[DDC_MAX_ORDER];
+    int16_t taps[(DDC_FIR_TAPS + 1) / 2]; // Q15, symmetric: centre tap last
+    int32_t fir_i[2 * DDC_FIR_TAPS];      // delay line written twice, read contiguously
+    int32_t fir_q[2 * DDC_FIR_TAPS];
+    uint32_t fir_pos;
+    uint32_t fir_phase; // FIR inputs since the last output, 0 or 1
+    uint64_t outputs;   // complex samples produced
+} ddc_t;
+
+bool ddc_init(ddc_t *d, const ddc_config_t *cfg);
+
+// Process n samples, writing I/Q pairs into the iq ring past its head. Returns outputs produced; the caller
+// then publishes head = 2 * outputs (dsp_graph_publish() on the device). The ring capacity must be even.
+size_t ddc_process(ddc_t *d, const sample_t *s, size_t n, sample_ring_t *iq);
+
+// Complex output rate, Hz
+float ddc_output_rate_hz(const ddc_config_t *cfg);
+
+// Two-sided flat bandwidth around the center, Hz
+float ddc_bandwidth_hz(const ddc_config_t *cfg);
+
+// Largest cic_shift whose bandwidth still covers bandwidth_hz, or -1 if even cic_shift 0 is too narrow
+int ddc_shift_for_bandwidth(uint32_t sample_rate_hz, float bandwidth_hz);
+
+#ifdef __cplusplus
+}
+#endif
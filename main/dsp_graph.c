@@ -0,0 +1,263 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "dsp_graph.h"
+
+#define BLOCK_ALIGN_MASK ((uint64_t)DSP_BLOCK_SAMPLES - 1)
+
+void dsp_graph_init(dsp_graph_t *graph, dsp_port_lock_t *lock)
+{
+    memset(graph, 0, sizeof(*graph));
+    graph->lock = lock;
+}
+
+int dsp_graph_add_stage(dsp_graph_t *graph, const dsp_stage_desc_t *desc)
+{
+    if (graph->running || graph->num_stages >= DSP_MAX_STAGES || desc->process == NULL ||
+        desc->num_inputs == 0 || desc->num_inputs > DSP_MAX_INPUTS)
+    {
+        return -1;
+    }
+
+    dsp_stage_t *st = &graph->stages[graph->num_stages];
+    memset(st, 0, sizeof(*st));
+    st->desc = *desc;
+    st->graph = graph;
+
+    // Start at the first whole block every input can still provide
+    uint64_t start = UINT64_MAX;
+    for (int i = 0; i < desc->num_inputs; i++)
+    {
+        uint64_t head = dsp_graph_head(graph, desc->inputs[i]);
+        start = head < start ? head : start;
+    }
+    st->done = start & ~BLOCK_ALIGN_MASK;
+    return graph->num_stages++;
+}
+
+uint64_t dsp_graph_head(dsp_graph_t *graph, const sample_ring_t *ring)
+{
+    dsp_port_lock(graph->lock);
+    uint64_t head = ring->head;
+    dsp_port_unlock(graph->lock);
+    return head;
+}
+
+void dsp_graph_publish(dsp_graph_t *graph, sample_ring_t *ring, uint64_t head)
+{
+    dsp_port_lock(graph->lock);
+    ring->head = head;
+    dsp_port_unlock(graph->lock);
+    dsp_graph_notify(graph);
+}
+
+static uint32_t run_stage(dsp_graph_t *graph, dsp_stage_t *st, int worker)
+{
+    const dsp_stage_desc_t *d = &st->desc;
+    if (!st->started)
+    {
+        if (d->init && !d->init(d->ctx))
+        {
+            return 0;
+        }
+        st->started = true;
+    }
+
+    // Snapshot every input head in one critical section
+    uint64_t avail = UINT64_MAX;
+    uint64_t oldest = 0;
+    dsp_port_lock(graph->lock);
+    for (int i = 0; i < d->num_inputs; i++)
+    {
+        uint64_t head = d->inputs[i]->head;
+        uint64_t old = sample_ring_oldest(d->inputs[i]);
+        avail = head < avail ? head : avail;
+        oldest = old > oldest ? old : oldest;
+    }
+    dsp_port_unlock(graph->lock);
+
+    if (st->done < oldest)
+    {
+        // Fell a whole ring behind: the stage's history is no longer contiguous
+        if (d->flush)
+        {
+            d->flush(d->ctx);
+        }
+        st->done = (oldest + BLOCK_ALIGN_MASK) & ~BLOCK_ALIGN_MASK;
+        dsp_port_lock(graph->lock);
+        st->stats.gaps++;
+        dsp_port_unlock(graph->lock);
+    }
+
+    uint32_t blocks = 0;
+    dsp_block_t blk = {.len = DSP_BLOCK_SAMPLES, .worker = worker};
+    while (st->done + DSP_BLOCK_SAMPLES <= avail)
+    {
+        // Aligned blocks never wrap inside a ring whose capacity is a multiple of the block
+        blk.pos = st->done;
+        for (int i = 0; i < d->num_inputs; i++)
+        {
+            blk.in[i] = &d->inputs[i]->buf[st->done & d->inputs[i]->mask];
+        }
+
+        int64_t t0 = dsp_port_time_us();
+        d->process(d->ctx, &blk);
+        int64_t dt = dsp_port_time_us() - t0;
+
+        st->done += DSP_BLOCK_SAMPLES;
+        blocks++;
+        dsp_port_lock(graph->lock);
+        st->stats.blocks++;
+        st->stats.total_us += dt;
+        if (dt > st->stats.max_us)
+        {
+            st->stats.max_us = dt;
+        }
+        dsp_port_unlock(graph->lock);
+    }
+    return blocks;
+}
+
+uint32_t dsp_graph_run_pending(dsp_graph_t *graph)
+{
+    uint32_t total = 0;
+    uint32_t progress;
+    do
+    {
+        // Repeat so a consumer registered after its producer sees fresh output
+        progress = 0;
+        for (int s = 0; s < graph->num_stages; s++)
+        {
+            progress += run_stage(graph, &graph->stages[s], 0);
+        }
+        total += progress;
+    } while (progress > 0);
+    return total;
+}
+
+// Scheduler unit: one activation of a stage, looping while notifications arrive
+static void stage_task(void *arg, int worker)
+{
+    dsp_stage_t *st = arg;
+    dsp_graph_t *graph = st->graph;
+    while (1)
+    {
+        run_stage(graph, st, worker);
+
+        dsp_port_lock(graph->lock);
+        if (!st->dirty)
+        {
+            st->queued = false;
+            dsp_port_unlock(graph->lock);
+            return;
+        }
+        st->dirty = false;
+        dsp_port_unlock(graph->lock);
+    }
+}
+
+// Whole block available or a gap to report. Call with graph->lock held.
+static bool stage_ready(const dsp_stage_t *st)
+{
+    for (int i = 0; i < st->desc.num_inputs; i++)
+    {
+        const sample_ring_t *in = st->desc.inputs[i];
+        if (st->done < sample_ring_oldest(in))
+        {
+            return true;
+        }
+        if (in->head < st->done + DSP_BLOCK_SAMPLES)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void dsp_graph_notify(dsp_graph_t *graph)
+{
+    if (!__atomic_load_n(&graph->running, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+    for (int s = 0; s < graph->num_stages; s++)
+    {
+        dsp_stage_t *st = &graph->stages[s];
+        bool submit = false;
+
+        dsp_port_lock(graph->lock);
+        if (st->queued)
+        {
+            st->dirty = true;
+        }
+        else if (stage_ready(st))
+        {
+            st->queued = true;
+            submit = true;
+        }
+        dsp_port_unlock(graph->lock);
+
+        if (submit && !dsp_sched_submit(&graph->sched, st->desc.worker, stage_task, st))
+        {
+            // Deque full: leave it to the next notification
+            dsp_port_lock(graph->lock);
+            st->queued = false;
+            dsp_port_unlock(graph->lock);
+        }
+    }
+}
+
+bool dsp_graph_start(dsp_graph_t *graph, int num_workers)
+{
+    if (!dsp_sched_start(&graph->sched, num_workers))
+    {
+        return false;
+    }
+    num_workers = graph->sched.num_workers;
+
+    int next = 0;
+    for (int s = 0; s < graph->num_stages; s++)
+    {
+        int *wk = &graph->stages[s].desc.worker;
+        if (*wk == DSP_PORT_CORE_ANY || *wk >= num_workers)
+        {
+            *wk = next;
+            next = (next + 1) % num_workers;
+        }
+    }
+
+    __atomic_store_n(&graph->running, true, __ATOMIC_RELEASE);
+    dsp_graph_notify(graph);
+    return true;
+}
+
+void dsp_graph_stop(dsp_graph_t *graph)
+{
+    // Queued activations still run while the scheduler drains
+    __atomic_store_n(&graph->running, false, __ATOMIC_RELEASE);
+    dsp_sched_stop(&graph->sched);
+
+    for (int s = 0; s < graph->num_stages; s++)
+    {
+        dsp_stage_t *st = &graph->stages[s];
+        if (st->started && st->desc.flush)
+        {
+            st->desc.flush(st->desc.ctx);
+        }
+    }
+}
+
+void dsp_graph_get_stats(dsp_graph_t *graph, int stage, dsp_stage_stats_t *out, bool reset)
+{
+    dsp_port_lock(graph->lock);
+    *out = graph->stages[stage].stats;
+    if (reset)
+    {
+        memset(&graph->stages[stage].stats, 0, sizeof(graph->stages[stage].stats));
+    }
+    dsp_port_unlock(graph->lock);
+}
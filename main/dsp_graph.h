@@ -0,0 +1,120 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * DSP stage graph
+ *
+ * A stage is a set of callbacks (init / process block / flush) plus the rings
+ * it reads. Stages that produce samples write their own output ring and
+ * publish its head with dsp_graph_publish(); any stage registered later may use
+ * that ring as an input, which is what makes the registry a graph.
+ *
+ * Scheduling is pull based: every stage remembers the next absolute position
+ * it needs and, once all of its inputs hold a whole block there, an activation
+ * of the stage is queued on the work-stealing scheduler (dsp_sched.h). A stage
+ * runs on at most one worker at a time, keeping its blocks in order, while
+ * different stages and any units they fork spread over both cores. The drain
+ * loop only publishes ring heads and calls dsp_graph_notify(); adding a filter,
+ * FFT or detector means registering a stage, not editing the drain loop.
+ */
+#pragma once
+
+#include "sample_ring.h"
+#include "dsp_port.h"
+#include "dsp_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSP_MAX_STAGES 16
+#define DSP_MAX_INPUTS 4
+#define DSP_BLOCK_SAMPLES 256 // same as BLOCK_INDEX_SAMPLES and MATH_BLOCK_SAMPLES
+
+typedef struct
+{
+    uint64_t pos;                      // absolute position of in[*][0]
+    const sample_t *in[DSP_MAX_INPUTS]; // DSP_BLOCK_SAMPLES samples per input, read-only
+    size_t len;
+    int worker; // index of the running worker (see dsp_task_fn_t), for per-worker scratch
+} dsp_block_t;
+
+typedef struct
+{
+    const char *name;
+    void *ctx;
+    bool (*init)(void *ctx);                            // optional, once before the first block
+    void (*process)(void *ctx, const dsp_block_t *blk); // required
+    void (*flush)(void *ctx);                           // optional, on input gaps and at stop
+    const sample_ring_t *inputs[DSP_MAX_INPUTS];
+    uint8_t num_inputs;
+    int worker; // preferred worker, DSP_PORT_CORE_ANY to let the graph balance stages
+} dsp_stage_desc_t;
+
+typedef struct
+{
+    uint32_t blocks;
+    uint32_t gaps;     // times the stage fell a full ring behind and was flushed
+    int64_t total_us;
+    int64_t max_us;
+} dsp_stage_stats_t;
+
+typedef struct dsp_graph dsp_graph_t;
+
+typedef struct
+{
+    dsp_stage_desc_t desc;
+    dsp_graph_t *graph;
+    uint64_t done; // next absolute position to process
+    bool started;
+    bool queued; // an activation is queued or running
+    bool dirty;  // new input arrived while queued, run again before going idle
+    dsp_stage_stats_t stats;
+} dsp_stage_t;
+
+struct dsp_graph
+{
+    dsp_port_lock_t *lock; // protects ring heads and stage scheduling state
+    dsp_stage_t stages[DSP_MAX_STAGES];
+    int num_stages;
+    dsp_sched_t sched;
+    bool running; // read atomically by producers calling dsp_graph_notify()
+};
+
+// lock is the lock the ring producers publish heads under (s_data_lock on device)
+void dsp_graph_init(dsp_graph_t *graph, dsp_port_lock_t *lock);
+
+// Register a stage. Returns its index, or -1 if the graph is full or desc is invalid.
+// Must be called before dsp_graph_start.
+int dsp_graph_add_stage(dsp_graph_t *graph, const dsp_stage_desc_t *desc);
+
+// Start num_workers scheduler workers (one per core on the device). Stages with
+// DSP_PORT_CORE_ANY are spread round-robin over the workers' deques.
+bool dsp_graph_start(dsp_graph_t *graph, int num_workers);
+
+// Stop the workers and flush every stage
+void dsp_graph_stop(dsp_graph_t *graph);
+
+// Queue every stage that has a whole block available, after publishing new samples
+void dsp_graph_notify(dsp_graph_t *graph);
+
+// Publish a stage output head and wake the workers so consumers can run
+void dsp_graph_publish(dsp_graph_t *graph, sample_ring_t *ring, uint64_t head);
+
+// Read a ring head the way the graph does
+uint64_t dsp_graph_head(dsp_graph_t *graph, const sample_ring_t *ring);
+
+// Run every stage on the calling thread until no input has a complete block
+// left. Returns the number of blocks processed. Lets tests and benchmarks drive
+// the graph without starting workers.
+uint32_t dsp_graph_run_pending(dsp_graph_t *graph);
+
+// Snapshot of a stage's timing, optionally resetting it
+void dsp_graph_get_stats(dsp_graph_t *graph, int stage, dsp_stage_stats_t *out, bool reset);
+
+#ifdef __cplusplus
+}
+#endif
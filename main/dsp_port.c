@@ -0,0 +1,164 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "dsp_port.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+
+#define DSP_TASK_PRIORITY (tskIDLE_PRIORITY + 2) // above processing_task, below the ADC drain loop
+
+int64_t dsp_port_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+int dsp_port_num_cores(void)
+{
+    return portNUM_PROCESSORS;
+}
+
+bool dsp_port_event_init(dsp_port_event_t *ev)
+{
+    *ev = xSemaphoreCreateBinary();
+    return *ev != NULL;
+}
+
+void dsp_port_event_deinit(dsp_port_event_t *ev)
+{
+    vSemaphoreDelete(*ev);
+}
+
+void dsp_port_event_signal(dsp_port_event_t *ev)
+{
+    xSemaphoreGive(*ev);
+}
+
+bool dsp_port_event_wait(dsp_port_event_t *ev, uint32_t timeout_ms)
+{
+    return xSemaphoreTake(*ev, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+static void thread_trampoline(void *arg)
+{
+    dsp_port_thread_t *th = arg;
+    th->fn(th->arg);
+    xSemaphoreGive(th->done);
+    vTaskDelete(NULL);
+}
+
+bool dsp_port_thread_start(dsp_port_thread_t *th, const char *name, int core, uint32_t stack_size,
+                           void (*fn)(void *), void *arg)
+{
+    th->fn = fn;
+    th->arg = arg;
+    th->done = xSemaphoreCreateBinary();
+    if (th->done == NULL)
+    {
+        return false;
+    }
+    BaseType_t affinity = core == DSP_PORT_CORE_ANY ? tskNO_AFFINITY : core;
+    if (xTaskCreatePinnedToCore(thread_trampoline, name, stack_size, th, DSP_TASK_PRIORITY, &th->task, affinity) != pdPASS)
+    {
+        vSemaphoreDelete(th->done);
+        return false;
+    }
+    return true;
+}
+
+void dsp_port_thread_join(dsp_port_thread_t *th)
+{
+    xSemaphoreTake(th->done, portMAX_DELAY);
+    vSemaphoreDelete(th->done);
+}
+
+#else
+#include <time.h>
+#include <unistd.h>
+
+int64_t dsp_port_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int dsp_port_num_cores(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+bool dsp_port_event_init(dsp_port_event_t *ev)
+{
+    ev->set = false;
+    return pthread_mutex_init(&ev->mutex, NULL) == 0 && pthread_cond_init(&ev->cond, NULL) == 0;
+}
+
+void dsp_port_event_deinit(dsp_port_event_t *ev)
+{
+    pthread_cond_destroy(&ev->cond);
+    pthread_mutex_destroy(&ev->mutex);
+}
+
+void dsp_port_event_signal(dsp_port_event_t *ev)
+{
+    pthread_mutex_lock(&ev->mutex);
+    ev->set = true;
+    pthread_cond_signal(&ev->cond);
+    pthread_mutex_unlock(&ev->mutex);
+}
+
+bool dsp_port_event_wait(dsp_port_event_t *ev, uint32_t timeout_ms)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&ev->mutex);
+    while (!ev->set)
+    {
+        if (pthread_cond_timedwait(&ev->cond, &ev->mutex, &deadline) != 0)
+        {
+            break;
+        }
+    }
+    bool got = ev->set;
+    ev->set = false;
+    pthread_mutex_unlock(&ev->mutex);
+    return got;
+}
+
+static void *thread_trampoline(void *arg)
+{
+    dsp_port_thread_t *th = arg;
+    th->fn(th->arg);
+    return NULL;
+}
+
+bool dsp_port_thread_start(dsp_port_thread_t *th, const char *name, int core, uint32_t stack_size,
+                           void (*fn)(void *), void *arg)
+{
+    // Host threads float; the scheduler does not depend on pinning for correctness
+    (void)name;
+    (void)core;
+    (void)stack_size;
+    th->fn = fn;
+    th->arg = arg;
+    return pthread_create(&th->thread, NULL, thread_trampoline, th) == 0;
+}
+
+void dsp_port_thread_join(dsp_port_thread_t *th)
+{
+    pthread_join(th->thread, NULL);
+}
+#endif
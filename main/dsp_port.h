@@ -0,0 +1,110 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Thin platform layer for the DSP modules: FreeRTOS on the device, pthreads
+ * on host builds. Only what the graph runner and schedulers need is here.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSP_PORT_CORE_ANY (-1)
+
+#ifdef ESP_PLATFORM
+typedef portMUX_TYPE dsp_port_lock_t;
+#define DSP_PORT_LOCK_INIT portMUX_INITIALIZER_UNLOCKED
+
+static inline void dsp_port_lock_init(dsp_port_lock_t *lock)
+{
+    portMUX_INITIALIZE(lock);
+}
+static inline void dsp_port_lock(dsp_port_lock_t *lock)
+{
+    portENTER_CRITICAL(lock);
+}
+static inline void dsp_port_unlock(dsp_port_lock_t *lock)
+{
+    portEXIT_CRITICAL(lock);
+}
+
+typedef SemaphoreHandle_t dsp_port_event_t;
+
+typedef struct
+{
+    TaskHandle_t task;
+    SemaphoreHandle_t done;
+    void (*fn)(void *);
+    void *arg;
+} dsp_port_thread_t;
+#else
+// Critical sections guard a handful of loads and stores, a mutex is plenty on host
+typedef pthread_mutex_t dsp_port_lock_t;
+#define DSP_PORT_LOCK_INIT PTHREAD_MUTEX_INITIALIZER
+
+static inline void dsp_port_lock_init(dsp_port_lock_t *lock)
+{
+    pthread_mutex_init(lock, NULL);
+}
+static inline void dsp_port_lock(dsp_port_lock_t *lock)
+{
+    pthread_mutex_lock(lock);
+}
+static inline void dsp_port_unlock(dsp_port_lock_t *lock)
+{
+    pthread_mutex_unlock(lock);
+}
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool set;
+} dsp_port_event_t;
+
+typedef struct
+{
+    pthread_t thread;
+    void (*fn)(void *);
+    void *arg;
+} dsp_port_thread_t;
+#endif
+
+// Monotonic time in microseconds
+int64_t dsp_port_time_us(void);
+
+// Number of cores work can be spread over
+int dsp_port_num_cores(void);
+
+// Auto-reset event: signal wakes one pending or the next wait
+bool dsp_port_event_init(dsp_port_event_t *ev);
+void dsp_port_event_deinit(dsp_port_event_t *ev);
+void dsp_port_event_signal(dsp_port_event_t *ev);
+// Returns false on timeout
+bool dsp_port_event_wait(dsp_port_event_t *ev, uint32_t timeout_ms);
+
+// Start fn(arg) on its own task/thread, pinned to core unless DSP_PORT_CORE_ANY.
+// The thread struct must stay valid until dsp_port_thread_join returns.
+bool dsp_port_thread_start(dsp_port_thread_t *th, const char *name, int core, uint32_t stack_size,
+                           void (*fn)(void *), void *arg);
+void dsp_port_thread_join(dsp_port_thread_t *th);
+
+#ifdef __cplusplus
+}
+#endif
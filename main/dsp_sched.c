@@ -0,0 +1,264 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "dsp_sched.h"
+
+#define DEQUE_MASK (DSP_SCHED_DEQUE_SIZE - 1)
+#define WORKER_IDLE_WAIT_MS 10 // bounded sleep so a missed wake-up only costs latency
+#define GROUP_WAIT_MS 1
+
+// Index of the pool worker running on this thread, -1 outside the pool
+static __thread int s_worker = -1;
+
+// depth is the number of units queued afterwards, read under the lock
+static bool deque_push(dsp_sched_worker_t *w, const dsp_task_t *task, uint32_t *depth)
+{
+    bool ok = false;
+    dsp_port_lock(&w->lock);
+    if (w->bottom - w->top < DSP_SCHED_DEQUE_SIZE)
+    {
+        w->tasks[w->bottom & DEQUE_MASK] = *task;
+        w->bottom++;
+        ok = true;
+    }
+    *depth = w->bottom - w->top;
+    dsp_port_unlock(&w->lock);
+    return ok;
+}
+
+static bool deque_pop_bottom(dsp_sched_worker_t *w, dsp_task_t *out)
+{
+    bool ok = false;
+    dsp_port_lock(&w->lock);
+    if (w->bottom != w->top)
+    {
+        w->bottom--;
+        *out = w->tasks[w->bottom & DEQUE_MASK];
+        ok = true;
+    }
+    dsp_port_unlock(&w->lock);
+    return ok;
+}
+
+static bool deque_steal_top(dsp_sched_worker_t *w, dsp_task_t *out)
+{
+    bool ok = false;
+    dsp_port_lock(&w->lock);
+    if (w->bottom != w->top)
+    {
+        *out = w->tasks[w->top & DEQUE_MASK];
+        w->top++;
+        ok = true;
+    }
+    dsp_port_unlock(&w->lock);
+    return ok;
+}
+
+static void run_task(dsp_sched_t *sched, const dsp_task_t *task)
+{
+    // Threads outside the pool get their own slot after the workers
+    task->fn(task->arg, s_worker >= 0 ? s_worker : __atomic_load_n(&sched->num_workers, __ATOMIC_ACQUIRE));
+    dsp_task_group_t *group = task->group;
+    if (group)
+    {
+        // The event is signalled outside the lock (no RTOS calls in a critical section), so
+        // signalling keeps the waiter from returning and freeing the group until it is done
+        dsp_port_lock(&sched->group_lock);
+        bool last = --group->outstanding == 0;
+        group->signalling += last;
+        dsp_port_unlock(&sched->group_lock);
+        if (last)
+        {
+            dsp_port_event_signal(&group->done);
+            dsp_port_lock(&sched->group_lock);
+            group->signalling--;
+            dsp_port_unlock(&sched->group_lock);
+        }
+    }
+}
+
+// Own deque first, then steal round-robin starting after ourselves
+static bool find_task(dsp_sched_t *sched, int worker, dsp_task_t *out)
+{
+    if (worker >= 0 && deque_pop_bottom(&sched->workers[worker], out))
+    {
+        return true;
+    }
+    const int num_workers = __atomic_load_n(&sched->num_workers, __ATOMIC_ACQUIRE);
+    int start = worker < 0 ? 0 : worker + 1;
+    for (int i = 0; i < num_workers; i++)
+    {
+        int victim = (start + i) % num_workers;
+        if (victim != worker && deque_steal_top(&sched->workers[victim], out))
+        {
+            if (worker >= 0)
+            {
+                sched->workers[worker].stolen++;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void worker_main(void *arg)
+{
+    dsp_sched_worker_t *w = arg;
+    dsp_sched_t *sched = w->sched;
+    dsp_task_t task;
+    s_worker = w->index;
+
+    while (1)
+    {
+        if (find_task(sched, w->index, &task))
+        {
+            run_task(sched, &task);
+            w->executed++;
+            continue;
+        }
+        if (!__atomic_load_n(&sched->running, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+        dsp_port_event_wait(&w->wake, WORKER_IDLE_WAIT_MS);
+    }
+}
+
+bool dsp_sched_start(dsp_sched_t *sched, int num_workers)
+{
+    memset(sched, 0, sizeof(*sched));
+    dsp_port_lock_init(&sched->group_lock);
+    if (num_workers < 1)
+    {
+        num_workers = 1;
+    }
+    if (num_workers > DSP_SCHED_MAX_WORKERS)
+    {
+        num_workers = DSP_SCHED_MAX_WORKERS;
+    }
+
+    __atomic_store_n(&sched->running, true, __ATOMIC_RELEASE);
+    bool pin = num_workers <= dsp_port_num_cores();
+    for (int i = 0; i < num_workers; i++)
+    {
+        dsp_sched_worker_t *w = &sched->workers[i];
+        w->sched = sched;
+        w->index = i;
+        dsp_port_lock_init(&w->lock);
+        if (!dsp_port_event_init(&w->wake))
+        {
+            dsp_sched_stop(sched);
+            return false;
+        }
+        // Count the worker before its thread exists so stealing sees every deque
+        __atomic_store_n(&sched->num_workers, i + 1, __ATOMIC_RELEASE);
+        if (!dsp_port_thread_start(&w->thread, "dsp_worker", pin ? i : DSP_PORT_CORE_ANY,
+                                   DSP_SCHED_STACK_SIZE, worker_main, w))
+        {
+            __atomic_store_n(&sched->num_workers, i, __ATOMIC_RELEASE);
+            dsp_port_event_deinit(&w->wake);
+            dsp_sched_stop(sched);
+            return false;
+        }
+    }
+    return true;
+}
+
+void dsp_sched_stop(dsp_sched_t *sched)
+{
+    // Workers drain their deques before they notice running == false
+    __atomic_store_n(&sched->running, false, __ATOMIC_RELEASE);
+    for (int i = 0; i < sched->num_workers; i++)
+    {
+        dsp_port_event_signal(&sched->workers[i].wake);
+    }
+    for (int i = 0; i < sched->num_workers; i++)
+    {
+        dsp_port_thread_join(&sched->workers[i].thread);
+        dsp_port_event_deinit(&sched->workers[i].wake);
+    }
+    __atomic_store_n(&sched->num_workers, 0, __ATOMIC_RELEASE);
+}
+
+static bool submit(dsp_sched_t *sched, int preferred, const dsp_task_t *task)
+{
+    const int num_workers = __atomic_load_n(&sched->num_workers, __ATOMIC_ACQUIRE);
+    if (num_workers == 0)
+    {
+        return false;
+    }
+    int target = preferred >= 0 ? preferred % num_workers : 0;
+    dsp_sched_worker_t *w = &sched->workers[target];
+    uint32_t depth;
+    if (!deque_push(w, task, &depth))
+    {
+        return false;
+    }
+    dsp_port_event_signal(&w->wake);
+
+    // A backlog on one deque is what the other workers should steal
+    if (num_workers > 1 && depth > 1)
+    {
+        dsp_port_event_signal(&sched->workers[(target + 1) % num_workers].wake);
+    }
+    return true;
+}
+
+bool dsp_sched_submit(dsp_sched_t *sched, int preferred, dsp_task_fn_t fn, void *arg)
+{
+    dsp_task_t task = {.fn = fn, .arg = arg, .group = NULL};
+    return submit(sched, preferred, &task);
+}
+
+bool dsp_sched_group_init(dsp_task_group_t *group)
+{
+    group->outstanding = 0;
+    group->signalling = 0;
+    return dsp_port_event_init(&group->done);
+}
+
+void dsp_sched_group_deinit(dsp_task_group_t *group)
+{
+    dsp_port_event_deinit(&group->done);
+}
+
+void dsp_sched_group_submit(dsp_sched_t *sched, dsp_task_group_t *group, int preferred,
+                            dsp_task_fn_t fn, void *arg)
+{
+    dsp_task_t task = {.fn = fn, .arg = arg, .group = group};
+    dsp_port_lock(&sched->group_lock);
+    group->outstanding++;
+    dsp_port_unlock(&sched->group_lock);
+
+    if (!submit(sched, preferred, &task))
+    {
+        run_task(sched, &task);
+    }
+}
+
+void dsp_sched_group_wait(dsp_sched_t *sched, dsp_task_group_t *group)
+{
+    dsp_task_t task;
+    while (1)
+    {
+        dsp_port_lock(&sched->group_lock);
+        bool done = group->outstanding == 0 && group->signalling == 0;
+        dsp_port_unlock(&sched->group_lock);
+        if (done)
+        {
+            break;
+        }
+
+        // Help out rather than block; this may run units of other groups too
+        if (find_task(sched, s_worker, &task))
+        {
+            run_task(sched, &task);
+            continue;
+        }
+        dsp_port_event_wait(&group->done, GROUP_WAIT_MS);
+    }
+}
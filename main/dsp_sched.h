@@ -0,0 +1,99 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Work-stealing scheduler for DSP work units
+ *
+ * Every worker (one per core) owns a bounded deque. The owner pushes and pops
+ * at the bottom, newest first, so its data stays in cache. An idle worker
+ * steals the oldest unit from the top of another worker's deque, which
+ * spreads a burst that landed on one core (FFT blocks, compression chunks,
+ * filter segments) over both. Deques are short and guarded by a per-deque
+ * spinlock. A lock-free Chase-Lev deque would save a few cycles per operation
+ * but is not worth its complexity at 256-sample granularity.
+ *
+ * Task groups give fork/join: submit units into a group, then
+ * dsp_sched_group_wait() runs or steals units itself until the group is done,
+ * so waiting from inside a unit cannot deadlock the pool.
+ */
+#pragma once
+
+#include "dsp_port.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSP_SCHED_MAX_WORKERS 4
+#define DSP_SCHED_DEQUE_SIZE 64 // power of two
+#define DSP_SCHED_STACK_SIZE 4096
+
+// worker is the index of the executing pool worker, or num_workers when the unit
+// runs on a thread outside the pool, so per-worker scratch needs num_workers + 1 slots
+typedef void (*dsp_task_fn_t)(void *arg, int worker);
+
+typedef struct
+{
+    int outstanding;
+    int signalling; // finished units still signalling done
+    dsp_port_event_t done;
+} dsp_task_group_t;
+
+typedef struct
+{
+    dsp_task_fn_t fn;
+    void *arg;
+    dsp_task_group_t *group;
+} dsp_task_t;
+
+typedef struct dsp_sched dsp_sched_t;
+
+typedef struct
+{
+    dsp_sched_t *sched;
+    int index;
+    dsp_port_lock_t lock;
+    dsp_task_t tasks[DSP_SCHED_DEQUE_SIZE];
+    uint32_t top;    // steal end (oldest)
+    uint32_t bottom; // owner end (newest)
+    dsp_port_event_t wake;
+    dsp_port_thread_t thread;
+    uint32_t executed;
+    uint32_t stolen;
+} dsp_sched_worker_t;
+
+struct dsp_sched
+{
+    dsp_sched_worker_t workers[DSP_SCHED_MAX_WORKERS];
+    int num_workers;            // written by start/stop, read atomically by the workers
+    bool running;               // cleared by stop, read atomically
+    dsp_port_lock_t group_lock; // protects task group counters
+};
+
+// Start num_workers threads, pinned to cores when there are enough of them
+bool dsp_sched_start(dsp_sched_t *sched, int num_workers);
+
+// Run remaining units, then stop and join the workers
+void dsp_sched_stop(dsp_sched_t *sched);
+
+// Queue a unit on the preferred worker (any worker may end up running it).
+// Returns false when that deque is full; the caller keeps ownership of arg.
+bool dsp_sched_submit(dsp_sched_t *sched, int preferred, dsp_task_fn_t fn, void *arg);
+
+bool dsp_sched_group_init(dsp_task_group_t *group);
+void dsp_sched_group_deinit(dsp_task_group_t *group);
+
+// Like dsp_sched_submit but counted in group. Never fails: when the deque is
+// full the unit runs inline on the calling thread.
+void dsp_sched_group_submit(dsp_sched_t *sched, dsp_task_group_t *group, int preferred,
+                            dsp_task_fn_t fn, void *arg);
+
+// Help execute units until every unit in group has finished
+void dsp_sched_group_wait(dsp_sched_t *sched, dsp_task_group_t *group);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,190 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include "fresp.h"
+#include "nco.h"
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b)
+{
+    while (b)
+    {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Best table for frequency f: whole cycles per table, whole ADC samples per table repeat
+static bool plan_point(const fresp_config_t *cfg, uint32_t lstep, double f, fresp_point_t *pt)
+{
+    double best_err = INFINITY;
+    for (uint32_t len = cfg->max_table / lstep * lstep; len >= cfg->min_table && len > 0; len -= lstep)
+    {
+        uint64_t span = (uint64_t)len * cfg->adc_rate_hz / cfg->dac_rate_hz;
+        if (span > cfg->max_window)
+        {
+            continue;
+        }
+        uint32_t cycles = (uint32_t)lrint(f * len / cfg->dac_rate_hz);
+        if (cycles == 0 || 2 * cycles >= len)
+        {
+            continue;
+        }
+        double err = fabs((double)cycles * cfg->dac_rate_hz / len - f);
+        if (err < best_err)
+        {
+            best_err = err;
+            pt->table_len = len;
+            pt->cycles = cycles;
+            pt->span = (uint32_t)span;
+        }
+    }
+    if (isinf(best_err))
+    {
+        return false;
+    }
+    pt->freq_hz = (float)((double)pt->cycles * cfg->dac_rate_hz / pt->table_len);
+    uint32_t spans = (cfg->min_window + pt->span - 1) / pt->span;
+    if ((uint64_t)spans * pt->span > cfg->max_window)
+    {
+        spans = cfg->max_window / pt->span;
+    }
+    pt->window = spans * pt->span;
+    pt->settle = (uint32_t)(((uint64_t)cfg->settle_cycles * pt->span + pt->cycles - 1) / pt->cycles);
+    return true;
+}
+
+uint32_t fresp_plan(const fresp_config_t *cfg, fresp_point_t *pts)
+{
+    if (cfg->adc_rate_hz == 0 || cfg->dac_rate_hz == 0 || cfg->points == 0 || cfg->f_start_hz <= 0 ||
+        cfg->f_stop_hz < cfg->f_start_hz || 2 * cfg->f_stop_hz >= cfg->dac_rate_hz ||
+        2 * cfg->f_stop_hz >= cfg->adc_rate_hz || cfg->min_table < 4 || cfg->max_table < cfg->min_table ||
+        cfg->max_window == 0)
+    {
+        return 0;
+    }
+    // Table lengths: multiples of the alignment whose repeat is a whole number of ADC samples
+    uint32_t align = cfg->table_align ? cfg->table_align : 1;
+    uint32_t unit = cfg->dac_rate_hz / gcd_u32(cfg->adc_rate_hz, cfg->dac_rate_hz);
+    uint32_t lstep = unit / gcd_u32(unit, align) * align;
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < cfg->points; i++)
+    {
+        double t = cfg->points > 1 ? (double)i / (cfg->points - 1) : 0;
+        double f = cfg->f_start_hz * pow((double)cfg->f_stop_hz / cfg->f_start_hz, t);
+        fresp_point_t pt;
+        if (!plan_point(cfg, lstep, f, &pt))
+        {
+            return 0;
+        }
+        // Low frequencies quantize coarsely: neighbours can land on the same tone
+        if (n > 0 && pts[n - 1].freq_hz == pt.freq_hz)
+        {
+            continue;
+        }
+        pts[n++] = pt;
+    }
+    return n;
+}
+
+void fresp_fill_table(const fresp_point_t *pt, uint8_t *table, uint8_t offset, uint8_t amplitude)
+{
+    for (uint32_t i = 0; i < pt->table_len; i++)
+    {
+        long v = offset + lrint(amplitude * sin(2 * M_PI * ((uint64_t)i * pt->cycles % pt->table_len) / pt->table_len));
+        table[i] = (uint8_t)(v < 0 ? 0 : v > 255 ? 255 : v);
+    }
+}
+
+uint64_t fresp_sweep_samples(const fresp_point_t *pts, uint32_t n)
+{
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        total += pts[i].settle + pts[i].window;
+    }
+    return total;
+}
+
+void fresp_acc_init(fresp_acc_t *acc, const fresp_point_t *pt, uint64_t start)
+{
+    memset(acc, 0, sizeof(*acc));
+    acc->pt = pt;
+    acc->start = start;
+    acc->inc = (uint32_t)(((uint64_t)pt->cycles << 32) / pt->span);
+}
+
+void fresp_acc_add(fresp_acc_t *acc, const sample_t *s, size_t n, uint64_t pos)
+{
+    // Phase of the first sample from its offset within the table repeat, exact in integers
+    const uint32_t span = acc->pt->span;
+    uint64_t off = pos >= acc->start ? (pos - acc->start) % span : span - (acc->start - pos) % span;
+    uint32_t phase = (uint32_t)((((uint64_t)off * acc->pt->cycles) % span << 32) / span);
+
+    const int16_t *tab = nco_table();
+    int64_t ss = 0, sc = 0, sum_s = 0, sum_sin = 0, sum_cos = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t idx = nco_index(phase);
+        int32_t sn = tab[idx];
+        int32_t cs = tab[nco_cos_index(idx)];
+        ss += (int32_t)s[i] * sn;
+        sc += (int32_t)s[i] * cs;
+        sum_s += s[i];
+        sum_sin += sn;
+        sum_cos += cs;
+        phase += acc->inc;
+    }
+    acc->ss += ss;
+    acc->sc += sc;
+    acc->sum_s += sum_s;
+    acc->sum_sin += sum_sin;
+    acc->sum_cos += sum_cos;
+    acc->count += (uint32_t)n;
+}
+
+bool fresp_acc_add_ring(fresp_acc_t *acc, const sample_ring_t *ring, uint64_t head, uint64_t from, size_t n)
+{
+    uint64_t cap = sample_ring_capacity(ring);
+    if (from + n > head || (head > cap && from < head - cap))
+    {
+        return false;
+    }
+    size_t off = from & ring->mask;
+    size_t first = cap - off < n ? cap - off : n;
+    fresp_acc_add(acc, &ring->buf[off], first, from);
+    fresp_acc_add(acc, ring->buf, n - first, from + first);
+    return true;
+}
+
+bool fresp_acc_result(const fresp_acc_t *acc, float stim_amplitude, fresp_result_t *out)
+{
+    if (acc->count == 0 || stim_amplitude <= 0)
+    {
+        return false;
+    }
+    // Remove the DC offset: sum((s - mean) * sin) = sum(s * sin) - mean * sum(sin)
+    double mean = (double)acc->sum_s / acc->count;
+    double in_phase = acc->ss - mean * acc->sum_sin;
+    double quad = acc->sc - mean * acc->sum_cos;
+    out->freq_hz = acc->pt->freq_hz;
+    out->gain = (float)(2 * sqrt(in_phase * in_phase + quad * quad) / ((double)acc->count * NCO_ONE * stim_amplitude));
+    out->phase_rad = (float)atan2(quad, in_phase);
+    return true;
+}
+
+void fresp_relative(const fresp_result_t *dut, const fresp_result_t *ref, fresp_result_t *out)
+{
+    float phase = dut->phase_rad - ref->phase_rad;
+    phase = phase > (float)M_PI ? phase - 2 * (float)M_PI : phase <= -(float)M_PI ? phase + 2 * (float)M_PI : phase;
+    out->freq_hz = dut->freq_hz;
+    out->gain = ref->gain > 0 ? dut->gain / ref->gain : 0;
+    out->phase_rad = phase;
+}
@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Frequency response (network analyzer) from a DAC sine sweep
+ *
+ * The DAC plays a table of table_len samples holding exactly `cycles` sine
+ * periods over and over, so each tone is seamless. A table repeat spans a
+ * whole number of ADC samples (span), and the measurement window is a whole
+ * number of spans. The response is therefore correlated over whole periods
+ * and needs no window function.
+ *
+ * Tone phase is tied to the ADC sample counter: `start` is the absolute
+ * sample where table index 0 plays, and the reference phase of every sample
+ * follows from its absolute position. Correlation is fixed point (Q15 sine
+ * table, 64-bit sums) and is fed in spans, straight from a ring if needed.
+ *
+ * The start latency known to software is coarse. Gain does not depend on
+ * it, and phase is exact relative to a reference channel that samples the
+ * stimulus (fresp_relative()). A thru sweep taken with a plain loopback
+ * removes DAC hold and wiring effects the same way.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    uint32_t adc_rate_hz; // per-channel sample rate
+    uint32_t dac_rate_hz;
+    float f_start_hz;
+    float f_stop_hz;      // below dac_rate_hz / 2
+    uint32_t points;      // log-spaced
+    uint32_t min_table;   // DAC table length bounds, samples
+    uint32_t max_table;
+    uint32_t table_align; // table lengths are multiples of this (4 for DAC DMA), 0 or 1 for any
+    uint32_t settle_cycles; // periods skipped after each tone starts
+    uint32_t min_window;    // ADC samples correlated per point, at least...
+    uint32_t max_window;    // ...and at most (e.g. half the ring)
+} fresp_config_t;
+
+typedef struct
+{
+    float freq_hz;      // achieved: cycles * dac_rate_hz / table_len
+    uint32_t table_len; // multiple of table_align
+    uint32_t cycles;    // sine periods per table
+    uint32_t span;      // ADC samples per table repeat
+    uint32_t settle;    // ADC samples skipped after start
+    uint32_t window;    // ADC samples correlated, a multiple of span
+} fresp_point_t;
+
+typedef struct
+{
+    float freq_hz;
+    float gain;      // response amplitude / stimulus amplitude
+    float phase_rad; // response phase relative to the stimulus, (-pi, pi]
+} fresp_result_t;
+
+typedef struct
+{
+    const fresp_point_t *pt;
+    uint64_t start; // absolute ADC sample where table index 0 plays
+    uint32_t inc;   // Q32 phase step per ADC sample
+    int64_t ss;     // sum of s * sin
+    int64_t sc;     // sum of s * cos
+    int64_t sum_s;
+    int64_t sum_sin;
+    int64_t sum_cos;
+    uint32_t count;
+} fresp_acc_t;
+
+// Plan a log sweep. Frequencies are quantized to whole cycles per table and
+// repeats are dropped. Returns the number of points written, 0 if cfg is invalid.
+uint32_t fresp_plan(const fresp_config_t *cfg, fresp_point_t *pts);
+
+// Unsigned 8-bit DAC table: offset + amplitude * sin, one table of pt->table_len samples
+void fresp_fill_table(const fresp_point_t *pt, uint8_t *table, uint8_t offset, uint8_t amplitude);
+
+// ADC samples a sweep needs in total (settle + window per point)
+uint64_t fresp_sweep_samples(const fresp_point_t *pts, uint32_t n);
+
+void fresp_acc_init(fresp_acc_t *acc, const fresp_point_t *pt, uint64_t start);
+
+// Correlate n samples; s[0] is absolute ADC sample pos
+void fresp_acc_add(fresp_acc_t *acc, const sample_t *s, size_t n, uint64_t pos);
+
+// Correlate [from, from + n) straight from a ring, in at most two spans.
+// Returns false if part of the range is not (or no longer) in the ring at head.
+bool fresp_acc_add_ring(fresp_acc_t *acc, const sample_ring_t *ring, uint64_t head, uint64_t from, size_t n);
+
+// Gain and phase of the accumulated samples for a stimulus of stim_amplitude ADC codes
+bool fresp_acc_result(const fresp_acc_t *acc, float stim_amplitude, fresp_result_t *out);
+
+// Response relative to a reference: gain ratio and wrapped phase difference
+void fresp_relative(const fresp_result_t *dut, const fresp_result_t *ref, fresp_result_t *out);
+
+#ifdef __cplusplus
+}
+#endif
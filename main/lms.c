@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "lms.h"
+
+#define W_FRAC_BITS 20
+#define NLMS_GUARD_BITS 12 // fraction kept in the normalized step
+// DC trackers: time constant of 2^20 samples (1 s at 1 MSPS). Their ripple at the interference
+// frequency acts as a high-pass on the reference the weights cannot model: 1 / (2 pi f tau), or
+// -50 dB at 50 Hz. They start as running means, the shift growing by one every 2^shift samples,
+// so the first second is not spent settling.
+#define DC_SHIFT 20
+
+bool lms_init(lms_t *lms, const lms_config_t *cfg)
+{
+    memset(lms, 0, sizeof(*lms));
+    if (cfg->taps < 1 || cfg->taps > LMS_MAX_TAPS || (!cfg->normalized && cfg->mu_shift < W_FRAC_BITS) ||
+        cfg->mu_shift > 40)
+    {
+        return false;
+    }
+    lms->cfg = *cfg;
+    return true;
+}
+
+static int64_t track_dc(int64_t dc_q32, int32_t x, uint8_t shift)
+{
+    return dc_q32 + ((((int64_t)x << 32) - dc_q32) >> shift);
+}
+
+static int32_t dc_codes(int64_t dc_q32)
+{
+    return (int32_t)((dc_q32 + ((int64_t)1 << 31)) >> 32);
+}
+
+void lms_process(lms_t *lms, const sample_t *primary, const sample_t *ref, sample_t *out, size_t n)
+{
+    const int taps = lms->cfg.taps;
+    const uint8_t mu = lms->cfg.mu_shift;
+    const int64_t eps = taps; // one code^2 per tap keeps the division defined on a silent reference
+    int32_t *w = lms->w;
+    if (!lms->primed && n > 0)
+    {
+        lms->dc_primary_q32 = (int64_t)primary[0] << 32;
+        lms->dc_ref_q32 = (int64_t)ref[0] << 32;
+        lms->dc_shift = 1;
+        lms->primed = true;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        // Newest reference sample into the window, power updated by what enters and leaves
+        int32_t dc_p = dc_codes(lms->dc_primary_q32);
+        int16_t x_new = (int16_t)(ref[i] - dc_codes(lms->dc_ref_q32));
+        lms->dc_primary_q32 = track_dc(lms->dc_primary_q32, primary[i], lms->dc_shift);
+        lms->dc_ref_q32 = track_dc(lms->dc_ref_q32, ref[i], lms->dc_shift);
+        if (lms->dc_shift < DC_SHIFT && ++lms->dc_count == 1u << lms->dc_shift)
+        {
+            lms->dc_shift++;
+            lms->dc_count = 0;
+        }
+        uint32_t pos = (lms->pos == 0 ? (uint32_t)taps : lms->pos) - 1;
+        int16_t x_old = lms->hist[pos + taps];
+        lms->hist[pos] = lms->hist[pos + taps] = x_new;
+        lms->pos = pos;
+        lms->power += (int32_t)x_new * x_new - (int32_t)x_old * x_old;
+        const int16_t *x = &lms->hist[pos];
+
+        int64_t acc = 0;
+        for (int k = 0; k < taps; k++)
+        {
+            acc += (int64_t)w[k] * x[k];
+        }
+        int32_t e = primary[i] - dc_p - (int32_t)((acc + (1 << (W_FRAC_BITS - 1))) >> W_FRAC_BITS);
+
+        if (lms->cfg.normalized)
+        {
+            int64_t g = ((int64_t)e << (W_FRAC_BITS + NLMS_GUARD_BITS)) / (lms->power + eps);
+            const uint8_t shift = NLMS_GUARD_BITS + mu;
+            const int64_t round = (int64_t)1 << (shift - 1);
+            for (int k = 0; k < taps; k++)
+            {
+                w[k] += (int32_t)((g * x[k] + round) >> shift);
+            }
+        }
+        else
+        {
+            const uint8_t shift = mu - W_FRAC_BITS;
+            const int64_t round = shift ? (int64_t)1 << (shift - 1) : 0;
+            for (int k = 0; k < taps; k++)
+            {
+                w[k] += (int32_t)(((int64_t)e * x[k] + round) >> shift);
+            }
+        }
+
+        int32_t v = e + dc_p;
+        out[i] = (sample_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+    }
+    lms->samples += n;
+}
+
+float lms_weight(const lms_t *lms, int k)
+{
+    return k >= 0 && k < lms->cfg.taps ? (float)lms->w[k] / (1 << W_FRAC_BITS) : 0;
+}
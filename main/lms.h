@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Adaptive noise cancellation with an LMS / NLMS filter
+ *
+ * A reference channel samples the interference source. An adaptive FIR
+ * predicts the part of the primary channel correlated with the reference,
+ * and subtracts it: out = primary - sum(w[k] * ref[n - k]). The error (the
+ * output itself) drives the weight update, so only what the reference can
+ * explain is removed and the wanted signal passes through.
+ *
+ * Both channels have a slowly tracked DC level removed before adapting. The
+ * primary's DC is put back into the output. Weights are Q20 int32, samples
+ * are int16, and products accumulate in 64 bits.
+ *
+ * NLMS divides the step by the reference power in the filter window (one
+ * division per sample), so the same mu_shift works at any input level.
+ * Plain LMS needs mu_shift scaled to the reference power and tap count
+ * (stable below about 2 / (taps * power)), but saves the division. At
+ * 1 MSPS keep the step small (NLMS mu_shift around 10): with a tonal
+ * reference the canceller behaves as a notch whose width grows with the
+ * step, and a fast one removes wanted signal near the interference.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LMS_MAX_TAPS 64
+
+typedef struct
+{
+    uint8_t taps;     // 1..LMS_MAX_TAPS, covering the delay spread between reference and primary
+    uint8_t mu_shift; // step size 2^-mu_shift; LMS needs mu_shift >= 20
+    bool normalized;  // NLMS
+} lms_config_t;
+
+typedef struct
+{
+    lms_config_t cfg;
+    int32_t w[LMS_MAX_TAPS];          // Q20
+    int16_t hist[2 * LMS_MAX_TAPS];   // reference less DC, newest first, written twice
+    uint32_t pos;
+    int64_t power;                    // sum of hist^2 over the window
+    int64_t dc_primary_q32;
+    int64_t dc_ref_q32;
+    uint8_t dc_shift;                 // DC tracker time constant, 2^dc_shift samples
+    uint32_t dc_count;
+    bool primed;                      // DC trackers started from the first samples
+    uint64_t samples;
+} lms_t;
+
+bool lms_init(lms_t *lms, const lms_config_t *cfg);
+
+// Cancel n samples of primary using ref, writing the cleaned samples to out (may alias primary)
+void lms_process(lms_t *lms, const sample_t *primary, const sample_t *ref, sample_t *out, size_t n);
+
+// Current weight k as a gain
+float lms_weight(const lms_t *lms, int k);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,160 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include "lockin.h"
+#include "nco.h"
+
+#define PLL_KP_SHIFT 2 // phase correction: 1/4 of the error per update
+#define PLL_KI_SHIFT 6 // frequency correction: 1/64 of the error per update, spread over the update
+// The reference is correlated over this many of its periods per PLL update, so the 2f mixing
+// product averages out of the phase detector
+#define PLL_PERIODS 16
+// The DC tracker is slower than the output filter: its ripple at the reference frequency
+// would otherwise mix down into a gain error of about 1 / (2 pi f tau)
+#define DC_TAU_FACTOR 16
+
+bool lockin_init(lockin_t *lk, const lockin_config_t *cfg)
+{
+    memset(lk, 0, sizeof(*lk));
+    if (cfg->sample_rate_hz == 0 || cfg->ref_hz <= 0 || 2 * cfg->ref_hz >= cfg->sample_rate_hz ||
+        cfg->decim_shift > 16 || cfg->order < 1 || cfg->order > LOCKIN_MAX_ORDER || cfg->tau_s <= 0)
+    {
+        return false;
+    }
+    lk->cfg = *cfg;
+    lk->inc = nco_phase_inc(cfg->ref_hz, cfg->sample_rate_hz);
+    double t = (double)(1u << cfg->decim_shift) / cfg->sample_rate_hz;
+    int32_t alpha = (int32_t)lrint(65536 * (1 - exp(-t / cfg->tau_s)));
+    lk->alpha_q16 = alpha < 1 ? 1 : alpha;
+    alpha = (int32_t)lrint(65536 * (1 - exp(-t / (DC_TAU_FACTOR * cfg->tau_s))));
+    lk->dc_alpha_q16 = alpha < 1 ? 1 : alpha;
+    double pll_samples = PLL_PERIODS * cfg->sample_rate_hz / cfg->ref_hz;
+    lk->pll_dumps = (uint32_t)ceil(pll_samples / (1u << cfg->decim_shift));
+    nco_table();
+    return true;
+}
+
+// Mix n samples against the NCO starting at phase; sums are added to *i, *q and *sum
+static void mix(const sample_t *s, size_t n, int32_t dc, uint32_t phase, uint32_t inc, int64_t *i_out,
+                int64_t *q_out, int64_t *sum_out)
+{
+    const int16_t *tab = nco_table();
+    int64_t si = 0, sq = 0, sum = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        uint32_t idx = nco_index(phase);
+        int32_t x = s[k] - dc;
+        si += x * tab[idx];
+        sq += x * tab[nco_cos_index(idx)];
+        sum += s[k];
+        phase += inc;
+    }
+    *i_out += si;
+    *q_out += sq;
+    *sum_out += sum;
+}
+
+static int32_t lowpass(int32_t y, int32_t x, int32_t alpha_q16)
+{
+    return y + (int32_t)(((int64_t)x - y) * alpha_q16 >> 16);
+}
+
+// Same filter on Q16 mixer outputs. ADC codes less DC stay below 2^14, so a mixed mean is below
+// 2^29 and the Q16 difference times alpha fits in 62 bits
+static int64_t lowpass64(int64_t y, int64_t x, int32_t alpha_q16)
+{
+    return y + ((x - y) * alpha_q16 >> 16);
+}
+
+// One decimated output: track DC, low-pass I/Q and, with a reference, steer the NCO
+static void dump(lockin_t *lk, bool has_ref)
+{
+    const uint8_t shift = lk->cfg.decim_shift;
+    // DC is tracked in Q16 so the slow low-pass cannot stall a few codes off
+    int32_t mean = (int32_t)((lk->acc_s << 16) >> shift);
+    lk->dc_q16 = lk->outputs == 0 ? mean : lowpass(lk->dc_q16, mean, lk->dc_alpha_q16);
+
+    // I/Q too: with a long tau the step alpha * (x - y) would round to nothing within
+    // 65536 / alpha of the target, which is most of a small signal
+    int64_t x = (lk->acc_i << 16) >> shift, y = (lk->acc_q << 16) >> shift;
+    for (int k = 0; k < lk->cfg.order; k++)
+    {
+        lk->lp_i_q16[k] = lowpass64(lk->lp_i_q16[k], x, lk->alpha_q16);
+        lk->lp_q_q16[k] = lowpass64(lk->lp_q_q16[k], y, lk->alpha_q16);
+        x = lk->lp_i_q16[k];
+        y = lk->lp_q_q16[k];
+    }
+
+    if (has_ref)
+    {
+        int32_t ref_mean = (int32_t)((lk->ref_s << 16) >> shift);
+        lk->ref_dc_q16 = lk->outputs == 0 ? ref_mean : lowpass(lk->ref_dc_q16, ref_mean, lk->dc_alpha_q16);
+        lk->ref_s = 0;
+        if (++lk->pll_count == lk->pll_dumps)
+        {
+            // Reference phase ahead of the NCO sine: advance the NCO and trim its frequency
+            int32_t err = nco_atan2(lk->ref_q, lk->ref_i);
+            lk->phase += (uint32_t)(err >> PLL_KP_SHIFT);
+            lk->inc += (uint32_t)((err >> PLL_KI_SHIFT) / (int32_t)(lk->pll_dumps << shift));
+            lk->ref_i = lk->ref_q = 0;
+            lk->pll_count = 0;
+        }
+    }
+    lk->acc_i = lk->acc_q = lk->acc_s = 0;
+    lk->dec_count = 0;
+    lk->outputs++;
+}
+
+uint32_t lockin_process(lockin_t *lk, const sample_t *s, const sample_t *ref, size_t n)
+{
+    const uint32_t dec_len = 1u << lk->cfg.decim_shift;
+    uint32_t outputs = 0;
+    while (n > 0)
+    {
+        size_t m = dec_len - lk->dec_count;
+        m = m < n ? m : n;
+        mix(s, m, (lk->dc_q16 + 0x8000) >> 16, lk->phase, lk->inc, &lk->acc_i, &lk->acc_q, &lk->acc_s);
+        if (ref)
+        {
+            mix(ref, m, (lk->ref_dc_q16 + 0x8000) >> 16, lk->phase, lk->inc, &lk->ref_i, &lk->ref_q, &lk->ref_s);
+            ref += m;
+        }
+        lk->phase += (uint32_t)m * lk->inc;
+        lk->dec_count += (uint32_t)m;
+        s += m;
+        n -= m;
+        if (lk->dec_count == dec_len)
+        {
+            dump(lk, ref != NULL);
+            outputs++;
+        }
+    }
+    return outputs;
+}
+
+void lockin_result(const lockin_t *lk, lockin_result_t *out)
+{
+    int last = lk->cfg.order - 1;
+    out->x = (float)(2.0 * lk->lp_i_q16[last] / (65536.0 * NCO_ONE));
+    out->y = (float)(2.0 * lk->lp_q_q16[last] / (65536.0 * NCO_ONE));
+    out->amplitude = sqrtf(out->x * out->x + out->y * out->y);
+    out->phase_rad = atan2f(out->y, out->x);
+    out->ref_hz = (float)((double)lk->inc * lk->cfg.sample_rate_hz / 4294967296.0);
+    out->outputs = lk->outputs;
+}
+
+float lockin_enbw_hz(const lockin_config_t *cfg)
+{
+    // n cascaded RC stages: 1/(4 tau) * C(2n - 2, n - 1) / 4^(n - 1)
+    static const float factor[LOCKIN_MAX_ORDER] = {1.0f, 0.5f, 0.375f, 0.3125f};
+    if (cfg->order < 1 || cfg->order > LOCKIN_MAX_ORDER || cfg->tau_s <= 0)
+    {
+        return 0;
+    }
+    return factor[cfg->order - 1] / (4 * cfg->tau_s);
+}
@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Lock-in amplifier: amplitude and phase of a small signal at a known frequency
+ *
+ * At full rate, each sample has a tracked DC level removed and is multiplied
+ * by the NCO sine and cosine (Q15). Products are summed over 2^decim_shift
+ * samples (integrate and dump), then low-passed by `order` cascaded
+ * first-order stages of time constant tau_s at the decimated rate. All of
+ * this is integer math; floats only appear when a result is read out.
+ *
+ * With a reference channel, a phase-locked loop steers the NCO onto the
+ * reference (type II: phase and frequency), updated once per 16 reference
+ * periods. Phase is then reported relative to the reference, and ref_hz
+ * only needs to be within a few percent of the loop update rate.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LOCKIN_MAX_ORDER 4
+
+typedef struct
+{
+    uint32_t sample_rate_hz;
+    float ref_hz;        // NCO frequency, or the starting guess with a reference channel
+    uint8_t decim_shift; // integrate and dump over 2^decim_shift samples, 0..16
+    uint8_t order;       // low-pass stages, 1..LOCKIN_MAX_ORDER, 6 dB/octave each
+    float tau_s;         // time constant per stage
+} lockin_config_t;
+
+typedef struct
+{
+    lockin_config_t cfg;
+    uint32_t phase; // NCO, Q32 turns
+    uint32_t inc;
+    uint32_t dec_count; // samples into the current dump
+    int64_t acc_i;      // sum of (s - dc) * sin
+    int64_t acc_q;      // sum of (s - dc) * cos
+    int64_t acc_s;      // sum of s, for the DC tracker
+    int64_t ref_i;
+    int64_t ref_q;
+    int64_t ref_s;
+    int32_t dc_q16;     // DC level removed before mixing, codes in Q16
+    int32_t ref_dc_q16;
+    int32_t alpha_q16;  // per decimated output
+    int32_t dc_alpha_q16;
+    int64_t lp_i_q16[LOCKIN_MAX_ORDER]; // I/Q low-pass stages in Q16, like the DC tracker
+    int64_t lp_q_q16[LOCKIN_MAX_ORDER];
+    uint32_t pll_dumps; // outputs per PLL update
+    uint32_t pll_count;
+    uint32_t outputs;   // decimated outputs so far
+} lockin_t;
+
+typedef struct
+{
+    float x;         // in-phase amplitude, codes
+    float y;         // quadrature amplitude, codes
+    float amplitude; // peak codes
+    float phase_rad; // relative to the NCO sine, or to the reference
+    float ref_hz;    // NCO frequency now (tracks the reference)
+    uint32_t outputs;
+} lockin_result_t;
+
+bool lockin_init(lockin_t *lk, const lockin_config_t *cfg);
+
+// Process n samples; ref is NULL without a reference channel. Returns the number of decimated outputs produced.
+uint32_t lockin_process(lockin_t *lk, const sample_t *s, const sample_t *ref, size_t n);
+
+// Current output of the low-pass chain
+void lockin_result(const lockin_t *lk, lockin_result_t *out);
+
+// Equivalent noise bandwidth of the low-pass chain, Hz. SNR gain is about sample_rate / (4 * ENBW).
+float lockin_enbw_hz(const lockin_config_t *cfg);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,127 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "mask_test.h"
+
+bool mask_init(mask_t *mask, const sample_t *upper, const sample_t *lower, uint32_t len, uint32_t pre)
+{
+    if (upper == NULL || lower == NULL || len == 0 || pre >= len)
+    {
+        return false;
+    }
+    mask->upper = upper;
+    mask->lower = lower;
+    mask->len = len;
+    mask->pre = pre;
+    mask->tested = 0;
+    mask->passed = 0;
+    mask->failed = 0;
+    return true;
+}
+
+void mask_from_reference(const sample_t *ref, uint32_t len, sample_t tol, uint32_t slack, sample_t *upper,
+                         sample_t *lower)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint32_t from = i > slack ? i - slack : 0;
+        uint32_t to = i + slack < len ? i + slack : len - 1;
+        int32_t hi = INT16_MIN, lo = INT16_MAX;
+        for (uint32_t k = from; k <= to; k++)
+        {
+            hi = ref[k] > hi ? ref[k] : hi;
+            lo = ref[k] < lo ? ref[k] : lo;
+        }
+        hi += tol;
+        lo -= tol;
+        upper[i] = (sample_t)(hi > INT16_MAX ? INT16_MAX : hi);
+        lower[i] = (sample_t)(lo < INT16_MIN ? INT16_MIN : lo);
+    }
+}
+
+// Violations in one contiguous span; the loop has no branches so it vectorizes
+static uint32_t count_outside(const sample_t *s, const sample_t *upper, const sample_t *lower, uint32_t n)
+{
+    uint32_t bad = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        bad += (s[i] > upper[i]) | (s[i] < lower[i]);
+    }
+    return bad;
+}
+
+static int32_t first_outside(const sample_t *s, const sample_t *upper, const sample_t *lower, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (s[i] > upper[i] || s[i] < lower[i])
+        {
+            return (int32_t)i;
+        }
+    }
+    return -1;
+}
+
+static void finish(mask_t *mask, mask_result_t *res, uint32_t violations)
+{
+    res->violations = violations;
+    res->pass = violations == 0;
+    res->first = -1;
+    mask->tested++;
+    if (res->pass)
+    {
+        mask->passed++;
+    }
+    else
+    {
+        mask->failed++;
+    }
+}
+
+void mask_check(mask_t *mask, const sample_t *capture, mask_result_t *res)
+{
+    finish(mask, res, count_outside(capture, mask->upper, mask->lower, mask->len));
+    if (!res->pass)
+    {
+        res->first = first_outside(capture, mask->upper, mask->lower, mask->len);
+    }
+}
+
+bool mask_check_ring(mask_t *mask, const sample_ring_t *ring, uint64_t head, uint64_t trigger_pos, mask_result_t *res)
+{
+    if (trigger_pos < mask->pre)
+    {
+        return false;
+    }
+    uint64_t start = trigger_pos - mask->pre;
+    uint64_t cap = sample_ring_capacity(ring);
+    if (start + mask->len > head || (head > cap && start < head - cap))
+    {
+        return false;
+    }
+
+    // At most two contiguous spans: up to the end of the buffer, then from its start
+    size_t off = start & ring->mask;
+    uint32_t first_len = (uint32_t)(sample_ring_capacity(ring) - off);
+    first_len = first_len < mask->len ? first_len : mask->len;
+    uint32_t rest = mask->len - first_len;
+
+    const sample_t *a = &ring->buf[off];
+    uint32_t bad = count_outside(a, mask->upper, mask->lower, first_len) +
+                   count_outside(ring->buf, mask->upper + first_len, mask->lower + first_len, rest);
+    finish(mask, res, bad);
+    if (!res->pass)
+    {
+        int32_t f = first_outside(a, mask->upper, mask->lower, first_len);
+        if (f < 0)
+        {
+            f = first_outside(ring->buf, mask->upper + first_len, mask->lower + first_len, rest);
+            f = f < 0 ? f : f + (int32_t)first_len;
+        }
+        res->first = f;
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Pass/fail mask testing of triggered captures
+ *
+ * A mask is an upper and a lower envelope of len samples, aligned so that
+ * index pre is the trigger sample. Captures are checked in place in the ring
+ * (no linearizing copy) with a branch-free compare loop, so every trigger can
+ * be tested at full rate; only failing captures need to be copied out.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    const sample_t *upper;
+    const sample_t *lower;
+    uint32_t len;
+    uint32_t pre; // mask index of the trigger sample
+    uint32_t tested;
+    uint32_t passed;
+    uint32_t failed;
+} mask_t;
+
+typedef struct
+{
+    bool pass;
+    uint32_t violations; // samples outside the envelope
+    int32_t first;       // mask index of the first violation, -1 on pass
+} mask_result_t;
+
+bool mask_init(mask_t *mask, const sample_t *upper, const sample_t *lower, uint32_t len, uint32_t pre);
+
+// Envelope around a golden capture: +-tol codes, widened by +-slack samples in time
+void mask_from_reference(const sample_t *ref, uint32_t len, sample_t tol, uint32_t slack, sample_t *upper,
+                         sample_t *lower);
+
+// Check a linear capture of mask->len samples and update the counters
+void mask_check(mask_t *mask, const sample_t *capture, mask_result_t *res);
+
+// Check the capture around trigger_pos in place, against a head snapshot. False (and
+// no counting) when part of it is not in the ring: not yet written or overwritten.
+bool mask_check_ring(mask_t *mask, const sample_ring_t *ring, uint64_t head, uint64_t trigger_pos, mask_result_t *res);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,514 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "math_channel.h"
+
+#define Q16_ONE 65536
+
+// =================================================================================
+// COMPILER
+// =================================================================================
+
+typedef struct
+{
+    const char *p;
+    math_program_t *prog;
+    int depth; // stack depth after the code emitted so far
+    const char *err;
+} parser_t;
+
+// A parsed subexpression is either code already emitted (its value on top of
+// the stack) or a literal that has not been emitted yet, so it can be folded.
+typedef struct
+{
+    bool is_lit;
+    double lit;
+} operand_t;
+
+static bool parse_expr(parser_t *ps, operand_t *out);
+
+static void skip_ws(parser_t *ps)
+{
+    while (isspace((unsigned char)*ps->p))
+    {
+        ps->p++;
+    }
+}
+
+static bool fail(parser_t *ps, const char *msg)
+{
+    if (!ps->err)
+    {
+        ps->err = msg;
+    }
+    return false;
+}
+
+static bool emit(parser_t *ps, math_op_t op, uint8_t arg, int32_t k, int32_t c, int stack_delta)
+{
+    if (ps->prog->len >= MATH_MAX_INSNS)
+    {
+        return fail(ps, "expression too long");
+    }
+    ps->depth += stack_delta;
+    if (ps->depth > MATH_STACK_DEPTH)
+    {
+        return fail(ps, "expression nests too deeply");
+    }
+    math_insn_t *in = &ps->prog->insn[ps->prog->len++];
+    in->op = op;
+    in->arg = arg;
+    in->k = k;
+    in->c = c;
+    return true;
+}
+
+static math_insn_t *last_insn(parser_t *ps)
+{
+    return ps->prog->len ? &ps->prog->insn[ps->prog->len - 1] : NULL;
+}
+
+static bool to_q16(parser_t *ps, double v, int32_t *out)
+{
+    if (v >= 32768.0 || v <= -32768.0)
+    {
+        return fail(ps, "scale factor out of range");
+    }
+    *out = (int32_t)(v * Q16_ONE + (v < 0 ? -0.5 : 0.5));
+    return true;
+}
+
+static bool to_int(parser_t *ps, double v, int32_t *out)
+{
+    if (v >= 2147483647.0 || v <= -2147483648.0)
+    {
+        return fail(ps, "constant out of range");
+    }
+    *out = (int32_t)(v + (v < 0 ? -0.5 : 0.5));
+    return true;
+}
+
+// top = top * k (+ 0), fused into a preceding SCALE when there is one
+static bool emit_scale(parser_t *ps, double k)
+{
+    int32_t kq;
+    math_insn_t *prev = last_insn(ps);
+    if (prev && prev->op == MATH_OP_SCALE)
+    {
+        // ((x*k1 >> 16) + c1) * k == (x * k1*k >> 16) + c1*k
+        double k1 = (double)prev->k / Q16_ONE;
+        int32_t c;
+        if (!to_q16(ps, k1 * k, &kq) || !to_int(ps, prev->c * k, &c))
+        {
+            return false;
+        }
+        prev->k = kq;
+        prev->c = c;
+        return true;
+    }
+    return to_q16(ps, k, &kq) && emit(ps, MATH_OP_SCALE, 0, kq, 0, 0);
+}
+
+// top = top + c, fused into a preceding SCALE when there is one
+static bool emit_offset(parser_t *ps, double c)
+{
+    int32_t ci;
+    math_insn_t *prev = last_insn(ps);
+    if (prev && prev->op == MATH_OP_SCALE)
+    {
+        if (!to_int(ps, prev->c + c, &ci))
+        {
+            return false;
+        }
+        prev->c = ci;
+        return true;
+    }
+    return to_int(ps, c, &ci) && emit(ps, MATH_OP_SCALE, 0, Q16_ONE, ci, 0);
+}
+
+static bool parse_unary(parser_t *ps, operand_t *out)
+{
+    skip_ws(ps);
+    char ch = *ps->p;
+
+    if (ch == '-')
+    {
+        ps->p++;
+        if (!parse_unary(ps, out))
+        {
+            return false;
+        }
+        if (out->is_lit)
+        {
+            out->lit = -out->lit;
+            return true;
+        }
+        return emit_scale(ps, -1.0);
+    }
+    if (strncmp(ps->p, "abs", 3) == 0)
+    {
+        ps->p += 3;
+        skip_ws(ps);
+        if (*ps->p != '(')
+        {
+            return fail(ps, "expected '(' after abs");
+        }
+        ps->p++;
+        if (!parse_expr(ps, out))
+        {
+            return false;
+        }
+        skip_ws(ps);
+        if (*ps->p != ')')
+        {
+            return fail(ps, "expected ')'");
+        }
+        ps->p++;
+        if (out->is_lit)
+        {
+            out->lit = out->lit < 0 ? -out->lit : out->lit;
+            return true;
+        }
+        return emit(ps, MATH_OP_ABS, 0, 0, 0, 0);
+    }
+    if (ch == '(')
+    {
+        ps->p++;
+        if (!parse_expr(ps, out))
+        {
+            return false;
+        }
+        skip_ws(ps);
+        if (*ps->p != ')')
+        {
+            return fail(ps, "expected ')'");
+        }
+        ps->p++;
+        return true;
+    }
+    if (ch >= 'A' && ch < 'A' + MATH_MAX_SOURCES)
+    {
+        ps->p++;
+        uint8_t src = (uint8_t)(ch - 'A');
+        if (src + 1 > ps->prog->num_sources)
+        {
+            ps->prog->num_sources = src + 1;
+        }
+        out->is_lit = false;
+        return emit(ps, MATH_OP_LOAD, src, 0, 0, 1);
+    }
+    if (isdigit((unsigned char)ch) || ch == '.')
+    {
+        char *end;
+        out->is_lit = true;
+        out->lit = strtod(ps->p, &end);
+        ps->p = end;
+        return true;
+    }
+    return fail(ps, "unexpected character");
+}
+
+// Emit a pending literal so it can take part in a signal x signal operation
+static bool materialize(parser_t *ps, operand_t *o)
+{
+    int32_t c;
+    if (!o->is_lit)
+    {
+        return true;
+    }
+    o->is_lit = false;
+    return to_int(ps, o->lit, &c) && emit(ps, MATH_OP_CONST, 0, 0, c, 1);
+}
+
+static bool parse_term(parser_t *ps, operand_t *out)
+{
+    if (!parse_unary(ps, out))
+    {
+        return false;
+    }
+    while (1)
+    {
+        skip_ws(ps);
+        char op = *ps->p;
+        if (op != '*' && op != '/')
+        {
+            return true;
+        }
+        ps->p++;
+
+        operand_t rhs;
+        if (!parse_unary(ps, &rhs))
+        {
+            return false;
+        }
+        if (op == '/')
+        {
+            if (!rhs.is_lit)
+            {
+                return fail(ps, "can only divide by a constant");
+            }
+            if (rhs.lit == 0.0)
+            {
+                return fail(ps, "division by zero");
+            }
+            rhs.lit = 1.0 / rhs.lit;
+        }
+
+        if (out->is_lit && rhs.is_lit)
+        {
+            out->lit *= rhs.lit;
+        }
+        else if (rhs.is_lit)
+        {
+            if (!emit_scale(ps, rhs.lit))
+            {
+                return false;
+            }
+        }
+        else if (out->is_lit)
+        {
+            // The right side is already on the stack, multiplication commutes
+            if (!emit_scale(ps, out->lit))
+            {
+                return false;
+            }
+            out->is_lit = false;
+        }
+        else if (!emit(ps, MATH_OP_MUL, 0, 0, 0, -1))
+        {
+            return false;
+        }
+    }
+}
+
+static bool parse_expr(parser_t *ps, operand_t *out)
+{
+    if (!parse_term(ps, out))
+    {
+        return false;
+    }
+    while (1)
+    {
+        skip_ws(ps);
+        char op = *ps->p;
+        if (op != '+' && op != '-')
+        {
+            return true;
+        }
+        ps->p++;
+
+        operand_t rhs;
+        if (!parse_term(ps, &rhs))
+        {
+            return false;
+        }
+        double sign = op == '-' ? -1.0 : 1.0;
+
+        if (out->is_lit && rhs.is_lit)
+        {
+            out->lit += sign * rhs.lit;
+        }
+        else if (rhs.is_lit)
+        {
+            if (!emit_offset(ps, sign * rhs.lit))
+            {
+                return false;
+            }
+        }
+        else if (out->is_lit)
+        {
+            // lit +/- expr: expr is on the stack, fold into k*expr + lit
+            if ((sign < 0 && !emit_scale(ps, -1.0)) || !emit_offset(ps, out->lit))
+            {
+                return false;
+            }
+            out->is_lit = false;
+        }
+        else if (!emit(ps, op == '-' ? MATH_OP_SUB : MATH_OP_ADD, 0, 0, 0, -1))
+        {
+            return false;
+        }
+    }
+}
+
+bool math_compile(const char *expr, math_program_t *prog, const char **err)
+{
+    memset(prog, 0, sizeof(*prog));
+    parser_t ps = {.p = expr, .prog = prog};
+    operand_t result;
+
+    bool ok = parse_expr(&ps, &result) && materialize(&ps, &result);
+    skip_ws(&ps);
+    if (ok && *ps.p != '\0')
+    {
+        ok = fail(&ps, "trailing characters");
+    }
+    if (ok && prog->num_sources == 0)
+    {
+        ok = fail(&ps, "expression uses no channel");
+    }
+    if (err)
+    {
+        *err = ok ? NULL : ps.err;
+    }
+    return ok;
+}
+
+// =================================================================================
+// INTERPRETER
+// =================================================================================
+
+static inline int32_t sat32(int64_t v)
+{
+    return v > INT32_MAX ? INT32_MAX : (v < INT32_MIN ? INT32_MIN : (int32_t)v);
+}
+
+void math_eval(const math_program_t *prog, const sample_t *const *src, size_t n,
+               sample_t *out, math_scratch_t *scratch)
+{
+    int sp = 0;
+    for (size_t pc = 0; pc < prog->len; pc++)
+    {
+        const math_insn_t *in = &prog->insn[pc];
+        int32_t *top = scratch->lane[sp - 1 < 0 ? 0 : sp - 1];
+        int32_t *below = scratch->lane[sp - 2 < 0 ? 0 : sp - 2];
+
+        switch (in->op)
+        {
+        case MATH_OP_LOAD:
+        {
+            int32_t *dst = scratch->lane[sp++];
+            const sample_t *s = src[in->arg];
+            for (size_t i = 0; i < n; i++)
+            {
+                dst[i] = s[i];
+            }
+            break;
+        }
+        case MATH_OP_CONST:
+        {
+            int32_t *dst = scratch->lane[sp++];
+            for (size_t i = 0; i < n; i++)
+            {
+                dst[i] = in->c;
+            }
+            break;
+        }
+        case MATH_OP_ADD:
+            for (size_t i = 0; i < n; i++)
+            {
+                below[i] = sat32((int64_t)below[i] + top[i]);
+            }
+            sp--;
+            break;
+        case MATH_OP_SUB:
+            for (size_t i = 0; i < n; i++)
+            {
+                below[i] = sat32((int64_t)below[i] - top[i]);
+            }
+            sp--;
+            break;
+        case MATH_OP_MUL:
+            for (size_t i = 0; i < n; i++)
+            {
+                below[i] = sat32((int64_t)below[i] * top[i]);
+            }
+            sp--;
+            break;
+        case MATH_OP_SCALE:
+        {
+            int64_t k = in->k;
+            int64_t c = in->c;
+            for (size_t i = 0; i < n; i++)
+            {
+                top[i] = sat32(((top[i] * k) >> 16) + c);
+            }
+            break;
+        }
+        case MATH_OP_ABS:
+            for (size_t i = 0; i < n; i++)
+            {
+                top[i] = top[i] < 0 ? (top[i] == INT32_MIN ? INT32_MAX : -top[i]) : top[i];
+            }
+            break;
+        }
+    }
+
+    const int32_t *res = scratch->lane[0];
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t v = res[i];
+        out[i] = (sample_t)(v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v));
+    }
+}
+
+// =================================================================================
+// DERIVED CHANNELS
+// =================================================================================
+
+bool math_channel_init(math_channel_t *ch, const char *expr, const sample_ring_t *const *sources,
+                       size_t num_sources, sample_t *storage, size_t capacity, const char **err)
+{
+    memset(ch, 0, sizeof(*ch));
+    if (!math_compile(expr, &ch->prog, err))
+    {
+        return false;
+    }
+    if (ch->prog.num_sources > num_sources)
+    {
+        if (err)
+        {
+            *err = "expression references a channel that is not sampled";
+        }
+        return false;
+    }
+
+    uint64_t start = UINT64_MAX;
+    for (size_t s = 0; s < ch->prog.num_sources; s++)
+    {
+        ch->src[s] = sources[s];
+        start = sources[s]->head < start ? sources[s]->head : start;
+    }
+    sample_ring_init(&ch->out, storage, capacity);
+    ch->done = start & ~(uint64_t)(MATH_BLOCK_SAMPLES - 1);
+    ch->out.head = ch->done;
+    return true;
+}
+
+uint64_t math_channel_run(math_channel_t *ch, math_scratch_t *scratch)
+{
+    // Evaluate up to the slowest source, never behind the oldest retained sample
+    uint64_t avail = UINT64_MAX;
+    uint64_t oldest = 0;
+    for (size_t s = 0; s < ch->prog.num_sources; s++)
+    {
+        uint64_t head = ch->src[s]->head;
+        uint64_t old = sample_ring_oldest(ch->src[s]);
+        avail = head < avail ? head : avail;
+        oldest = old > oldest ? old : oldest;
+    }
+    if (ch->done < oldest)
+    {
+        ch->done = (oldest + MATH_BLOCK_SAMPLES - 1) & ~(uint64_t)(MATH_BLOCK_SAMPLES - 1);
+    }
+
+    const sample_t *ptrs[MATH_MAX_SOURCES];
+    while (ch->done + MATH_BLOCK_SAMPLES <= avail)
+    {
+        // Blocks are aligned and ring capacities are multiples of the block
+        // length, so a block never wraps inside a ring
+        for (size_t s = 0; s < ch->prog.num_sources; s++)
+        {
+            ptrs[s] = &ch->src[s]->buf[ch->done & ch->src[s]->mask];
+        }
+        math_eval(&ch->prog, ptrs, MATH_BLOCK_SAMPLES, &ch->out.buf[ch->done & ch->out.mask], scratch);
+        ch->done += MATH_BLOCK_SAMPLES;
+    }
+    return ch->done;
+}
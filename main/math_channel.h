@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Math channels: derived signals such as "A-B", "A*0.5+100", "abs(A)" or "A*B"
+ *
+ * An expression is compiled once into a short stack bytecode. The interpreter
+ * then runs each instruction over a whole block of samples at a time, so the
+ * dispatch cost is paid once per block rather than once per sample and every
+ * opcode body is a tight loop the compiler can unroll. Lanes are int32 and the
+ * result saturates to sample_t when it is stored into the derived ring.
+ *
+ * Grammar: expr := term (('+'|'-') term)*, term := unary (('*'|'/') unary)*,
+ * unary := '-' unary | 'abs(' expr ')' | '(' expr ')' | A..D | number.
+ * Multiplying or dividing by a literal compiles to a Q16 scale, and a scale
+ * followed by adding a literal is fused into one SCALE instruction.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MATH_MAX_SOURCES 4     // A, B, C, D
+#define MATH_MAX_INSNS 16
+#define MATH_STACK_DEPTH 4
+#define MATH_BLOCK_SAMPLES 256 // evaluated block length, same as BLOCK_INDEX_SAMPLES
+
+typedef enum
+{
+    MATH_OP_LOAD,  // push source[arg]
+    MATH_OP_CONST, // push c
+    MATH_OP_ADD,   // a + b
+    MATH_OP_SUB,   // a - b
+    MATH_OP_MUL,   // a * b
+    MATH_OP_SCALE, // ((top * k) >> 16) + c, k in Q16
+    MATH_OP_ABS,   // |top|
+} math_op_t;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t arg;
+    int32_t k;
+    int32_t c;
+} math_insn_t;
+
+typedef struct
+{
+    math_insn_t insn[MATH_MAX_INSNS];
+    uint8_t len;
+    uint8_t num_sources; // highest source referenced + 1
+} math_program_t;
+
+// Working lanes for the interpreter; one per concurrently evaluating task
+typedef struct
+{
+    int32_t lane[MATH_STACK_DEPTH][MATH_BLOCK_SAMPLES];
+} math_scratch_t;
+
+// Compile expr. On failure returns false and points *err at a static message.
+bool math_compile(const char *expr, math_program_t *prog, const char **err);
+
+// Evaluate n (<= MATH_BLOCK_SAMPLES) samples of every source into out
+void math_eval(const math_program_t *prog, const sample_t *const *src, size_t n,
+               sample_t *out, math_scratch_t *scratch);
+
+// A derived channel fed block by block from source rings
+typedef struct
+{
+    math_program_t prog;
+    const sample_ring_t *src[MATH_MAX_SOURCES];
+    sample_ring_t out; // derived samples share absolute positions with the sources
+    uint64_t done;     // next absolute position to evaluate
+} math_channel_t;
+
+// sources must provide prog.num_sources rings whose capacity is a multiple of
+// MATH_BLOCK_SAMPLES. storage/capacity back the derived ring.
+bool math_channel_init(math_channel_t *ch, const char *expr, const sample_ring_t *const *sources,
+                       size_t num_sources, sample_t *storage, size_t capacity, const char **err);
+
+// Evaluate every whole block the sources have completed. Only writes derived
+// samples; returns the head the caller should publish as ch->out.head (under
+// its own lock) once the call returns.
+uint64_t math_channel_run(math_channel_t *ch, math_scratch_t *scratch);
+
+#ifdef __cplusplus
+}
+#endif
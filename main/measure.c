@@ -0,0 +1,252 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "measure.h"
+
+#define MODE_MIN_SHARE 20 // a half needs a mode bin holding 1/20 of its samples
+
+// Mean of the samples around the mode bin: the window grows while neighbouring bins
+// hold at least a quarter of the peak, so a noisy plateau is averaged symmetrically
+static float mode_level(const uint32_t *hist, const int32_t *sums, int from, int to, uint32_t *peak)
+{
+    int best = from;
+    for (int b = from; b <= to; b++)
+    {
+        best = hist[b] > hist[best] ? b : best;
+    }
+    *peak = hist[best];
+    int l = best, r = best;
+    while (l > from && hist[l - 1] * 4 >= *peak)
+    {
+        l--;
+    }
+    while (r < to && hist[r + 1] * 4 >= *peak)
+    {
+        r++;
+    }
+    int64_t sum = 0;
+    uint32_t count = 0;
+    for (int b = l; b <= r; b++)
+    {
+        sum += sums[b];
+        count += hist[b];
+    }
+    return count ? (float)sum / count : 0.0f;
+}
+
+// Time where the signal crosses y between samples i and i + 1
+static inline float cross_at(const sample_t *s, size_t i, float y)
+{
+    float d = (float)s[i + 1] - s[i];
+    return d != 0.0f ? i + (y - s[i]) / d : (float)i;
+}
+
+// Walk from a recorded edge to the crossing of y, staying within [lo, hi) samples.
+// Returns -1 if the crossing is not reached.
+static float find_crossing(const sample_t *s, size_t lo, size_t hi, size_t at, float y, bool rising)
+{
+    // Back up while the sample is still past y, then go forward to the first sample past y
+    size_t i = at;
+    while (i > lo && (rising ? s[i - 1] >= y : s[i - 1] <= y))
+    {
+        i--;
+    }
+    while (i < hi && (rising ? s[i] < y : s[i] > y))
+    {
+        i++;
+    }
+    if (i == lo || i >= hi)
+    {
+        return -1.0f;
+    }
+    return cross_at(s, i - 1, y);
+}
+
+bool meas_capture(const meas_config_t *cfg, const sample_t *s, size_t n, meas_result_t *out, meas_scratch_t *scratch)
+{
+    memset(out, 0, sizeof(*out));
+    if (n < 4 || n > UINT16_MAX || cfg->hysteresis <= 0 || cfg->hist_shift > 15)
+    {
+        return false;
+    }
+
+    // The one sweep: histogram, min/max/sum and slicer edges
+    uint32_t *hist = scratch->hist;
+    int32_t *sums = scratch->sums; // captures are limited to 64K samples, so no overflow
+    uint32_t *edge_pos = scratch->edge_pos;
+    bool *edge_rising = scratch->edge_rising;
+    float *t50 = scratch->t50;
+    memset(hist, 0, sizeof(scratch->hist));
+    memset(sums, 0, sizeof(scratch->sums));
+    int num_edges = 0;
+    const int32_t up = cfg->level, down = (int32_t)cfg->level - cfg->hysteresis;
+    bool high = s[0] >= up;
+    int32_t mn = s[0], mx = s[0];
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t v = s[i];
+        int32_t b = (v - cfg->hist_min) >> cfg->hist_shift;
+        b = b < 0 ? 0 : b >= MEAS_HIST_BINS ? MEAS_HIST_BINS - 1 : b;
+        hist[b]++;
+        sums[b] += v;
+        mn = v < mn ? v : mn;
+        mx = v > mx ? v : mx;
+        sum += v;
+        bool h = high ? v > down : v >= up;
+        if (h != high && num_edges < MEAS_MAX_EDGES)
+        {
+            edge_pos[num_edges] = (uint32_t)i;
+            edge_rising[num_edges++] = h;
+        }
+        high = h;
+    }
+    out->min = (sample_t)mn;
+    out->max = (sample_t)mx;
+    out->mean = (float)sum / n;
+
+    // Top and base: modes of the halves above and below the middle of the range
+    int32_t mid_code = (mn + mx) / 2;
+    int32_t bmin = (mn - cfg->hist_min) >> cfg->hist_shift;
+    int32_t bmid = (mid_code - cfg->hist_min) >> cfg->hist_shift;
+    int32_t bmax = (mx - cfg->hist_min) >> cfg->hist_shift;
+    bmin = bmin < 0 ? 0 : bmin;
+    bmax = bmax >= MEAS_HIST_BINS ? MEAS_HIST_BINS - 1 : bmax;
+    bmid = bmid < bmin ? bmin : bmid > bmax ? bmax : bmid;
+    uint32_t lo_n = 0, hi_n = 0, lo_peak = 0, hi_peak = 0;
+    for (int b = bmin; b <= bmax; b++)
+    {
+        if (b <= bmid)
+        {
+            lo_n += hist[b];
+        }
+        else
+        {
+            hi_n += hist[b];
+        }
+    }
+    out->top = (float)mx;
+    out->base = (float)mn;
+    if (bmax > bmid && bmid >= bmin)
+    {
+        float top = mode_level(hist, sums, bmid + 1, bmax, &hi_peak);
+        float base = mode_level(hist, sums, bmin, bmid, &lo_peak);
+        if (hi_peak * MODE_MIN_SHARE >= hi_n && lo_peak * MODE_MIN_SHARE >= lo_n && top > base)
+        {
+            out->top = top > mx ? mx : top;
+            out->base = base < mn ? mn : base;
+            out->flags |= MEAS_HAVE_LEVELS;
+        }
+    }
+    out->amplitude = out->top - out->base;
+    if (out->amplitude <= 0.0f)
+    {
+        return true; // flat capture: levels only
+    }
+    out->overshoot_pct = 100.0f * (mx - out->top) / out->amplitude;
+    out->undershoot_pct = 100.0f * (out->base - mn) / out->amplitude;
+
+    // Refine every edge at 10/50/90 %, walking no further than the neighbouring edges
+    const float y10 = out->base + 0.1f * out->amplitude;
+    const float y50 = out->base + 0.5f * out->amplitude;
+    const float y90 = out->base + 0.9f * out->amplitude;
+    float rise_sum = 0, fall_sum = 0;
+    int rise_n = 0, fall_n = 0;
+    for (int e = 0; e < num_edges; e++)
+    {
+        size_t lo = e > 0 ? edge_pos[e - 1] : 0;
+        size_t hi = e + 1 < num_edges ? edge_pos[e + 1] : n;
+        bool r = edge_rising[e];
+        t50[e] = find_crossing(s, lo, hi, edge_pos[e], y50, r);
+        float ta = find_crossing(s, lo, hi, edge_pos[e], r ? y10 : y90, r);
+        float tb = find_crossing(s, lo, hi, edge_pos[e], r ? y90 : y10, r);
+        if (ta >= 0.0f && tb >= ta)
+        {
+            if (r)
+            {
+                rise_sum += tb - ta;
+                rise_n++;
+            }
+            else
+            {
+                fall_sum += tb - ta;
+                fall_n++;
+            }
+        }
+        out->rising_edges += r;
+        out->falling_edges += !r;
+    }
+    if (rise_n)
+    {
+        out->rise = rise_sum / rise_n;
+        out->flags |= MEAS_HAVE_RISE;
+    }
+    if (fall_n)
+    {
+        out->fall = fall_sum / fall_n;
+        out->flags |= MEAS_HAVE_FALL;
+    }
+
+    // Widths between consecutive opposite edges, period between same-direction edges
+    float pos_sum = 0, neg_sum = 0;
+    int pos_n = 0, neg_n = 0;
+    for (int e = 0; e + 1 < num_edges; e++)
+    {
+        if (t50[e] < 0.0f || t50[e + 1] < 0.0f)
+        {
+            continue;
+        }
+        float w = t50[e + 1] - t50[e];
+        if (edge_rising[e])
+        {
+            pos_sum += w;
+            pos_n++;
+        }
+        else
+        {
+            neg_sum += w;
+            neg_n++;
+        }
+    }
+    out->width_pos = pos_n ? pos_sum / pos_n : 0.0f;
+    out->width_neg = neg_n ? neg_sum / neg_n : 0.0f;
+    if (pos_n || neg_n)
+    {
+        out->flags |= MEAS_HAVE_WIDTH;
+    }
+
+    // Period from the first and last valid edge of the more frequent direction
+    bool use_rising = out->rising_edges >= out->falling_edges;
+    int first = -1, last = -1, cycles = 0;
+    for (int e = 0; e < num_edges; e++)
+    {
+        if (edge_rising[e] != use_rising || t50[e] < 0.0f)
+        {
+            continue;
+        }
+        if (first < 0)
+        {
+            first = e;
+        }
+        else
+        {
+            cycles++;
+        }
+        last = e;
+    }
+    if (cycles > 0)
+    {
+        out->period = (t50[last] - t50[first]) / cycles;
+        out->frequency_hz = cfg->sample_rate_hz / out->period;
+        if (pos_n)
+        {
+            out->duty_pct = 100.0f * out->width_pos / out->period;
+        }
+        out->flags |= MEAS_HAVE_PERIOD;
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Automatic waveform measurements on a capture
+ *
+ * One sweep over the samples builds an amplitude histogram and records the
+ * edges seen by a hysteresis slicer (normally at the trigger level). Top and
+ * base are the mean levels around the histogram modes of the upper and lower
+ * halves, falling back to max and min when a half has no distinct mode
+ * (sines, triangles).
+ * The 10 %, 50 % and 90 % crossings are interpolated by walking outward
+ * from each recorded edge, touching only samples on the transitions.
+ * Times are in samples, with sub-sample interpolation; only the first
+ * MEAS_MAX_EDGES edges are timed.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEAS_HIST_BINS 512
+#define MEAS_MAX_EDGES 64
+
+#define MEAS_HAVE_LEVELS 0x01 // top/base from histogram modes (else max/min)
+#define MEAS_HAVE_RISE 0x02
+#define MEAS_HAVE_FALL 0x04
+#define MEAS_HAVE_WIDTH 0x08  // positive and/or negative pulse width
+#define MEAS_HAVE_PERIOD 0x10
+
+typedef struct
+{
+    sample_t level;      // edge slicer level, e.g. the trigger level
+    sample_t hysteresis; // slicer hysteresis
+    sample_t hist_min;   // lowest code of the histogram
+    uint8_t hist_shift;  // codes per histogram bin = 1 << hist_shift
+    uint32_t sample_rate_hz;
+} meas_config_t;
+
+typedef struct
+{
+    uint32_t flags; // MEAS_HAVE_*
+    sample_t min;
+    sample_t max;
+    float mean;
+    float top;
+    float base;
+    float amplitude;     // top - base
+    float overshoot_pct; // (max - top) / amplitude
+    float undershoot_pct; // (base - min) / amplitude
+    float rise;          // mean 10-90 % rise time, samples
+    float fall;          // mean 90-10 % fall time, samples
+    float width_pos;     // mean positive pulse width at 50 %, samples
+    float width_neg;     // mean negative pulse width at 50 %, samples
+    float period;        // samples
+    float frequency_hz;
+    float duty_pct;
+    uint16_t rising_edges;
+    uint16_t falling_edges;
+} meas_result_t;
+
+// Histogram and edge workspace, about 5 KB: too large for a worker stack
+typedef struct
+{
+    uint32_t hist[MEAS_HIST_BINS];
+    int32_t sums[MEAS_HIST_BINS];
+    uint32_t edge_pos[MEAS_MAX_EDGES]; // first sample past the slicer level
+    bool edge_rising[MEAS_MAX_EDGES];
+    float t50[MEAS_MAX_EDGES];
+} meas_scratch_t;
+
+// Measure a linear capture of 4..65535 samples. Returns false if n is out of range or the config is invalid.
+bool meas_capture(const meas_config_t *cfg, const sample_t *s, size_t n, meas_result_t *out, meas_scratch_t *scratch);
+
+#ifdef __cplusplus
+}
+#endif
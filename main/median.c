@@ -0,0 +1,193 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include "median.h"
+
+#define CHUNK 64 // inputs staged per pass, kept small for the 4 KB worker stacks
+
+// Compare-exchange: a gets the smaller value. Written with selects so it compiles branch-free.
+#define SORT2(a, b)                      \
+    do                                   \
+    {                                    \
+        sample_t lo_ = (a) < (b) ? (a) : (b); \
+        (b) = (a) < (b) ? (b) : (a);     \
+        (a) = lo_;                       \
+    } while (0)
+
+static sample_t med3(const sample_t *x)
+{
+    sample_t a = x[0], b = x[1], c = x[2];
+    SORT2(a, b);
+    SORT2(b, c);
+    SORT2(a, b);
+    return b;
+}
+
+// Median networks after Devillard, "Fast median search: an ANSI C implementation"
+static sample_t med5(const sample_t *x)
+{
+    sample_t p[5];
+    memcpy(p, x, sizeof(p));
+    SORT2(p[0], p[1]); SORT2(p[3], p[4]); SORT2(p[0], p[3]);
+    SORT2(p[1], p[4]); SORT2(p[1], p[2]); SORT2(p[2], p[3]);
+    SORT2(p[1], p[2]);
+    return p[2];
+}
+
+static sample_t med7(const sample_t *x)
+{
+    sample_t p[7];
+    memcpy(p, x, sizeof(p));
+    SORT2(p[0], p[5]); SORT2(p[0], p[3]); SORT2(p[1], p[6]);
+    SORT2(p[2], p[4]); SORT2(p[0], p[1]); SORT2(p[3], p[5]);
+    SORT2(p[2], p[6]); SORT2(p[2], p[3]); SORT2(p[3], p[6]);
+    SORT2(p[4], p[5]); SORT2(p[1], p[4]); SORT2(p[1], p[3]);
+    SORT2(p[3], p[4]);
+    return p[3];
+}
+
+static sample_t med9(const sample_t *x)
+{
+    sample_t p[9];
+    memcpy(p, x, sizeof(p));
+    SORT2(p[1], p[2]); SORT2(p[4], p[5]); SORT2(p[7], p[8]);
+    SORT2(p[0], p[1]); SORT2(p[3], p[4]); SORT2(p[6], p[7]);
+    SORT2(p[1], p[2]); SORT2(p[4], p[5]); SORT2(p[7], p[8]);
+    SORT2(p[0], p[3]); SORT2(p[5], p[8]); SORT2(p[4], p[7]);
+    SORT2(p[3], p[6]); SORT2(p[1], p[4]); SORT2(p[2], p[5]);
+    SORT2(p[4], p[7]); SORT2(p[4], p[2]); SORT2(p[6], p[4]);
+    SORT2(p[4], p[2]);
+    return p[4];
+}
+
+bool median_init(median_t *m, const median_config_t *cfg)
+{
+    memset(m, 0, sizeof(*m));
+    if (cfg->window < 3 || cfg->window > MEDIAN_MAX_WINDOW || cfg->window % 2 == 0 ||
+        (cfg->hampel && cfg->n_sigma <= 0))
+    {
+        return false;
+    }
+    m->cfg = *cfg;
+    m->thresh_q8 = (uint32_t)lrintf(cfg->n_sigma * 1.4826f * 256);
+    return true;
+}
+
+// Swap the outgoing sample for the incoming one in the sorted window
+static void sorted_replace(sample_t *s, int w, sample_t out, sample_t in)
+{
+    int lo = 0, hi = w - 1;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (s[mid] < out)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    int i = lo;
+    while (i + 1 < w && s[i + 1] < in)
+    {
+        s[i] = s[i + 1];
+        i++;
+    }
+    while (i > 0 && s[i - 1] > in)
+    {
+        s[i] = s[i - 1];
+        i--;
+    }
+    s[i] = in;
+}
+
+// Median absolute deviation of a sorted window around its median s[c]: the deviation of rank c,
+// where rank 0 is the median itself and the others merge from both sides outward
+static int32_t sorted_mad(const sample_t *s, int c)
+{
+    int lo = c - 1, hi = c + 1;
+    int32_t d = 0;
+    for (int rank = 1; rank <= c; rank++)
+    {
+        int32_t dl = s[c] - s[lo], dh = s[hi] - s[c];
+        if (dl <= dh)
+        {
+            d = dl;
+            lo--;
+        }
+        else
+        {
+            d = dh;
+            hi++;
+        }
+    }
+    return d;
+}
+
+void median_process(median_t *m, const sample_t *in, sample_t *out, size_t n)
+{
+    const int w = m->cfg.window;
+    const int c = w / 2;
+    if (!m->primed && n > 0)
+    {
+        for (int k = 0; k < w; k++)
+        {
+            m->hist[k] = m->sorted[k] = in[0];
+        }
+        m->primed = true;
+    }
+
+    // buf holds the previous window then the chunk; output i covers buf[i + 1 .. i + w]
+    sample_t buf[MEDIAN_MAX_WINDOW + CHUNK];
+    while (n > 0)
+    {
+        size_t len = n < CHUNK ? n : CHUNK;
+        memcpy(buf, m->hist, w * sizeof(sample_t));
+        memcpy(&buf[w], in, len * sizeof(sample_t));
+
+        if (!m->cfg.hampel && w <= 9)
+        {
+            sample_t (*net)(const sample_t *) = w == 3 ? med3 : w == 5 ? med5 : w == 7 ? med7 : med9;
+            for (size_t i = 0; i < len; i++)
+            {
+                out[i] = net(&buf[i + 1]);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < len; i++)
+            {
+                sorted_replace(m->sorted, w, buf[i], buf[i + w]);
+                sample_t med = m->sorted[c];
+                if (!m->cfg.hampel)
+                {
+                    out[i] = med;
+                    continue;
+                }
+                sample_t x = buf[i + 1 + c];
+                int32_t dev = x > med ? x - med : med - x;
+                if (dev > m->cfg.min_dev && (uint32_t)dev * 256 > m->thresh_q8 * (uint32_t)sorted_mad(m->sorted, c))
+                {
+                    out[i] = med;
+                    m->replaced++;
+                }
+                else
+                {
+                    out[i] = x;
+                }
+            }
+        }
+
+        memcpy(m->hist, &buf[len], w * sizeof(sample_t));
+        in += len;
+        out += len;
+        n -= len;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Running median and Hampel spike filter for impulsive noise
+ *
+ * Both are causal over the last `window` samples, so output n describes
+ * input n - window / 2: the filtered stream is delayed by median_delay()
+ * samples but keeps its absolute positions, and triggers and measurements
+ * can run on it unchanged.
+ *
+ * Median: windows 3, 5, 7 and 9 use branch-free min/max sorting networks
+ * over a block at a time; 11..15 keep the window sorted, finding the
+ * outgoing sample by binary search and sliding the incoming one into place.
+ *
+ * Hampel: the centre sample is replaced by the window median only when it
+ * lies more than n_sigma robust standard deviations (1.4826 * MAD) and more
+ * than min_dev codes away from it, so edges and noise pass untouched and
+ * isolated glitches disappear. The MAD comes from the sorted window in
+ * O(window) by merging the deviations below and above the median.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MEDIAN_MAX_WINDOW 15
+
+typedef struct
+{
+    uint8_t window;   // odd, 3..MEDIAN_MAX_WINDOW
+    bool hampel;      // replace outliers only, instead of every sample by the median
+    float n_sigma;    // Hampel threshold in robust standard deviations, typically 3
+    uint16_t min_dev; // Hampel: deviations up to this many codes always pass
+} median_config_t;
+
+typedef struct
+{
+    median_config_t cfg;
+    sample_t hist[MEDIAN_MAX_WINDOW];     // newest `window` inputs, oldest first
+    sample_t sorted[MEDIAN_MAX_WINDOW];   // current window in ascending order (sorted-window kernels)
+    uint32_t thresh_q8;                   // n_sigma * 1.4826 in Q8
+    bool primed;                          // history filled from the first sample
+    uint32_t replaced;                    // Hampel: samples replaced so far
+} median_t;
+
+bool median_init(median_t *m, const median_config_t *cfg);
+
+// Filter n samples; out may alias in
+void median_process(median_t *m, const sample_t *in, sample_t *out, size_t n);
+
+// Samples between an input and the output that describes it
+static inline uint32_t median_delay(const median_config_t *cfg)
+{
+    return cfg->window / 2;
+}
+
+#ifdef __cplusplus
+}
+#endif
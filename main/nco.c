@@ -0,0 +1,86 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include "nco.h"
+
+#define CORDIC_STEPS 24
+
+// atan(2^-i) in Q32 turns
+static const int32_t s_atan_q32[CORDIC_STEPS] = {
+    536870912, 316933406, 167458907, 85004756, 42667331, 21354465, 10679838, 5340245,
+    2670163, 1335087, 667544, 333772, 166886, 83443, 41722, 20861,
+    10430, 5215, 2608, 1304, 652, 326, 163, 81,
+};
+
+static int16_t s_sin[NCO_SIN_LEN];
+static bool s_sin_ready;
+
+// Filled on first use, identical every time, so a race is harmless
+const int16_t *nco_table(void)
+{
+    if (!s_sin_ready)
+    {
+        for (uint32_t i = 0; i < NCO_SIN_LEN; i++)
+        {
+            s_sin[i] = (int16_t)lrint(NCO_ONE * sin(2 * M_PI * i / NCO_SIN_LEN));
+        }
+        s_sin_ready = true;
+    }
+    return s_sin;
+}
+
+uint32_t nco_phase_inc(double freq_hz, double rate_hz)
+{
+    double turns = freq_hz / rate_hz;
+    turns -= floor(turns);
+    return (uint32_t)llround(turns * 4294967296.0);
+}
+
+int32_t nco_atan2(int64_t y, int64_t x)
+{
+    // Scale into 29..30 bits: the rotations cannot overflow and small vectors keep their precision
+    if (x == 0 && y == 0)
+    {
+        return 0;
+    }
+    while (x > (1 << 29) || x < -(1 << 29) || y > (1 << 29) || y < -(1 << 29))
+    {
+        x /= 2;
+        y /= 2;
+    }
+    while (x < (1 << 28) && x > -(1 << 28) && y < (1 << 28) && y > -(1 << 28))
+    {
+        x *= 2;
+        y *= 2;
+    }
+    int32_t xi = (int32_t)x, yi = (int32_t)y;
+    uint32_t angle = 0;
+    if (xi < 0)
+    {
+        xi = -xi;
+        yi = -yi;
+        angle = 0x80000000u;
+    }
+    for (int i = 0; i < CORDIC_STEPS; i++)
+    {
+        int32_t dx = yi >> i, dy = xi >> i;
+        if (yi > 0)
+        {
+            xi += dx;
+            yi -= dy;
+            angle += (uint32_t)s_atan_q32[i];
+        }
+        else
+        {
+            xi -= dx;
+            yi += dy;
+            angle -= (uint32_t)s_atan_q32[i];
+        }
+    }
+    return (int32_t)angle;
+}
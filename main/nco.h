@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Numerically controlled oscillator helpers shared by the demodulators
+ *
+ * Phase is a 32-bit fraction of a turn that wraps for free. A Q15 sine
+ * table of NCO_SIN_LEN entries is indexed by the nearest entry, so the
+ * table adds no phase bias; cosine is the same table a quarter turn on.
+ * nco_atan2() is an integer CORDIC, for phase detectors on CPUs without
+ * an FPU.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NCO_SIN_BITS 10
+#define NCO_SIN_LEN (1u << NCO_SIN_BITS)
+#define NCO_ONE 32767 // table amplitude
+
+// Q15 sine over one period, built on first use
+const int16_t *nco_table(void);
+
+static inline uint32_t nco_index(uint32_t phase)
+{
+    return ((phase + (1u << (31 - NCO_SIN_BITS))) >> (32 - NCO_SIN_BITS)) & (NCO_SIN_LEN - 1);
+}
+
+static inline uint32_t nco_cos_index(uint32_t index)
+{
+    return (index + NCO_SIN_LEN / 4) & (NCO_SIN_LEN - 1);
+}
+
+// Phase step per sample for freq_hz at rate_hz, in Q32 turns
+uint32_t nco_phase_inc(double freq_hz, double rate_hz);
+
+// Angle of (x, y) in Q32 turns, signed: INT32_MIN is half a turn. Accurate to about 1e-6 turn.
+int32_t nco_atan2(int64_t y, int64_t x);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,251 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "persist_map.h"
+
+#define HIST_MASK (PERSIST_MAX_PRE - 1)
+#define LOOP_KP 3 // phase correction: 1/8 of the edge error
+#define LOOP_KI 7 // unit interval correction: 1/128 of the edge error
+
+static void update_xscale(persist_map_t *map)
+{
+    map->span_q16 = map->ui_q16 * map->cfg.span_ui;
+    map->xscale = ((uint64_t)map->cfg.width << 32) / map->span_q16;
+}
+
+bool persist_map_init(persist_map_t *map, const persist_config_t *cfg, uint16_t *bins)
+{
+    memset(map, 0, sizeof(*map));
+    if (bins == NULL || cfg->width == 0 || cfg->height == 0 || cfg->amp_min >= cfg->amp_max || cfg->low >= cfg->high)
+    {
+        return false;
+    }
+    if (cfg->mode == PERSIST_TRIGGERED && (cfg->pre > PERSIST_MAX_PRE || cfg->pre >= cfg->width))
+    {
+        return false;
+    }
+    // Clock mode needs at least two samples per unit interval and a span under 2^15 samples
+    if (cfg->mode == PERSIST_CLOCK &&
+        (cfg->ui_q16 < (2u << 16) || cfg->span_ui < 1 || cfg->span_ui > 2 || cfg->ui_q16 > (16384u << 16)))
+    {
+        return false;
+    }
+    map->cfg = *cfg;
+    map->bins = bins;
+    map->yscale_q16 = (uint32_t)(((uint64_t)cfg->height << 16) / ((int32_t)cfg->amp_max - cfg->amp_min));
+    persist_map_clear(map);
+    persist_map_reset(map);
+    return true;
+}
+
+void persist_map_reset(persist_map_t *map)
+{
+    map->primed = false;
+    map->hist_count = 0;
+    map->column = -1;
+    map->ui_q16 = map->cfg.ui_q16;
+    map->phase_q16 = 0;
+    if (map->cfg.mode == PERSIST_CLOCK)
+    {
+        update_xscale(map);
+    }
+}
+
+void persist_map_clear(persist_map_t *map)
+{
+    memset(map->bins, 0, (size_t)map->cfg.width * map->cfg.height * sizeof(uint16_t));
+    map->traces = 0;
+}
+
+static inline int row_of(const persist_map_t *map, sample_t v)
+{
+    int32_t d = (int32_t)v - map->cfg.amp_min;
+    if (d < 0)
+    {
+        return 0;
+    }
+    uint32_t y = ((uint32_t)d * map->yscale_q16) >> 16;
+    return y >= map->cfg.height ? map->cfg.height - 1 : (int)y;
+}
+
+static inline void bump(uint16_t *bin)
+{
+    if (*bin != UINT16_MAX)
+    {
+        (*bin)++;
+    }
+}
+
+static inline uint8_t slice(uint8_t prev, sample_t v, sample_t low, sample_t high)
+{
+    return prev ? v > low : v >= high;
+}
+
+static void accumulate_triggered(persist_map_t *map, const sample_t *in, size_t n)
+{
+    const persist_config_t *c = &map->cfg;
+    for (size_t i = 0; i < n; i++)
+    {
+        sample_t v = in[i];
+        uint8_t l = slice(map->level, v, c->low, c->high);
+
+        if (map->column < 0 && !map->level && l && map->hist_count >= c->pre)
+        {
+            // Trigger: replay the pre-trigger history into the first columns
+            for (int k = 0; k < c->pre; k++)
+            {
+                sample_t h = map->hist[(map->hist_count - c->pre + k) & HIST_MASK];
+                bump(&map->bins[row_of(map, h) * c->width + k]);
+            }
+            map->column = c->pre;
+            map->traces++;
+        }
+        if (map->column >= 0)
+        {
+            bump(&map->bins[row_of(map, v) * c->width + map->column]);
+            if (++map->column == c->width)
+            {
+                map->column = -1;
+            }
+        }
+        map->hist[map->hist_count & HIST_MASK] = v;
+        map->hist_count++;
+        map->level = l;
+    }
+}
+
+static void accumulate_clock(persist_map_t *map, const sample_t *in, size_t n)
+{
+    const persist_config_t *c = &map->cfg;
+    const int32_t mid = ((int32_t)c->low + c->high) / 2;
+    uint32_t phase = map->phase_q16;
+    uint8_t level = map->level;
+    sample_t prev = map->prev;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        sample_t v = in[i];
+        uint8_t l = slice(level, v, c->low, c->high);
+        if (l != level)
+        {
+            // Sub-sample crossing of the mid level, as a fraction of the last sample step
+            int32_t step = (int32_t)v - prev;
+            int32_t back_q16 = 0;
+            if (step != 0)
+            {
+                back_q16 = (int32_t)(((int64_t)((int32_t)v - mid) << 16) / step);
+                back_q16 = back_q16 < 0 ? 0 : back_q16 > 65536 ? 65536 : back_q16;
+            }
+            // Phase of the crossing within its unit interval; edges should sit at UI/2
+            int64_t cross = (int64_t)phase - back_q16;
+            int64_t ui = map->ui_q16;
+            int64_t in_ui = ((cross % ui) + ui) % ui;
+            int64_t err = in_ui - ui / 2;
+
+            int64_t p = (int64_t)phase - (err >> LOOP_KP);
+            int64_t new_ui = ui + (err >> LOOP_KI);
+            // Keep the loop within +-25% of nominal so noise cannot run it away
+            int64_t nominal = c->ui_q16;
+            new_ui = new_ui < nominal - nominal / 4 ? nominal - nominal / 4 : new_ui;
+            new_ui = new_ui > nominal + nominal / 4 ? nominal + nominal / 4 : new_ui;
+            map->ui_q16 = (uint32_t)new_ui;
+            update_xscale(map);
+            int64_t span = map->span_q16;
+            phase = (uint32_t)(((p % span) + span) % span);
+            map->traces++;
+        }
+        level = l;
+        prev = v;
+
+        uint32_t x = (uint32_t)(((uint64_t)phase * map->xscale) >> 32);
+        bump(&map->bins[row_of(map, v) * c->width + (x < c->width ? x : c->width - 1u)]);
+
+        phase += 65536;
+        if (phase >= map->span_q16)
+        {
+            phase -= map->span_q16;
+        }
+    }
+    map->phase_q16 = phase;
+    map->level = level;
+    map->prev = prev;
+}
+
+void persist_map_accumulate(persist_map_t *map, const sample_t *in, size_t n)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    if (!map->primed)
+    {
+        map->level = in[0] >= ((int32_t)map->cfg.low + map->cfg.high) / 2;
+        map->prev = in[0];
+        map->primed = true;
+    }
+    if (map->cfg.mode == PERSIST_CLOCK)
+    {
+        accumulate_clock(map, in, n);
+    }
+    else
+    {
+        accumulate_triggered(map, in, n);
+    }
+}
+
+void persist_map_decay(persist_map_t *map, int shift)
+{
+    size_t count = (size_t)map->cfg.width * map->cfg.height;
+    for (size_t i = 0; i < count; i++)
+    {
+        // Round the decrement up so faint bins reach zero
+        uint16_t b = map->bins[i];
+        map->bins[i] = b - ((b + (1u << shift) - 1) >> shift);
+    }
+}
+
+uint16_t persist_map_peak(const persist_map_t *map)
+{
+    uint16_t peak = 0;
+    size_t count = (size_t)map->cfg.width * map->cfg.height;
+    for (size_t i = 0; i < count; i++)
+    {
+        peak = map->bins[i] > peak ? map->bins[i] : peak;
+    }
+    return peak;
+}
+
+size_t persist_map_image_bound(const persist_config_t *cfg)
+{
+    return 32 + (size_t)cfg->width * cfg->height; // "P5\n<w> <h>\n255\n" fits in 32 bytes
+}
+
+size_t persist_map_export_pgm(const persist_map_t *map, uint8_t *out, size_t cap)
+{
+    const persist_config_t *c = &map->cfg;
+    if (cap < persist_map_image_bound(c))
+    {
+        return 0;
+    }
+    int hdr = snprintf((char *)out, cap, "P5\n%u %u\n255\n", c->width, c->height);
+
+    // Log scale keeps rare excursions visible next to the dense trace
+    uint16_t peak = persist_map_peak(map);
+    float k = peak ? 255.0f / logf(1.0f + peak) : 0.0f;
+    uint8_t *px = out + hdr;
+    for (int row = c->height - 1; row >= 0; row--)
+    {
+        const uint16_t *src = &map->bins[(size_t)row * c->width];
+        for (int x = 0; x < c->width; x++)
+        {
+            *px++ = src[x] ? (uint8_t)(k * logf(1.0f + src[x]) + 0.5f) : 0;
+        }
+    }
+    return (size_t)(px - out);
+}
@@ -0,0 +1,97 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Persistence map / eye diagram accumulator
+ *
+ * A 2D histogram of time-in-segment (columns) against amplitude (rows),
+ * updated sample by sample so it can run as a graph stage on the live ring.
+ * Segments come from either
+ *   - PERSIST_TRIGGERED: a rising edge (with hysteresis) starts a trace of
+ *     width samples, pre of them taken from before the edge, or
+ *   - PERSIST_CLOCK: a recovered clock. Edges are interpolated to sub-sample
+ *     time and a PI loop tracks the unit interval, so each sample lands at its
+ *     fractional phase and a serial stream folds into an eye diagram.
+ * Bins are 16-bit and saturate; persist_map_decay() fades old traces.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PERSIST_MAX_PRE 256 // pre-trigger history, power of 2
+
+typedef enum
+{
+    PERSIST_TRIGGERED,
+    PERSIST_CLOCK,
+} persist_mode_t;
+
+typedef struct
+{
+    persist_mode_t mode;
+    uint16_t width;   // time bins
+    uint16_t height;  // amplitude bins
+    sample_t amp_min; // bottom of the lowest row
+    sample_t amp_max; // top of the highest row
+    sample_t low;     // edge detection hysteresis: falls at or below low
+    sample_t high;    // rises at or above high
+    uint16_t pre;     // PERSIST_TRIGGERED: columns before the trigger edge, <= PERSIST_MAX_PRE
+    uint32_t ui_q16;  // PERSIST_CLOCK: nominal unit interval in samples, Q16
+    uint8_t span_ui;  // PERSIST_CLOCK: unit intervals across the map, 1 or 2
+} persist_config_t;
+
+typedef struct
+{
+    persist_config_t cfg;
+    uint16_t *bins; // height rows of width columns, row 0 = amp_min
+    uint32_t yscale_q16;
+    uint32_t traces; // triggered traces or recovered clock edges
+    uint8_t level;   // sliced level of the previous sample
+    bool primed;
+    sample_t prev;
+
+    // Triggered mode
+    sample_t hist[PERSIST_MAX_PRE];
+    uint32_t hist_count;
+    int32_t column; // next column of the running trace, -1 when armed
+
+    // Clock mode: phase within the span and the tracked unit interval, Q16 samples
+    uint32_t phase_q16;
+    uint32_t ui_q16;
+    uint32_t span_q16;
+    uint64_t xscale; // width / span in Q32
+} persist_map_t;
+
+// bins holds cfg->width * cfg->height counters
+bool persist_map_init(persist_map_t *map, const persist_config_t *cfg, uint16_t *bins);
+
+// Zero the histogram; segmentation and clock lock are kept
+void persist_map_clear(persist_map_t *map);
+
+// Restart segmentation and clock recovery, e.g. after a gap in the input
+void persist_map_reset(persist_map_t *map);
+
+// Accumulate n consecutive samples
+void persist_map_accumulate(persist_map_t *map, const sample_t *in, size_t n);
+
+// Fade every bin by 1/2^shift of its value
+void persist_map_decay(persist_map_t *map, int shift);
+
+// Largest bin, for display scaling
+uint16_t persist_map_peak(const persist_map_t *map);
+
+// Binary 8-bit PGM image, highest amplitude on top, log-scaled intensity.
+// Returns bytes written, 0 if cap < persist_map_image_bound().
+size_t persist_map_image_bound(const persist_config_t *cfg);
+size_t persist_map_export_pgm(const persist_map_t *map, uint8_t *out, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,331 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "proto_decode.h"
+
+enum
+{
+    UART_IDLE,
+    UART_START,
+    UART_DATA,
+    UART_PARITY,
+    UART_STOP,
+};
+
+enum
+{
+    I2C_IDLE,
+    I2C_BUSY, // between start and stop
+};
+
+static inline uint8_t slice(uint8_t prev, sample_t v, sample_t low, sample_t high)
+{
+    return prev ? v > low : v >= high;
+}
+
+static void emit(proto_decoder_t *dec, uint8_t type, uint64_t start, uint64_t end, uint16_t data,
+                 uint16_t data2, uint8_t flags)
+{
+    proto_frame_t f = {
+        .start = start,
+        .end = end,
+        .data = data,
+        .data2 = data2,
+        .type = type,
+        .flags = flags,
+    };
+    dec->cb(dec->cb_ctx, &f);
+}
+
+int proto_num_lines(const proto_config_t *cfg)
+{
+    switch (cfg->kind)
+    {
+    case PROTO_UART:
+        return 1;
+    case PROTO_I2C:
+        return 2;
+    case PROTO_SPI:
+        return 2 + cfg->spi.has_miso + cfg->spi.has_cs;
+    default:
+        return 0;
+    }
+}
+
+bool proto_decoder_init(proto_decoder_t *dec, const proto_config_t *cfg, proto_frame_cb_t cb, void *ctx)
+{
+    memset(dec, 0, sizeof(*dec));
+    if (cb == NULL || cfg->low >= cfg->high)
+    {
+        return false;
+    }
+    switch (cfg->kind)
+    {
+    case PROTO_UART:
+        if (cfg->uart.baud == 0 || cfg->uart.data_bits < 5 || cfg->uart.data_bits > 9 ||
+            cfg->sample_rate_hz < 2 * cfg->uart.baud)
+        {
+            return false;
+        }
+        dec->spb_q16 = ((uint64_t)cfg->sample_rate_hz << 16) / cfg->uart.baud;
+        break;
+    case PROTO_I2C:
+        break;
+    case PROTO_SPI:
+        if (cfg->spi.mode > 3 || cfg->spi.word_bits == 0 || cfg->spi.word_bits > 16)
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    dec->cfg = *cfg;
+    dec->cb = cb;
+    dec->cb_ctx = ctx;
+    return true;
+}
+
+void proto_decoder_reset(proto_decoder_t *dec)
+{
+    dec->primed = false;
+    dec->state = 0;
+    dec->bit = 0;
+    dec->shift = 0;
+    dec->shift2 = 0;
+}
+
+static void uart_process(proto_decoder_t *dec, const sample_t *rx, size_t n, uint64_t pos)
+{
+    const sample_t lo = dec->cfg.low, hi = dec->cfg.high;
+    uint8_t level = dec->level[0];
+    size_t i = 0;
+
+    while (i < n)
+    {
+        if (dec->state == UART_IDLE)
+        {
+            // Fast path: only look for the falling edge of a start bit
+            for (; i < n; i++)
+            {
+                uint8_t l = slice(level, rx[i], lo, hi);
+                if (level && !l)
+                {
+                    level = 0;
+                    dec->state = UART_START;
+                    dec->frame_start = pos + i;
+                    dec->next_q16 = ((pos + i) << 16) + dec->spb_q16 / 2; // centre of the start bit
+                    dec->bit = 0;
+                    dec->shift = 0;
+                    i++;
+                    break;
+                }
+                level = l;
+            }
+            continue;
+        }
+
+        // Mid-frame: slice every sample, act at each bit centre
+        level = slice(level, rx[i], lo, hi);
+        uint64_t now_q16 = (pos + i) << 16;
+        i++;
+        if (now_q16 < dec->next_q16)
+        {
+            continue;
+        }
+        dec->next_q16 += dec->spb_q16;
+
+        switch (dec->state)
+        {
+        case UART_START:
+            // A glitch shorter than half a bit is not a start bit
+            dec->state = level ? UART_IDLE : UART_DATA;
+            break;
+        case UART_DATA:
+            dec->shift |= (uint16_t)level << dec->bit;
+            if (++dec->bit == dec->cfg.uart.data_bits)
+            {
+                dec->state = dec->cfg.uart.parity == PROTO_PARITY_NONE ? UART_STOP : UART_PARITY;
+            }
+            break;
+        case UART_PARITY:
+        {
+            int ones = __builtin_popcount(dec->shift) + level;
+            bool ok = dec->cfg.uart.parity == PROTO_PARITY_EVEN ? (ones & 1) == 0 : (ones & 1) == 1;
+            dec->shift2 = ok ? 0 : PROTO_FLAG_PARITY_ERR; // stash until the stop bit
+            dec->state = UART_STOP;
+            break;
+        }
+        case UART_STOP:
+        {
+            uint8_t flags = (uint8_t)dec->shift2 | (level ? 0 : PROTO_FLAG_FRAMING_ERR);
+            emit(dec, PROTO_EVT_DATA, dec->frame_start, pos + i - 1, dec->shift, 0, flags);
+            dec->shift2 = 0;
+            dec->state = UART_IDLE;
+            break;
+        }
+        }
+    }
+    dec->level[0] = level;
+}
+
+static void i2c_process(proto_decoder_t *dec, const sample_t *scl_in, const sample_t *sda_in, size_t n, uint64_t pos)
+{
+    const sample_t lo = dec->cfg.low, hi = dec->cfg.high;
+    uint8_t scl = dec->level[0], sda = dec->level[1];
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint8_t c = slice(scl, scl_in[i], lo, hi);
+        uint8_t d = slice(sda, sda_in[i], lo, hi);
+
+        if (scl && c && sda != d)
+        {
+            // SDA moving while SCL is high is a start (falling) or stop (rising)
+            if (!d)
+            {
+                emit(dec, PROTO_EVT_START, pos + i, pos + i, 0, 0, 0);
+                dec->state = I2C_BUSY;
+                dec->bit = 0;
+                dec->shift = 0;
+                dec->address_next = true;
+            }
+            else if (dec->state == I2C_BUSY)
+            {
+                emit(dec, PROTO_EVT_STOP, pos + i, pos + i, 0, 0, 0);
+                dec->state = I2C_IDLE;
+            }
+        }
+        else if (!scl && c && dec->state == I2C_BUSY)
+        {
+            // Data is valid on the rising edge of SCL: 8 data bits, then ACK
+            if (dec->bit == 0)
+            {
+                dec->frame_start = pos + i;
+            }
+            if (dec->bit < 8)
+            {
+                dec->shift = (uint16_t)((dec->shift << 1) | d);
+                dec->bit++;
+            }
+            else
+            {
+                uint8_t flags = (d ? 0 : PROTO_FLAG_ACK) | (dec->address_next ? PROTO_FLAG_ADDRESS : 0);
+                emit(dec, PROTO_EVT_DATA, dec->frame_start, pos + i, dec->shift, 0, flags);
+                dec->address_next = false;
+                dec->bit = 0;
+                dec->shift = 0;
+            }
+        }
+        scl = c;
+        sda = d;
+    }
+    dec->level[0] = scl;
+    dec->level[1] = sda;
+}
+
+static void spi_process(proto_decoder_t *dec, const sample_t *const *lines, size_t n, uint64_t pos)
+{
+    const sample_t lo = dec->cfg.low, hi = dec->cfg.high;
+    const sample_t *sclk_in = lines[0];
+    const sample_t *mosi_in = lines[1];
+    const sample_t *miso_in = dec->cfg.spi.has_miso ? lines[2] : NULL;
+    const sample_t *cs_in = dec->cfg.spi.has_cs ? lines[2 + dec->cfg.spi.has_miso] : NULL;
+    const uint8_t cpol = dec->cfg.spi.mode >> 1, cpha = dec->cfg.spi.mode & 1;
+    const bool sample_on_rising = cpol == cpha;
+    uint8_t clk = dec->level[0], mosi = dec->level[1], miso = dec->level[2], cs = dec->level[3];
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint8_t k = slice(clk, sclk_in[i], lo, hi);
+        mosi = slice(mosi, mosi_in[i], lo, hi);
+        if (miso_in)
+        {
+            miso = slice(miso, miso_in[i], lo, hi);
+        }
+        if (cs_in)
+        {
+            cs = slice(cs, cs_in[i], lo, hi);
+            if (cs)
+            {
+                // Deselected: drop any partial word
+                dec->bit = 0;
+                clk = k;
+                continue;
+            }
+        }
+
+        bool edge = sample_on_rising ? (!clk && k) : (clk && !k);
+        clk = k;
+        if (!edge)
+        {
+            continue;
+        }
+        if (dec->bit == 0)
+        {
+            dec->frame_start = pos + i;
+            dec->shift = 0;
+            dec->shift2 = 0;
+        }
+        dec->shift = (uint16_t)((dec->shift << 1) | mosi);
+        dec->shift2 = (uint16_t)((dec->shift2 << 1) | miso);
+        if (++dec->bit == dec->cfg.spi.word_bits)
+        {
+            emit(dec, PROTO_EVT_DATA, dec->frame_start, pos + i, dec->shift, miso_in ? dec->shift2 : 0, 0);
+            dec->bit = 0;
+        }
+    }
+    dec->level[0] = clk;
+    dec->level[1] = mosi;
+    dec->level[2] = miso;
+    dec->level[3] = cs;
+}
+
+void proto_decoder_process(proto_decoder_t *dec, const sample_t *const *lines, size_t n, uint64_t pos)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    if (!dec->primed)
+    {
+        // Start from the first sample's levels so the first sample is never an edge
+        int count = proto_num_lines(&dec->cfg);
+        for (int l = 0; l < count; l++)
+        {
+            dec->level[l] = lines[l][0] >= (dec->cfg.low + dec->cfg.high) / 2;
+        }
+        dec->primed = true;
+    }
+
+    switch (dec->cfg.kind)
+    {
+    case PROTO_UART:
+        uart_process(dec, lines[0], n, pos);
+        break;
+    case PROTO_I2C:
+        i2c_process(dec, lines[0], lines[1], n, pos);
+        break;
+    case PROTO_SPI:
+        spi_process(dec, lines, n, pos);
+        break;
+    default:
+        break;
+    }
+}
+
+bool proto_decode_capture(const proto_config_t *cfg, const sample_t *const *lines, size_t n, uint64_t pos,
+                          proto_frame_cb_t cb, void *ctx)
+{
+    proto_decoder_t dec;
+    if (!proto_decoder_init(&dec, cfg, cb, ctx))
+    {
+        return false;
+    }
+    proto_decoder_process(&dec, lines, n, pos);
+    return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Serial protocol decoding from analog samples
+ *
+ * Each line is sliced to a logic level with hysteresis (a level only changes
+ * once the sample crosses the opposite threshold, so noise around a single
+ * threshold cannot chatter) and fed to a UART, I2C or SPI state machine.
+ * Decoders are streaming: blocks can come from the live ring via a graph
+ * stage or from a linearized capture, and state carries across blocks.
+ * Frames are timestamped with absolute sample positions.
+ *
+ * Line order passed to proto_decoder_process():
+ *   UART: rx
+ *   I2C:  scl, sda
+ *   SPI:  sclk, mosi, miso (if has_miso), cs (if has_cs, active low)
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PROTO_MAX_LINES 4
+
+typedef enum
+{
+    PROTO_NONE,
+    PROTO_UART,
+    PROTO_I2C,
+    PROTO_SPI,
+} proto_kind_t;
+
+typedef enum
+{
+    PROTO_PARITY_NONE,
+    PROTO_PARITY_EVEN,
+    PROTO_PARITY_ODD,
+} proto_parity_t;
+
+typedef enum
+{
+    PROTO_EVT_DATA,  // one UART character, I2C byte or SPI word
+    PROTO_EVT_START, // I2C start / repeated start
+    PROTO_EVT_STOP,  // I2C stop
+} proto_event_t;
+
+#define PROTO_FLAG_FRAMING_ERR 0x01 // UART stop bit low
+#define PROTO_FLAG_PARITY_ERR 0x02  // UART parity mismatch
+#define PROTO_FLAG_ACK 0x04         // I2C byte was acknowledged
+#define PROTO_FLAG_ADDRESS 0x08     // I2C byte is the address byte after a start
+
+typedef struct
+{
+    uint64_t start; // absolute sample position of the first edge of the frame
+    uint64_t end;   // absolute sample position where the frame completed
+    uint16_t data;  // UART character, I2C byte or SPI MOSI word
+    uint16_t data2; // SPI MISO word
+    uint8_t type;   // proto_event_t
+    uint8_t flags;  // PROTO_FLAG_*
+} proto_frame_t;
+
+typedef struct
+{
+    proto_kind_t kind;
+    sample_t low;  // a high line goes low at or below this code
+    sample_t high; // a low line goes high at or above this code
+    uint32_t sample_rate_hz;
+    struct
+    {
+        uint32_t baud;
+        uint8_t data_bits; // 5..9
+        uint8_t parity;    // proto_parity_t
+    } uart;
+    struct
+    {
+        uint8_t mode;      // 0..3, CPOL = mode >> 1, CPHA = mode & 1
+        uint8_t word_bits; // 1..16, MSB first
+        bool has_miso;
+        bool has_cs;
+    } spi;
+} proto_config_t;
+
+typedef void (*proto_frame_cb_t)(void *ctx, const proto_frame_t *frame);
+
+typedef struct
+{
+    proto_config_t cfg;
+    proto_frame_cb_t cb;
+    void *cb_ctx;
+    bool primed;                   // levels hold the previous sample
+    uint8_t level[PROTO_MAX_LINES]; // sliced level after the previous sample
+
+    // Shared bit accumulator
+    int state;
+    int bit;
+    uint16_t shift;
+    uint16_t shift2;
+    uint64_t frame_start;
+
+    // UART bit timing in Q16 sample positions
+    uint64_t spb_q16;
+    uint64_t next_q16;
+    bool address_next; // I2C: next byte is an address
+} proto_decoder_t;
+
+// Number of lines the configuration expects
+int proto_num_lines(const proto_config_t *cfg);
+
+bool proto_decoder_init(proto_decoder_t *dec, const proto_config_t *cfg, proto_frame_cb_t cb, void *ctx);
+
+// Forget any partial frame, e.g. after a gap in the input
+void proto_decoder_reset(proto_decoder_t *dec);
+
+// Decode n samples of every line; lines[i][0] is at absolute position pos
+void proto_decoder_process(proto_decoder_t *dec, const sample_t *const *lines, size_t n, uint64_t pos);
+
+// Decode a whole linearized capture starting at absolute position pos
+bool proto_decode_capture(const proto_config_t *cfg, const sample_t *const *lines, size_t n, uint64_t pos,
+                          proto_frame_cb_t cb, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
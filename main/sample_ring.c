@@ -0,0 +1,54 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "sample_ring.h"
+
+void sample_ring_write(sample_ring_t *ring, const sample_t *src, size_t count)
+{
+    size_t cap = sample_ring_capacity(ring);
+    if (count > cap)
+    {
+        // Only the newest capacity samples survive anyway
+        ring->head += count - cap;
+        src += count - cap;
+        count = cap;
+    }
+
+    size_t pos = ring->head & ring->mask;
+    size_t first = cap - pos;
+    if (first > count)
+    {
+        first = count;
+    }
+    memcpy(&ring->buf[pos], src, first * sizeof(sample_t));
+    memcpy(&ring->buf[0], src + first, (count - first) * sizeof(sample_t));
+    ring->head += count;
+}
+
+size_t sample_ring_copy(const sample_ring_t *ring, uint64_t from, size_t count, sample_t *out)
+{
+    uint64_t oldest = sample_ring_oldest(ring);
+    if (from < oldest || from >= ring->head)
+    {
+        return 0;
+    }
+    if (count > ring->head - from)
+    {
+        count = (size_t)(ring->head - from);
+    }
+
+    // Copy in at most two contiguous runs instead of masking every sample
+    size_t pos = from & ring->mask;
+    size_t first = sample_ring_capacity(ring) - pos;
+    if (first > count)
+    {
+        first = count;
+    }
+    memcpy(out, &ring->buf[pos], first * sizeof(sample_t));
+    memcpy(out + first, &ring->buf[0], (count - first) * sizeof(sample_t));
+    return count;
+}
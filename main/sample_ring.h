@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Power-of-two sample ring addressed by absolute sample number.
+ *
+ * The ring does no locking of its own: a single producer writes samples and
+ * then publishes the new head, and readers snapshot the head under whatever
+ * lock the owner uses (s_data_lock in continuous_read_main.c). Keeping the
+ * head as an absolute 64-bit count means a reader can always tell whether a
+ * sample it wants has already been overwritten.
+ *
+ * This file is plain C with no ESP-IDF dependencies so it also builds on host.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef int16_t sample_t;
+
+typedef struct
+{
+    sample_t *buf;
+    size_t mask;   // capacity - 1, capacity must be a power of two
+    uint64_t head; // absolute number of samples ever written
+} sample_ring_t;
+
+static inline void sample_ring_init(sample_ring_t *ring, sample_t *storage, size_t capacity)
+{
+    ring->buf = storage;
+    ring->mask = capacity - 1;
+    ring->head = 0;
+}
+
+static inline size_t sample_ring_capacity(const sample_ring_t *ring)
+{
+    return ring->mask + 1;
+}
+
+// Absolute number of the oldest sample still held by the ring
+static inline uint64_t sample_ring_oldest(const sample_ring_t *ring)
+{
+    size_t cap = sample_ring_capacity(ring);
+    return ring->head > cap ? ring->head - cap : 0;
+}
+
+static inline sample_t sample_ring_at(const sample_ring_t *ring, uint64_t abs_pos)
+{
+    return ring->buf[abs_pos & ring->mask];
+}
+
+// Append samples and advance the head (producer side, derived rings)
+void sample_ring_write(sample_ring_t *ring, const sample_t *src, size_t count);
+
+// Linearize [from, from + count) into out. Returns the number of samples copied,
+// which is less than count when part of the range is not (or no longer) in the ring.
+size_t sample_ring_copy(const sample_ring_t *ring, uint64_t from, size_t count, sample_t *out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,162 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+#include "time_sync.h"
+
+bool tsync_init(tsync_t *s, const tsync_config_t *cfg)
+{
+    memset(s, 0, sizeof(*s));
+    if (!(cfg->nominal_hz > 0) || cfg->window < 2 || cfg->window > TSYNC_MAX_WINDOW)
+    {
+        return false;
+    }
+    s->cfg = *cfg;
+    tsync_reset(s);
+    return true;
+}
+
+void tsync_reset(tsync_t *s)
+{
+    s->started = false;
+    s->base = 0;
+    s->base_ns = 0;
+    s->count = 0;
+    s->wr = 0;
+    s->rtt_count = 0;
+    s->anchor_x2 = 0;
+    s->anchor_y = 0;
+    s->offset = 0;
+    s->slope = 1e9 / s->cfg.nominal_hz;
+    s->residual_ns = 0;
+    s->in_a_row = 0;
+}
+
+// Least-squares line through the window, about its oldest point so the sums stay small
+static void fit(tsync_t *s)
+{
+    const uint32_t w = s->cfg.window;
+    const tsync_obs_t *o = &s->obs[(s->wr + w - s->count) % w];
+    double mx = 0, my = 0;
+    for (uint32_t i = 0; i < s->count; i++)
+    {
+        const tsync_obs_t *p = &s->obs[(s->wr + w - s->count + i) % w];
+        mx += (p->x2 - o->x2) / 2.0;
+        my += (double)(p->y - o->y);
+    }
+    mx /= s->count;
+    my /= s->count;
+    double sxx = 0, sxy = 0;
+    for (uint32_t i = 0; i < s->count; i++)
+    {
+        const tsync_obs_t *p = &s->obs[(s->wr + w - s->count + i) % w];
+        double dx = (p->x2 - o->x2) / 2.0 - mx, dy = (double)(p->y - o->y) - my;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    if (sxx > 0)
+    {
+        s->slope = sxy / sxx;
+    }
+    s->anchor_x2 = o->x2;
+    s->anchor_y = o->y;
+    s->offset = my - s->slope * mx;
+
+    double sq = 0;
+    for (uint32_t i = 0; i < s->count; i++)
+    {
+        const tsync_obs_t *p = &s->obs[(s->wr + w - s->count + i) % w];
+        double r = (double)(p->y - o->y) - s->offset - s->slope * (p->x2 - o->x2) / 2.0;
+        sq += r * r;
+    }
+    s->residual_ns = sqrt(sq / s->count);
+}
+
+// sum2 is twice the counter (or the sum of two counters), ref_ns the common time there
+static bool add_obs(tsync_t *s, uint64_t sum2, int64_t ref_ns)
+{
+    if (!s->started)
+    {
+        s->started = true;
+        s->base = sum2 / 2;
+        s->base_ns = ref_ns;
+    }
+    tsync_obs_t o = {(int64_t)(sum2 - 2 * s->base), ref_ns - s->base_ns};
+    if (s->count == s->cfg.window && s->cfg.max_residual_ns > 0)
+    {
+        double err = (double)(o.y - s->anchor_y) - s->offset - s->slope * (o.x2 - s->anchor_x2) / 2.0;
+        if (fabs(err) > s->cfg.max_residual_ns)
+        {
+            s->rejected++;
+            if (++s->in_a_row < (s->cfg.window + 1u) / 2)
+            {
+                return false;
+            }
+            // The clocks jumped: refit from here on. The old line stays in place until then,
+            // so periodic pulses keep their numbering.
+            s->restarts++;
+            s->count = 0;
+        }
+    }
+    s->in_a_row = 0;
+    s->obs[s->wr % s->cfg.window] = o;
+    s->wr = (s->wr + 1) % s->cfg.window;
+    s->count += s->count < s->cfg.window;
+    fit(s);
+    return true;
+}
+
+bool tsync_add_pulse(tsync_t *s, uint64_t counter, int64_t ref_ns)
+{
+    return add_obs(s, 2 * counter, ref_ns);
+}
+
+bool tsync_add_pulse_periodic(tsync_t *s, uint64_t counter, int64_t period_ns)
+{
+    int64_t ref = 0;
+    if (s->started)
+    {
+        ref = llround((double)tsync_to_ref(s, counter) / period_ns) * period_ns;
+    }
+    return add_obs(s, 2 * counter, ref);
+}
+
+bool tsync_add_exchange(tsync_t *s, int64_t t1_ns, uint64_t c2, uint64_t c3, int64_t t4_ns)
+{
+    int64_t rtt = (t4_ns - t1_ns) - llround((double)(c3 - c2) * s->slope);
+    s->rtt[s->rtt_count % s->cfg.window] = rtt;
+    s->rtt_count++;
+    uint32_t n = s->rtt_count < s->cfg.window ? s->rtt_count : s->cfg.window;
+    int64_t best = rtt;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        best = s->rtt[i] < best ? s->rtt[i] : best;
+    }
+    if (rtt > best + (int64_t)s->cfg.max_excess_ns)
+    {
+        s->rejected++;
+        return false;
+    }
+    return add_obs(s, c2 + c3, t1_ns + (t4_ns - t1_ns) / 2);
+}
+
+int64_t tsync_to_ref(const tsync_t *s, uint64_t counter)
+{
+    int64_t x2 = (int64_t)(2 * (counter - s->base));
+    return s->base_ns + s->anchor_y + llround(s->offset + s->slope * (x2 - s->anchor_x2) / 2.0);
+}
+
+double tsync_from_ref(const tsync_t *s, int64_t ref_ns)
+{
+    double dy = (double)(ref_ns - s->base_ns - s->anchor_y) - s->offset;
+    return (double)s->base + s->anchor_x2 / 2.0 + dy / s->slope;
+}
+
+double tsync_drift_ppm(const tsync_t *s)
+{
+    return (1e9 / s->cfg.nominal_hz / s->slope - 1) * 1e6;
+}
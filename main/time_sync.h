@@ -0,0 +1,119 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Sample counter to common timebase mapping for multi-device captures
+ *
+ * Each device keeps an absolute sample counter (the ring heads). A tsync_t
+ * collects observations pairing a counter value with a time on the common
+ * timebase (nanoseconds) and fits a line through the last `window` of them
+ * by least squares: the slope is the device's real sample period, which
+ * tracks crystal drift as old observations leave the window, and the fit
+ * maps any counter to common time and back. Captures from several devices
+ * line up by mapping their positions through their own tsync_t.
+ *
+ * Observations come from either source:
+ *
+ * - A shared sync pulse wired to every device and sampled as an ADC channel:
+ *   the position of each edge and the pulse's time on the master, for a
+ *   periodic pulse its index times the period (tsync_add_pulse_periodic()
+ *   numbers pulses from the fit, so a missed pulse does not shift the rest).
+ *   Accuracy is about one sample.
+ * - A PTP-like two-way exchange: the master sends at t1 (its clock), the
+ *   device receives at counter c2 and replies at c3, the master receives at
+ *   t4. This module only does the arithmetic; the caller runs the exchange
+ *   over its own transport (e.g. UDP) and supplies the four timestamps.
+ *   With symmetric paths, the master time at the middle of c2..c3 is
+ *   (t1 + t4) / 2. Queuing makes paths asymmetric, so exchanges whose round
+ *   trip exceeds the best one of the recent window by more than
+ *   max_excess_ns are dropped.
+ *
+ * Once the window is full, an observation further than max_residual_ns from
+ * the fit is dropped as an outlier; after half a window of them in a row the
+ * fit restarts from the newest one (e.g. the master clock was stepped).
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TSYNC_MAX_WINDOW 64
+
+typedef struct
+{
+    double nominal_hz;        // sample rate as configured
+    uint8_t window;           // observations per fit, 2..TSYNC_MAX_WINDOW
+    uint32_t max_excess_ns;   // exchange round trips this far above the recent best are dropped
+    uint32_t max_residual_ns; // outlier threshold once the window is full, 0 to keep everything
+} tsync_config_t;
+
+typedef struct
+{
+    int64_t x2; // counter - base, in half samples
+    int64_t y;  // common time - base, ns
+} tsync_obs_t;
+
+typedef struct
+{
+    tsync_config_t cfg;
+    bool started;
+    uint64_t base;        // counter of the first observation
+    int64_t base_ns;      // its common time
+    tsync_obs_t obs[TSYNC_MAX_WINDOW];
+    uint32_t count;       // observations kept, up to window
+    uint32_t wr;
+    int64_t rtt[TSYNC_MAX_WINDOW]; // round trips of the recent exchanges, accepted or not
+    uint32_t rtt_count;
+    // Fit: time(x2) = base_ns + anchor_y + offset + slope * (x2 - anchor_x2) / 2
+    int64_t anchor_x2;
+    int64_t anchor_y;
+    double offset;        // ns
+    double slope;         // ns per sample
+    double residual_ns;   // RMS distance of the window from the fit
+    uint32_t rejected;    // outliers and congested exchanges dropped
+    uint32_t in_a_row;    // consecutive outliers
+    uint32_t restarts;
+} tsync_t;
+
+bool tsync_init(tsync_t *s, const tsync_config_t *cfg);
+
+// Drop every observation and start over
+void tsync_reset(tsync_t *s);
+
+// The shared pulse was first seen at sample `counter`; ref_ns is its time on the common timebase.
+// Returns false if it was dropped as an outlier.
+bool tsync_add_pulse(tsync_t *s, uint64_t counter, int64_t ref_ns);
+
+// Periodic pulse: its time is the nearest multiple of period_ns to the fit's prediction,
+// and the first one observed is time 0. Start the pulse train after every device runs.
+bool tsync_add_pulse_periodic(tsync_t *s, uint64_t counter, int64_t period_ns);
+
+// Two-way exchange timestamps from the caller's transport: master clock t1 (send) and t4 (receive),
+// device counter c2 (receive) and c3 (reply). Returns false if it was dropped.
+bool tsync_add_exchange(tsync_t *s, int64_t t1_ns, uint64_t c2, uint64_t c3, int64_t t4_ns);
+
+static inline bool tsync_locked(const tsync_t *s)
+{
+    return s->count >= 2;
+}
+
+// Common time of sample `counter`, ns; extrapolates past the newest observation
+int64_t tsync_to_ref(const tsync_t *s, uint64_t counter);
+
+// Sample position (fractional) at common time ref_ns
+double tsync_from_ref(const tsync_t *s, int64_t ref_ns);
+
+// Sample clock error against nominal, ppm (positive runs fast)
+double tsync_drift_ppm(const tsync_t *s);
+
+#ifdef __cplusplus
+}
+#endif
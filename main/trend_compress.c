@@ -0,0 +1,145 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "trend_compress.h"
+
+bool trend_init(trend_t *tr, const trend_config_t *cfg)
+{
+    memset(tr, 0, sizeof(*tr));
+    if ((cfg->mode != TREND_DEADBAND && cfg->mode != TREND_SWINGING_DOOR) || cfg->tol < 0 ||
+        cfg->max_gap < 1 || cfg->max_gap > TREND_MAX_GAP)
+    {
+        return false;
+    }
+    tr->cfg = *cfg;
+    return true;
+}
+
+static int archive(trend_t *tr, const trend_point_t *p, trend_point_t *out)
+{
+    tr->anchor = *p;
+    tr->held = false;
+    tr->archived++;
+    *out = *p;
+    return 1;
+}
+
+// Narrow the doors from the anchor with the band of point p
+static void doors_add(trend_t *tr, const trend_point_t *p)
+{
+    int64_t dt = (int64_t)(p->t - tr->anchor.t);
+    int64_t lo = (int64_t)p->v - tr->cfg.tol - tr->anchor.v;
+    int64_t hi = (int64_t)p->v + tr->cfg.tol - tr->anchor.v;
+    if (!tr->held)
+    {
+        tr->lo_num = lo;
+        tr->lo_den = dt;
+        tr->hi_num = hi;
+        tr->hi_den = dt;
+        return;
+    }
+    if (lo * tr->lo_den > tr->lo_num * dt)
+    {
+        tr->lo_num = lo;
+        tr->lo_den = dt;
+    }
+    if (hi * tr->hi_den < tr->hi_num * dt)
+    {
+        tr->hi_num = hi;
+        tr->hi_den = dt;
+    }
+}
+
+// The line from the anchor to p stays within tol of every held input before it
+static bool line_fits(const trend_t *tr, const trend_point_t *p)
+{
+    uint64_t gap = p->t - tr->anchor.t;
+    if (gap > tr->cfg.max_gap)
+    {
+        return false;
+    }
+    if (!tr->held)
+    {
+        return true;
+    }
+    int64_t num = (int64_t)p->v - tr->anchor.v, dt = (int64_t)gap;
+    return num * tr->lo_den >= tr->lo_num * dt && num * tr->hi_den <= tr->hi_num * dt;
+}
+
+int trend_push(trend_t *tr, uint64_t t, int32_t v, trend_point_t *out)
+{
+    const trend_point_t p = {t, v};
+    tr->inputs++;
+    if (!tr->started)
+    {
+        tr->started = true;
+        return archive(tr, &p, out);
+    }
+
+    int n = 0;
+    if (tr->cfg.mode == TREND_DEADBAND)
+    {
+        if (t - tr->anchor.t > tr->cfg.max_gap && tr->held)
+        {
+            trend_point_t end = tr->last;
+            n += archive(tr, &end, out);
+        }
+        int64_t d = (int64_t)v - tr->anchor.v;
+        if (d > tr->cfg.tol || -d > tr->cfg.tol || t - tr->anchor.t > tr->cfg.max_gap)
+        {
+            return n + archive(tr, &p, &out[n]);
+        }
+        tr->last = p;
+        tr->held = true;
+        return n;
+    }
+
+    if (!line_fits(tr, &p))
+    {
+        // The held candidate ends this segment; start the next one there
+        if (tr->held)
+        {
+            trend_point_t end = tr->last;
+            n += archive(tr, &end, &out[n]);
+        }
+        if (t - tr->anchor.t > tr->cfg.max_gap)
+        {
+            return n + archive(tr, &p, &out[n]);
+        }
+    }
+    doors_add(tr, &p);
+    tr->last = p;
+    tr->held = true;
+    return n;
+}
+
+int trend_flush(trend_t *tr, trend_point_t *out)
+{
+    if (!tr->held)
+    {
+        return 0;
+    }
+    trend_point_t end = tr->last;
+    return archive(tr, &end, out);
+}
+
+int32_t trend_value_at(trend_mode_t mode, const trend_point_t *a, const trend_point_t *b, uint64_t t)
+{
+    if (mode == TREND_DEADBAND || b->t == a->t)
+    {
+        return t < b->t ? a->v : b->v;
+    }
+    // Nearest integer on the line, rounding halves up
+    int64_t den = (int64_t)(b->t - a->t);
+    int64_t num = 2 * ((int64_t)b->v - a->v) * (int64_t)(t - a->t) + den;
+    int64_t q = num / (2 * den);
+    if (num % (2 * den) < 0)
+    {
+        q--;
+    }
+    return (int32_t)(a->v + q);
+}
@@ -0,0 +1,87 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Deadband and swinging-door compression for slow trend logging
+ *
+ * Only points where the signal departs from what the archive already
+ * predicts are kept, with a hard bound on the reconstruction error at every
+ * input point:
+ *
+ * - Deadband: a point is archived when it moves more than tol away from the
+ *   last archived value; reconstruction holds that value.
+ * - Swinging door: reconstruction interpolates linearly between archived
+ *   points. From the last archived point the slopes that keep every later
+ *   input within tol form a window (the doors); an input becomes the
+ *   candidate end point while the straight line to it stays inside the
+ *   window built from the inputs before it. When one does not, the previous
+ *   candidate is archived and a new segment starts there. Archived values
+ *   are real inputs, and the bound holds exactly.
+ *
+ * Slopes are compared as integer fractions, so the bound holds in integer
+ * arithmetic; max_gap forces a point after that many time units, which also
+ * bounds the products. Values are typically decimated codes in a fixed-point
+ * format, with tol in the same units.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TREND_MAX_GAP (1u << 24)
+
+typedef enum
+{
+    TREND_DEADBAND,
+    TREND_SWINGING_DOOR,
+} trend_mode_t;
+
+typedef struct
+{
+    trend_mode_t mode;
+    int32_t tol;      // largest reconstruction error, >= 0; |values| below 2^20
+    uint32_t max_gap; // archive at least every max_gap time units, 1..TREND_MAX_GAP
+} trend_config_t;
+
+typedef struct
+{
+    uint64_t t;
+    int32_t v;
+} trend_point_t;
+
+typedef struct
+{
+    trend_config_t cfg;
+    bool started;
+    bool held;             // last holds a point not archived yet
+    trend_point_t anchor;  // last archived point
+    trend_point_t last;    // newest input, the current candidate end point in swinging-door mode
+    int64_t lo_num, hi_num; // door slopes lo_num / lo_den .. hi_num / hi_den from the anchor
+    int64_t lo_den, hi_den;
+    uint64_t inputs;
+    uint64_t archived;
+} trend_t;
+
+bool trend_init(trend_t *tr, const trend_config_t *cfg);
+
+// Feed one value at time t (strictly increasing). Returns how many points were archived into out (0..2).
+int trend_push(trend_t *tr, uint64_t t, int32_t v, trend_point_t *out);
+
+// Archive the newest input if it is not archived yet, e.g. at the end of a log. Returns 0 or 1.
+int trend_flush(trend_t *tr, trend_point_t *out);
+
+// Reconstructed value at time t between archived points a and b (a.t <= t <= b.t). The line is
+// rounded to the nearest integer, which keeps integer inputs within tol.
+int32_t trend_value_at(trend_mode_t mode, const trend_point_t *a, const trend_point_t *b, uint64_t t);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,103 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "trigger.h"
+
+#define PENDING_MASK (TRIGGER_MAX_PENDING - 1)
+
+bool trigger_init(trigger_t *trig, const trigger_config_t *cfg)
+{
+    memset(trig, 0, sizeof(*trig));
+    if (cfg->hysteresis <= 0 || cfg->post == 0)
+    {
+        return false;
+    }
+    int32_t arm = cfg->edge == TRIGGER_RISING ? (int32_t)cfg->level - cfg->hysteresis
+                                              : (int32_t)cfg->level + cfg->hysteresis;
+    if (arm < INT16_MIN || arm > INT16_MAX)
+    {
+        return false;
+    }
+    trig->cfg = *cfg;
+    return true;
+}
+
+void trigger_reset(trigger_t *trig)
+{
+    trig->armed = false;
+    trig->fired_once = false;
+    trig->pend_rd = trig->pend_wr;
+}
+
+static bool queue_trigger(trigger_t *trig, uint64_t pos)
+{
+    trig->last = pos;
+    trig->fired_once = true;
+    if (pos < trig->cfg.pre)
+    {
+        return false; // not enough history for the pre-trigger part
+    }
+    if (trig->pend_wr - trig->pend_rd == TRIGGER_MAX_PENDING)
+    {
+        trig->dropped++;
+        return false;
+    }
+    trig->pending[trig->pend_wr++ & PENDING_MASK] = pos;
+    trig->fired++;
+    return true;
+}
+
+uint32_t trigger_scan(trigger_t *trig, const sample_t *in, size_t n, uint64_t pos)
+{
+    const trigger_config_t *c = &trig->cfg;
+    uint32_t found = 0;
+    bool armed = trig->armed;
+
+    // Fold the falling edge into the rising one by negating levels and samples
+    const int32_t sign = c->edge == TRIGGER_RISING ? 1 : -1;
+    const int32_t fire = sign * c->level;
+    const int32_t arm = fire - c->hysteresis;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int32_t v = sign * in[i];
+        if (!armed)
+        {
+            armed = v <= arm;
+            continue;
+        }
+        if (v < fire)
+        {
+            continue;
+        }
+        armed = false;
+        uint64_t at = pos + i;
+        if (trig->fired_once && at - trig->last < c->holdoff)
+        {
+            continue;
+        }
+        found += queue_trigger(trig, at);
+    }
+    trig->armed = armed;
+    return found;
+}
+
+bool trigger_next_capture(trigger_t *trig, uint64_t head, uint64_t *trigger_pos)
+{
+    if (trig->pend_rd == trig->pend_wr)
+    {
+        return false;
+    }
+    uint64_t at = trig->pending[trig->pend_rd & PENDING_MASK];
+    if (at + trig->cfg.post > head)
+    {
+        return false;
+    }
+    trig->pend_rd++;
+    *trigger_pos = at;
+    return true;
+}
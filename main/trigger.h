@@ -0,0 +1,74 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Streaming edge trigger and capture window queue
+ *
+ * trigger_scan() looks for edges through a level with hysteresis: a rising
+ * trigger re-arms only after the signal has been at or below
+ * level - hysteresis, so noise on a slow edge fires once. Trigger positions are
+ * queued; a capture is [trigger - pre, trigger + post) in absolute sample
+ * positions, and trigger_next_capture() hands out captures once the ring
+ * head has passed their end, so consumers can read them in place.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRIGGER_MAX_PENDING 32 // power of 2
+
+typedef enum
+{
+    TRIGGER_RISING,
+    TRIGGER_FALLING,
+} trigger_edge_t;
+
+typedef struct
+{
+    trigger_edge_t edge;
+    sample_t level;
+    sample_t hysteresis; // > 0
+    uint32_t pre;        // samples kept before the trigger
+    uint32_t post;       // samples from the trigger on
+    uint32_t holdoff;    // minimum samples between triggers, 0 for every edge
+} trigger_config_t;
+
+typedef struct
+{
+    trigger_config_t cfg;
+    bool armed;
+    bool fired_once;
+    uint64_t last; // position of the last trigger
+    uint64_t pending[TRIGGER_MAX_PENDING];
+    uint32_t pend_rd;
+    uint32_t pend_wr;
+    uint32_t fired;   // triggers queued
+    uint32_t dropped; // triggers lost to a full queue
+} trigger_t;
+
+bool trigger_init(trigger_t *trig, const trigger_config_t *cfg);
+
+// Drop pending captures and wait for a fresh arm, e.g. after a gap in the input
+void trigger_reset(trigger_t *trig);
+
+// Scan n samples starting at absolute position pos; returns captures queued
+uint32_t trigger_scan(trigger_t *trig, const sample_t *in, size_t n, uint64_t pos);
+
+// Pop the oldest capture whose last sample is below head. Returns false if none is complete.
+bool trigger_next_capture(trigger_t *trig, uint64_t head, uint64_t *trigger_pos);
+
+static inline uint32_t trigger_capture_len(const trigger_t *trig)
+{
+    return trig->cfg.pre + trig->cfg.post;
+}
+
+#ifdef __cplusplus
+}
+#endif
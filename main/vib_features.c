@@ -0,0 +1,229 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <complex.h>
+#include <math.h>
+#include <string.h>
+#include "vib_features.h"
+
+#define COEF_FRAC_BITS 28
+#define BAND_FRAC_BITS 8
+// Samples per exact int64 power sum: 13-bit codes less an offset stay below 2^13, so d^4 < 2^52
+#define CHUNK 256
+
+// Fourth-order Butterworth band-pass: the second-order low-pass prototype through the low-pass to
+// band-pass transform gives two pole pairs, one section each with a zero at DC and one at Nyquist.
+// Edges are prewarped for the bilinear transform.
+static bool bandpass_design(vib_bandpass_t *bp, float lo_hz, float hi_hz, float rate_hz)
+{
+    if (lo_hz <= 0 || hi_hz <= lo_hz || hi_hz >= rate_hz / 2)
+    {
+        return false;
+    }
+    const double k = 2.0 * rate_hz;
+    double w1 = k * tan(M_PI * lo_hz / rate_hz), w2 = k * tan(M_PI * hi_hz / rate_hz);
+    double bw = w2 - w1, w0sq = w1 * w2;
+    double complex p = cexp(I * 3 * M_PI / 4); // prototype pole; its conjugate gives the conjugate pairs
+    double complex root = csqrt(p * p * bw * bw - 4 * w0sq);
+    double complex poles[2] = {(p * bw + root) / 2, (p * bw - root) / 2};
+    const double one = (double)(1 << COEF_FRAC_BITS);
+    memset(bp, 0, sizeof(*bp));
+    for (int i = 0; i < 2; i++)
+    {
+        // bw s / (s^2 + a s + c) through s = k (1 - z^-1) / (1 + z^-1)
+        double a = -2 * creal(poles[i]), c = creal(poles[i] * conj(poles[i]));
+        double d0 = k * k + a * k + c;
+        bp->sec[i].b0 = (int32_t)lrint(bw * k / d0 * one);
+        bp->sec[i].a1 = (int32_t)lrint((2 * c - 2 * k * k) / d0 * one);
+        bp->sec[i].a2 = (int32_t)lrint((k * k - a * k + c) / d0 * one);
+    }
+    return true;
+}
+
+bool vib_init(vib_t *v, const vib_config_t *cfg, vib_features_cb_t cb, void *ctx)
+{
+    memset(v, 0, sizeof(*v));
+    if (cfg->sample_rate_hz == 0 || cfg->window_shift < 8 || cfg->window_shift > 24 ||
+        cfg->band_decim_shift > 16 || cfg->band_decim_shift >= cfg->window_shift || cfg->num_bands > VIB_MAX_BANDS)
+    {
+        return false;
+    }
+    float band_rate = (float)cfg->sample_rate_hz / (1u << cfg->band_decim_shift);
+    for (int b = 0; b < cfg->num_bands; b++)
+    {
+        if (!bandpass_design(&v->bp[b], cfg->bands[b].lo_hz, cfg->bands[b].hi_hz, band_rate))
+        {
+            return false;
+        }
+    }
+    v->cfg = *cfg;
+    v->cb = cb;
+    v->cb_ctx = ctx;
+    return true;
+}
+
+static void clear_window(vib_t *v)
+{
+    v->count = 0;
+    v->s1 = v->s2 = v->s3 = v->s4 = 0;
+    v->min = INT16_MAX;
+    v->max = INT16_MIN;
+    for (int b = 0; b < v->cfg.num_bands; b++)
+    {
+        v->bp[b].energy = 0;
+    }
+}
+
+void vib_reset(vib_t *v)
+{
+    for (int b = 0; b < v->cfg.num_bands; b++)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            vib_biquad_t *q = &v->bp[b].sec[i];
+            q->x1 = q->x2 = q->y1 = q->y2 = 0;
+        }
+    }
+    v->dec_sum = 0;
+    v->dec_count = 0;
+    v->primed = false;
+    clear_window(v);
+}
+
+static int32_t biquad_step(vib_biquad_t *q, int32_t x)
+{
+    int64_t acc = (int64_t)q->b0 * (x - q->x2) - (int64_t)q->a1 * q->y1 - (int64_t)q->a2 * q->y2;
+    int32_t y = (int32_t)((acc + (1 << (COEF_FRAC_BITS - 1))) >> COEF_FRAC_BITS);
+    q->x2 = q->x1;
+    q->x1 = x;
+    q->y2 = q->y1;
+    q->y1 = y;
+    return y;
+}
+
+static void bands_step(vib_t *v, int32_t x)
+{
+    for (int b = 0; b < v->cfg.num_bands; b++)
+    {
+        vib_bandpass_t *bp = &v->bp[b];
+        int32_t y = biquad_step(&bp->sec[1], biquad_step(&bp->sec[0], x));
+        bp->energy += (uint64_t)((int64_t)y * y) >> BAND_FRAC_BITS;
+    }
+}
+
+static void finish_window(vib_t *v)
+{
+    const double n = v->count;
+    double m1 = v->s1 / n, e2 = v->s2 / n, e3 = v->s3 / n, e4 = v->s4 / n;
+    double mu2 = e2 - m1 * m1;
+    double mu3 = e3 - 3 * m1 * e2 + 2 * m1 * m1 * m1;
+    double mu4 = e4 - 4 * m1 * e3 + 6 * m1 * m1 * e2 - 3 * m1 * m1 * m1 * m1;
+    double mean = v->offset + m1;
+
+    vib_features_t f = {
+        .pos = v->start,
+        .mean = (float)mean,
+        .rms = (float)sqrt(mu2 > 0 ? mu2 : 0),
+        .peak = (float)fmax(v->max - mean, mean - v->min),
+    };
+    f.crest = f.rms > 0 ? f.peak / f.rms : 0;
+    f.skewness = mu2 > 0 ? (float)(mu3 / (mu2 * sqrt(mu2))) : 0;
+    f.kurtosis = mu2 > 0 ? (float)(mu4 / (mu2 * mu2)) : 0;
+    const double band_n = (double)(1u << (v->cfg.window_shift - v->cfg.band_decim_shift)) * (1 << BAND_FRAC_BITS);
+    for (int b = 0; b < v->cfg.num_bands; b++)
+    {
+        f.band_rms[b] = (float)sqrt(v->bp[b].energy / band_n);
+    }
+    v->vectors++;
+    if (v->cb)
+    {
+        v->cb(v->cb_ctx, &f);
+    }
+
+    // Centre the next window's sums on this one's mean so they stay small and exact
+    v->offset = (int32_t)lrint(mean);
+    clear_window(v);
+}
+
+void vib_process(vib_t *v, const sample_t *in, size_t n, uint64_t pos)
+{
+    const uint32_t window = 1u << v->cfg.window_shift;
+    const uint8_t dshift = v->cfg.band_decim_shift;
+    if (!v->primed && n > 0)
+    {
+        // Start the band filters and the offset at the first level, without a step from zero
+        int32_t x = (int32_t)in[0] << BAND_FRAC_BITS;
+        for (int b = 0; b < v->cfg.num_bands; b++)
+        {
+            v->bp[b].sec[0].x1 = v->bp[b].sec[0].x2 = x;
+        }
+        v->offset = in[0];
+        clear_window(v);
+        v->primed = true;
+    }
+    while (n > 0)
+    {
+        if (v->count == 0)
+        {
+            v->start = pos;
+        }
+        size_t len = window - v->count;
+        len = len < CHUNK ? len : CHUNK;
+        len = len < n ? len : n;
+
+        int64_t s1 = 0, s2 = 0, s3 = 0, s4 = 0;
+        sample_t lo = v->min, hi = v->max;
+        for (size_t i = 0; i < len; i++)
+        {
+            int64_t d = in[i] - v->offset;
+            int64_t d2 = d * d;
+            s1 += d;
+            s2 += d2;
+            s3 += d2 * d;
+            s4 += d2 * d2;
+            lo = in[i] < lo ? in[i] : lo;
+            hi = in[i] > hi ? in[i] : hi;
+            if (v->cfg.num_bands)
+            {
+                v->dec_sum += in[i];
+                if (++v->dec_count == 1u << dshift)
+                {
+                    bands_step(v, (int32_t)(((int64_t)v->dec_sum << BAND_FRAC_BITS) >> dshift));
+                    v->dec_sum = 0;
+                    v->dec_count = 0;
+                }
+            }
+        }
+        v->s1 += (double)s1;
+        v->s2 += (double)s2;
+        v->s3 += (double)s3;
+        v->s4 += (double)s4;
+        v->min = lo;
+        v->max = hi;
+        v->count += len;
+        if (v->count == window)
+        {
+            finish_window(v);
+        }
+        in += len;
+        pos += len;
+        n -= len;
+    }
+}
+
+int vib_features_to_array(const vib_features_t *f, uint8_t num_bands, float *out)
+{
+    out[0] = log2f(1 + f->rms);
+    out[1] = log2f(1 + f->peak);
+    out[2] = f->crest;
+    out[3] = f->skewness;
+    out[4] = log2f(f->kurtosis > 0.5f ? f->kurtosis : 0.5f);
+    for (int b = 0; b < num_bands; b++)
+    {
+        out[5 + b] = log2f(1 + f->band_rms[b]);
+    }
+    return 5 + num_bands;
+}
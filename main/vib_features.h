@@ -0,0 +1,109 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2022 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Vibration condition-monitoring features
+ *
+ * Each window of 2^window_shift samples is reduced to one feature vector:
+ * mean, AC RMS, peak (largest excursion from the mean), crest factor,
+ * skewness, kurtosis (3 for Gaussian noise, 1.5 for a sine, large for
+ * impacts) and the RMS in up to VIB_MAX_BANDS frequency bands.
+ *
+ * Moments accumulate incrementally as exact integer power sums of the
+ * samples less an offset (the previous window's mean), 256 samples at a
+ * time in 64 bits, then in double per window; the central moments are
+ * formed once per window. Samples are expected to be ADC codes of up to
+ * 13 bits so the fourth powers fit.
+ *
+ * Band energies come from fourth-order Butterworth band-passes (two Q28
+ * fixed-point sections each, -3 dB at the band edges, skirts 12 dB/octave).
+ * They run on the input averaged over 2^band_decim_shift samples, so low
+ * bands stay well conditioned at 1 MSPS and cost little per raw sample.
+ */
+#pragma once
+
+#include "sample_ring.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VIB_MAX_BANDS 8
+
+typedef struct
+{
+    float lo_hz;
+    float hi_hz;
+} vib_band_t;
+
+typedef struct
+{
+    uint32_t sample_rate_hz;
+    uint8_t window_shift;     // samples per feature vector, 2^8..2^24
+    uint8_t band_decim_shift; // band filters run at sample_rate_hz / 2^band_decim_shift, below window_shift
+    uint8_t num_bands;        // 0..VIB_MAX_BANDS
+    vib_band_t bands[VIB_MAX_BANDS];
+} vib_config_t;
+
+typedef struct
+{
+    uint64_t pos; // absolute position of the window's first sample
+    float mean;   // codes
+    float rms;    // codes, DC removed
+    float peak;   // codes from the mean
+    float crest;  // peak / rms
+    float skewness;
+    float kurtosis;
+    float band_rms[VIB_MAX_BANDS]; // codes
+} vib_features_t;
+
+typedef void (*vib_features_cb_t)(void *ctx, const vib_features_t *f);
+
+typedef struct
+{
+    int32_t b0, a1, a2; // Q28; b1 = 0 and b2 = -b0 for a band-pass
+    int32_t x1, x2;     // Q8 codes
+    int32_t y1, y2;
+} vib_biquad_t;
+
+typedef struct
+{
+    vib_biquad_t sec[2];
+    uint64_t energy; // sum of y^2 over the window, Q8 codes^2
+} vib_bandpass_t;
+
+typedef struct
+{
+    vib_config_t cfg;
+    vib_features_cb_t cb;
+    void *cb_ctx;
+    vib_bandpass_t bp[VIB_MAX_BANDS];
+    bool primed;        // offset holds a level near the signal
+    int32_t offset;     // subtracted before the power sums
+    uint64_t start;     // absolute position of the current window
+    uint32_t count;     // samples into the current window
+    double s1, s2, s3, s4; // power sums of (x - offset)
+    sample_t min, max;
+    int32_t dec_sum;    // band input: samples summed towards the next decimated value
+    uint32_t dec_count;
+    uint32_t vectors;   // feature vectors emitted
+} vib_t;
+
+bool vib_init(vib_t *v, const vib_config_t *cfg, vib_features_cb_t cb, void *ctx);
+
+// Drop the partial window and the band filter state, e.g. after a gap in the input
+void vib_reset(vib_t *v);
+
+// Accumulate n samples, in[0] at absolute position pos; cb runs for every completed window
+void vib_process(vib_t *v, const sample_t *in, size_t n, uint64_t pos);
+
+// Classifier inputs from a vector: log2(1 + x) of rms and peak, crest, skewness, log2 kurtosis,
+// then log2(1 + x) of each band RMS. Returns the count, 5 + num_bands.
+int vib_features_to_array(const vib_features_t *f, uint8_t num_bands, float *out);
+
+#ifdef __cplusplus
+}
+#endif